@@ -22,6 +22,9 @@ while(True):
     # blured togheter. A smaller value means they have to be closer.
     # A larger value is less strict.
 
+    # fast=True approximates the filter with a cost that doesn't grow with the kernel
+    # size, use it for kernel sizes above 2.
+
     # Run the kernel on every pixel of the image.
     img.bilateral(3, color_sigma=0.1, space_sigma=1)
 
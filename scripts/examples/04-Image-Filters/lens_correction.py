@@ -13,9 +13,17 @@ sensor.set_framesize(sensor.QVGA)
 sensor.skip_frames(time = 2000)
 clock = time.clock()
 
+# The remap table keeps the source pixel of a grid of output pixels (1.3KB of heap
+# at QVGA) so the correction math only runs on the first frame (and again if the
+# arguments change). The grid is not bit-identical to lens_corr() without a table,
+# about 5% of the pixels come from a source pixel next to the one lens_corr() picks.
+# Pass bilinear=True to interpolate between source pixels instead. print(remap)
+# shows if the last call used the table.
+remap = image.RemapTable()
+
 while(True):
     clock.tick()
 
-    img = sensor.snapshot().lens_corr(strength = 1.8, zoom = 1.0)
+    img = sensor.snapshot().lens_corr(strength = 1.8, zoom = 1.0, remap = remap)
 
     print(clock.fps())
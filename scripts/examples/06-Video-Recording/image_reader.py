@@ -4,6 +4,9 @@
 #
 # This example shows how to use the Image Reader object to replay snapshots of what your
 # OpenMV Cam saw saved by the Image Writer object for testing machine vision algorithms.
+#
+# Streams closed by the Image Writer object have a frame index so you can jump to any frame
+# with seek(frame) or to any point in time with seek_ms(ms).
 
 import sensor, image, time
 
@@ -5,6 +5,9 @@
 # This example shows how to use the Image Writer object to record snapshots of what your
 # OpenMV Cam sees for later analysis using the Image Reader object. Images written to disk
 # by the Image Writer object are stored in a simple file format readable by your OpenMV Cam.
+#
+# Frames are lossless compressed by default. Pass quality=1-100 to add_frame() to store them
+# as JPEG images instead (smaller but lossy) or lossless=False to store them uncompressed.
 
 import sensor, image, pyb, time
 
@@ -0,0 +1,24 @@
+# MJPEG Reader Example
+#
+# Note: You will need an SD card to run this demo.
+#
+# This example shows how to use the Mjpeg Reader object to replay a recording
+# saved by the Mjpeg object. Frames are looked up in the file index so any frame
+# can be read directly without scanning the file.
+
+import sensor, image, time, mjpeg
+
+m = mjpeg.MjpegReader("example.mjpeg")
+print("%d frames at %f FPS" % (m.count(), m.fps()))
+
+clock = time.clock()
+
+# Play the recording backwards.
+for i in range(m.count() - 1, -1, -1):
+    clock.tick()
+    img = m.read_frame(i, copy_to_fb=True)
+    # Do machine vision algorithms on the image here.
+
+    print(clock.fps())
+
+m.close()
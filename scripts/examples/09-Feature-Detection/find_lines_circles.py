@@ -0,0 +1,39 @@
+# Find Lines and Circles Example
+#
+# This example shows off how to find lines and circles in the same image while
+# computing the image's gradient only once per frame.
+#
+# find_lines() and find_circles() both start by computing the sobel gradient of
+# the image. An image.Gradient object holds that gradient so that it can be
+# computed once by img.gradient() and then passed to both methods.
+#
+# The gradient is kept in heap memory (about 38KB at QQVGA with x_stride=2), so
+# create it once and reuse it, it's only valid for the frame it was computed on.
+
+import sensor, image, time
+
+sensor.reset()
+sensor.set_pixformat(sensor.GRAYSCALE)
+sensor.set_framesize(sensor.QQVGA)
+sensor.skip_frames(time = 2000)
+clock = time.clock()
+
+# The roi and the x/y strides of the gradient replace the ones of find_lines()
+# and find_circles() when the gradient is passed to them.
+grad = image.Gradient((0, 0, sensor.width(), sensor.height()), x_stride = 2, y_stride = 1)
+
+while(True):
+    clock.tick()
+    img = sensor.snapshot()
+
+    # The gradient must be recomputed after every snapshot.
+    img.gradient(grad)
+
+    for l in img.find_lines(threshold = 1000, theta_margin = 25, rho_margin = 25, gradient = grad):
+        img.draw_line(l.line(), color = 127)
+
+    for c in img.find_circles(threshold = 2000, x_margin = 10, y_margin = 10, r_margin = 10,
+            r_min = 2, r_max = 100, r_step = 2, gradient = grad):
+        img.draw_circle(c.x(), c.y(), c.r(), color = 255)
+
+    print("FPS %f" % clock.fps())
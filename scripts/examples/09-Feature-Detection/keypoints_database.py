@@ -0,0 +1,51 @@
+# Object recognition with a keypoints database example.
+# Many keypoints descriptors saved with keypoints_save.py are collected into one database file
+# the first time the script runs. The database is then loaded once and each frame is matched
+# against all the objects in a single call. NOTE: see the docs for arguments to tune find_keypoints.
+import sensor, time, image, os
+
+# Reset sensor
+sensor.reset()
+
+# Sensor settings
+sensor.set_contrast(3)
+sensor.set_gainceiling(16)
+sensor.set_framesize(sensor.VGA)
+sensor.set_windowing((320, 240))
+sensor.set_pixformat(sensor.GRAYSCALE)
+
+sensor.skip_frames(time = 2000)
+sensor.set_auto_gain(False, value=100)
+
+# Descriptors of the objects, the position in the list is the object number. The database is kept
+# in the heap, each keypoint takes 78 bytes with the search index. With 190KB of heap free on the
+# OpenMV Cam H7 it holds about 2400 keypoints, 16 objects saved with max_keypoints=150 or 24 with
+# max_keypoints=100. The OpenMV Cam M7 holds about 280 keypoints, one or two objects.
+OBJECTS = ["/desc0.orb", "/desc1.orb", "/desc2.orb"]
+DATABASE = "/objects.orb"
+
+if not DATABASE[1:] in os.listdir():
+    db = image.KeypointDatabase()
+    for path in OBJECTS:
+        db.add(image.load_descriptor(path))
+    # The database file also holds the search index, so loading it later is fast.
+    image.save_descriptor(db, DATABASE)
+
+db = image.load_descriptor(DATABASE)
+print(db)
+
+clock = time.clock()
+while (True):
+    clock.tick()
+    img = sensor.snapshot()
+    kpts = img.find_keypoints(max_keypoints=150, threshold=10, normalized=True)
+    if (kpts):
+        # Returns a list of (object, matches) tuples with the best matching object first.
+        matches = image.match_descriptor(db, kpts, threshold=85)
+        if (matches and matches[0][1] > 10):
+            # If we have at least n "good matches"
+            img.draw_string(0, 10, "Object:%d" % matches[0][0])
+        print(kpts, matches)
+
+    # Draw FPS
+    img.draw_string(0, 0, "FPS:%.2f"%(clock.fps()))
@@ -29,19 +29,18 @@ sensor.set_framesize(sensor.B64X64) # Set frame size to 64x64... (or 64x32)...
 sensor.skip_frames(time = 2000)     # Wait for settings take effect.
 clock = time.clock()                # Create a clock object to track the FPS.
 
-# Take from the main frame buffer's RAM to allocate a second frame buffer.
-# There's a lot more RAM in the frame buffer than in the MicroPython heap.
-# However, after doing this you have a lot less RAM for some algorithms...
-# So, be aware that it's a lot easier to get out of RAM issues now.
-extra_fb = sensor.alloc_extra_fb(sensor.width(), sensor.height(), sensor.RGB565)
-extra_fb.replace(sensor.snapshot())
+# The tracker keeps the FFT of the previous image so each new image is
+# only transformed once and no second frame buffer is needed. Passing it
+# to find_displacement() compares the image against the previous image
+# passed with it and then replaces that image. The first call returns a
+# response of 0.
+tracker = image.DisplacementTracker()
 
 while(True):
     clock.tick() # Track elapsed milliseconds between snapshots().
     img = sensor.snapshot() # Take a picture and return the image.
 
-    displacement = extra_fb.find_displacement(img)
-    extra_fb.replace(img)
+    displacement = img.find_displacement(tracker)
 
     # Offset results are noisy without filtering so we drop some accuracy.
     sub_pixel_x = int(displacement.x_translation() * 5) / 5.0
@@ -0,0 +1,1390 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * imlib benchmark runner.
+ *
+ * Every benchmark runs on a unittest image scaled to QQVGA/QVGA/VGA and copied
+ * into the frame buffer (like copy_to_fb=True), so fb_alloc sees the same free
+ * memory that it would see on a camera. For each run we print the best time in
+ * ns/pixel, the peak number of fb_alloc bytes touched and a digest of the output
+ * so that changes in results show up next to changes in speed.
+ *
+ * With -p the fb_alloc profiler is enabled and the allocation sites of every run
+ * are printed. Addresses are offsets into the bench binary for addr2line.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mp.h>
+#include "imlib.h"
+#include "ff_wrapper.h"
+#include "framebuffer.h"
+#include "fb_alloc.h"
+#include "fft.h"
+#include "host.h"
+
+#define BENCH_GRAYSCALE     (1 << IMAGE_BPP_GRAYSCALE)
+#define BENCH_RGB565        (1 << IMAGE_BPP_RGB565)
+#define BENCH_BOTH          (BENCH_GRAYSCALE | BENCH_RGB565)
+
+#define BENCH_MIN_ITERATIONS    3
+#define BENCH_MAX_ITERATIONS    100
+#define BENCH_TIME_BUDGET_NS    (250 * 1000000ULL)
+
+typedef uint32_t (*bench_run_t)(image_t *img);
+
+typedef struct bench {
+    const char *name;
+    const char *image;  // File in the unittest data directory.
+    int formats;        // Pixel formats the benchmark is run on.
+    bench_run_t run;    // Returns a digest of the output.
+} bench_t;
+
+typedef struct bench_resolution {
+    const char *name;
+    int w, h;
+} bench_resolution_t;
+
+static const bench_resolution_t bench_resolutions[] = {
+    { "QQVGA", 160, 120 },
+    { "QVGA",  320, 240 },
+    { "VGA",   640, 480 },
+};
+
+static const char *data_dir = "../../scripts/unittest/data";
+static bool profile = false;
+
+////////////////////////
+// Digest Helpers     //
+////////////////////////
+
+static uint32_t bench_hash(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619; // FNV-1a
+    }
+    return h;
+}
+
+#define BENCH_HASH_INIT     (2166136261)
+#define BENCH_HASH_VAL(h, v) ({ __typeof__ (v) _v = (v); bench_hash((h), &_v, sizeof(_v)); })
+
+static uint32_t bench_hash_image(image_t *img)
+{
+    return bench_hash(BENCH_HASH_INIT, img->data, image_size(img));
+}
+
+// Hashes the list elements up to (not including) the first pointer member and frees the list.
+static uint32_t bench_hash_list(list_t *list, size_t len)
+{
+    uint32_t h = BENCH_HASH_VAL(BENCH_HASH_INIT, (uint32_t) list_size(list));
+    for (list_lnk_t *it = iterator_start_from_head(list); it; it = iterator_next(it)) {
+        h = bench_hash(h, it->data, len);
+    }
+    list_free(list);
+    return h;
+}
+
+// Like bench_hash_list() but also hashes and frees the decoded payload string.
+#define BENCH_HASH_PAYLOAD_LIST(list, type) \
+    bench_hash_payload_list((list), offsetof(type, payload_len), offsetof(type, payload))
+
+static uint32_t bench_hash_payload_list(list_t *list, size_t len_offset, size_t payload_offset)
+{
+    uint32_t h = BENCH_HASH_VAL(BENCH_HASH_INIT, (uint32_t) list_size(list));
+    for (list_lnk_t *it = iterator_start_from_head(list); it; it = iterator_next(it)) {
+        char *payload = *((char **) (((char *) it->data) + payload_offset));
+        h = bench_hash(h, it->data, payload_offset);
+        h = bench_hash(h, payload, *((size_t *) (((char *) it->data) + len_offset)));
+        xfree(payload);
+    }
+    list_free(list);
+    return h;
+}
+
+static uint32_t bench_hash_array(array_t *array, size_t len)
+{
+    uint32_t h = BENCH_HASH_VAL(BENCH_HASH_INIT, (uint32_t) array_length(array));
+    for (int i = 0, j = array_length(array); i < j; i++) {
+        h = bench_hash(h, array_at(array, i), len);
+    }
+    array_free(array);
+    return h;
+}
+
+////////////////////////
+// Benchmarks         //
+////////////////////////
+
+static rectangle_t bench_roi(image_t *img)
+{
+    rectangle_t roi = { .x = 0, .y = 0, .w = img->w, .h = img->h };
+    return roi;
+}
+
+static void bench_thresholds(list_t *thresholds, image_t *img)
+{
+    list_init(thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    if (img->bpp == IMAGE_BPP_GRAYSCALE) {
+        color_thresholds_list_lnk_data_t t0 = { 0, 64, 0, 0, 0, 0 };
+        color_thresholds_list_lnk_data_t t1 = { 128, 255, 0, 0, 0, 0 };
+        list_push_back(thresholds, &t0);
+        list_push_back(thresholds, &t1);
+    } else {
+        color_thresholds_list_lnk_data_t t0 = { 0, 100, 56, 95, 41, 74 }; // generic_red_thresholds
+        color_thresholds_list_lnk_data_t t1 = { 0, 100, -128, -22, -128, 99 }; // generic_green_thresholds
+        color_thresholds_list_lnk_data_t t2 = { 0, 100, -128, 98, -128, -16 }; // generic_blue_thresholds
+        list_push_back(thresholds, &t0);
+        list_push_back(thresholds, &t1);
+        list_push_back(thresholds, &t2);
+    }
+}
+
+static uint32_t bench_find_blobs(image_t *img)
+{
+    list_t thresholds, out;
+    rectangle_t roi = bench_roi(img);
+    bench_thresholds(&thresholds, img);
+    imlib_find_blobs(&out, img, &roi, 1, 1, &thresholds, false, NULL, 200, 200, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0);
+    list_free(&thresholds);
+    // Stop before the padding in front of the histogram pointers.
+    return bench_hash_list(&out, offsetof(find_blobs_list_lnk_data_t, y_hist_bins_count) + sizeof(uint16_t));
+}
+
+static uint32_t bench_binary(image_t *img)
+{
+    list_t thresholds;
+    bench_thresholds(&thresholds, img);
+    imlib_binary(img, img, &thresholds, false, NULL, false, NULL);
+    list_free(&thresholds);
+    return bench_hash_image(img);
+}
+
+// Same digest as binary but with the tables compiled once, like image.Thresholds().
+static uint32_t bench_binary_compiled(image_t *img)
+{
+    static uint8_t *compiled = NULL;
+    list_t thresholds;
+    bench_thresholds(&thresholds, img);
+    if (!compiled) {
+        compiled = xalloc(COLOR_THRESHOLDS_LUT_RGB565_SIZE);
+        imlib_color_thresholds_lut_build(compiled, &thresholds);
+    }
+    imlib_binary(img, img, &thresholds, false, compiled, false, NULL);
+    list_free(&thresholds);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_histogram_stats(image_t *img, rectangle_t *roi)
+{
+    histogram_t hist = {
+        .LBinCount = 256, .ABinCount = (img->bpp == IMAGE_BPP_RGB565) ? 256 : 0,
+        .BBinCount = (img->bpp == IMAGE_BPP_RGB565) ? 256 : 0
+    };
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+    hist.ABins = fb_alloc(hist.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
+    hist.BBins = fb_alloc(hist.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+    imlib_get_histogram(&hist, img, roi, &thresholds, false, NULL, NULL);
+    statistics_t stats;
+    imlib_get_statistics(&stats, img->bpp, &hist);
+    list_free(&thresholds);
+    return bench_hash(BENCH_HASH_INIT, &stats, sizeof(stats));
+}
+
+static uint32_t bench_get_histogram(image_t *img)
+{
+    rectangle_t roi = bench_roi(img);
+    return bench_histogram_stats(img, &roi);
+}
+
+// Same digest as get_histogram but computed on a strided view of the roi.
+static uint32_t bench_get_histogram_view(image_t *img)
+{
+    rectangle_t roi = bench_roi(img);
+    image_t view;
+    image_init_view(&view, img, &roi);
+    rectangle_t all = { 0, 0, view.w, view.h };
+    return bench_histogram_stats(&view, &all);
+}
+
+static uint32_t bench_mean_filter(image_t *img)
+{
+    imlib_mean_filter(img, 2, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_median_filter(image_t *img)
+{
+    imlib_median_filter(img, 2, 0.5f, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_mode_filter(image_t *img)
+{
+    imlib_mode_filter(img, 1, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_midpoint_filter(image_t *img)
+{
+    imlib_midpoint_filter(img, 1, 0.5f, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_gaussian(image_t *img)
+{
+    // Same kernel as Image.gaussian(2).
+    const int krn[25] = { 1,  4,  6,  4, 1,
+                          4, 16, 24, 16, 4,
+                          6, 24, 36, 24, 6,
+                          4, 16, 24, 16, 4,
+                          1,  4,  6,  4, 1 };
+    imlib_morph(img, 2, krn, 1.0f / 256, 0, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_bilateral_filter(image_t *img)
+{
+    imlib_bilateral_filter(img, 1, 0.1f, 1.0f, false, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_bilateral_filter_fast(image_t *img)
+{
+    imlib_bilateral_filter(img, 3, 0.1f, 1.0f, true, false, 0, false, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_erode(image_t *img)
+{
+    imlib_erode(img, 1, 4, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_histeq(image_t *img)
+{
+    imlib_histeq(img, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_clahe(image_t *img)
+{
+    imlib_clahe_histeq(img, 2.0f, NULL);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_gamma_corr(image_t *img)
+{
+    imlib_gamma_corr(img, 0.5f, 1.0f, 0.0f);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_lens_corr(image_t *img)
+{
+    imlib_lens_corr(img, 1.8f, 1.0f, 0.0f, 0.0f);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_rotation_corr(image_t *img)
+{
+    imlib_rotation_corr(img, 10.0f, 10.0f, 10.0f, 0.0f, 0.0f, 1.0f, 60.0f, NULL);
+    return bench_hash_image(img);
+}
+
+// Correction with a remap table kept across frames, only the first frame builds it.
+static bool bench_remap(image_t *img)
+{
+    static remap_t remap;
+    static void *buf;
+    static size_t buf_size;
+
+    size_t size = imlib_remap_size(img->w, img->h);
+    if (buf_size < size) {
+        xfree(buf);
+        buf = xalloc(size);
+        buf_size = size;
+    }
+
+    if (!imlib_lens_corr_remap(&remap, buf, img, false, 1.8f, 1.0f, 0.0f, 0.0f)) {
+        return false;
+    }
+
+    imlib_remap(img, &remap);
+    return true;
+}
+
+static uint32_t bench_lens_corr_remap(image_t *img)
+{
+    return bench_remap(img) ? bench_hash_image(img) : 0;
+}
+
+// Checks the table against the direct lens_corr() on images whose pixels hold their own x or y
+// coordinate plus one. Pixels that both paths fill must come from source pixels at most one pixel
+// apart, the digest hashes the number of pixels that differ and the largest distance.
+static uint32_t bench_lens_corr_remap_diff(image_t *img)
+{
+    image_t coords = { .w = img->w, .h = img->h, .bpp = IMAGE_BPP_RGB565 };
+    image_t table = coords;
+    coords.data = fb_alloc(image_size(&coords), FB_ALLOC_NO_HINT);
+    table.data = fb_alloc(image_size(&table), FB_ALLOC_NO_HINT);
+    uint32_t count = 0, max_dist = 0;
+
+    for (int axis = 0; axis < 2; axis++) {
+        for (int y = 0; y < coords.h; y++) {
+            uint16_t *row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&coords, y);
+            for (int x = 0; x < coords.w; x++) {
+                row[x] = (axis ? y : x) + 1;
+            }
+        }
+
+        memcpy(table.data, coords.data, image_size(&coords));
+        imlib_lens_corr(&coords, 1.8f, 1.0f, 0.0f, 0.0f);
+        if (!bench_remap(&table)) {
+            break;
+        }
+
+        for (int y = 0; y < coords.h; y++) {
+            uint16_t *row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&coords, y);
+            uint16_t *table_row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&table, y);
+            for (int x = 0; x < coords.w; x++) {
+                if (row[x] != table_row[x]) {
+                    count += 1;
+                    if (row[x] && table_row[x]) {
+                        max_dist = IM_MAX(max_dist, abs(row[x] - table_row[x]));
+                    }
+                }
+            }
+        }
+    }
+
+    fb_free();
+    fb_free();
+
+    if (max_dist > 1) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Remap table is off by more than a pixel!"));
+    }
+
+    return BENCH_HASH_VAL(BENCH_HASH_VAL(BENCH_HASH_INIT, count), max_dist);
+}
+
+// Half size copies of the frame, draw_image() is the scaler the warp engine replaces.
+static uint32_t bench_half(image_t *img, bool warp, image_hint_t hint)
+{
+    image_t dst;
+    image_init(&dst, img->w / 2, img->h / 2, img->bpp, NULL);
+    dst.data = fb_alloc0(image_size(&dst), FB_ALLOC_NO_HINT);
+
+    if (warp) {
+        imlib_resize(&dst, img, &((rectangle_t) {0, 0, img->w, img->h}), hint);
+    } else {
+        imlib_draw_image(&dst, img, 0, 0, 0.5f, 0.5f, 256, NULL, NULL, NULL, hint);
+    }
+
+    uint32_t digest = bench_hash_image(&dst);
+    fb_free();
+    return digest;
+}
+
+static uint32_t bench_draw_image_half(image_t *img)
+{
+    return bench_half(img, false, 0);
+}
+
+static uint32_t bench_draw_image_half_bl(image_t *img)
+{
+    return bench_half(img, false, IMAGE_HINT_BILINEAR);
+}
+
+static uint32_t bench_resize_half(image_t *img)
+{
+    return bench_half(img, true, 0);
+}
+
+static uint32_t bench_resize_half_bl(image_t *img)
+{
+    return bench_half(img, true, IMAGE_HINT_BILINEAR);
+}
+
+static uint32_t bench_resize_half_area(image_t *img)
+{
+    return bench_half(img, true, IMAGE_HINT_AREA);
+}
+
+// Doubles the center quarter of the frame back to full size.
+static uint32_t bench_resize_double_bl(image_t *img)
+{
+    image_t dst;
+    image_init(&dst, img->w, img->h, img->bpp, NULL);
+    dst.data = fb_alloc(image_size(&dst), FB_ALLOC_NO_HINT);
+    imlib_resize(&dst, img, &((rectangle_t) {img->w / 4, img->h / 4, img->w / 2, img->h / 2}), IMAGE_HINT_BILINEAR);
+    uint32_t digest = bench_hash_image(&dst);
+    fb_free();
+    return digest;
+}
+
+static uint32_t bench_warp(image_t *img, bool perspective)
+{
+    // 10 degree rotation about the center, the perspective one also tilts the plane.
+    float c = cosf(10.0f * M_PI / 180.0f), s = sinf(10.0f * M_PI / 180.0f);
+    float cx = img->w / 2.0f, cy = img->h / 2.0f;
+    float transform[9] = {
+        c, -s, cx - (c * cx) + (s * cy),
+        s,  c, cy - (s * cx) - (c * cy),
+        perspective ? (0.2f / img->w) : 0.0f, perspective ? (0.1f / img->h) : 0.0f, 1.0f
+    };
+
+    image_t dst;
+    image_init(&dst, img->w, img->h, img->bpp, NULL);
+    dst.data = fb_alloc(image_size(&dst), FB_ALLOC_NO_HINT);
+    imlib_warp(&dst, img, transform, IMAGE_HINT_BILINEAR);
+    uint32_t digest = bench_hash_image(&dst);
+    fb_free();
+    return digest;
+}
+
+static uint32_t bench_warp_affine(image_t *img)
+{
+    return bench_warp(img, false);
+}
+
+static uint32_t bench_warp_perspective(image_t *img)
+{
+    return bench_warp(img, true);
+}
+
+static uint32_t bench_logpolar(image_t *img)
+{
+    imlib_logpolar(img, false, false);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_jpeg_compress(image_t *img)
+{
+    uint32_t size;
+    uint8_t *buffer = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE);
+    image_t out = { .w = img->w, .h = img->h, .bpp = size, .data = buffer };
+    if (jpeg_compress(img, &out, 90, false)) {
+        return 0;
+    }
+    return bench_hash(BENCH_HASH_INIT, out.data, out.bpp);
+}
+
+// Simulates the DCMI line callback in sensor.c streaming lines into the JPEG encoder. The
+// digest must match jpeg_compress() at the same quality.
+static uint32_t bench_jpeg_stream_quality(image_t *img, int quality)
+{
+    jpeg_stream_t stream;
+    uint8_t *lines = fb_alloc(JPEG_STREAM_LINES_SIZE(img->w, img->bpp), FB_ALLOC_NO_HINT);
+    uint32_t size;
+    image_t out = { .w = img->w, .h = img->h, .data = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE) };
+    out.bpp = size;
+
+    jpeg_stream_init(&stream, img->w, img->h, img->bpp, quality, &out, lines);
+    for (int y = 0; y < img->h; y++) {
+        memcpy(jpeg_stream_get_line(&stream), img->data + (y * img->w * img->bpp), img->w * img->bpp);
+        if (jpeg_stream_put_line(&stream)) {
+            return 0;
+        }
+    }
+
+    if (jpeg_stream_end(&stream, &out)) {
+        return 0;
+    }
+    return bench_hash(BENCH_HASH_INIT, out.data, out.bpp);
+}
+
+static uint32_t bench_jpeg_stream(image_t *img)
+{
+    return bench_jpeg_stream_quality(img, 90);
+}
+
+// Decodes a JPEG of the input (compressed once per input) back into the frame buffer.
+static uint32_t bench_jpeg_decompress_div(image_t *img, int div)
+{
+    static image_t jpeg;
+    static int jpeg_w, jpeg_h, jpeg_bpp;
+
+    if ((jpeg_w != img->w) || (jpeg_h != img->h) || (jpeg_bpp != img->bpp)) {
+        uint32_t size;
+        fb_alloc_mark();
+        image_t out = { .w = img->w, .h = img->h, .data = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE) };
+        out.bpp = size;
+        if (jpeg_compress(img, &out, 90, false)) {
+            fb_alloc_free_till_mark();
+            return 0;
+        }
+        xfree(jpeg.data);
+        jpeg = out;
+        jpeg.data = xalloc(out.bpp);
+        memcpy(jpeg.data, out.data, out.bpp);
+        fb_alloc_free_till_mark();
+        jpeg_w = img->w; jpeg_h = img->h; jpeg_bpp = img->bpp;
+    }
+
+    img->w = (jpeg.w + div - 1) / div;
+    img->h = (jpeg.h + div - 1) / div;
+    jpeg_decompress(&jpeg, img);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_jpeg_decompress(image_t *img)
+{
+    return bench_jpeg_decompress_div(img, 1);
+}
+
+static uint32_t bench_jpeg_decompress_4(image_t *img)
+{
+    return bench_jpeg_decompress_div(img, 4);
+}
+
+static uint32_t bench_lossless_compress(image_t *img)
+{
+    uint32_t size;
+    uint8_t *buffer = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE);
+    size = lossless_compress(img, buffer, size);
+    return bench_hash(BENCH_HASH_VAL(BENCH_HASH_INIT, size), buffer, size);
+}
+
+// Decodes the lossless compressed input (compressed once per input) back into the frame buffer,
+// the digest must match the digest of the input.
+static uint32_t bench_lossless_decompress(image_t *img)
+{
+    static uint8_t *data;
+    static uint32_t data_size;
+    static int data_w, data_h, data_bpp;
+
+    if ((data_w != img->w) || (data_h != img->h) || (data_bpp != img->bpp)) {
+        uint32_t size;
+        fb_alloc_mark();
+        uint8_t *buffer = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE);
+        data_size = lossless_compress(img, buffer, size);
+        xfree(data);
+        data = xalloc(data_size);
+        memcpy(data, buffer, data_size);
+        fb_alloc_free_till_mark();
+        data_w = img->w; data_h = img->h; data_bpp = img->bpp;
+    }
+
+    memset(img->data, 0, image_size(img));
+    if (lossless_decompress(data, data_size, img)) {
+        return 0;
+    }
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_edge_canny(image_t *img)
+{
+    rectangle_t roi = bench_roi(img);
+    imlib_edge_canny(img, &roi, 50, 80);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_find_hog(image_t *img)
+{
+    // imlib_find_hog() walks whole 2x2 cell blocks, keep the ROI block aligned.
+    rectangle_t roi = bench_roi(img);
+    roi.w &= ~15;
+    roi.h &= ~15;
+    imlib_find_hog(img, &roi, 8);
+    return bench_hash_image(img);
+}
+
+static uint32_t bench_find_lines(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_lines(&out, img, &roi, 2, 1, 1000, 25, 25, NULL);
+    return bench_hash_list(&out, sizeof(find_lines_list_lnk_data_t));
+}
+
+static uint32_t bench_find_line_segments(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_lsd_find_line_segments(&out, img, &roi, 0, 15);
+    return bench_hash_list(&out, sizeof(find_lines_list_lnk_data_t));
+}
+
+static uint32_t bench_find_circles(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_circles(&out, img, &roi, 2, 1, 2000, 10, 10, 10, 2, IM_MIN(roi.w, roi.h) / 2, 1, NULL);
+    return bench_hash_list(&out, sizeof(find_circles_list_lnk_data_t));
+}
+
+// One gradient field per frame shared by find_lines() and find_circles().
+static uint32_t bench_find_lines_circles(image_t *img)
+{
+    list_t lines, circles;
+    gradient_t grad;
+    rectangle_t roi = bench_roi(img);
+    imlib_gradient_init(&grad, fb_alloc(imlib_gradient_size(&roi, 2, 1), FB_ALLOC_NO_HINT), &roi, 2, 1);
+    imlib_gradient_update(&grad, img);
+    imlib_find_lines(&lines, img, &roi, 2, 1, 1000, 25, 25, &grad);
+    imlib_find_circles(&circles, img, &roi, 2, 1, 2000, 10, 10, 10, 2, IM_MIN(roi.w, roi.h) / 2, 1, &grad);
+    fb_free();
+    return BENCH_HASH_VAL(bench_hash_list(&lines, sizeof(find_lines_list_lnk_data_t)),
+                          bench_hash_list(&circles, sizeof(find_circles_list_lnk_data_t)));
+}
+
+static uint32_t bench_find_rects(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_rects(&out, img, &roi, 10000);
+    return bench_hash_list(&out, sizeof(find_rects_list_lnk_data_t));
+}
+
+static uint32_t bench_find_qrcodes(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_qrcodes(&out, img, &roi);
+    return BENCH_HASH_PAYLOAD_LIST(&out, find_qrcodes_list_lnk_data_t);
+}
+
+static uint32_t bench_find_apriltags(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_apriltags(&out, img, &roi, TAG36H11,
+                         (2.8 / 3.984) * img->w, (2.8 / 2.952) * img->h, img->w * 0.5, img->h * 0.5, -1, 1);
+    return bench_hash_list(&out, offsetof(find_apriltags_list_lnk_data_t, goodness));
+}
+
+static uint32_t bench_find_apriltags_dec2(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_apriltags(&out, img, &roi, TAG36H11,
+                         (2.8 / 3.984) * img->w, (2.8 / 2.952) * img->h, img->w * 0.5, img->h * 0.5, -1, 2);
+    return bench_hash_list(&out, offsetof(find_apriltags_list_lnk_data_t, goodness));
+}
+
+static uint32_t bench_find_datamatrices(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_datamatrices(&out, img, &roi, 200);
+    return BENCH_HASH_PAYLOAD_LIST(&out, find_datamatrices_list_lnk_data_t);
+}
+
+static uint32_t bench_find_barcodes(image_t *img)
+{
+    list_t out;
+    rectangle_t roi = bench_roi(img);
+    imlib_find_barcodes(&out, img, &roi);
+    return BENCH_HASH_PAYLOAD_LIST(&out, find_barcodes_list_lnk_data_t);
+}
+
+static uint32_t bench_find_features(image_t *img)
+{
+    cascade_t cascade;
+    imlib_load_cascade(&cascade, "frontalface");
+    cascade.threshold = 0.75f;
+    cascade.scale_factor = 1.25f;
+    rectangle_t roi = bench_roi(img);
+    array_t *objects = imlib_detect_objects(img, &cascade, &roi);
+    return bench_hash_array(objects, sizeof(rectangle_t));
+}
+
+static uint32_t bench_find_keypoints(image_t *img)
+{
+    rectangle_t roi = bench_roi(img);
+    array_t *kpts = orb_find_keypoints(img, false, 20, 1.5f, 100, CORNER_AGAST, &roi);
+    return bench_hash_array(kpts, sizeof(kp_t));
+}
+
+static uint32_t bench_find_keypoints_500(image_t *img)
+{
+    rectangle_t roi = bench_roi(img);
+    array_t *kpts = orb_find_keypoints(img, false, 10, 1.2f, 500, CORNER_AGAST, &roi);
+    return bench_hash_array(kpts, sizeof(kp_t));
+}
+
+// The graffiti model saved by the unittests, loaded once and kept like a script would.
+static array_t *bench_orb_model()
+{
+    static array_t *model;
+
+    if (!model) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/graffiti.orb", data_dir);
+        FIL fp;
+        uint32_t desc_type;
+        file_read_open(&fp, path);
+        read_long(&fp, &desc_type);
+        array_alloc(&model, xfree);
+        orb_load_descriptor(&fp, model);
+        file_close(&fp);
+    }
+
+    return model;
+}
+
+// Keypoints of the frame and of the frame rotated by 10 degrees, extracted once per resolution.
+static array_t *bench_orb_frame(image_t *img, bool rotated)
+{
+    static array_t *kpts[2];
+    static int w[2], h[2];
+
+    if ((!kpts[rotated]) || (w[rotated] != img->w) || (h[rotated] != img->h)) {
+        if (kpts[rotated]) {
+            array_free(kpts[rotated]);
+        }
+
+        image_t src = *img;
+        if (rotated) {
+            float c = cosf(10.0f * M_PI / 180.0f), s = sinf(10.0f * M_PI / 180.0f);
+            float cx = img->w / 2.0f, cy = img->h / 2.0f;
+            float transform[9] = { c, -s, cx - (c * cx) + (s * cy), s, c, cy - (s * cx) - (c * cy), 0.0f, 0.0f, 1.0f };
+            src.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+            imlib_warp(&src, img, transform, IMAGE_HINT_BILINEAR);
+        }
+
+        rectangle_t roi = bench_roi(&src);
+        kpts[rotated] = orb_find_keypoints(&src, false, 10, 1.2f, 500, CORNER_AGAST, &roi);
+        w[rotated] = img->w;
+        h[rotated] = img->h;
+
+        if (rotated) {
+            fb_free();
+        }
+    }
+
+    for (int i = 0, ii = array_length(kpts[rotated]); i < ii; i++) {
+        ((kp_t *) array_at(kpts[rotated], i))->matched = 0;
+    }
+
+    return kpts[rotated];
+}
+
+// Indexes built in fb memory are released by the caller, like a frame's keypoints are.
+static orb_index_t *bench_orb_index(orb_index_t *index, array_t *kpts)
+{
+    orb_index_init(index, fb_alloc(orb_index_size(kpts), FB_ALLOC_NO_HINT), kpts);
+    return index;
+}
+
+static uint32_t bench_match(array_t *kpts1, array_t *kpts2, orb_index_t *index1, orb_index_t *index2)
+{
+    int *match = fb_alloc((array_length(kpts1) * sizeof(int) * 2) + 1, FB_ALLOC_NO_HINT);
+    int angle = 0;
+    point_t c = {0};
+    rectangle_t r = {0};
+    int count = orb_match_keypoints(kpts1, kpts2, match, 85, &r, &c, &angle, index1, index2);
+    uint32_t h = bench_hash(BENCH_HASH_VAL(BENCH_HASH_INIT, count), match, count * sizeof(int) * 2);
+    h = BENCH_HASH_VAL(BENCH_HASH_VAL(BENCH_HASH_VAL(h, r), c), angle);
+    fb_free();
+    return h;
+}
+
+// The stored model against a live frame. The model index is built once, the frame index every frame.
+static uint32_t bench_match_desc(image_t *img, bool index)
+{
+    static orb_index_t model_index;
+    array_t *model = bench_orb_model(), *frame = bench_orb_frame(img, false);
+
+    if (!index) {
+        return bench_match(model, frame, NULL, NULL);
+    }
+
+    if (!model_index.kpts) {
+        orb_index_init(&model_index, xalloc(orb_index_size(model)), model);
+    }
+
+    orb_index_t frame_index;
+    uint32_t h = bench_match(model, frame, &model_index, bench_orb_index(&frame_index, frame));
+    fb_free(); // frame_index
+    return h;
+}
+
+// Two live frames of up to 500 keypoints each, both indexes are built every frame.
+static uint32_t bench_match_desc_500(image_t *img, bool index)
+{
+    array_t *kpts1 = bench_orb_frame(img, false);
+    array_t *kpts2 = bench_orb_frame(img, true);
+
+    if (!index) {
+        return bench_match(kpts1, kpts2, NULL, NULL);
+    }
+
+    orb_index_t index1, index2;
+    uint32_t h = bench_match(kpts1, kpts2, bench_orb_index(&index1, kpts1), bench_orb_index(&index2, kpts2));
+    fb_free(); // index2
+    fb_free(); // index1
+    return h;
+}
+
+// Three keypoints with the same descriptor in each set, the index then returns a zero second
+// distance that the ratio test must reject without dividing by it.
+static uint32_t bench_match_desc_dup(image_t *img)
+{
+    array_t *kpts[2];
+
+    for (int i = 0; i < 2; i++) {
+        array_alloc(&kpts[i], xfree);
+        for (int j = 0; j < 3; j++) {
+            kp_t *kp = xalloc0(sizeof(kp_t));
+            kp->x = (j + 1) * img->w / 4;
+            kp->y = img->h / 2;
+            memcpy(kp->desc, img->data, sizeof(kp->desc));
+            array_push_back(kpts[i], kp);
+        }
+    }
+
+    orb_index_t index1, index2;
+    uint32_t h = bench_match(kpts[0], kpts[1], NULL, NULL);
+    h = BENCH_HASH_VAL(h, bench_match(kpts[0], kpts[1], bench_orb_index(&index1, kpts[0]), bench_orb_index(&index2, kpts[1])));
+    fb_free(); // index2
+    fb_free(); // index1
+    array_free(kpts[0]);
+    array_free(kpts[1]);
+    return h;
+}
+
+static uint32_t bench_match_desc_scan(image_t *img)
+{
+    return bench_match_desc(img, false);
+}
+
+static uint32_t bench_match_desc_index(image_t *img)
+{
+    return bench_match_desc(img, true);
+}
+
+static uint32_t bench_match_desc_500_scan(image_t *img)
+{
+    return bench_match_desc_500(img, false);
+}
+
+static uint32_t bench_match_desc_500_index(image_t *img)
+{
+    return bench_match_desc_500(img, true);
+}
+
+// 49 models from rotated views of the other test images plus the graffiti model, like a database of
+// 50 product labels built once and kept resident.
+static orb_db_t *bench_orb_db()
+{
+    static orb_db_t db;
+    static const char *images[] = { "apriltags.pgm", "barcode.pgm", "cat.pgm", "datamatrix.pgm",
+                                    "dennis.pgm", "drawing.pgm", "qrcode.pgm" };
+
+    if (!db.starts) {
+        orb_db_init(&db);
+
+        for (int i = 0; i < 7; i++) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", data_dir, images[i]);
+            image_t img = { .w = 0, .h = 0, .bpp = 0, .data = NULL };
+            imlib_load_image(&img, path);
+
+            // QVGA views so the small images have keypoints too.
+            image_t view = { .w = 320, .h = 240, .bpp = IMAGE_BPP_GRAYSCALE };
+            view.data = fb_alloc(image_size(&view), FB_ALLOC_NO_HINT);
+
+            for (int t = 0; t < 7; t++) {
+                float c = cosf(t * 50.0f * M_PI / 180.0f), s = sinf(t * 50.0f * M_PI / 180.0f);
+                float sx = img.w / 320.0f, sy = img.h / 240.0f;
+                float transform[9] = { sx * c, -sx * s, sx * (160.0f - (c * 160.0f) + (s * 120.0f)),
+                                       sy * s,  sy * c, sy * (120.0f - (s * 160.0f) - (c * 120.0f)),
+                                       0.0f, 0.0f, 1.0f };
+                imlib_warp(&view, &img, transform, IMAGE_HINT_BILINEAR);
+
+                rectangle_t roi = { 0, 0, view.w, view.h };
+                array_t *kpts = orb_find_keypoints(&view, false, 10, 1.2f, 150, CORNER_AGAST, &roi);
+                orb_db_add(&db, kpts);
+                array_free(kpts);
+
+                if (db.count == 3) {
+                    orb_db_add(&db, bench_orb_model());
+                }
+            }
+
+            fb_free();
+            xfree(img.data);
+        }
+    }
+
+    return &db;
+}
+
+static uint32_t bench_match_db(image_t *img)
+{
+    orb_db_t *db = bench_orb_db();
+    int *counts = fb_alloc(db->count * sizeof(int), FB_ALLOC_NO_HINT);
+    int matches = orb_db_match(db, bench_orb_frame(img, false), 85, counts);
+    uint32_t h = bench_hash(BENCH_HASH_VAL(BENCH_HASH_INIT, matches), counts, db->count * sizeof(int));
+    fb_free();
+    return h;
+}
+
+// The same models matched one at a time.
+static uint32_t bench_match_db_scan(image_t *img)
+{
+    orb_db_t *db = bench_orb_db();
+    array_t *model;
+    array_alloc(&model, NULL);
+    uint32_t h = BENCH_HASH_INIT;
+
+    for (int i = 0; i < db->count; i++) {
+        array_clear(model);
+        for (int j = db->starts[i]; j < db->starts[i + 1]; j++) {
+            array_push_back(model, &db->kpts[j]);
+        }
+        if (array_length(model)) {
+            h = bench_match(model, bench_orb_frame(img, false), NULL, NULL) ^ (h * 31);
+        }
+    }
+
+    array_free(model);
+    return h;
+}
+
+// The template is the w by h center of the image.
+static void bench_template(image_t *img, image_t *template, int w, int h)
+{
+    template->w = w;
+    template->h = h;
+    template->bpp = img->bpp;
+    template->data = fb_alloc(image_size(template), FB_ALLOC_NO_HINT);
+    template->stride = 0;
+    for (int y = 0; y < template->h; y++) {
+        uint8_t *row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y + ((img->h - template->h) / 2));
+        memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(template, y), row + ((img->w - template->w) / 2), template->w);
+    }
+}
+
+static uint32_t bench_find_template(image_t *img)
+{
+    image_t template;
+    bench_template(img, &template, img->w / 4, img->h / 4);
+    rectangle_t roi = bench_roi(img), r;
+    float corr = imlib_template_match_ex(img, &template, &roi, 4, &r);
+    return BENCH_HASH_VAL(bench_hash(BENCH_HASH_INIT, &r, sizeof(r)), corr);
+}
+
+// 64x64 template searched at every position, the digest is of the location only.
+static uint32_t bench_find_template_64(image_t *img)
+{
+    image_t template;
+    bench_template(img, &template, 64, 64);
+    rectangle_t roi = bench_roi(img), r;
+    imlib_template_match_ex(img, &template, &roi, 1, &r);
+    return bench_hash(BENCH_HASH_INIT, &r, sizeof(r));
+}
+
+// The template of find_template with black and saturated bands above and below it, searched at every
+// position. The patches inside the bands have no variance so they must not match.
+static uint32_t bench_find_template_flat(image_t *img)
+{
+    image_t template;
+    bench_template(img, &template, img->w / 4, img->h / 4);
+    for (int y = 0, yy = (img->h - template.h) / 2; y < yy; y++) {
+        memset(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y), 0, img->w);
+        memset(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, img->h - 1 - y), 255, img->w);
+    }
+    rectangle_t roi = bench_roi(img), r;
+    float corr = imlib_template_match_ex(img, &template, &roi, 1, &r);
+    return BENCH_HASH_VAL(bench_hash(BENCH_HASH_INIT, &r, sizeof(r)), corr);
+}
+
+// Real FFT and inverse FFT of the first n pixels of every row, the digest is of the rounded round
+// trip so it only changes if the transforms lose precision.
+static uint32_t bench_fft(image_t *img, int n)
+{
+    uint32_t h = BENCH_HASH_INIT;
+
+    for (int y = 0; y < img->h; y++) {
+        fft1d_controller_t fft;
+        fft1d_alloc(&fft, IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y), IM_MIN(img->w, n));
+        fft1d_run(&fft);
+        ifft1d_run(&fft);
+        for (int i = 0; i < IM_MIN(img->w, n); i++) {
+            h = BENCH_HASH_VAL(h, fast_roundf(fft.data[i]));
+        }
+        fft1d_dealloc();
+    }
+
+    return h;
+}
+
+static uint32_t bench_fft_64(image_t *img)
+{
+    return bench_fft(img, 64);
+}
+
+static uint32_t bench_fft_128(image_t *img)
+{
+    return bench_fft(img, 128);
+}
+
+static uint32_t bench_fft_256(image_t *img)
+{
+    return bench_fft(img, 256);
+}
+
+static uint32_t bench_fft_512(image_t *img)
+{
+    return bench_fft(img, 512);
+}
+
+static uint32_t bench_fft2d(image_t *img, int n)
+{
+    uint32_t h = BENCH_HASH_INIT;
+    rectangle_t roi = { .x = (img->w - n) / 2, .y = (img->h - n) / 2, .w = n, .h = n };
+    fft2d_controller_t fft;
+    fft2d_alloc(&fft, img, &roi);
+    fft2d_run(&fft);
+    ifft2d_run(&fft);
+
+    for (int y = 0; y < fft.r.h; y++) {
+        for (int x = 0; x < fft.r.w; x++) {
+            h = BENCH_HASH_VAL(h, fast_roundf(fft.data[(y << (fft.w_pow2 + 1)) + x]));
+        }
+    }
+
+    fft2d_dealloc();
+    return h;
+}
+
+static uint32_t bench_fft2d_64(image_t *img)
+{
+    return bench_fft2d(img, 64);
+}
+
+static uint32_t bench_fft2d_128(image_t *img)
+{
+    return bench_fft2d(img, 128);
+}
+
+// Copy of the image shifted by (2, 1) pixels.
+static void bench_shifted_copy(image_t *img, image_t *other)
+{
+    *other = (image_t) { .w = img->w, .h = img->h, .bpp = img->bpp };
+    other->data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+    memset(other->data, 0, image_size(img));
+    for (int y = 1; y < img->h; y++) {
+        size_t bpp = (img->bpp == IMAGE_BPP_RGB565) ? 2 : 1;
+        memcpy(other->data + (((y * img->w) + 2) * bpp), img->data + ((y - 1) * img->w * bpp), (img->w - 2) * bpp);
+    }
+}
+
+static uint32_t bench_find_displacement(image_t *img)
+{
+    float x, y, r, s, response;
+    image_t other;
+    // Compare the image against a copy shifted by (2, 1) pixels.
+    bench_shifted_copy(img, &other);
+    rectangle_t roi = { .x = (img->w - 64) / 2, .y = (img->h - 64) / 2, .w = 64, .h = 64 };
+    imlib_phasecorrelate(img, &other, &roi, &roi, false, false, &x, &y, &r, &s, &response);
+    return BENCH_HASH_VAL(BENCH_HASH_VAL(BENCH_HASH_INIT, fast_roundf(x * 100)), fast_roundf(y * 100));
+}
+
+// Tracker kept across frames which alternate between the image and its shifted copy, so every
+// frame after the first is compared against the previous one with a single forward fft.
+static uint32_t bench_find_disp_trk(image_t *img)
+{
+    static phasecorrelate_tracker_t tracker;
+    static int frame;
+    float x, y, r, s, response;
+    image_t other;
+    bench_shifted_copy(img, &other);
+    rectangle_t roi = { .x = (img->w - 64) / 2, .y = (img->h - 64) / 2, .w = 64, .h = 64 };
+    imlib_phasecorrelate_tracker((frame++ & 1) ? &other : img, &roi, &tracker, false, false, &x, &y, &r, &s, &response);
+    return BENCH_HASH_VAL(BENCH_HASH_VAL(BENCH_HASH_INIT, fast_roundf(fabsf(x) * 100)), fast_roundf(fabsf(y) * 100));
+}
+
+static uint32_t bench_selective_search(image_t *img)
+{
+    array_t *proposals = imlib_selective_search(img, 500, 20, 1.0f, 1.0f, 1.0f);
+    return bench_hash_array(proposals, sizeof(rectangle_t));
+}
+
+static const bench_t benches[] = {
+    { "find_blobs",             "blobs.ppm",        BENCH_BOTH,         bench_find_blobs },
+    { "binary",                 "blobs.ppm",        BENCH_BOTH,         bench_binary },
+    { "binary_compiled",        "blobs.ppm",        BENCH_RGB565,       bench_binary_compiled },
+    { "get_histogram",          "blobs.ppm",        BENCH_BOTH,         bench_get_histogram },
+    { "get_histogram_view",     "blobs.ppm",        BENCH_BOTH,         bench_get_histogram_view },
+    { "mean_filter",            "shapes.ppm",       BENCH_BOTH,         bench_mean_filter },
+    { "median_filter",          "shapes.ppm",       BENCH_BOTH,         bench_median_filter },
+    { "mode_filter",            "shapes.ppm",       BENCH_BOTH,         bench_mode_filter },
+    { "midpoint_filter",        "shapes.ppm",       BENCH_BOTH,         bench_midpoint_filter },
+    { "gaussian",               "shapes.ppm",       BENCH_BOTH,         bench_gaussian },
+    { "bilateral_filter",       "shapes.ppm",       BENCH_BOTH,         bench_bilateral_filter },
+    { "bilateral_filter_fast",  "shapes.ppm",       BENCH_BOTH,         bench_bilateral_filter_fast },
+    { "erode",                  "shapes.ppm",       BENCH_BOTH,         bench_erode },
+    { "histeq",                 "dennis.pgm",       BENCH_BOTH,         bench_histeq },
+    { "clahe",                  "dennis.pgm",       BENCH_BOTH,         bench_clahe },
+    { "gamma_corr",             "dennis.pgm",       BENCH_BOTH,         bench_gamma_corr },
+    { "lens_corr",              "drawing.pgm",      BENCH_BOTH,         bench_lens_corr },
+    { "rotation_corr",          "drawing.pgm",      BENCH_BOTH,         bench_rotation_corr },
+    { "lens_corr_remap",        "drawing.pgm",      BENCH_BOTH,         bench_lens_corr_remap },
+    { "lens_corr_remap_diff",   "drawing.pgm",      BENCH_GRAYSCALE,    bench_lens_corr_remap_diff },
+    { "logpolar",               "drawing.pgm",      BENCH_BOTH,         bench_logpolar },
+    { "draw_image_half",        "dennis.pgm",       BENCH_BOTH,         bench_draw_image_half },
+    { "draw_image_half_bl",     "dennis.pgm",       BENCH_BOTH,         bench_draw_image_half_bl },
+    { "resize_half",            "dennis.pgm",       BENCH_BOTH,         bench_resize_half },
+    { "resize_half_bl",         "dennis.pgm",       BENCH_BOTH,         bench_resize_half_bl },
+    { "resize_half_area",       "dennis.pgm",       BENCH_BOTH,         bench_resize_half_area },
+    { "resize_double_bl",       "dennis.pgm",       BENCH_BOTH,         bench_resize_double_bl },
+    { "warp_affine",            "drawing.pgm",      BENCH_BOTH,         bench_warp_affine },
+    { "warp_perspective",       "drawing.pgm",      BENCH_BOTH,         bench_warp_perspective },
+    { "jpeg_compress",          "dennis.pgm",       BENCH_BOTH,         bench_jpeg_compress },
+    { "jpeg_stream",            "dennis.pgm",       BENCH_BOTH,         bench_jpeg_stream },
+    { "jpeg_decompress",        "dennis.pgm",       BENCH_BOTH,         bench_jpeg_decompress },
+    { "jpeg_decompress_4",      "dennis.pgm",       BENCH_BOTH,         bench_jpeg_decompress_4 },
+    { "lossless_compress",      "dennis.pgm",       BENCH_BOTH,         bench_lossless_compress },
+    { "lossless_decompress",    "dennis.pgm",       BENCH_BOTH,         bench_lossless_decompress },
+    { "edge_canny",             "shapes.ppm",       BENCH_GRAYSCALE,    bench_edge_canny },
+    { "find_hog",               "dennis.pgm",       BENCH_GRAYSCALE,    bench_find_hog },
+    { "find_lines",             "shapes.ppm",       BENCH_BOTH,         bench_find_lines },
+    { "find_line_segments",     "shapes.ppm",       BENCH_BOTH,         bench_find_line_segments },
+    { "find_circles",           "shapes.ppm",       BENCH_BOTH,         bench_find_circles },
+    { "find_lines_circles",     "shapes.ppm",       BENCH_BOTH,         bench_find_lines_circles },
+    { "find_rects",             "shapes.ppm",       BENCH_BOTH,         bench_find_rects },
+    { "find_qrcodes",           "qrcode.pgm",       BENCH_GRAYSCALE,    bench_find_qrcodes },
+    { "find_apriltags",         "apriltags.pgm",    BENCH_GRAYSCALE,    bench_find_apriltags },
+    { "find_apriltags_dec2",    "apriltags.pgm",    BENCH_GRAYSCALE,    bench_find_apriltags_dec2 },
+    { "find_datamatrices",      "datamatrix.pgm",   BENCH_GRAYSCALE,    bench_find_datamatrices },
+    { "find_barcodes",          "barcode.pgm",      BENCH_GRAYSCALE,    bench_find_barcodes },
+    { "find_features",          "dennis.pgm",       BENCH_GRAYSCALE,    bench_find_features },
+    { "find_keypoints",         "graffiti.pgm",     BENCH_GRAYSCALE,    bench_find_keypoints },
+    { "find_keypoints_500",     "graffiti.pgm",     BENCH_GRAYSCALE,    bench_find_keypoints_500 },
+    { "match_desc",             "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_desc_scan },
+    { "match_desc_index",       "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_desc_index },
+    { "match_desc_500",         "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_desc_500_scan },
+    { "match_desc_500_index",   "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_desc_500_index },
+    { "match_desc_dup",         "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_desc_dup },
+    { "match_db",               "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_db },
+    { "match_db_scan",          "graffiti.pgm",     BENCH_GRAYSCALE,    bench_match_db_scan },
+    { "find_template",          "dennis.pgm",       BENCH_GRAYSCALE,    bench_find_template },
+    { "find_template_64",       "dennis.pgm",       BENCH_GRAYSCALE,    bench_find_template_64 },
+    { "find_template_flat",     "dennis.pgm",       BENCH_GRAYSCALE,    bench_find_template_flat },
+    { "fft_64",                 "graffiti.pgm",     BENCH_GRAYSCALE,    bench_fft_64 },
+    { "fft_128",                "graffiti.pgm",     BENCH_GRAYSCALE,    bench_fft_128 },
+    { "fft_256",                "graffiti.pgm",     BENCH_GRAYSCALE,    bench_fft_256 },
+    { "fft_512",                "graffiti.pgm",     BENCH_GRAYSCALE,    bench_fft_512 },
+    { "fft2d_64",               "graffiti.pgm",     BENCH_BOTH,         bench_fft2d_64 },
+    { "fft2d_128",              "graffiti.pgm",     BENCH_BOTH,         bench_fft2d_128 },
+    { "find_displacement",      "graffiti.pgm",     BENCH_BOTH,         bench_find_displacement },
+    { "find_disp_trk",          "graffiti.pgm",     BENCH_BOTH,         bench_find_disp_trk },
+    { "selective_search",       "blobs.ppm",        BENCH_RGB565,       bench_selective_search },
+};
+
+////////////////////////
+// Runner             //
+////////////////////////
+
+// Nearest neighbour scale and convert the source image into dst.
+static void bench_scale_image(image_t *dst, image_t *src)
+{
+    for (int y = 0; y < dst->h; y++) {
+        int src_y = (y * src->h) / dst->h;
+        for (int x = 0; x < dst->w; x++) {
+            int src_x = (x * src->w) / dst->w;
+            int pixel = (src->bpp == IMAGE_BPP_GRAYSCALE)
+                ? IMAGE_GET_GRAYSCALE_PIXEL(src, src_x, src_y)
+                : IMAGE_GET_RGB565_PIXEL(src, src_x, src_y);
+            if (dst->bpp == IMAGE_BPP_GRAYSCALE) {
+                IMAGE_PUT_GRAYSCALE_PIXEL(dst, x, y,
+                    (src->bpp == IMAGE_BPP_GRAYSCALE) ? pixel : COLOR_RGB565_TO_GRAYSCALE(pixel));
+            } else {
+                IMAGE_PUT_RGB565_PIXEL(dst, x, y,
+                    (src->bpp == IMAGE_BPP_RGB565) ? pixel : COLOR_GRAYSCALE_TO_RGB565(pixel));
+            }
+        }
+    }
+}
+
+static void bench_print_address(uintptr_t address)
+{
+    Dl_info info;
+    if (address && dladdr((void *) address, &info)) {
+        printf(" 0x%06lx %-28s", (unsigned long) (address - (uintptr_t) info.dli_fbase),
+               info.dli_sname ? info.dli_sname : "?");
+    } else {
+        printf(" 0x%06lx %-28s", (unsigned long) address, "?");
+    }
+}
+
+static void bench_print_profile()
+{
+    const fb_alloc_profile_t *p = fb_alloc_profile_get();
+    printf("  peak %lu B, min free %lu B, dropped %lu\n",
+           (unsigned long) p->peak, (unsigned long) p->min_free, (unsigned long) p->dropped);
+    for (int i = 0; i < p->n_scopes; i++) {
+        printf("  scope");
+        bench_print_address(p->scopes[i].caller);
+        printf(" marks %6lu peak %9lu B\n", (unsigned long) p->scopes[i].marks, (unsigned long) p->scopes[i].peak);
+    }
+    for (int i = 0; i < p->n_sites; i++) {
+        printf("  site ");
+        bench_print_address(p->sites[i].caller);
+        printf(" allocs %5lu peak %9lu B max %9lu B all %9lu B\n",
+               (unsigned long) p->sites[i].allocs, (unsigned long) p->sites[i].peak,
+               (unsigned long) p->sites[i].max_alloc, (unsigned long) p->sites[i].max_all);
+    }
+    if (p->fail.caller) {
+        printf("  fail ");
+        bench_print_address(p->fail.caller);
+        printf(" size %lu B free %lu B\n", (unsigned long) p->fail.size, (unsigned long) p->fail.free);
+    }
+}
+
+static int bench_one(const bench_t *bench, image_t *src, const bench_resolution_t *res, int bpp, int max_iterations)
+{
+    image_t fb, pristine = { .w = res->w, .h = res->h, .bpp = bpp };
+    pristine.data = xalloc(image_size(&pristine));
+    bench_scale_image(&pristine, src);
+
+    framebuffer_set(res->w, res->h, bpp);
+    framebuffer_initialize_image(&fb);
+
+    uint64_t best = UINT64_MAX, total = 0;
+    uint32_t peak = 0, digest = 0;
+    int iterations = 0;
+    const char *error = NULL;
+    bool out_of_memory = false;
+    fb_alloc_profile_enable(profile);
+
+    while ((iterations < max_iterations)
+       && ((iterations < BENCH_MIN_ITERATIONS) || (total < BENCH_TIME_BUDGET_NS))) {
+        memcpy(fb.data, pristine.data, image_size(&pristine));
+        fb.w = pristine.w; fb.h = pristine.h; fb.bpp = pristine.bpp;
+        host_fb_paint();
+
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) == 0) {
+            fb_alloc_mark();
+            uint64_t start = host_ticks_ns();
+            digest = bench->run(&fb);
+            uint64_t elapsed = host_ticks_ns() - start;
+            fb_alloc_free_till_mark();
+            nlr_pop();
+            best = IM_MIN(best, elapsed);
+            total += elapsed;
+        } else {
+            fb_alloc_free_till_mark();
+            error = ((mp_obj_exception_t *) nlr.ret_val)->msg;
+            out_of_memory = ((mp_obj_exception_t *) nlr.ret_val)->type == &mp_type_MemoryError;
+        }
+
+        peak = IM_MAX(peak, host_fb_peak());
+        iterations += 1;
+        if (error) break;
+    }
+
+    xfree(pristine.data);
+
+    const char *fmt = (bpp == IMAGE_BPP_GRAYSCALE) ? "GS" : "RGB565";
+    if (out_of_memory) {
+        // Algorithms which do not fit in fb_alloc memory at this resolution are skipped, not failed.
+        printf("%-20s %-6s %-5s  skipped: out of fb_alloc memory\n", bench->name, fmt, res->name);
+        if (profile) {
+            bench_print_profile();
+        }
+        return 0;
+    } else if (error) {
+        printf("%-20s %-6s %-5s  error: %s\n", bench->name, fmt, res->name, error);
+        return -1;
+    }
+    printf("%-20s %-6s %-5s %10.2f ns/px %10.3f ms %10lu B %4d it %08x\n",
+           bench->name, fmt, res->name, ((double) best) / (res->w * res->h), best / 1e6,
+           (unsigned long) peak, iterations, digest);
+    if (profile) {
+        bench_print_profile();
+    }
+    return 0;
+}
+
+static void usage(const char *argv0)
+{
+    printf("usage: %s [-d data_dir] [-r QQVGA|QVGA|VGA] [-f name] [-n max_iterations] [-p] [-l]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *res_filter = NULL, *name_filter = NULL;
+    int max_iterations = BENCH_MAX_ITERATIONS, failed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d") && (i + 1 < argc)) {
+            data_dir = argv[++i];
+        } else if (!strcmp(argv[i], "-r") && (i + 1 < argc)) {
+            res_filter = argv[++i];
+        } else if (!strcmp(argv[i], "-f") && (i + 1 < argc)) {
+            name_filter = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+            max_iterations = IM_MAX(atoi(argv[++i]), 1);
+        } else if (!strcmp(argv[i], "-p")) {
+            profile = true;
+        } else if (!strcmp(argv[i], "-l")) {
+            for (size_t j = 0; j < sizeof(benches) / sizeof(benches[0]); j++) {
+                printf("%s\n", benches[j].name);
+            }
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    fb_alloc_init0();
+    file_buffer_init0();
+    framebuffer_set(0, 0, 0);
+
+    printf("%-20s %-6s %-5s %16s %13s %12s %7s %s\n",
+           "benchmark", "format", "res", "time/pixel", "time", "fb_alloc", "iters", "digest");
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const bench_t *bench = &benches[i];
+        if (name_filter && strcmp(bench->name, name_filter)) {
+            continue;
+        }
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", data_dir, bench->image);
+        image_t src = { .w = 0, .h = 0, .bpp = 0, .data = NULL };
+
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) == 0) {
+            imlib_load_image(&src, path);
+            nlr_pop();
+        } else {
+            printf("%-20s failed to load %s: %s\n", bench->name, path, ((mp_obj_exception_t *) nlr.ret_val)->msg);
+            failed += 1;
+            continue;
+        }
+
+        for (size_t r = 0; r < sizeof(bench_resolutions) / sizeof(bench_resolutions[0]); r++) {
+            if (res_filter && strcmp(bench_resolutions[r].name, res_filter)) {
+                continue;
+            }
+            for (int bpp = IMAGE_BPP_GRAYSCALE; bpp <= IMAGE_BPP_RGB565; bpp++) {
+                if (bench->formats & (1 << bpp)) {
+                    failed += bench_one(bench, &src, &bench_resolutions[r], bpp, max_iterations) ? 1 : 0;
+                }
+            }
+        }
+
+        xfree(src.data);
+    }
+
+    return failed ? 1 : 0;
+}
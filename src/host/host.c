@@ -0,0 +1,312 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: runtime, memory layout and file system glue for imlib.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <mp.h>
+#include <ff.h>
+#include "mutex.h"
+#include "fb_alloc.h"
+#include "framebuffer.h"
+#include "host.h"
+#include "omv_boardconfig.h"
+
+#define HOST_STR(x)     #x
+#define HOST_XSTR(x)    HOST_STR(x)
+
+// Mirrors the FB section of stm32fxxx.ld.S: the framebuffer header and pixels
+// at _fb_base followed by fb_alloc memory, with the fb_alloc stack growing
+// down from _fballoc. The IDE JPEG buffer lives in its own region.
+__asm__(
+    ".section .bss.omv_fb,\"aw\",@nobits\n"
+    ".balign 32\n"
+    ".global _fb_base\n"
+    "_fb_base:\n"
+    ".space " HOST_XSTR(OMV_FB_SIZE) " + " HOST_XSTR(OMV_FB_ALLOC_SIZE) "\n"
+    ".global _fballoc\n"
+    "_fballoc:\n"
+    ".balign 32\n"
+    ".global _jpeg_buf\n"
+    "_jpeg_buf:\n"
+    ".space " HOST_XSTR(OMV_JPEG_BUF_SIZE) "\n"
+    ".previous\n"
+);
+
+uint32_t __host_apsr_ge;
+
+const mp_obj_type_t mp_type_Exception = { "Exception" };
+const mp_obj_type_t mp_type_MemoryError = { "MemoryError" };
+const mp_obj_type_t mp_type_OSError = { "OSError" };
+const mp_obj_type_t mp_type_ValueError = { "ValueError" };
+const mp_obj_type_t mp_type_TypeError = { "TypeError" };
+const mp_obj_type_t mp_type_RuntimeError = { "RuntimeError" };
+
+static nlr_buf_t *nlr_top = NULL;
+static mp_obj_exception_t nlr_exception;
+
+mp_obj_t mp_obj_new_exception_msg(const mp_obj_type_t *type, const char *msg)
+{
+    nlr_exception.type = type;
+    nlr_exception.msg = msg;
+    return &nlr_exception;
+}
+
+void nlr_push_tail(nlr_buf_t *nlr)
+{
+    nlr->prev = nlr_top;
+    nlr_top = nlr;
+}
+
+void nlr_pop(void)
+{
+    nlr_top = nlr_top->prev;
+}
+
+NORETURN void nlr_jump(void *val)
+{
+    nlr_buf_t *top = nlr_top;
+    if (top == NULL) {
+        mp_obj_exception_t *e = (mp_obj_exception_t *) val;
+        fprintf(stderr, "Uncaught %s: %s\n", e->type->name, e->msg);
+        abort();
+    }
+    top->ret_val = val;
+    nlr_top = top->prev;
+    longjmp(top->jmpbuf, 1);
+}
+
+void *gc_alloc(size_t n_bytes, unsigned int alloc_flags)
+{
+    return n_bytes ? malloc(n_bytes) : NULL;
+}
+
+void gc_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *gc_realloc(void *ptr, size_t n_bytes, bool allow_move)
+{
+    if (!n_bytes) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, n_bytes);
+}
+
+void gc_info(gc_info_t *info)
+{
+    // The C library heap is effectively unbounded compared to the MicroPython heap,
+    // so report the size of the OPENMV4 heap to keep heap-bounded loops comparable.
+    memset(info, 0, sizeof(gc_info_t));
+    info->total = info->free = info->max_free = 244 * 1024;
+}
+
+void gc_collect(void)
+{
+}
+
+// Deterministic so that benchmark digests are reproducible.
+uint32_t rng_randint(uint32_t min, uint32_t max)
+{
+    static uint32_t state = 12345;
+    state = (state * 1103515245) + 12345;
+    return (max > min) ? (min + ((state >> 8) % (max - min + 1))) : min;
+}
+
+static void host_print_strn(void *data, const char *str, size_t len)
+{
+    fwrite(str, 1, len, stdout);
+}
+
+const mp_print_t mp_plat_print = { NULL, host_print_strn };
+
+uint32_t HAL_GetTick(void)
+{
+    return host_ticks_ns() / 1000000;
+}
+
+uint64_t host_ticks_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+}
+
+#define HOST_FB_PAINT (0xA5)
+
+void host_fb_paint(void)
+{
+    char *start = (char *) framebuffer_get_buffers_end();
+    char *end = fb_alloc_stack_pointer();
+    if (start < end) {
+        memset(start, HOST_FB_PAINT, end - start);
+    }
+}
+
+// Counts the painted bytes which were overwritten. Scanning for the lowest touched address
+// instead would charge fb_alloc_all() users for the whole region even when they only use a
+// little of it from the bottom up.
+uint32_t host_fb_peak(void)
+{
+    char *start = (char *) framebuffer_get_buffers_end();
+    char *end = fb_alloc_stack_pointer();
+    uint32_t touched = 0;
+    for (char *ptr = start; ptr < end; ptr++) {
+        touched += (*ptr != (char) HOST_FB_PAINT);
+    }
+    return touched;
+}
+
+void mutex_init(mutex_t *mutex)
+{
+    mutex->tid = 0;
+    mutex->lock = 0;
+}
+
+void mutex_lock(mutex_t *mutex, uint32_t tid)
+{
+    mutex->tid = tid;
+    mutex->lock = 1;
+}
+
+int mutex_try_lock(mutex_t *mutex, uint32_t tid)
+{
+    if (mutex->lock) {
+        return 0;
+    }
+    mutex_lock(mutex, tid);
+    return 1;
+}
+
+void mutex_unlock(mutex_t *mutex, uint32_t tid)
+{
+    if (mutex->tid == tid) {
+        mutex->lock = 0;
+    }
+}
+
+//////////////////////////
+// File System (stdio)  //
+//////////////////////////
+
+static fs_user_mount_t host_vfs_fs;
+static mp_vfs_mount_t host_vfs_mount = { &host_vfs_fs };
+
+mp_vfs_mount_t *mp_vfs_lookup_path(const char *path, const char **path_out)
+{
+    *path_out = path;
+    return &host_vfs_mount;
+}
+
+const char *ffs_strerror(FRESULT res)
+{
+    switch (res) {
+        case FR_OK: return "Succeeded";
+        case FR_NO_FILE: return "Could not find the file";
+        case FR_NO_PATH: return "Could not find the path";
+        case FR_DENIED: return "Access denied";
+        case FR_EXIST: return "Access denied (file exists)";
+        default: return "A hard error occurred in the low level disk I/O layer";
+    }
+}
+
+FRESULT f_open(FATFS *fs, FIL *fp, const TCHAR *path, BYTE mode)
+{
+    const char *m = (mode & FA_WRITE) ? ((mode & FA_CREATE_ALWAYS) ? "w+b" : "r+b") : "rb";
+    fp->file = fopen(path, m);
+    fp->flag = mode & (FA_READ | FA_WRITE);
+    return fp->file ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_close(FIL *fp)
+{
+    if (fp->file) {
+        fclose(fp->file);
+        fp->file = NULL;
+    }
+    return FR_OK;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+    *br = fread(buff, 1, btr, fp->file);
+    return ferror(fp->file) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+    *bw = fwrite(buff, 1, btw, fp->file);
+    return ferror(fp->file) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    return fseek(fp->file, ofs, SEEK_SET) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_truncate(FIL *fp)
+{
+    return ftruncate(fileno(fp->file), ftell(fp->file)) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_sync(FIL *fp)
+{
+    return fflush(fp->file) ? FR_DISK_ERR : FR_OK;
+}
+
+FSIZE_t f_size(FIL *fp)
+{
+    long pos = ftell(fp->file);
+    fseek(fp->file, 0, SEEK_END);
+    long size = ftell(fp->file);
+    fseek(fp->file, pos, SEEK_SET);
+    return size;
+}
+
+FSIZE_t f_tell(FIL *fp)
+{
+    return ftell(fp->file);
+}
+
+FRESULT f_opendir(FATFS *fs, FF_DIR *dp, const TCHAR *path)
+{
+    return FR_NO_PATH;
+}
+
+FRESULT f_stat(FATFS *fs, const TCHAR *path, FILINFO *fno)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return FR_NO_FILE;
+    }
+    fseek(file, 0, SEEK_END);
+    fno->fsize = ftell(file);
+    fno->fattrib = 0;
+    fclose(file);
+    return FR_OK;
+}
+
+FRESULT f_mkdir(FATFS *fs, const TCHAR *path)
+{
+    return FR_DENIED;
+}
+
+FRESULT f_unlink(FATFS *fs, const TCHAR *path)
+{
+    return remove(path) ? FR_NO_FILE : FR_OK;
+}
+
+FRESULT f_rename(FATFS *fs, const TCHAR *path_old, const TCHAR *path_new)
+{
+    return rename(path_old, path_new) ? FR_NO_FILE : FR_OK;
+}
@@ -0,0 +1,20 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port helpers.
+ */
+#ifndef __HOST_H__
+#define __HOST_H__
+#include <stdint.h>
+// Monotonic time in nanoseconds.
+uint64_t host_ticks_ns(void);
+// Fills the free fb_alloc region with a known pattern.
+void host_fb_paint(void);
+// Returns the number of fb_alloc bytes touched since the last host_fb_paint().
+uint32_t host_fb_peak(void);
+#endif // __HOST_H__
@@ -0,0 +1,178 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: portable C versions of the CMSIS types and intrinsics used by imlib.
+ */
+#ifndef __HOST_ARM_MATH_H__
+#define __HOST_ARM_MATH_H__
+#include <stdint.h>
+#include <math.h>
+
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
+#ifndef __INLINE
+#define __INLINE inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE static inline __attribute__((always_inline))
+#endif
+
+#define PI 3.14159265358979f
+
+typedef int8_t  q7_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+typedef float   float32_t;
+typedef double  float64_t;
+
+static inline float32_t arm_sin_f32(float32_t x) { return sinf(x); }
+static inline float32_t arm_cos_f32(float32_t x) { return cosf(x); }
+
+// The APSR.GE flags set by __USUB8 and consumed by __SEL.
+extern uint32_t __host_apsr_ge;
+
+__STATIC_FORCEINLINE uint32_t __CLZ(uint32_t x)
+{
+    return x ? __builtin_clz(x) : 32;
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+    return __builtin_bswap32(x);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t x)
+{
+    return __builtin_bswap32(x);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t x)
+{
+    return ((x & 0xFF00FF00) >> 8) | ((x & 0x00FF00FF) << 8);
+}
+
+#define __REV32 __REV
+
+__STATIC_FORCEINLINE int32_t __SSAT(int32_t x, uint32_t bits)
+{
+    int32_t max = (1 << (bits - 1)) - 1, min = -(1 << (bits - 1));
+    return (x > max) ? max : ((x < min) ? min : x);
+}
+
+__STATIC_FORCEINLINE uint32_t __USAT(int32_t x, uint32_t bits)
+{
+    int32_t max = (1 << bits) - 1;
+    return (x > max) ? max : ((x < 0) ? 0 : x);
+}
+
+__STATIC_FORCEINLINE int32_t __QADD(int32_t a, int32_t b)
+{
+    int64_t r = (int64_t) a + b;
+    return (r > INT32_MAX) ? INT32_MAX : ((r < INT32_MIN) ? INT32_MIN : r);
+}
+
+__STATIC_FORCEINLINE int32_t __QSUB(int32_t a, int32_t b)
+{
+    int64_t r = (int64_t) a - b;
+    return (r > INT32_MAX) ? INT32_MAX : ((r < INT32_MIN) ? INT32_MIN : r);
+}
+
+__STATIC_FORCEINLINE uint32_t __ROR(uint32_t x, uint32_t n)
+{
+    n &= 31;
+    return n ? ((x >> n) | (x << (32 - n))) : x;
+}
+
+__STATIC_FORCEINLINE uint32_t __SADD16(uint32_t a, uint32_t b)
+{
+    return ((uint16_t) ((int16_t) a + (int16_t) b)) | (((uint32_t) ((int16_t) (a >> 16) + (int16_t) (b >> 16))) << 16);
+}
+
+__STATIC_FORCEINLINE uint32_t __SSUB16(uint32_t a, uint32_t b)
+{
+    return ((uint16_t) ((int16_t) a - (int16_t) b)) | (((uint32_t) ((int16_t) (a >> 16) - (int16_t) (b >> 16))) << 16);
+}
+
+__STATIC_FORCEINLINE uint32_t __SMUAD(uint32_t a, uint32_t b)
+{
+    return ((int16_t) a * (int16_t) b) + ((int16_t) (a >> 16) * (int16_t) (b >> 16));
+}
+
+__STATIC_FORCEINLINE uint32_t __SMUSD(uint32_t a, uint32_t b)
+{
+    return ((int16_t) a * (int16_t) b) - ((int16_t) (a >> 16) * (int16_t) (b >> 16));
+}
+
+__STATIC_FORCEINLINE uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc)
+{
+    return acc + __SMUAD(a, b);
+}
+
+__STATIC_FORCEINLINE uint64_t __SMLALD(uint32_t a, uint32_t b, uint64_t acc)
+{
+    return acc + (int64_t) (int32_t) __SMUAD(a, b);
+}
+
+__STATIC_FORCEINLINE uint32_t __PKHBT(uint32_t a, uint32_t b, uint32_t shift)
+{
+    return (a & 0xFFFF) | ((b << shift) & 0xFFFF0000);
+}
+
+__STATIC_FORCEINLINE uint32_t __PKHTB(uint32_t a, uint32_t b, uint32_t shift)
+{
+    return (a & 0xFFFF0000) | ((b >> shift) & 0xFFFF);
+}
+
+__STATIC_FORCEINLINE uint32_t __USUB8(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0, ge = 0;
+    for (int i = 0; i < 32; i += 8) {
+        int32_t d = (int32_t) ((a >> i) & 0xFF) - (int32_t) ((b >> i) & 0xFF);
+        if (d >= 0) ge |= 0xFF << i;
+        r |= (d & 0xFF) << i;
+    }
+    __host_apsr_ge = ge;
+    return r;
+}
+
+__STATIC_FORCEINLINE uint32_t __SEL(uint32_t a, uint32_t b)
+{
+    return (a & __host_apsr_ge) | (b & ~__host_apsr_ge);
+}
+
+__STATIC_FORCEINLINE uint32_t __USADA8(uint32_t a, uint32_t b, uint32_t acc)
+{
+    for (int i = 0; i < 32; i += 8) {
+        int32_t d = (int32_t) ((a >> i) & 0xFF) - (int32_t) ((b >> i) & 0xFF);
+        acc += (d < 0) ? -d : d;
+    }
+    return acc;
+}
+
+__STATIC_FORCEINLINE uint32_t __UXTB16(uint32_t x)
+{
+    return x & 0x00FF00FF;
+}
+
+__STATIC_FORCEINLINE uint32_t __UXTB16_ROR8(uint32_t x)
+{
+    return (x >> 8) & 0x00FF00FF;
+}
+
+#endif // __HOST_ARM_MATH_H__
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: FatFs API subset backed by the C library stdio.
+ */
+#ifndef __HOST_FF_H__
+#define __HOST_FF_H__
+#include <stdio.h>
+#include <stdint.h>
+
+typedef char            TCHAR;
+typedef unsigned int    UINT;
+typedef unsigned char   BYTE;
+typedef uint16_t        WORD;
+typedef uint32_t        DWORD;
+typedef uint32_t        FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+} FRESULT;
+
+#define FA_READ             0x01
+#define FA_WRITE            0x02
+#define FA_OPEN_EXISTING    0x00
+#define FA_CREATE_NEW       0x04
+#define FA_CREATE_ALWAYS    0x08
+#define FA_OPEN_ALWAYS      0x10
+#define FA_OPEN_APPEND      0x30
+
+typedef struct {
+    int unused;
+} FATFS;
+
+typedef struct {
+    FILE *file;
+    BYTE flag;
+} FIL;
+
+typedef struct {
+    void *dir;
+} FF_DIR;
+
+typedef struct {
+    FSIZE_t fsize;
+    BYTE fattrib;
+    TCHAR fname[256];
+} FILINFO;
+
+FRESULT f_open(FATFS *fs, FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_truncate(FIL *fp);
+FRESULT f_sync(FIL *fp);
+FRESULT f_opendir(FATFS *fs, FF_DIR *dp, const TCHAR *path);
+FRESULT f_stat(FATFS *fs, const TCHAR *path, FILINFO *fno);
+FRESULT f_mkdir(FATFS *fs, const TCHAR *path);
+FRESULT f_unlink(FATFS *fs, const TCHAR *path);
+FRESULT f_rename(FATFS *fs, const TCHAR *path_old, const TCHAR *path_new);
+FSIZE_t f_size(FIL *fp);
+FSIZE_t f_tell(FIL *fp);
+#define f_eof(fp) (f_tell(fp) == f_size(fp))
+
+#endif // __HOST_FF_H__
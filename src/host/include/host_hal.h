@@ -0,0 +1,15 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: stands in for STM32_HAL_H.
+ */
+#ifndef __HOST_HAL_H__
+#define __HOST_HAL_H__
+#include <stdint.h>
+uint32_t HAL_GetTick(void);
+#endif // __HOST_HAL_H__
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: minimal MicroPython runtime shim (exceptions, heap, VFS).
+ */
+#ifndef __HOST_MP_H__
+#define __HOST_MP_H__
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <setjmp.h>
+#include <ff.h>
+
+#define STATIC static
+#define NORETURN __attribute__((noreturn))
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
+
+typedef void *mp_obj_t;
+typedef unsigned char byte;
+
+typedef struct _mp_obj_type_t {
+    const char *name;
+} mp_obj_type_t;
+
+extern const mp_obj_type_t mp_type_Exception;
+extern const mp_obj_type_t mp_type_MemoryError;
+extern const mp_obj_type_t mp_type_OSError;
+extern const mp_obj_type_t mp_type_ValueError;
+extern const mp_obj_type_t mp_type_TypeError;
+extern const mp_obj_type_t mp_type_RuntimeError;
+
+// Raised exceptions only carry their type and message on the host.
+typedef struct _mp_obj_exception_t {
+    const mp_obj_type_t *type;
+    const char *msg;
+} mp_obj_exception_t;
+
+mp_obj_t mp_obj_new_exception_msg(const mp_obj_type_t *type, const char *msg);
+
+// Non-local return implemented with setjmp/longjmp.
+typedef struct _nlr_buf_t {
+    struct _nlr_buf_t *prev;
+    void *ret_val;
+    jmp_buf jmpbuf;
+} nlr_buf_t;
+
+void nlr_push_tail(nlr_buf_t *nlr);
+void nlr_pop(void);
+NORETURN void nlr_jump(void *val);
+#define nlr_push(buf)   (nlr_push_tail(buf), setjmp((buf)->jmpbuf))
+#define nlr_raise(val)  nlr_jump(val)
+#define nlr_raise_for_fb_alloc_mark(val) nlr_jump(val)
+
+// GC heap maps onto the C library heap.
+void *gc_alloc(size_t n_bytes, unsigned int alloc_flags);
+void gc_free(void *ptr);
+void *gc_realloc(void *ptr, size_t n_bytes, bool allow_move);
+
+typedef struct _gc_info_t {
+    size_t total;
+    size_t used;
+    size_t free;
+    size_t max_free;
+    size_t num_1block;
+    size_t num_2block;
+    size_t max_block;
+} gc_info_t;
+void gc_info(gc_info_t *info);
+void gc_collect(void);
+
+#define MP_STACK_CHECK()
+
+// Printer used by the framebuffer fallback path.
+typedef void (*mp_print_strn_t)(void *data, const char *str, size_t len);
+typedef struct _mp_print_t {
+    void *data;
+    mp_print_strn_t print_strn;
+} mp_print_t;
+extern const mp_print_t mp_plat_print;
+#define MP_PYTHON_PRINTER (&mp_plat_print)
+
+// VFS: the host has a single mount that maps paths onto the C library.
+typedef struct _fs_user_mount_t {
+    FATFS fatfs;
+} fs_user_mount_t;
+
+typedef struct _mp_vfs_mount_t {
+    mp_obj_t obj;
+} mp_vfs_mount_t;
+
+#define MP_VFS_NONE     ((mp_vfs_mount_t *) 1)
+#define MP_VFS_ROOT     ((mp_vfs_mount_t *) 0)
+#define MP_OBJ_TO_PTR(o) ((void *) (o))
+mp_vfs_mount_t *mp_vfs_lookup_path(const char *path, const char **path_out);
+
+#endif // __HOST_MP_H__
@@ -0,0 +1,8 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host port: forwards to the runtime shim.
+ */
+#include <mp.h>
@@ -0,0 +1,41 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Board configuration for the host (x86-64 Linux) port.
+ */
+#ifndef __OMV_BOARDCONFIG_H__
+#define __OMV_BOARDCONFIG_H__
+
+// Architecture info
+#define OMV_ARCH_STR            "OMV HOST"
+#define OMV_BOARD_TYPE          "HOST"
+
+// RAW buffer size (VGA RGB565)
+#define OMV_RAW_BUF_SIZE        (640 * 480 * 2)
+
+// Hardware JPEG is not available on the host.
+#define OMV_HARDWARE_JPEG       (0)
+
+// If buffer size is bigger than this threshold, the quality is reduced.
+// This is only used for JPEG images sent to the IDE not normal compression.
+#define JPEG_QUALITY_THRESH     (320*240*2)
+
+// Low and high JPEG QS.
+#define JPEG_QUALITY_LOW        50
+#define JPEG_QUALITY_HIGH       90
+
+// FB Heap Block Size
+#define OMV_UMM_BLOCK_SIZE      16
+
+// Host memory layout (see host.c): the framebuffer header and pixels followed
+// by the fb_alloc stack, which grows down from the end of the region.
+#define OMV_FB_SIZE             (OMV_RAW_BUF_SIZE + 64)
+#define OMV_FB_ALLOC_SIZE       (4 * 1024 * 1024)
+#define OMV_JPEG_BUF_SIZE       (32 * 1024)
+
+#endif //__OMV_BOARDCONFIG_H__
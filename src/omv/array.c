@@ -87,8 +87,8 @@ void *array_take(array_t *array, int idx)
 {
     void *el=array->data[idx];
     if ((1 < array->index) && (idx < (array->index - 1))) {
-        /* Since dst is always < src we can just use memcpy */
-        memcpy(array->data+idx, array->data+idx+1, (array->index-idx-1) * sizeof(void*));
+        /* The source and destination overlap, use memmove */
+        memmove(array->data+idx, array->data+idx+1, (array->index-idx-1) * sizeof(void*));
     }
     array->index--;
     return el;
@@ -20,6 +20,17 @@ static uint32_t alloc_bytes;
 static uint32_t alloc_bytes_peak;
 #endif
 
+// The profiler keys allocations by the return address of the fb_alloc call.
+#define FB_ALLOC_CALLER() ((uintptr_t) __builtin_return_address(0))
+#define FB_ALLOC_PROFILE_MAX_DEPTH 8
+static bool profile_enabled = false;
+static fb_alloc_profile_t profile;
+// Scope index (or -1 if not recorded) and stack pointer of each open mark.
+static int8_t profile_scope_index[FB_ALLOC_PROFILE_MAX_DEPTH];
+static char *profile_scope_base[FB_ALLOC_PROFILE_MAX_DEPTH];
+// Set when fb_alloc() already recorded the failure that fb_alloc_fail() raises.
+static bool profile_fail_recorded = false;
+
 #if defined(OMV_FB_OVERLAY_MEMORY)
 #define FB_OVERLAY_MEMORY_FLAG 0x1
 extern char _fballoc_overlay;
@@ -28,9 +39,11 @@ static char *pointer_overlay = &_fballoc_overlay;
 
 static char *fb_alloc_min_address()
 {
-    return (char *) (framebuffer_get_buffer() + framebuffer_get_frame_size());
+    return (char *) framebuffer_get_buffers_end();
 }
 
+static void fb_alloc_profile_fail(uintptr_t caller, uint32_t size);
+
 char *fb_alloc_stack_pointer()
 {
     return pointer;
@@ -38,6 +51,11 @@ char *fb_alloc_stack_pointer()
 
 __weak NORETURN void fb_alloc_fail()
 {
+    // Failures raised by code using fb memory through other allocators (e.g. umm_malloc).
+    if (profile_enabled && (!profile_fail_recorded)) {
+        fb_alloc_profile_fail(FB_ALLOC_CALLER(), 0);
+    }
+    profile_fail_recorded = false;
     nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError,
         "Out of fast Frame Buffer Stack Memory!"
         " Please reduce the resolution of the image you are running this algorithm on to bypass this issue!"));
@@ -58,12 +76,141 @@ uint32_t fb_avail()
     return (temp < sizeof(uint32_t)) ? 0 : temp;
 }
 
+// Returns the caller of the fb_alloc_mark() which opened the given mark level.
+static uintptr_t fb_alloc_profile_scope_at(int level)
+{
+    if ((level <= 0) || (level > FB_ALLOC_PROFILE_MAX_DEPTH) || (profile_scope_index[level - 1] < 0)) {
+        return 0;
+    }
+    return profile.scopes[(int) profile_scope_index[level - 1]].caller;
+}
+
+static uintptr_t fb_alloc_profile_scope()
+{
+    return fb_alloc_profile_scope_at(marks);
+}
+
+static void fb_alloc_profile_mark(uintptr_t caller)
+{
+    if (marks > FB_ALLOC_PROFILE_MAX_DEPTH) {
+        return;
+    }
+
+    // Called after the mark is pushed, so marks is at least 1 here.
+    uintptr_t parent = fb_alloc_profile_scope_at(marks - 1);
+    int index = -1;
+
+    for (int i = 0; i < profile.n_scopes; i++) {
+        if ((profile.scopes[i].caller == caller) && (profile.scopes[i].parent == parent)) {
+            index = i;
+            break;
+        }
+    }
+
+    if ((index < 0) && (profile.n_scopes < FB_ALLOC_PROFILE_MAX_SCOPES)) {
+        index = profile.n_scopes++;
+        profile.scopes[index].caller = caller;
+        profile.scopes[index].parent = parent;
+    }
+
+    if (index >= 0) {
+        profile.scopes[index].marks += 1;
+    }
+
+    profile_scope_index[marks - 1] = index;
+    profile_scope_base[marks - 1] = pointer;
+}
+
+static void fb_alloc_profile_alloc(uintptr_t caller, uint32_t size, bool all)
+{
+    uint32_t depth = &_fballoc - pointer;
+    uint32_t avail = fb_avail();
+    uintptr_t scope = fb_alloc_profile_scope();
+    fb_alloc_profile_site_t *site = NULL;
+
+    profile.peak = IM_MAX(profile.peak, depth);
+    profile.min_free = IM_MIN(profile.min_free, avail);
+
+    for (int i = 0, j = IM_MIN(marks, FB_ALLOC_PROFILE_MAX_DEPTH); i < j; i++) {
+        if (profile_scope_index[i] >= 0) {
+            fb_alloc_profile_scope_t *s = &profile.scopes[(int) profile_scope_index[i]];
+            s->peak = IM_MAX(s->peak, profile_scope_base[i] - pointer);
+        }
+    }
+
+    for (int i = 0; i < profile.n_sites; i++) {
+        if ((profile.sites[i].caller == caller) && (profile.sites[i].scope == scope)) {
+            site = &profile.sites[i];
+            break;
+        }
+    }
+
+    if ((!site) && (profile.n_sites < FB_ALLOC_PROFILE_MAX_SITES)) {
+        site = &profile.sites[profile.n_sites++];
+        site->caller = caller;
+        site->scope = scope;
+    }
+
+    if (!site) {
+        profile.dropped += 1;
+        return;
+    }
+
+    site->allocs += 1;
+    site->peak = IM_MAX(site->peak, depth);
+    if (all) {
+        site->max_all = IM_MAX(site->max_all, size);
+    } else {
+        site->max_alloc = IM_MAX(site->max_alloc, size);
+    }
+}
+
+static void fb_alloc_profile_fail(uintptr_t caller, uint32_t size)
+{
+    profile_fail_recorded = true;
+    profile.fail.caller = caller;
+    profile.fail.scope = fb_alloc_profile_scope();
+    profile.fail.size = size;
+    profile.fail.free = fb_avail();
+}
+
+void fb_alloc_profile_clear()
+{
+    memset(&profile, 0, sizeof(profile));
+    profile.min_free = UINT32_MAX;
+    // Marks opened before the profiler was cleared are not attributed to a scope.
+    memset(profile_scope_index, -1, sizeof(profile_scope_index));
+}
+
+void fb_alloc_profile_enable(bool enable)
+{
+    if (enable) {
+        fb_alloc_profile_clear();
+    }
+    profile_enabled = enable;
+}
+
+bool fb_alloc_profile_enabled()
+{
+    return profile_enabled;
+}
+
+const fb_alloc_profile_t *fb_alloc_profile_get()
+{
+    return &profile;
+}
+
 void fb_alloc_mark()
 {
     char *new_pointer = pointer - sizeof(uint32_t);
 
     // Check if allocation overwrites the framebuffer pixels
     if (new_pointer < fb_alloc_min_address()) {
+        if (profile_enabled) {
+            fb_alloc_profile_fail(FB_ALLOC_CALLER(), sizeof(uint32_t));
+            // Raised here and not by fb_alloc_fail(), which would clear the flag.
+            profile_fail_recorded = false;
+        }
         nlr_raise_for_fb_alloc_mark(mp_obj_new_exception_msg(&mp_type_MemoryError,
             "Out of fast Frame Buffer Stack Memory!"
             " Please reduce the resolution of the image you are running this algorithm on to bypass this issue!"));
@@ -75,6 +222,9 @@ void fb_alloc_mark()
     *((uint32_t *) new_pointer) = sizeof(uint32_t); // Save size.
     pointer = new_pointer;
     marks += 1;
+    if (profile_enabled) {
+        fb_alloc_profile_mark(FB_ALLOC_CALLER());
+    }
     #if defined(FB_ALLOC_STATS)
     alloc_bytes = 0;
     alloc_bytes_peak = 0;
@@ -101,8 +251,7 @@ void fb_alloc_free_till_mark()
     #endif
 }
 
-// returns null pointer without error if size==0
-void *fb_alloc(uint32_t size, int hints)
+static void *fb_alloc_internal(uint32_t size, int hints, uintptr_t caller)
 {
     if (!size) {
         return NULL;
@@ -114,6 +263,9 @@ void *fb_alloc(uint32_t size, int hints)
 
     // Check if allocation overwrites the framebuffer pixels
     if (new_pointer < fb_alloc_min_address()) {
+        if (profile_enabled) {
+            fb_alloc_profile_fail(caller, size);
+        }
         fb_alloc_fail();
     }
 
@@ -127,6 +279,9 @@ void *fb_alloc(uint32_t size, int hints)
     }
     printf("fb_alloc %lu bytes\n", size);
     #endif
+    if (profile_enabled) {
+        fb_alloc_profile_alloc(caller, size, false);
+    }
     #if defined(OMV_FB_OVERLAY_MEMORY)
     if ((!(hints & FB_ALLOC_PREFER_SIZE))
     && (((uint32_t) (pointer_overlay - OMV_FB_OVERLAY_MEMORY_ORIGIN)) >= size)) {
@@ -139,15 +294,21 @@ void *fb_alloc(uint32_t size, int hints)
     return result;
 }
 
+// returns null pointer without error if size==0
+void *fb_alloc(uint32_t size, int hints)
+{
+    return fb_alloc_internal(size, hints, FB_ALLOC_CALLER());
+}
+
 // returns null pointer without error if passed size==0
 void *fb_alloc0(uint32_t size, int hints)
 {
-    void *mem = fb_alloc(size, hints);
+    void *mem = fb_alloc_internal(size, hints, FB_ALLOC_CALLER());
     memset(mem, 0, size); // does nothing if size is zero.
     return mem;
 }
 
-void *fb_alloc_all(uint32_t *size, int hints)
+static void *fb_alloc_all_internal(uint32_t *size, int hints, uintptr_t caller)
 {
     uint32_t temp = pointer - fb_alloc_min_address() - sizeof(uint32_t);
 
@@ -176,6 +337,9 @@ void *fb_alloc_all(uint32_t *size, int hints)
     }
     printf("fb_alloc_all %lu bytes\n", *size);
     #endif
+    if (profile_enabled) {
+        fb_alloc_profile_alloc(caller, *size, true);
+    }
     #if defined(OMV_FB_OVERLAY_MEMORY)
     if (!(hints & FB_ALLOC_PREFER_SIZE)) {
         // Return overlay memory instead.
@@ -187,10 +351,15 @@ void *fb_alloc_all(uint32_t *size, int hints)
     return result;
 }
 
+void *fb_alloc_all(uint32_t *size, int hints)
+{
+    return fb_alloc_all_internal(size, hints, FB_ALLOC_CALLER());
+}
+
 // returns null pointer without error if returned size==0
 void *fb_alloc0_all(uint32_t *size, int hints)
 {
-    void *mem = fb_alloc_all(size, hints);
+    void *mem = fb_alloc_all_internal(size, hints, FB_ALLOC_CALLER());
     memset(mem, 0, *size); // does nothing if size is zero.
     return mem;
 }
@@ -9,9 +9,39 @@
 #ifndef __FB_ALLOC_H__
 #define __FB_ALLOC_H__
 #include <stdint.h>
+#include <stdbool.h>
 #define FB_ALLOC_NO_HINT 0
 #define FB_ALLOC_PREFER_SPEED 1
 #define FB_ALLOC_PREFER_SIZE 2
+#define FB_ALLOC_PROFILE_MAX_SCOPES 8
+#define FB_ALLOC_PROFILE_MAX_SITES 24
+typedef struct fb_alloc_profile_scope {
+    uintptr_t caller; // Return address of the fb_alloc_mark() call.
+    uintptr_t parent; // Return address of the enclosing fb_alloc_mark() call (0 if none).
+    uint32_t marks; // Number of times the scope was entered.
+    uint32_t peak; // Peak bytes allocated inside the scope.
+} fb_alloc_profile_scope_t;
+typedef struct fb_alloc_profile_site {
+    uintptr_t caller; // Return address of the allocating call.
+    uintptr_t scope; // Return address of the enclosing fb_alloc_mark() call (0 if none).
+    uint32_t allocs; // Number of allocations.
+    uint32_t peak; // Peak stack depth right after an allocation from this site.
+    uint32_t max_alloc; // Largest fb_alloc()/fb_alloc0() request.
+    uint32_t max_all; // Largest fb_alloc_all()/fb_alloc0_all() grab.
+} fb_alloc_profile_site_t;
+typedef struct fb_alloc_profile {
+    uint32_t peak; // Peak stack depth in bytes.
+    uint32_t min_free; // Smallest amount of free fb_alloc memory seen.
+    uint32_t dropped; // Allocations not recorded because the tables were full.
+    uint32_t n_scopes, n_sites;
+    fb_alloc_profile_scope_t scopes[FB_ALLOC_PROFILE_MAX_SCOPES];
+    fb_alloc_profile_site_t sites[FB_ALLOC_PROFILE_MAX_SITES];
+    // The allocation which last raised an out of memory error.
+    struct {
+        uintptr_t caller, scope;
+        uint32_t size, free;
+    } fail;
+} fb_alloc_profile_t;
 char *fb_alloc_stack_pointer();
 void fb_alloc_fail();
 void fb_alloc_init0();
@@ -24,4 +54,8 @@ void *fb_alloc_all(uint32_t *size, int hints); // returns pointer and sets size
 void *fb_alloc0_all(uint32_t *size, int hints); // returns pointer and sets size
 void fb_free();
 void fb_free_all();
+void fb_alloc_profile_enable(bool enable); // Enabling also clears the profile.
+bool fb_alloc_profile_enabled();
+void fb_alloc_profile_clear();
+const fb_alloc_profile_t *fb_alloc_profile_get();
 #endif /* __FF_ALLOC_H__ */
@@ -21,6 +21,8 @@ framebuffer_t *framebuffer = (framebuffer_t *) &_fb_base;
 extern char _jpeg_buf;
 jpegbuffer_t *jpeg_framebuffer = (jpegbuffer_t *) &_jpeg_buf;
 
+static uint32_t framebuffer_frame_id;
+
 void fb_set_streaming_enabled(bool enable)
 {
     framebuffer->streaming_enabled = enable;
@@ -75,7 +77,8 @@ void framebuffer_initialize_image(image_t *img)
     img->w = framebuffer->w;
     img->h = framebuffer->h;
     img->bpp = framebuffer->bpp;
-    img->data = framebuffer->pixels;
+    img->data = framebuffer_get_buffer();
+    img->stride = 0;
 }
 
 static void initialize_jpeg_buf_from_image(image_t *img)
@@ -205,18 +208,38 @@ uint32_t framebuffer_get_frame_size()
 }
 
 uint32_t framebuffer_get_buffer_size()
+{
+    // Each buffer of a running capture ring gets an equal share.
+    return framebuffer_get_ring_buffer_size(framebuffer->buf_size ? framebuffer->n_buffers : 1);
+}
+
+uint32_t framebuffer_get_ring_buffer_size(int32_t n_buffers)
 {
     uint32_t size = (uint32_t) (fb_alloc_stack_pointer() - ((char *) framebuffer->pixels));
     // We don't want to give all of the frame buffer RAM to the frame buffer. So, we will limit the
     // maximum amount of RAM we return.
-    size = IM_MIN(size, OMV_RAW_BUF_SIZE);
+    size = IM_MIN(size, OMV_RAW_BUF_SIZE) / n_buffers;
     // Needs to be a multiple of 32 for DMA transfers...
     return (size / 32) * 32;
 }
 
 uint8_t *framebuffer_get_buffer()
 {
-    return framebuffer->pixels;
+    return framebuffer_get_buffer_at(framebuffer->buf_index);
+}
+
+uint8_t *framebuffer_get_buffer_at(int32_t index)
+{
+    return framebuffer->pixels + (index * framebuffer->buf_size);
+}
+
+uint8_t *framebuffer_get_buffers_end()
+{
+    if (framebuffer->buf_size) {
+        // The DCMI may be writing to any buffer in the ring.
+        return framebuffer->pixels + (framebuffer->n_buffers * framebuffer->buf_size);
+    }
+    return framebuffer_get_buffer() + framebuffer_get_frame_size();
 }
 
 void framebuffer_set(int32_t w, int32_t h, int32_t bpp)
@@ -225,3 +248,13 @@ void framebuffer_set(int32_t w, int32_t h, int32_t bpp)
     framebuffer->h = h;
     framebuffer->bpp = bpp;
 }
+
+uint32_t framebuffer_get_frame_id()
+{
+    return framebuffer_frame_id;
+}
+
+void framebuffer_new_frame()
+{
+    framebuffer_frame_id += 1;
+}
@@ -20,10 +20,16 @@ typedef struct framebuffer {
     int32_t u,v;
     int32_t bpp;
     int32_t streaming_enabled;
+    int32_t n_buffers; // Number of buffers in the capture ring (1 to FB_MAX_BUFFERS).
+    int32_t buf_index; // Index of the buffer holding the current frame.
+    int32_t buf_size; // Size of each ring buffer while the capture ring is running (else 0).
+    int32_t reserved; // Keeps pixels aligned.
     // NOTE: This buffer must be aligned on a 16 byte boundary
     uint8_t pixels[];
 } framebuffer_t;
 
+#define FB_MAX_BUFFERS  (3)
+
 extern framebuffer_t *framebuffer;
 
 typedef struct jpegbuffer {
@@ -65,15 +71,29 @@ int32_t framebuffer_get_depth();
 uint32_t framebuffer_get_frame_size();
 
 // Return the max frame size that fits the framebuffer
-// (i.e OMV_RAW_BUF_SIZE - sizeof(framebuffer_t))
+// (i.e OMV_RAW_BUF_SIZE - sizeof(framebuffer_t)), divided between the ring buffers
+// while the capture ring is running.
 uint32_t framebuffer_get_buffer_size();
+// Size of each buffer of a capture ring with n_buffers buffers.
+uint32_t framebuffer_get_ring_buffer_size(int32_t n_buffers);
 
 // Return the current buffer address.
 uint8_t *framebuffer_get_buffer();
 
+// Return the address of a capture ring buffer.
+uint8_t *framebuffer_get_buffer_at(int32_t index);
+
+// Return the end of the frame buffer memory in use (the current frame or the whole capture ring).
+uint8_t *framebuffer_get_buffers_end();
+
 // Set the framebuffer w, h and bpp.
 void framebuffer_set(int32_t w, int32_t h, int32_t bpp);
 
+// Counts the frames captured or loaded in the frame buffer, data computed from the frame buffer
+// can keep the id to check that it still holds the same frame.
+uint32_t framebuffer_get_frame_id();
+void framebuffer_new_frame();
+
 // Use these macros to get a pointer to main or JPEG framebuffer.
 #define MAIN_FB()           (framebuffer)
 #define JPEG_FB()           (jpeg_framebuffer)
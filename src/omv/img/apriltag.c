@@ -5191,6 +5191,12 @@ struct apriltag_detector
     ///////////////////////////////////////////////////////////////
     // User-configurable parameters.
 
+    // detection of quads can be done on a lower-resolution image,
+    // improving speed at a cost of pose accuracy and a slight
+    // decrease in detection rate. Decoding the binary payload is
+    // still done at full resolution.
+    int quad_decimate;
+
     // When non-zero, the edges of the each quad are adjusted to "snap
     // to" strong gradients nearby. This is useful when decimation is
     // employed, as it can increase the quality of the initial quad
@@ -5233,6 +5239,9 @@ struct apriltag_detector
     // between multiple users. The user should ultimately destroy the
     // tag family passed into the constructor.
     zarray_t *tag_families;
+
+    // Quick decode tables of the tag families above, in the same order.
+    zarray_t *quick_decodes;
 };
 
 // Represents the detection of a tag. These are returned to the user
@@ -5285,14 +5294,14 @@ apriltag_detector_t *apriltag_detector_create();
 
 // add a family to the apriltag detector. caller still "owns" the family.
 // a single instance should only be provided to one apriltag detector instance.
+// bits_corrected is clamped to the most errors the family can safely correct,
+// a negative value selects that maximum. Each bit costs another copy of the
+// code indices in the quick decode table.
 void apriltag_detector_add_family_bits(apriltag_detector_t *td, apriltag_family_t *fam, int bits_corrected);
 
-// Tunable, but really, 2 is a good choice. Values of >=3
-// consume prohibitively large amounts of memory, and otherwise
-// you want the largest value possible.
 static inline void apriltag_detector_add_family(apriltag_detector_t *td, apriltag_family_t *fam)
 {
-    apriltag_detector_add_family_bits(td, fam, 2);
+    apriltag_detector_add_family_bits(td, fam, -1);
 }
 
 // does not deallocate the family.
@@ -10193,6 +10202,28 @@ static void do_unionfind_line(unionfind_t *uf, image_u8_t *im, int h, int w, int
 #undef DO_UNIONFIND
 #endif // OPTIMIZED
 
+// Keeps every factor-th pixel of every factor-th row, the caller has to
+// fb_free() the returned image and its buffer.
+static image_u8_t *image_u8_decimate(image_u8_t *im, int factor)
+{
+    image_u8_t *decim = fb_alloc(sizeof(image_u8_t), FB_ALLOC_NO_HINT);
+    decim->width = im->width / factor;
+    decim->height = im->height / factor;
+    decim->stride = decim->width;
+    decim->buf = fb_alloc(decim->width * decim->height, FB_ALLOC_NO_HINT);
+
+    for (int y = 0; y < decim->height; y++) {
+        uint8_t *src = im->buf + (y * factor * im->stride);
+        uint8_t *dst = decim->buf + (y * decim->stride);
+
+        for (int x = 0; x < decim->width; x++) {
+            dst[x] = src[x * factor];
+        }
+    }
+
+    return decim;
+}
+
 image_u8_t *threshold(apriltag_detector_t *td, image_u8_t *im)
 {
     int w = im->width, h = im->height, s = im->stride;
@@ -10837,10 +10868,27 @@ struct quick_decode_entry
     bool vflip;
 };
 
+// Longest chunk key, longer chunks only index their low bits.
+#define QUICK_DECODE_MAX_KEY_BITS 10
+
+struct quick_decode_chunk
+{
+    uint8_t shift;      // first bit of the chunk in the code
+    uint8_t bits;       // key width, the table has (1 << bits) buckets
+    uint16_t *offsets;  // bucket i holds ids[offsets[i]] to ids[offsets[i + 1] - 1]
+    uint16_t *ids;      // code indices sorted by bucket, ascending in each bucket
+};
+
+// The codes are split into maxhamming + 1 chunks and each chunk is hashed
+// on its own. A code within maxhamming bits of the query must match it
+// exactly in at least one chunk, so only the codes in the query's buckets
+// have to be compared instead of the whole family.
 struct quick_decode
 {
-    int nentries;
-    struct quick_decode_entry *entries;
+    apriltag_family_t *family;
+    int maxhamming;     // most bits corrected, trades accuracy for memory
+    int nchunks;
+    struct quick_decode_chunk *chunks; // built on the first decode
 };
 
 /** if the bits in w were arranged in a d*d grid and that grid was
@@ -10978,85 +11026,110 @@ int popcount64c(uint64_t x)
     return (x * h01) >> 56;  //returns left 8 bits of x + (x<<8) + (x<<16) + (x<<24) + ...
 }
 
-// returns an entry with hamming set to 255 if no decode was found.
-static void quick_decode_codeword(apriltag_family_t *tf, uint64_t rcode,
-                                  struct quick_decode_entry *entry)
+static void quick_decode_init(struct quick_decode *qd)
 {
-    int threshold = imax(tf->h - tf->d - 1, 0);
+    apriltag_family_t *tf = qd->family;
+    int nbits = tf->d * tf->d;
 
-    for (int ridx = 0; ridx < 4; ridx++) {
+    qd->nchunks = imin(qd->maxhamming + 1, nbits);
+    qd->chunks = calloc(qd->nchunks, sizeof(struct quick_decode_chunk));
 
-        for (int i = 0, j = tf->ncodes; i < j; i++) {
-            int hamming = popcount64c(tf->codes[i] ^ rcode);
-            if(hamming <= threshold) {
-                entry->rcode = rcode;
-                entry->id = i;
-                entry->hamming = hamming;
-                entry->rotation = ridx;
-                entry->hmirror = false;
-                entry->vflip = false;
-                return;
-            }
-        }
+    for (int c = 0; c < qd->nchunks; c++) {
+        struct quick_decode_chunk *chunk = &qd->chunks[c];
+        int lo = (c * nbits) / qd->nchunks, hi = ((c + 1) * nbits) / qd->nchunks;
+        chunk->shift = lo;
+        chunk->bits = imin(hi - lo, QUICK_DECODE_MAX_KEY_BITS);
 
-        rcode = rotate90(rcode, tf->d);
-    }
+        int nbuckets = 1 << chunk->bits, mask = nbuckets - 1;
+        chunk->offsets = calloc(nbuckets + 1, sizeof(uint16_t));
+        chunk->ids = malloc(tf->ncodes * sizeof(uint16_t));
 
-    rcode = hmirror_code(rcode, tf->d); // handle hmirror
+        // Counting sort of the code indices by bucket.
+        for (int i = 0; i < tf->ncodes; i++) {
+            chunk->offsets[((tf->codes[i] >> lo) & mask) + 1]++;
+        }
 
-    for (int ridx = 0; ridx < 4; ridx++) {
+        for (int i = 0; i < nbuckets; i++) {
+            chunk->offsets[i + 1] += chunk->offsets[i];
+        }
 
-        for (int i = 0, j = tf->ncodes; i < j; i++) {
-            int hamming = popcount64c(tf->codes[i] ^ rcode);
-            if(hamming <= threshold) {
-                entry->rcode = rcode;
-                entry->id = i;
-                entry->hamming = hamming;
-                entry->rotation = ridx;
-                entry->hmirror = true;
-                entry->vflip = false;
-                return;
-            }
+        for (int i = 0; i < tf->ncodes; i++) {
+            chunk->ids[chunk->offsets[(tf->codes[i] >> lo) & mask]++] = i;
         }
 
-        rcode = rotate90(rcode, tf->d);
+        // Each offset now points to the end of its bucket, shift them back.
+        memmove(chunk->offsets + 1, chunk->offsets, nbuckets * sizeof(uint16_t));
+        chunk->offsets[0] = 0;
     }
+}
 
-    rcode = vflip_code(rcode, tf->d); // handle hmirror+vflip
+static void quick_decode_uninit(struct quick_decode *qd)
+{
+    if (!qd->chunks)
+        return;
 
-    for (int ridx = 0; ridx < 4; ridx++) {
+    for (int c = 0; c < qd->nchunks; c++) {
+        free(qd->chunks[c].offsets);
+        free(qd->chunks[c].ids);
+    }
 
-        for (int i = 0, j = tf->ncodes; i < j; i++) {
-            int hamming = popcount64c(tf->codes[i] ^ rcode);
-            if(hamming <= threshold) {
-                entry->rcode = rcode;
-                entry->id = i;
-                entry->hamming = hamming;
-                entry->rotation = ridx;
-                entry->hmirror = true;
-                entry->vflip = true;
-                return;
+    free(qd->chunks);
+    qd->chunks = NULL;
+}
+
+// returns the lowest code index within maxhamming bits of rcode or -1.
+static int quick_decode_lookup(struct quick_decode *qd, uint64_t rcode, int *hamming)
+{
+    apriltag_family_t *tf = qd->family;
+    int best = -1;
+
+    for (int c = 0; c < qd->nchunks; c++) {
+        struct quick_decode_chunk *chunk = &qd->chunks[c];
+        int key = (rcode >> chunk->shift) & ((1 << chunk->bits) - 1);
+
+        for (int i = chunk->offsets[key], j = chunk->offsets[key + 1]; i < j; i++) {
+            int id = chunk->ids[i];
+            if ((best >= 0) && (id >= best))
+                break;
+
+            int h = popcount64c(tf->codes[id] ^ rcode);
+            if (h <= qd->maxhamming) {
+                best = id;
+                *hamming = h;
+                break;
             }
         }
-
-        rcode = rotate90(rcode, tf->d);
     }
 
-    rcode = hmirror_code(rcode, tf->d); // handle vflip
+    return best;
+}
 
-    for (int ridx = 0; ridx < 4; ridx++) {
+// returns an entry with hamming set to 255 if no decode was found.
+static void quick_decode_codeword(struct quick_decode *qd, uint64_t rcode,
+                                  struct quick_decode_entry *entry)
+{
+    apriltag_family_t *tf = qd->family;
 
-        for (int i = 0, j = tf->ncodes; i < j; i++) {
-            int hamming = popcount64c(tf->codes[i] ^ rcode);
-            if(hamming <= threshold) {
-                entry->rcode = rcode;
-                entry->id = i;
-                entry->hamming = hamming;
-                entry->rotation = ridx;
-                entry->hmirror = false;
-                entry->vflip = true;
-                return;
-            }
+    if (!qd->chunks)
+        quick_decode_init(qd);
+
+    // Tries the 4 rotations of the code, then of its hmirror, hmirror+vflip and vflip.
+    for (int variant = 0; variant < 16; variant++) {
+        int ridx = variant % 4, hamming;
+
+        if (variant && !ridx) {
+            rcode = (variant == 8) ? vflip_code(rcode, tf->d) : hmirror_code(rcode, tf->d);
+        }
+
+        int id = quick_decode_lookup(qd, rcode, &hamming);
+        if (id >= 0) {
+            entry->rcode = rcode;
+            entry->id = id;
+            entry->hamming = hamming;
+            entry->rotation = ridx;
+            entry->hmirror = (variant >= 4) && (variant < 12);
+            entry->vflip = (variant >= 8);
+            return;
         }
 
         rcode = rotate90(rcode, tf->d);
@@ -11080,17 +11153,46 @@ static inline int detection_compare_function(const void *_a, const void *_b)
 
 void apriltag_detector_remove_family(apriltag_detector_t *td, apriltag_family_t *fam)
 {
-    zarray_remove_value(td->tag_families, &fam, 0);
+    for (int i = 0; i < zarray_size(td->tag_families); i++) {
+        apriltag_family_t *f;
+        zarray_get(td->tag_families, i, &f);
+
+        if (f == fam) {
+            struct quick_decode *qd;
+            zarray_get(td->quick_decodes, i, &qd);
+            quick_decode_uninit(qd);
+            free(qd);
+
+            zarray_remove_index(td->tag_families, i, 0);
+            zarray_remove_index(td->quick_decodes, i, 0);
+            return;
+        }
+    }
 }
 
 void apriltag_detector_add_family_bits(apriltag_detector_t *td, apriltag_family_t *fam, int bits_corrected)
 {
+    int max_bits = imax(fam->h - fam->d - 1, 0);
+
+    struct quick_decode *qd = calloc(1, sizeof(struct quick_decode));
+    qd->family = fam;
+    qd->maxhamming = (bits_corrected < 0) ? max_bits : imin(bits_corrected, max_bits);
+
     zarray_add(td->tag_families, &fam);
+    zarray_add(td->quick_decodes, &qd);
 }
 
 void apriltag_detector_clear_families(apriltag_detector_t *td)
 {
+    for (int i = 0; i < zarray_size(td->quick_decodes); i++) {
+        struct quick_decode *qd;
+        zarray_get(td->quick_decodes, i, &qd);
+        quick_decode_uninit(qd);
+        free(qd);
+    }
+
     zarray_clear(td->tag_families);
+    zarray_clear(td->quick_decodes);
 }
 
 apriltag_detector_t *apriltag_detector_create()
@@ -11106,7 +11208,9 @@ apriltag_detector_t *apriltag_detector_create()
     td->qtp.min_white_black_diff = 5;
 
     td->tag_families = zarray_create(sizeof(apriltag_family_t*));
+    td->quick_decodes = zarray_create(sizeof(struct quick_decode*));
 
+    td->quad_decimate = 1;
     td->refine_edges = 1;
     td->refine_pose = 0;
     td->refine_decode = 0;
@@ -11119,6 +11223,7 @@ void apriltag_detector_destroy(apriltag_detector_t *td)
     apriltag_detector_clear_families(td);
 
     zarray_destroy(td->tag_families);
+    zarray_destroy(td->quick_decodes);
     free(td);
 }
 
@@ -11284,7 +11389,7 @@ float quad_goodness(apriltag_family_t *family, image_u8_t *im, struct quad *quad
 }
 
 // returns the decision margin. Return < 0 if the detection should be rejected.
-float quad_decode(apriltag_family_t *family, image_u8_t *im, struct quad *quad, struct quick_decode_entry *entry, image_u8_t *im_samples)
+float quad_decode(apriltag_family_t *family, struct quick_decode *qd, image_u8_t *im, struct quad *quad, struct quick_decode_entry *entry, image_u8_t *im_samples)
 {
     // decode the tag binary contents by sampling the pixel
     // closest to the center of each bit cell.
@@ -11437,7 +11542,7 @@ float quad_decode(apriltag_family_t *family, image_u8_t *im, struct quad *quad,
             im_samples->buf[iy*im_samples->stride + ix] = (1 - (rcode & 1)) * 255;
     }
 
-    quick_decode_codeword(family, rcode, entry);
+    quick_decode_codeword(qd, rcode, entry);
 
     return fmin(white_score / white_score_count, black_score / black_score_count);
 }
@@ -11451,7 +11556,7 @@ float score_decodability(apriltag_family_t *family, image_u8_t *im, struct quad
 {
     struct quick_decode_entry entry;
 
-    float decision_margin = quad_decode(family, im, quad, &entry, NULL);
+    float decision_margin = quad_decode(family, (struct quick_decode *) user, im, quad, &entry, NULL);
 
     // hamming trumps decision margin; maximum value for decision_margin is 255.
     return decision_margin - entry.hamming*1000;
@@ -11577,7 +11682,7 @@ static void refine_edges(apriltag_detector_t *td, image_u8_t *im_orig, struct qu
             // search on another pixel in the first place. Likewise,
             // for very small tags, we don't want the range to be too
             // big.
-            float range = 1.0 + 1;
+            float range = td->quad_decimate + 1;
 
             // XXX tunable step size.
             for (float n = -range; n <= range; n +=  0.25) {
@@ -11710,8 +11815,30 @@ zarray_t *apriltag_detector_detect(apriltag_detector_t *td, image_u8_t *im_orig)
     // Step 1. Detect quads according to requested image decimation
     // and blurring parameters.
 
+    image_u8_t *quad_im = im_orig;
+    if (td->quad_decimate > 1) {
+        quad_im = image_u8_decimate(im_orig, td->quad_decimate);
+    }
+
 //    zarray_t *quads = apriltag_quad_gradient(td, im_orig);
-    zarray_t *quads = apriltag_quad_thresh(td, im_orig, false);
+    zarray_t *quads = apriltag_quad_thresh(td, quad_im, false);
+
+    // adjust centers of pixels so that they correspond to the
+    // original full-resolution image.
+    if (td->quad_decimate > 1) {
+        fb_free(); // quad_im->buf
+        fb_free(); // quad_im
+
+        for (int i = 0; i < zarray_size(quads); i++) {
+            struct quad *q;
+            zarray_get_volatile(quads, i, &q);
+
+            for (int j = 0; j < 4; j++) {
+                q->p[j][0] = (q->p[j][0] - 0.5) * td->quad_decimate + 0.5;
+                q->p[j][1] = (q->p[j][1] - 0.5) * td->quad_decimate + 0.5;
+            }
+        }
+    }
 
     zarray_t *detections = zarray_create(sizeof(apriltag_detection_t*));
 
@@ -11739,6 +11866,9 @@ zarray_t *apriltag_detector_detect(apriltag_detector_t *td, image_u8_t *im_orig)
                 apriltag_family_t *family;
                 zarray_get(td->tag_families, famidx, &family);
 
+                struct quick_decode *qd;
+                zarray_get(td->quick_decodes, famidx, &qd);
+
                 float goodness = 0;
 
                 // since the geometry of tag families can vary, start any
@@ -11768,12 +11898,12 @@ zarray_t *apriltag_detector_detect(apriltag_detector_t *td, image_u8_t *im_orig)
                     float stepsizes[] = { .4 };
                     int nstepsizes = sizeof(stepsizes)/sizeof(float);
 
-                    optimize_quad_generic(family, im_orig, quad, stepsizes, nstepsizes, score_decodability, NULL);
+                    optimize_quad_generic(family, im_orig, quad, stepsizes, nstepsizes, score_decodability, qd);
                 }
 
                 struct quick_decode_entry entry;
 
-                float decision_margin = quad_decode(family, im_orig, quad, &entry, NULL);
+                float decision_margin = quad_decode(family, qd, im_orig, quad, &entry, NULL);
 
                 if (entry.hamming < 255 && decision_margin >= 0) {
                     apriltag_detection_t *det = calloc(1, sizeof(apriltag_detection_t));
@@ -11942,39 +12072,42 @@ void apriltag_detections_destroy(zarray_t *detections)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_families_t families,
-                          float fx, float fy, float cx, float cy)
+                          float fx, float fy, float cx, float cy, int max_hamming, int decimate)
 {
     // Frame Buffer Memory Usage...
     // -> GRAYSCALE Input Image = w*h*1
-    // -> GRAYSCALE Threhsolded Image = w*h*1
-    // -> UnionFind = w*h*2 (+w*h*1 for hash table)
+    // -> GRAYSCALE Decimated Image = (w/d)*(h/d)*1 (if d > 1)
+    // -> GRAYSCALE Threhsolded Image = (w/d)*(h/d)*1
+    // -> UnionFind = (w/d)*(h/d)*2 (+(w/d)*(h/d)*1 for hash table)
     size_t resolution = roi->w * roi->h;
-    size_t fb_alloc_need = resolution * (1 + 1 + 2 + 1); // read above...
+    size_t quad_resolution = (roi->w / decimate) * (roi->h / decimate);
+    size_t fb_alloc_need = resolution + (quad_resolution * (((decimate > 1) ? 1 : 0) + 1 + 2 + 1)); // read above...
     umm_init_x(((fb_avail() - fb_alloc_need) / resolution) * resolution);
     apriltag_detector_t *td = apriltag_detector_create();
+    td->quad_decimate = decimate;
 
     if (families & TAG16H5) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &tag16h5);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &tag16h5, max_hamming);
     }
 
     if (families & TAG25H7) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &tag25h7);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &tag25h7, max_hamming);
     }
 
     if (families & TAG25H9) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &tag25h9);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &tag25h9, max_hamming);
     }
 
     if (families & TAG36H10) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &tag36h10);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &tag36h10, max_hamming);
     }
 
     if (families & TAG36H11) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &tag36h11);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &tag36h11, max_hamming);
     }
 
     if (families & ARTOOLKIT) {
-        apriltag_detector_add_family(td, (apriltag_family_t *) &artoolkit);
+        apriltag_detector_add_family_bits(td, (apriltag_family_t *) &artoolkit, max_hamming);
     }
 
     uint8_t *grayscale_image = fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
@@ -12325,20 +12458,14 @@ void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi, uint32_t thre
 
 #ifdef IMLIB_ENABLE_ROTATION_CORR
 // http://jepsonsblog.blogspot.com/2012/11/rotation-in-3d-using-opencvs.html
-void imlib_rotation_corr(image_t *img, float x_rotation, float y_rotation, float z_rotation,
-                         float x_translation, float y_translation,
-                         float zoom, float fov, float *corners)
+// Computes the matrix mapping destination pixels to source pixels. Returns false if the rotation
+// can't be inverted.
+static bool rotation_corr_transform(int w, int h, float x_rotation, float y_rotation, float z_rotation,
+                                    float x_translation, float y_translation,
+                                    float zoom, float fov, float *corners, float *transform)
 {
-    // Create a tmp copy of the image to pull pixels from.
-    size_t size = image_size(img);
-    void *data = fb_alloc(size, FB_ALLOC_NO_HINT);
-    memcpy(data, img->data, size);
-    memset(img->data, 0, size);
-
     umm_init_x(fb_avail());
 
-    int w = img->w;
-    int h = img->h;
     float z = (fast_sqrtf((w * w) + (h * h)) / 2) / tanf(fov / 2);
     float z_z = z * zoom;
 
@@ -12428,146 +12555,11 @@ void imlib_rotation_corr(image_t *img, float x_rotation, float y_rotation, float
         zarray_destroy(correspondences);
     }
 
+    bool invertible = (T4 != NULL);
+
     if (T4) {
-        float T4_00 = MATD_EL(T4, 0, 0), T4_01 = MATD_EL(T4, 0, 1), T4_02 = MATD_EL(T4, 0, 2);
-        float T4_10 = MATD_EL(T4, 1, 0), T4_11 = MATD_EL(T4, 1, 1), T4_12 = MATD_EL(T4, 1, 2);
-        float T4_20 = MATD_EL(T4, 2, 0), T4_21 = MATD_EL(T4, 2, 1), T4_22 = MATD_EL(T4, 2, 2);
-
-        if ((fast_fabsf(T4_20) < MATD_EPS) && (fast_fabsf(T4_21) < MATD_EPS)) { // warp affine
-            T4_00 /= T4_22;
-            T4_01 /= T4_22;
-            T4_02 /= T4_22;
-            T4_10 /= T4_22;
-            T4_11 /= T4_22;
-            T4_12 /= T4_22;
-            switch(img->bpp) {
-                case IMAGE_BPP_BINARY: {
-                    uint32_t *tmp = (uint32_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            int sourceX = fast_roundf(T4_00*x + T4_01*y + T4_02);
-                            int sourceY = fast_roundf(T4_10*x + T4_11*y + T4_12);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint32_t *ptr = tmp + (((w + UINT32_T_MASK) >> UINT32_T_SHIFT) * sourceY);
-                                int pixel = IMAGE_GET_BINARY_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                case IMAGE_BPP_GRAYSCALE: {
-                    uint8_t *tmp = (uint8_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            int sourceX = fast_roundf(T4_00*x + T4_01*y + T4_02);
-                            int sourceY = fast_roundf(T4_10*x + T4_11*y + T4_12);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint8_t *ptr = tmp + (w * sourceY);
-                                int pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                case IMAGE_BPP_RGB565: {
-                    uint16_t *tmp = (uint16_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            int sourceX = fast_roundf(T4_00*x + T4_01*y + T4_02);
-                            int sourceY = fast_roundf(T4_10*x + T4_11*y + T4_12);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint16_t *ptr = tmp + (w * sourceY);
-                                int pixel = IMAGE_GET_RGB565_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                default: {
-                    break;
-                }
-            }
-        } else { // warp persepective
-            switch(img->bpp) {
-                case IMAGE_BPP_BINARY: {
-                    uint32_t *tmp = (uint32_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            float xxx = T4_00*x + T4_01*y + T4_02;
-                            float yyy = T4_10*x + T4_11*y + T4_12;
-                            float zzz = T4_20*x + T4_21*y + T4_22;
-                            int sourceX = fast_roundf(xxx / zzz);
-                            int sourceY = fast_roundf(yyy / zzz);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint32_t *ptr = tmp + (((w + UINT32_T_MASK) >> UINT32_T_SHIFT) * sourceY);
-                                int pixel = IMAGE_GET_BINARY_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                case IMAGE_BPP_GRAYSCALE: {
-                    uint8_t *tmp = (uint8_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            float xxx = T4_00*x + T4_01*y + T4_02;
-                            float yyy = T4_10*x + T4_11*y + T4_12;
-                            float zzz = T4_20*x + T4_21*y + T4_22;
-                            int sourceX = fast_roundf(xxx / zzz);
-                            int sourceY = fast_roundf(yyy / zzz);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint8_t *ptr = tmp + (w * sourceY);
-                                int pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                case IMAGE_BPP_RGB565: {
-                    uint16_t *tmp = (uint16_t *) data;
-
-                    for (int y = 0, yy = h; y < yy; y++) {
-                        uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
-                        for (int x = 0, xx = w; x < xx; x++) {
-                            float xxx = T4_00*x + T4_01*y + T4_02;
-                            float yyy = T4_10*x + T4_11*y + T4_12;
-                            float zzz = T4_20*x + T4_21*y + T4_22;
-                            int sourceX = fast_roundf(xxx / zzz);
-                            int sourceY = fast_roundf(yyy / zzz);
-
-                            if ((0 <= sourceX) && (sourceX < w) && (0 <= sourceY) && (sourceY < h)) {
-                                uint16_t *ptr = tmp + (w * sourceY);
-                                int pixel = IMAGE_GET_RGB565_PIXEL_FAST(ptr, sourceX);
-                                IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr, x, pixel);
-                            }
-                        }
-                    }
-                    break;
-                }
-                default: {
-                    break;
-                }
-            }
+        for (int i = 0; i < 9; i++) {
+            transform[i] = MATD_EL(T4, i / 3, i % 3);
         }
 
         matd_destroy(T4);
@@ -12585,6 +12577,32 @@ void imlib_rotation_corr(image_t *img, float x_rotation, float y_rotation, float
     matd_destroy(A1);
 
     fb_free(); // umm_init_x();
+    return invertible;
+}
+
+void imlib_rotation_corr(image_t *img, float x_rotation, float y_rotation, float z_rotation,
+                         float x_translation, float y_translation,
+                         float zoom, float fov, float *corners)
+{
+    // Create a tmp copy of the image to pull pixels from.
+    size_t size = image_size(img);
+    image_t tmp = *img;
+    tmp.data = fb_alloc(size, FB_ALLOC_NO_HINT);
+    memcpy(tmp.data, img->data, size);
+
+    float T4[9];
+
+    if (rotation_corr_transform(img->w, img->h, x_rotation, y_rotation, z_rotation, x_translation, y_translation,
+                                zoom, fov, corners, T4)) {
+        if ((fast_fabsf(T4[6]) < MATD_EPS) && (fast_fabsf(T4[7]) < MATD_EPS)) { // warp affine
+            T4[6] = 0;
+            T4[7] = 0;
+        }
+
+        imlib_warp(img, &tmp, T4, 0);
+    } else {
+        memset(img->data, 0, size);
+    }
 
     fb_free();
 }
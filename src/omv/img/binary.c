@@ -11,24 +11,28 @@
 #include "imlib.h"
 
 #ifdef IMLIB_ENABLE_BINARY_OPS
-void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, bool zero, image_t *mask)
+void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, uint8_t *compiled, bool zero, image_t *mask)
 {
     image_t bmp;
     bmp.w = img->w;
     bmp.h = img->h;
     bmp.bpp = IMAGE_BPP_BINARY;
+    bmp.stride = 0;
     bmp.data = fb_alloc0(image_size(&bmp), FB_ALLOC_NO_HINT);
 
-    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-        color_thresholds_list_lnk_data_t lnk_data;
-        iterator_get(thresholds, it, &lnk_data);
+    // Pixels are classified against up to COLOR_THRESHOLDS_LUT_MAX thresholds per pass.
+    color_thresholds_lut_t lut;
+    imlib_color_thresholds_lut_alloc(&lut, img->bpp, img->w * img->h, compiled);
+
+    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
         switch(img->bpp) {
             case IMAGE_BPP_BINARY: {
                 for (int y = 0, yy = img->h; y < yy; y++) {
                     uint32_t *old_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
                     for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x), &lnk_data, invert)) {
+                        if (COLOR_THRESHOLDS_LUT_BINARY(&lut, IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x))) {
                             IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
                         }
                     }
@@ -40,7 +44,7 @@ void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, b
                     uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
                     for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x), &lnk_data, invert)) {
+                        if (COLOR_THRESHOLDS_LUT_GRAYSCALE(&lut, IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x))) {
                             IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
                         }
                     }
@@ -52,7 +56,7 @@ void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, b
                     uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
                     for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x), &lnk_data, invert)) {
+                        if (COLOR_THRESHOLDS_LUT_RGB565(&lut, IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x))) {
                             IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
                         }
                     }
@@ -65,6 +69,8 @@ void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, b
         }
     }
 
+    imlib_color_thresholds_lut_free(&lut);
+
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
             if (!zero) {
@@ -674,6 +680,7 @@ static void imlib_erode_dilate(image_t *img, int ksize, int threshold, int e_or_
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
 
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -909,6 +916,7 @@ void imlib_top_hat(image_t *img, int ksize, int threshold, image_t *mask)
     temp.w = img->w;
     temp.h = img->h;
     temp.bpp = img->bpp;
+    temp.stride = 0;
     temp.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
     memcpy(temp.data, img->data, image_size(img));
     imlib_open(&temp, ksize, threshold, mask);
@@ -922,6 +930,7 @@ void imlib_black_hat(image_t *img, int ksize, int threshold, image_t *mask)
     temp.w = img->w;
     temp.h = img->h;
     temp.bpp = img->bpp;
+    temp.stride = 0;
     temp.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
     memcpy(temp.data, img->data, image_size(img));
     imlib_close(&temp, ksize, threshold, mask);
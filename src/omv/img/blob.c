@@ -129,830 +129,495 @@ static float calc_roundness(float blob_a, float blob_b, float blob_c)
     return IM_DIV(roundness_min, roundness_max);
 }
 
-void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      list_t *thresholds, bool invert, unsigned int area_threshold, unsigned int pixels_threshold,
-                      bool merge, int margin,
-                      bool (*threshold_cb)(void*,find_blobs_list_lnk_data_t*), void *threshold_cb_arg,
-                      bool (*merge_cb)(void*,find_blobs_list_lnk_data_t*,find_blobs_list_lnk_data_t*), void *merge_cb_arg,
-                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max)
-{
-    // Same size as the image so we don't have to translate.
-    image_t bmp;
-    bmp.w = ptr->w;
-    bmp.h = ptr->h;
-    bmp.bpp = IMAGE_BPP_BINARY;
-    bmp.data = fb_alloc0(image_size(&bmp), FB_ALLOC_NO_HINT);
+typedef struct blob_run {
+    int16_t l, r;
+    uint16_t up, down; // First run of the row above/below that ends at or after l, relative to the row.
+    bool visited;
+}
+blob_run_t;
 
-    uint16_t *x_hist_bins = NULL;
-    if (x_hist_bins_max) x_hist_bins = fb_alloc(ptr->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+typedef struct blob_frame {
+    uint32_t run;
+    int16_t y, t_l, b_l;
+}
+blob_frame_t;
+
+// Row y of the roi has the runs [row[y], row[y + 1]).
+typedef struct blob_runs {
+    blob_run_t *runs;
+    uint32_t *prev_row; // Pixels already in a blob for an earlier threshold.
+    uint32_t *cur_row; // Pixels of the current threshold not in prev_row.
+    uint32_t len, size;
+}
+blob_runs_t;
 
-    uint16_t *y_hist_bins = NULL;
-    if (y_hist_bins_max) y_hist_bins = fb_alloc(ptr->h * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+#define BLOB_NO_RUN UINT32_MAX
 
-    lifo_t lifo;
-    size_t lifo_len;
-    lifo_alloc_all(&lifo, &lifo_len, sizeof(xylr_t));
+// Returns the first run in [start, end) that ends at or after x.
+static uint32_t blob_first_run(blob_run_t *runs, uint32_t start, uint32_t end, int x)
+{
+    while (start < end) {
+        uint32_t mid = (start + end) / 2;
+        if (runs[mid].r < x) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
 
-    list_init(out, sizeof(find_blobs_list_lnk_data_t));
+    return start;
+}
 
-    size_t code = 0;
-    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-        color_thresholds_list_lnk_data_t lnk_data;
-        iterator_get(thresholds, it, &lnk_data);
+// Scans row y from a to b for the first run not yet in a blob. The pixels passed over which are
+// in no blob are added to the perimeter, except for the end points of the run left to right.
+// The scan starts at run i, which is linked to the run left to right.
+static uint32_t blob_row_scan(blob_runs_t *r, int y, uint32_t i, int a, int b, int left, int right, int *perimeter)
+{
+    uint32_t next = BLOB_NO_RUN;
+    int lo = IM_MAX(a, left + 1), hi = IM_MIN(b, right - 1), covered = 0;
 
-        switch(ptr->bpp) {
-            case IMAGE_BPP_BINARY: {
-                for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
-                    uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w, x_max = xx - 1; x < xx; x += x_stride) {
-                        if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row_ptr, x))
-                        && COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
-                            int old_x = x;
-                            int old_y = y;
-
-                            float corners_acc[FIND_BLOBS_CORNERS_RESOLUTION];
-                            point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
-                            int corners_n[FIND_BLOBS_CORNERS_RESOLUTION];
-                            // These values are initialized to their maximum before we minimize.
-                            for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                corners[i].x = IM_MAX(IM_MIN(x_max * sign(cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), x_max), 0);
-                                corners[i].y = IM_MAX(IM_MIN(y_max * sign(sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), y_max), 0);
-                                corners_acc[i] = (corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                                 (corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                corners_n[i] = 1;
-                            }
+    for (uint32_t j = r->cur_row[y + 1]; (i < j) && (r->runs[i].l <= b); i++) {
+        if (r->runs[i].r < a) {
+            continue;
+        }
 
-                            int blob_pixels = 0;
-                            int blob_perimeter = 0;
-                            int blob_cx = 0;
-                            int blob_cy = 0;
-                            long long blob_a = 0;
-                            long long blob_b = 0;
-                            long long blob_c = 0;
+        if (!r->runs[i].visited) {
+            next = i;
+            hi = IM_MIN(hi, IM_MAX(r->runs[i].l, a) - 1);
+            break;
+        }
 
-                            if (x_hist_bins) memset(x_hist_bins, 0, ptr->w * sizeof(uint16_t));
-                            if (y_hist_bins) memset(y_hist_bins, 0, ptr->h * sizeof(uint16_t));
+        covered += IM_MAX(IM_MIN(r->runs[i].r, hi) - IM_MAX(r->runs[i].l, lo) + 1, 0);
+    }
 
-                            // Scanline Flood Fill Algorithm //
+    if (lo <= hi) {
+        for (uint32_t i = blob_first_run(r->runs, r->prev_row[y], r->prev_row[y + 1], lo), j = r->prev_row[y + 1];
+             (i < j) && (r->runs[i].l <= hi); i++) {
+            covered += IM_MIN(r->runs[i].r, hi) - IM_MAX(r->runs[i].l, lo) + 1;
+        }
 
-                            for(;;) {
-                                int left = x, right = x;
-                                uint32_t *row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                                uint32_t *bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+        *perimeter += (hi - lo + 1) - covered;
+    }
 
-                                while ((left > roi->x)
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, left - 1))
-                                && COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(row, left - 1), &lnk_data, invert)) {
-                                    left--;
-                                }
+    return next;
+}
 
-                                while ((right < (roi->x + roi->w - 1))
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, right + 1))
-                                && COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(row, right + 1), &lnk_data, invert)) {
-                                    right++;
-                                }
+// The runs are the last fb_alloc so they can be grown by moving them down the fb stack.
+static void blob_runs_grow(blob_runs_t *r)
+{
+    uint32_t avail = (fb_avail() / sizeof(blob_run_t)) + r->size;
+    uint32_t size = IM_MIN(r->size * 2, avail);
 
-                                for (int i = left; i <= right; i++) {
-                                    IMAGE_SET_BINARY_PIXEL_FAST(bmp_row, i);
-                                }
+    if (size <= r->size) {
+        fb_alloc_fail();
+    }
 
-                                int sum = sum_m_to_n(left, right);
-                                int sum_2 = sum_2_m_to_n(left, right);
-                                int cnt = right - left + 1;
-                                int avg = sum / cnt;
-
-                                for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                    int x_new = (cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] > 0) ? left :
-                                                ((cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] == 0) ? avg :
-                                                                                                  right);
-                                    float z = (x_new * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                              (y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                    if (z < corners_acc[i]) {
-                                        corners_acc[i] = z;
-                                        corners[i].x = x_new;
-                                        corners[i].y = y;
-                                        corners_n[i] = 1;
-                                    } else if (z == corners_acc[i]) {
-                                        corners[i].x = cumulative_moving_average(corners[i].x, x_new, corners_n[i]);
-                                        corners[i].y = cumulative_moving_average(corners[i].y, y, corners_n[i]);
-                                        corners_n[i] += 1;
-                                    }
-                                }
+    blob_run_t *runs = r->runs;
+    fb_free();
+    r->runs = fb_alloc(size * sizeof(blob_run_t), FB_ALLOC_NO_HINT);
+    memmove(r->runs, runs, r->len * sizeof(blob_run_t));
+    r->size = size;
+}
 
-                                blob_pixels += cnt;
-                                blob_perimeter += 2;
-                                blob_cx += sum;
-                                blob_cy += y * cnt;
-                                blob_a += sum_2;
-                                blob_b += y * sum;
-                                blob_c += y * y * cnt;
-
-                                if (y_hist_bins) y_hist_bins[y] += cnt;
-                                if (x_hist_bins) for (int i = left; i <= right; i++) x_hist_bins[i] += 1;
-
-                                int top_left = left;
-                                int bot_left = left;
-                                bool break_out = false;
-                                for(;;) {
-                                    if (lifo_size(&lifo) < lifo_len) {
-
-                                        if (y > roi->y) {
-                                            row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y - 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y - 1);
-
-                                            bool recurse = false;
-                                            for (int i = top_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = i + 1; // Don't test the same pixel again...
-                                                    context.b_l = bot_left;
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y - 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-
-                                        if (y < (roi->y + roi->h - 1)) {
-                                            row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y + 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y + 1);
-
-                                            bool recurse = false;
-                                            for (int i = bot_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = top_left;
-                                                    context.b_l = i + 1; // Don't test the same pixel again...
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y + 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-                                    } else {
-                                        blob_perimeter += (right - left + 1) * 2;
-                                    }
-
-                                    if (!lifo_size(&lifo)) {
-                                        break_out = true;
-                                        break;
-                                    }
+static void blob_runs_add(blob_runs_t *r, int l, int right)
+{
+    if (r->len == r->size) {
+        blob_runs_grow(r);
+    }
 
-                                    xylr_t context;
-                                    lifo_dequeue(&lifo, &context);
-                                    x = context.x;
-                                    y = context.y;
-                                    left = context.l;
-                                    right = context.r;
-                                    top_left = context.t_l;
-                                    bot_left = context.b_l;
-                                }
+    r->runs[r->len].l = l;
+    r->runs[r->len].r = right;
+    r->runs[r->len].visited = false;
+    r->len += 1;
+}
 
-                                if (break_out) {
-                                    break;
-                                }
-                            }
+// Adds the pixels of [l, right] in row y which are not already in a blob.
+static void blob_runs_push(blob_runs_t *r, int y, int l, int right)
+{
+    for (uint32_t i = blob_first_run(r->runs, r->prev_row[y], r->prev_row[y + 1], l), j = r->prev_row[y + 1];
+         (i < j) && (r->runs[i].l <= right); i++) {
+        if (r->runs[i].l > l) {
+            blob_runs_add(r, l, r->runs[i].l - 1);
+        }
 
-                            rectangle_t rect;
-                            rect.x = corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x; // l
-                            rect.y = corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y; // t
-                            rect.w = corners[(FIND_BLOBS_CORNERS_RESOLUTION*2)/4].x - corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x + 1; // r - l + 1
-                            rect.h = corners[(FIND_BLOBS_CORNERS_RESOLUTION*3)/4].y - corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y + 1; // b - t + 1
-
-                            if (((rect.w * rect.h) >= area_threshold) && (blob_pixels >= pixels_threshold)) {
-
-                                // http://www.cse.usf.edu/~r1k/MachineVisionBook/MachineVision.files/MachineVision_Chapter2.pdf
-                                // https://www.strchr.com/standard_deviation_in_one_pass
-                                //
-                                // a = sigma(x*x) + (mx*sigma(x)) + (mx*sigma(x)) + (sigma()*mx*mx)
-                                // b = sigma(x*y) + (mx*sigma(y)) + (my*sigma(x)) + (sigma()*mx*my)
-                                // c = sigma(y*y) + (my*sigma(y)) + (my*sigma(y)) + (sigma()*my*my)
-                                //
-                                // blob_a = sigma(x*x)
-                                // blob_b = sigma(x*y)
-                                // blob_c = sigma(y*y)
-                                // blob_cx = sigma(x)
-                                // blob_cy = sigma(y)
-                                // blob_pixels = sigma()
-
-                                float b_mx = blob_cx / ((float) blob_pixels);
-                                float b_my = blob_cy / ((float) blob_pixels);
-                                int mx = fast_roundf(b_mx); // x centroid
-                                int my = fast_roundf(b_my); // y centroid
-                                int small_blob_a = blob_a - ((mx * blob_cx) + (mx * blob_cx)) + (blob_pixels * mx * mx);
-                                int small_blob_b = blob_b - ((mx * blob_cy) + (my * blob_cx)) + (blob_pixels * mx * my);
-                                int small_blob_c = blob_c - ((my * blob_cy) + (my * blob_cy)) + (blob_pixels * my * my);
-
-                                find_blobs_list_lnk_data_t lnk_blob;
-                                memcpy(lnk_blob.corners, corners, FIND_BLOBS_CORNERS_RESOLUTION * sizeof(point_t));
-                                memcpy(&lnk_blob.rect, &rect, sizeof(rectangle_t));
-                                lnk_blob.pixels = blob_pixels;
-                                lnk_blob.perimeter = blob_perimeter;
-                                lnk_blob.code = 1 << code;
-                                lnk_blob.count = 1;
-                                lnk_blob.centroid_x = b_mx;
-                                lnk_blob.centroid_y = b_my;
-                                lnk_blob.rotation = (small_blob_a != small_blob_c) ? (fast_atan2f(2 * small_blob_b, small_blob_a - small_blob_c) / 2.0f) : 0.0f;
-                                lnk_blob.roundness = calc_roundness(small_blob_a, small_blob_b, small_blob_c);
-                                lnk_blob.x_hist_bins_count = 0;
-                                lnk_blob.x_hist_bins = NULL;
-                                lnk_blob.y_hist_bins_count = 0;
-                                lnk_blob.y_hist_bins = NULL;
-                                // These store the current average accumulation.
-                                lnk_blob.centroid_x_acc = lnk_blob.centroid_x * lnk_blob.pixels;
-                                lnk_blob.centroid_y_acc = lnk_blob.centroid_y * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_x = cosf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_y = sinf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.roundness_acc = lnk_blob.roundness * lnk_blob.pixels;
-
-                                if (x_hist_bins) {
-                                    bin_up(x_hist_bins, ptr->w, x_hist_bins_max, &lnk_blob.x_hist_bins, &lnk_blob.x_hist_bins_count);
-                                }
+        l = r->runs[i].r + 1;
+    }
 
-                                if (y_hist_bins) {
-                                    bin_up(y_hist_bins, ptr->h, y_hist_bins_max, &lnk_blob.y_hist_bins, &lnk_blob.y_hist_bins_count);
-                                }
+    if (l <= right) {
+        blob_runs_add(r, l, right);
+    }
+}
 
-                                if (((threshold_cb_arg == NULL) || threshold_cb(threshold_cb_arg, &lnk_blob))) {
-                                    list_push_back(out, &lnk_blob);
-                                } else {
-                                    if (lnk_blob.x_hist_bins) xfree(lnk_blob.x_hist_bins);
-                                    if (lnk_blob.y_hist_bins) xfree(lnk_blob.y_hist_bins);
-                                }
-                            }
+// Links the runs of row y to the overlapping runs of row y - 1 and back.
+static void blob_runs_link(blob_runs_t *r, int y)
+{
+    uint32_t i = r->cur_row[y], ii = r->cur_row[y + 1];
+    uint32_t j = r->cur_row[y - 1], jj = r->cur_row[y];
 
-                            x = old_x;
-                            y = old_y;
-                        }
-                    }
-                }
-                break;
-            }
-            case IMAGE_BPP_GRAYSCALE: {
-                for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
-                    uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w, x_max = xx - 1; x < xx; x += x_stride) {
-                        if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row_ptr, x))
-                        && COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
-                            int old_x = x;
-                            int old_y = y;
-
-                            float corners_acc[FIND_BLOBS_CORNERS_RESOLUTION];
-                            point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
-                            int corners_n[FIND_BLOBS_CORNERS_RESOLUTION];
-                            // These values are initialized to their maximum before we minimize.
-                            for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                corners[i].x = IM_MAX(IM_MIN(x_max * sign(cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), x_max), 0);
-                                corners[i].y = IM_MAX(IM_MIN(y_max * sign(sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), y_max), 0);
-                                corners_acc[i] = (corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                                 (corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                corners_n[i] = 1;
-                            }
+    for (uint32_t k = i; k < ii; k++) {
+        while ((j < jj) && (r->runs[j].r < r->runs[k].l)) {
+            j++;
+        }
+        r->runs[k].up = j - r->cur_row[y - 1];
+    }
 
-                            int blob_pixels = 0;
-                            int blob_perimeter = 0;
-                            int blob_cx = 0;
-                            int blob_cy = 0;
-                            long long blob_a = 0;
-                            long long blob_b = 0;
-                            long long blob_c = 0;
+    j = r->cur_row[y - 1];
 
-                            if (x_hist_bins) memset(x_hist_bins, 0, ptr->w * sizeof(uint16_t));
-                            if (y_hist_bins) memset(y_hist_bins, 0, ptr->h * sizeof(uint16_t));
+    for (uint32_t k = j; k < jj; k++) {
+        while ((i < ii) && (r->runs[i].r < r->runs[k].l)) {
+            i++;
+        }
+        r->runs[k].down = i - r->cur_row[y];
+    }
+}
 
-                            // Scanline Flood Fill Algorithm //
+// Moves the runs of the current threshold that ended up in a blob to prev_row.
+static void blob_runs_retire(blob_runs_t *r, int h)
+{
+    uint32_t len = r->len;
 
-                            for(;;) {
-                                int left = x, right = x;
-                                uint8_t *row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                                uint32_t *bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+    for (int y = 0; y < h; y++) {
+        uint32_t i = r->prev_row[y], ii = r->prev_row[y + 1];
+        uint32_t j = r->cur_row[y], jj = r->cur_row[y + 1];
+        r->prev_row[y] = r->len - len;
 
-                                while ((left > roi->x)
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, left - 1))
-                                && COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row, left - 1), &lnk_data, invert)) {
-                                    left--;
-                                }
+        for (;;) {
+            while ((j < jj) && (!r->runs[j].visited)) {
+                j++;
+            }
 
-                                while ((right < (roi->x + roi->w - 1))
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, right + 1))
-                                && COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row, right + 1), &lnk_data, invert)) {
-                                    right++;
-                                }
+            if ((i < ii) && ((j == jj) || (r->runs[i].l < r->runs[j].l))) {
+                blob_runs_add(r, r->runs[i].l, r->runs[i].r);
+                i++;
+            } else if (j < jj) {
+                blob_runs_add(r, r->runs[j].l, r->runs[j].r);
+                j++;
+            } else {
+                break;
+            }
+        }
+    }
 
-                                for (int i = left; i <= right; i++) {
-                                    IMAGE_SET_BINARY_PIXEL_FAST(bmp_row, i);
-                                }
+    r->prev_row[h] = r->len - len;
+    r->len -= len;
+    memmove(r->runs, r->runs + len, r->len * sizeof(blob_run_t));
+}
 
-                                int sum = sum_m_to_n(left, right);
-                                int sum_2 = sum_2_m_to_n(left, right);
-                                int cnt = right - left + 1;
-                                int avg = sum / cnt;
-
-                                for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                    int x_new = (cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] > 0) ? left :
-                                                ((cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] == 0) ? avg :
-                                                                                                  right);
-                                    float z = (x_new * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                              (y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                    if (z < corners_acc[i]) {
-                                        corners_acc[i] = z;
-                                        corners[i].x = x_new;
-                                        corners[i].y = y;
-                                        corners_n[i] = 1;
-                                    } else if (z == corners_acc[i]) {
-                                        corners[i].x = cumulative_moving_average(corners[i].x, x_new, corners_n[i]);
-                                        corners[i].y = cumulative_moving_average(corners[i].y, y, corners_n[i]);
-                                        corners_n[i] += 1;
-                                    }
-                                }
+void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
+                      list_t *thresholds, bool invert, uint8_t *compiled, unsigned int area_threshold, unsigned int pixels_threshold,
+                      bool merge, int margin,
+                      bool (*threshold_cb)(void*,find_blobs_list_lnk_data_t*), void *threshold_cb_arg,
+                      bool (*merge_cb)(void*,find_blobs_list_lnk_data_t*,find_blobs_list_lnk_data_t*), void *merge_cb_arg,
+                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max)
+{
+    uint16_t *x_hist_bins = NULL;
+    if (x_hist_bins_max) x_hist_bins = fb_alloc(ptr->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
 
-                                blob_pixels += cnt;
-                                blob_perimeter += 2;
-                                blob_cx += sum;
-                                blob_cy += y * cnt;
-                                blob_a += sum_2;
-                                blob_b += y * sum;
-                                blob_c += y * y * cnt;
-
-                                if (y_hist_bins) y_hist_bins[y] += cnt;
-                                if (x_hist_bins) for (int i = left; i <= right; i++) x_hist_bins[i] += 1;
-
-                                int top_left = left;
-                                int bot_left = left;
-                                bool break_out = false;
-                                for(;;) {
-                                    if (lifo_size(&lifo) < lifo_len) {
-
-                                        if (y > roi->y) {
-                                            row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y - 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y - 1);
-
-                                            bool recurse = false;
-                                            for (int i = top_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = i + 1; // Don't test the same pixel again...
-                                                    context.b_l = bot_left;
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y - 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-
-                                        if (y < (roi->y + roi->h - 1)) {
-                                            row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y + 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y + 1);
-
-                                            bool recurse = false;
-                                            for (int i = bot_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = top_left;
-                                                    context.b_l = i + 1; // Don't test the same pixel again...
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y + 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-                                    } else {
-                                        blob_perimeter += (right - left + 1) * 2;
-                                    }
-
-                                    if (!lifo_size(&lifo)) {
-                                        break_out = true;
-                                        break;
-                                    }
+    uint16_t *y_hist_bins = NULL;
+    if (y_hist_bins_max) y_hist_bins = fb_alloc(ptr->h * sizeof(uint16_t), FB_ALLOC_NO_HINT);
 
-                                    xylr_t context;
-                                    lifo_dequeue(&lifo, &context);
-                                    x = context.x;
-                                    y = context.y;
-                                    left = context.l;
-                                    right = context.r;
-                                    top_left = context.t_l;
-                                    bot_left = context.b_l;
-                                }
+    color_thresholds_lut_t lut;
+    imlib_color_thresholds_lut_alloc(&lut, ptr->bpp, roi->w * roi->h * list_size(thresholds), compiled);
 
-                                if (break_out) {
-                                    break;
-                                }
-                            }
+    // The thresholded image is stored as runs of pixels per row. Blobs are traced over the runs in
+    // the same order the scanline flood fill visited them so that the corners and the perimeter
+    // come out the same, but each pixel is only thresholded once and no bitmap is needed.
+    blob_runs_t r;
+    r.prev_row = fb_alloc0((roi->h + 1) * sizeof(uint32_t) * 2, FB_ALLOC_NO_HINT);
+    r.cur_row = r.prev_row + roi->h + 1;
+    // The run buffer starts at one run per row and doubles when full.
+    r.len = 0;
+    r.size = roi->h;
+    r.runs = fb_alloc(r.size * sizeof(blob_run_t), FB_ALLOC_NO_HINT);
 
-                            rectangle_t rect;
-                            rect.x = corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x; // l
-                            rect.y = corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y; // t
-                            rect.w = corners[(FIND_BLOBS_CORNERS_RESOLUTION*2)/4].x - corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x + 1; // r - l + 1
-                            rect.h = corners[(FIND_BLOBS_CORNERS_RESOLUTION*3)/4].y - corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y + 1; // b - t + 1
-
-                            if (((rect.w * rect.h) >= area_threshold) && (blob_pixels >= pixels_threshold)) {
-
-                                // http://www.cse.usf.edu/~r1k/MachineVisionBook/MachineVision.files/MachineVision_Chapter2.pdf
-                                // https://www.strchr.com/standard_deviation_in_one_pass
-                                //
-                                // a = sigma(x*x) + (mx*sigma(x)) + (mx*sigma(x)) + (sigma()*mx*mx)
-                                // b = sigma(x*y) + (mx*sigma(y)) + (my*sigma(x)) + (sigma()*mx*my)
-                                // c = sigma(y*y) + (my*sigma(y)) + (my*sigma(y)) + (sigma()*my*my)
-                                //
-                                // blob_a = sigma(x*x)
-                                // blob_b = sigma(x*y)
-                                // blob_c = sigma(y*y)
-                                // blob_cx = sigma(x)
-                                // blob_cy = sigma(y)
-                                // blob_pixels = sigma()
-
-                                float b_mx = blob_cx / ((float) blob_pixels);
-                                float b_my = blob_cy / ((float) blob_pixels);
-                                int mx = fast_roundf(b_mx); // x centroid
-                                int my = fast_roundf(b_my); // y centroid
-                                int small_blob_a = blob_a - ((mx * blob_cx) + (mx * blob_cx)) + (blob_pixels * mx * mx);
-                                int small_blob_b = blob_b - ((mx * blob_cy) + (my * blob_cx)) + (blob_pixels * mx * my);
-                                int small_blob_c = blob_c - ((my * blob_cy) + (my * blob_cy)) + (blob_pixels * my * my);
-
-                                find_blobs_list_lnk_data_t lnk_blob;
-                                memcpy(lnk_blob.corners, corners, FIND_BLOBS_CORNERS_RESOLUTION * sizeof(point_t));
-                                memcpy(&lnk_blob.rect, &rect, sizeof(rectangle_t));
-                                lnk_blob.pixels = blob_pixels;
-                                lnk_blob.perimeter = blob_perimeter;
-                                lnk_blob.code = 1 << code;
-                                lnk_blob.count = 1;
-                                lnk_blob.centroid_x = b_mx;
-                                lnk_blob.centroid_y = b_my;
-                                lnk_blob.rotation = (small_blob_a != small_blob_c) ? (fast_atan2f(2 * small_blob_b, small_blob_a - small_blob_c) / 2.0f) : 0.0f;
-                                lnk_blob.roundness = calc_roundness(small_blob_a, small_blob_b, small_blob_c);
-                                lnk_blob.x_hist_bins_count = 0;
-                                lnk_blob.x_hist_bins = NULL;
-                                lnk_blob.y_hist_bins_count = 0;
-                                lnk_blob.y_hist_bins = NULL;
-                                // These store the current average accumulation.
-                                lnk_blob.centroid_x_acc = lnk_blob.centroid_x * lnk_blob.pixels;
-                                lnk_blob.centroid_y_acc = lnk_blob.centroid_y * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_x = cosf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_y = sinf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.roundness_acc = lnk_blob.roundness * lnk_blob.pixels;
-
-                                if (x_hist_bins) {
-                                    bin_up(x_hist_bins, ptr->w, x_hist_bins_max, &lnk_blob.x_hist_bins, &lnk_blob.x_hist_bins_count);
-                                }
+    list_init(out, sizeof(find_blobs_list_lnk_data_t));
 
-                                if (y_hist_bins) {
-                                    bin_up(y_hist_bins, ptr->h, y_hist_bins_max, &lnk_blob.y_hist_bins, &lnk_blob.y_hist_bins_count);
-                                }
+    size_t code = 0;
+    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
+        // Thresholds are compiled COLOR_THRESHOLDS_LUT_MAX at a time, each one is a bit of the lut.
+        if (!(code % COLOR_THRESHOLDS_LUT_MAX)) {
+            imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
+        }
 
-                                if (((threshold_cb_arg == NULL) || threshold_cb(threshold_cb_arg, &lnk_blob))) {
-                                    list_push_back(out, &lnk_blob);
-                                } else {
-                                    if (lnk_blob.x_hist_bins) xfree(lnk_blob.x_hist_bins);
-                                    if (lnk_blob.y_hist_bins) xfree(lnk_blob.y_hist_bins);
-                                }
-                            }
+        uint8_t bit = 1 << (code % COLOR_THRESHOLDS_LUT_MAX);
 
-                            x = old_x;
-                            y = old_y;
+        for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
+            int row = y - roi->y;
+            r.cur_row[row] = r.len;
+
+            switch(ptr->bpp) {
+                case IMAGE_BPP_BINARY: {
+                    uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
+                    for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
+                        if ((COLOR_THRESHOLDS_LUT_BINARY(&lut, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x)) & bit)) {
+                            int left = x;
+                            while (((x + 1) < xx)
+                            && (COLOR_THRESHOLDS_LUT_BINARY(&lut, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1)) & bit)) {
+                                x++;
+                            }
+                            blob_runs_push(&r, row, left, x);
                         }
                     }
+                    break;
                 }
-                break;
-            }
-            case IMAGE_BPP_RGB565: {
-                for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
+                case IMAGE_BPP_GRAYSCALE: {
+                    uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
+                    for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
+                        if ((COLOR_THRESHOLDS_LUT_GRAYSCALE(&lut, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) & bit)) {
+                            int left = x;
+                            while (((x + 1) < xx)
+                            && (COLOR_THRESHOLDS_LUT_GRAYSCALE(&lut, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1)) & bit)) {
+                                x++;
+                            }
+                            blob_runs_push(&r, row, left, x);
+                        }
+                    }
+                    break;
+                }
+                case IMAGE_BPP_RGB565: {
                     uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w, x_max = xx - 1; x < xx; x += x_stride) {
-                        if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row_ptr, x))
-                        && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x), &lnk_data, invert)) {
-                            int old_x = x;
-                            int old_y = y;
-
-                            float corners_acc[FIND_BLOBS_CORNERS_RESOLUTION];
-                            point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
-                            int corners_n[FIND_BLOBS_CORNERS_RESOLUTION];
-                            // Ensures that maximum goes all the way to the edge of the image.
-                            for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                corners[i].x = IM_MAX(IM_MIN(x_max * sign(cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), x_max), 0);
-                                corners[i].y = IM_MAX(IM_MIN(y_max * sign(sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]), y_max), 0);
-                                corners_acc[i] = (corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                                 (corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                corners_n[i] = 1;
+                    for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
+                        if ((COLOR_THRESHOLDS_LUT_RGB565(&lut, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x)) & bit)) {
+                            int left = x;
+                            while (((x + 1) < xx)
+                            && (COLOR_THRESHOLDS_LUT_RGB565(&lut, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1)) & bit)) {
+                                x++;
                             }
+                            blob_runs_push(&r, row, left, x);
+                        }
+                    }
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
 
-                            int blob_pixels = 0;
-                            int blob_perimeter = 0;
-                            int blob_cx = 0;
-                            int blob_cy = 0;
-                            long long blob_a = 0;
-                            long long blob_b = 0;
-                            long long blob_c = 0;
+            if (row) {
+                r.cur_row[row + 1] = r.len;
+                blob_runs_link(&r, row);
+            }
+        }
 
-                            if (x_hist_bins) memset(x_hist_bins, 0, ptr->w * sizeof(uint16_t));
-                            if (y_hist_bins) memset(y_hist_bins, 0, ptr->h * sizeof(uint16_t));
+        r.cur_row[roi->h] = r.len;
 
-                            // Scanline Flood Fill Algorithm //
+        // Each run of the current threshold is pushed on the flood fill stack at most once.
+        size_t stack_len = IM_MAX(r.len - r.prev_row[roi->h], 1);
+        blob_frame_t *stack = fb_alloc(stack_len * sizeof(blob_frame_t), FB_ALLOC_NO_HINT);
 
-                            for(;;) {
-                                int left = x, right = x;
-                                uint16_t *row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                                uint32_t *bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+        for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
+            int x_start = roi->x + (y % x_stride), x_max = roi->x + roi->w - 1;
 
-                                while ((left > roi->x)
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, left - 1))
-                                && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, left - 1), &lnk_data, invert)) {
-                                    left--;
-                                }
+            for (uint32_t i = r.cur_row[y - roi->y], j = r.cur_row[y - roi->y + 1]; i < j; i++) {
+                // Skip runs already in a blob or without a sample point.
+                int x = (r.runs[i].l <= x_start) ? x_start : (x_start + ((((r.runs[i].l - x_start) + x_stride - 1) / x_stride) * x_stride));
+                if (r.runs[i].visited || (x > r.runs[i].r)) {
+                    continue;
+                }
 
-                                while ((right < (roi->x + roi->w - 1))
-                                && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, right + 1))
-                                && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, right + 1), &lnk_data, invert)) {
-                                    right++;
-                                }
+                float corners_acc[FIND_BLOBS_CORNERS_RESOLUTION];
+                point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
+                int corners_n[FIND_BLOBS_CORNERS_RESOLUTION];
+                // These values are initialized to their maximum before we minimize.
+                for (int k = 0; k < FIND_BLOBS_CORNERS_RESOLUTION; k++) {
+                    corners[k].x = IM_MAX(IM_MIN(x_max * sign(cos_table[FIND_BLOBS_ANGLE_RESOLUTION*k]), x_max), 0);
+                    corners[k].y = IM_MAX(IM_MIN(y_max * sign(sin_table[FIND_BLOBS_ANGLE_RESOLUTION*k]), y_max), 0);
+                    corners_acc[k] = (corners[k].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*k]) +
+                                     (corners[k].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*k]);
+                    corners_n[k] = 1;
+                }
 
-                                for (int i = left; i <= right; i++) {
-                                    IMAGE_SET_BINARY_PIXEL_FAST(bmp_row, i);
-                                }
+                int blob_pixels = 0;
+                int blob_perimeter = 0;
+                int blob_cx = 0;
+                int blob_cy = 0;
+                long long blob_a = 0;
+                long long blob_b = 0;
+                long long blob_c = 0;
 
-                                int sum = sum_m_to_n(left, right);
-                                int sum_2 = sum_2_m_to_n(left, right);
-                                int cnt = right - left + 1;
-                                int avg = sum / cnt;
-
-                                for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                                    int x_new = (cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] > 0) ? left :
-                                                ((cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i] == 0) ? avg :
-                                                                                                  right);
-                                    float z = (x_new * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*i]) +
-                                              (y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*i]);
-                                    if (z < corners_acc[i]) {
-                                        corners_acc[i] = z;
-                                        corners[i].x = x_new;
-                                        corners[i].y = y;
-                                        corners_n[i] = 1;
-                                    } else if (z == corners_acc[i]) {
-                                        corners[i].x = cumulative_moving_average(corners[i].x, x_new, corners_n[i]);
-                                        corners[i].y = cumulative_moving_average(corners[i].y, y, corners_n[i]);
-                                        corners_n[i] += 1;
-                                    }
-                                }
+                if (x_hist_bins) memset(x_hist_bins, 0, ptr->w * sizeof(uint16_t));
+                if (y_hist_bins) memset(y_hist_bins, 0, ptr->h * sizeof(uint16_t));
 
-                                blob_pixels += cnt;
-                                blob_perimeter += 2;
-                                blob_cx += sum;
-                                blob_cy += y * cnt;
-                                blob_a += sum_2;
-                                blob_b += y * sum;
-                                blob_c += y * y * cnt;
-
-                                if (y_hist_bins) y_hist_bins[y] += cnt;
-                                if (x_hist_bins) for (int i = left; i <= right; i++) x_hist_bins[i] += 1;
-
-                                int top_left = left;
-                                int bot_left = left;
-                                bool break_out = false;
-                                for(;;) {
-                                    if (lifo_size(&lifo) < lifo_len) {
-
-                                        if (y > roi->y) {
-                                            row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y - 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y - 1);
-
-                                            bool recurse = false;
-                                            for (int i = top_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = i + 1; // Don't test the same pixel again...
-                                                    context.b_l = bot_left;
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y - 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-
-                                        if (y < (roi->y + roi->h - 1)) {
-                                            row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y + 1);
-                                            bmp_row = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y + 1);
-
-                                            bool recurse = false;
-                                            for (int i = bot_left; i <= right; i++) {
-                                                bool ok = true; // Does nothing if thresholding is skipped.
-
-                                                if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
-                                                && (ok = COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, i), &lnk_data, invert))) {
-                                                    xylr_t context;
-                                                    context.x = x;
-                                                    context.y = y;
-                                                    context.l = left;
-                                                    context.r = right;
-                                                    context.t_l = top_left;
-                                                    context.b_l = i + 1; // Don't test the same pixel again...
-                                                    lifo_enqueue(&lifo, &context);
-                                                    x = i;
-                                                    y = y + 1;
-                                                    recurse = true;
-                                                    break;
-                                                }
-
-                                                blob_perimeter += (!ok) && (i != left) && (i != right);
-                                            }
-                                            if (recurse) {
-                                                break;
-                                            }
-                                        } else {
-                                            blob_perimeter += right - left + 1;
-                                        }
-                                    } else {
-                                        blob_perimeter += (right - left + 1) * 2;
-                                    }
-
-                                    if (!lifo_size(&lifo)) {
-                                        break_out = true;
-                                        break;
-                                    }
+                // Scanline Flood Fill Algorithm //
 
-                                    xylr_t context;
-                                    lifo_dequeue(&lifo, &context);
-                                    x = context.x;
-                                    y = context.y;
-                                    left = context.l;
-                                    right = context.r;
-                                    top_left = context.t_l;
-                                    bot_left = context.b_l;
-                                }
+                size_t sp = 0;
+                uint32_t next = i;
+                int next_y = y;
 
-                                if (break_out) {
-                                    break;
-                                }
+                for(;;) {
+                    if (next != BLOB_NO_RUN) {
+                        if (sp == stack_len) {
+                            fb_alloc_fail();
+                        }
+
+                        int left = r.runs[next].l, right = r.runs[next].r;
+                        r.runs[next].visited = true;
+                        stack[sp].run = next;
+                        stack[sp].y = next_y;
+                        stack[sp].t_l = left;
+                        stack[sp].b_l = left;
+                        sp += 1;
+
+                        int sum = sum_m_to_n(left, right);
+                        int sum_2 = sum_2_m_to_n(left, right);
+                        int cnt = right - left + 1;
+                        int avg = sum / cnt;
+
+                        for (int k = 0; k < FIND_BLOBS_CORNERS_RESOLUTION; k++) {
+                            int x_new = (cos_table[FIND_BLOBS_ANGLE_RESOLUTION*k] > 0) ? left :
+                                        ((cos_table[FIND_BLOBS_ANGLE_RESOLUTION*k] == 0) ? avg :
+                                                                                          right);
+                            float z = (x_new * cos_table[FIND_BLOBS_ANGLE_RESOLUTION*k]) +
+                                      (next_y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION*k]);
+                            if (z < corners_acc[k]) {
+                                corners_acc[k] = z;
+                                corners[k].x = x_new;
+                                corners[k].y = next_y;
+                                corners_n[k] = 1;
+                            } else if (z == corners_acc[k]) {
+                                corners[k].x = cumulative_moving_average(corners[k].x, x_new, corners_n[k]);
+                                corners[k].y = cumulative_moving_average(corners[k].y, next_y, corners_n[k]);
+                                corners_n[k] += 1;
                             }
+                        }
 
-                            rectangle_t rect;
-                            rect.x = corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x; // l
-                            rect.y = corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y; // t
-                            rect.w = corners[(FIND_BLOBS_CORNERS_RESOLUTION*2)/4].x - corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x + 1; // r - l + 1
-                            rect.h = corners[(FIND_BLOBS_CORNERS_RESOLUTION*3)/4].y - corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y + 1; // b - t + 1
-
-                            if (((rect.w * rect.h) >= area_threshold) && (blob_pixels >= pixels_threshold)) {
-
-                                // http://www.cse.usf.edu/~r1k/MachineVisionBook/MachineVision.files/MachineVision_Chapter2.pdf
-                                // https://www.strchr.com/standard_deviation_in_one_pass
-                                //
-                                // a = sigma(x*x) + (mx*sigma(x)) + (mx*sigma(x)) + (sigma()*mx*mx)
-                                // b = sigma(x*y) + (mx*sigma(y)) + (my*sigma(x)) + (sigma()*mx*my)
-                                // c = sigma(y*y) + (my*sigma(y)) + (my*sigma(y)) + (sigma()*my*my)
-                                //
-                                // blob_a = sigma(x*x)
-                                // blob_b = sigma(x*y)
-                                // blob_c = sigma(y*y)
-                                // blob_cx = sigma(x)
-                                // blob_cy = sigma(y)
-                                // blob_pixels = sigma()
-
-                                float b_mx = blob_cx / ((float) blob_pixels);
-                                float b_my = blob_cy / ((float) blob_pixels);
-                                int mx = fast_roundf(b_mx); // x centroid
-                                int my = fast_roundf(b_my); // y centroid
-                                int small_blob_a = blob_a - ((mx * blob_cx) + (mx * blob_cx)) + (blob_pixels * mx * mx);
-                                int small_blob_b = blob_b - ((mx * blob_cy) + (my * blob_cx)) + (blob_pixels * mx * my);
-                                int small_blob_c = blob_c - ((my * blob_cy) + (my * blob_cy)) + (blob_pixels * my * my);
-
-                                find_blobs_list_lnk_data_t lnk_blob;
-                                memcpy(lnk_blob.corners, corners, FIND_BLOBS_CORNERS_RESOLUTION * sizeof(point_t));
-                                memcpy(&lnk_blob.rect, &rect, sizeof(rectangle_t));
-                                lnk_blob.pixels = blob_pixels;
-                                lnk_blob.perimeter = blob_perimeter;
-                                lnk_blob.code = 1 << code;
-                                lnk_blob.count = 1;
-                                lnk_blob.centroid_x = b_mx;
-                                lnk_blob.centroid_y = b_my;
-                                lnk_blob.rotation = (small_blob_a != small_blob_c) ? (fast_atan2f(2 * small_blob_b, small_blob_a - small_blob_c) / 2.0f) : 0.0f;
-                                lnk_blob.roundness = calc_roundness(small_blob_a, small_blob_b, small_blob_c);
-                                lnk_blob.x_hist_bins_count = 0;
-                                lnk_blob.x_hist_bins = NULL;
-                                lnk_blob.y_hist_bins_count = 0;
-                                lnk_blob.y_hist_bins = NULL;
-                                // These store the current average accumulation.
-                                lnk_blob.centroid_x_acc = lnk_blob.centroid_x * lnk_blob.pixels;
-                                lnk_blob.centroid_y_acc = lnk_blob.centroid_y * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_x = cosf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.rotation_acc_y = sinf(lnk_blob.rotation) * lnk_blob.pixels;
-                                lnk_blob.roundness_acc = lnk_blob.roundness * lnk_blob.pixels;
-
-                                if (x_hist_bins) {
-                                    bin_up(x_hist_bins, ptr->w, x_hist_bins_max, &lnk_blob.x_hist_bins, &lnk_blob.x_hist_bins_count);
-                                }
+                        blob_pixels += cnt;
+                        blob_perimeter += 2;
+                        blob_cx += sum;
+                        blob_cy += next_y * cnt;
+                        blob_a += sum_2;
+                        blob_b += next_y * sum;
+                        blob_c += next_y * next_y * cnt;
 
-                                if (y_hist_bins) {
-                                    bin_up(y_hist_bins, ptr->h, y_hist_bins_max, &lnk_blob.y_hist_bins, &lnk_blob.y_hist_bins_count);
-                                }
+                        if (y_hist_bins) y_hist_bins[next_y] += cnt;
+                        if (x_hist_bins) for (int k = left; k <= right; k++) x_hist_bins[k] += 1;
 
-                                if (((threshold_cb_arg == NULL) || threshold_cb(threshold_cb_arg, &lnk_blob))) {
-                                    list_push_back(out, &lnk_blob);
-                                } else {
-                                    if (lnk_blob.x_hist_bins) xfree(lnk_blob.x_hist_bins);
-                                    if (lnk_blob.y_hist_bins) xfree(lnk_blob.y_hist_bins);
-                                }
-                            }
+                        next = BLOB_NO_RUN;
+                    }
+
+                    if (!sp) {
+                        break;
+                    }
+
+                    // Like the flood fill the row above is scanned again after each recursion below
+                    // which also counts its perimeter again.
+                    blob_frame_t *frame = &stack[sp - 1];
+                    int left = r.runs[frame->run].l, right = r.runs[frame->run].r;
+                    int row = frame->y - roi->y;
+
+                    if (frame->y > roi->y) {
+                        next = blob_row_scan(&r, row - 1, r.cur_row[row - 1] + r.runs[frame->run].up,
+                                             frame->t_l, right, left, right, &blob_perimeter);
+                        if (next != BLOB_NO_RUN) {
+                            frame->t_l = IM_MAX(r.runs[next].l, frame->t_l) + 1; // Don't test the same pixel again...
+                            next_y = frame->y - 1;
+                            continue;
+                        }
+                    } else {
+                        blob_perimeter += right - left + 1;
+                    }
 
-                            x = old_x;
-                            y = old_y;
+                    if (frame->y < y_max) {
+                        next = blob_row_scan(&r, row + 1, r.cur_row[row + 1] + r.runs[frame->run].down,
+                                             frame->b_l, right, left, right, &blob_perimeter);
+                        if (next != BLOB_NO_RUN) {
+                            frame->b_l = IM_MAX(r.runs[next].l, frame->b_l) + 1; // Don't test the same pixel again...
+                            next_y = frame->y + 1;
+                            continue;
                         }
+                    } else {
+                        blob_perimeter += right - left + 1;
                     }
+
+                    sp -= 1;
                 }
-                break;
-            }
-            default: {
-                break;
+
+                rectangle_t rect;
+                rect.x = corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x; // l
+                rect.y = corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y; // t
+                rect.w = corners[(FIND_BLOBS_CORNERS_RESOLUTION*2)/4].x - corners[(FIND_BLOBS_CORNERS_RESOLUTION*0)/4].x + 1; // r - l + 1
+                rect.h = corners[(FIND_BLOBS_CORNERS_RESOLUTION*3)/4].y - corners[(FIND_BLOBS_CORNERS_RESOLUTION*1)/4].y + 1; // b - t + 1
+
+                if (((rect.w * rect.h) >= area_threshold) && (blob_pixels >= pixels_threshold)) {
+
+                    // http://www.cse.usf.edu/~r1k/MachineVisionBook/MachineVision.files/MachineVision_Chapter2.pdf
+                    // https://www.strchr.com/standard_deviation_in_one_pass
+                    //
+                    // a = sigma(x*x) + (mx*sigma(x)) + (mx*sigma(x)) + (sigma()*mx*mx)
+                    // b = sigma(x*y) + (mx*sigma(y)) + (my*sigma(x)) + (sigma()*mx*my)
+                    // c = sigma(y*y) + (my*sigma(y)) + (my*sigma(y)) + (sigma()*my*my)
+                    //
+                    // blob_a = sigma(x*x)
+                    // blob_b = sigma(x*y)
+                    // blob_c = sigma(y*y)
+                    // blob_cx = sigma(x)
+                    // blob_cy = sigma(y)
+                    // blob_pixels = sigma()
+
+                    float b_mx = blob_cx / ((float) blob_pixels);
+                    float b_my = blob_cy / ((float) blob_pixels);
+                    int mx = fast_roundf(b_mx); // x centroid
+                    int my = fast_roundf(b_my); // y centroid
+                    int small_blob_a = blob_a - ((mx * blob_cx) + (mx * blob_cx)) + (blob_pixels * mx * mx);
+                    int small_blob_b = blob_b - ((mx * blob_cy) + (my * blob_cx)) + (blob_pixels * mx * my);
+                    int small_blob_c = blob_c - ((my * blob_cy) + (my * blob_cy)) + (blob_pixels * my * my);
+
+                    find_blobs_list_lnk_data_t lnk_blob;
+                    memcpy(lnk_blob.corners, corners, FIND_BLOBS_CORNERS_RESOLUTION * sizeof(point_t));
+                    memcpy(&lnk_blob.rect, &rect, sizeof(rectangle_t));
+                    lnk_blob.pixels = blob_pixels;
+                    lnk_blob.perimeter = blob_perimeter;
+                    lnk_blob.code = 1 << code;
+                    lnk_blob.count = 1;
+                    lnk_blob.centroid_x = b_mx;
+                    lnk_blob.centroid_y = b_my;
+                    lnk_blob.rotation = (small_blob_a != small_blob_c) ? (fast_atan2f(2 * small_blob_b, small_blob_a - small_blob_c) / 2.0f) : 0.0f;
+                    lnk_blob.roundness = calc_roundness(small_blob_a, small_blob_b, small_blob_c);
+                    lnk_blob.x_hist_bins_count = 0;
+                    lnk_blob.x_hist_bins = NULL;
+                    lnk_blob.y_hist_bins_count = 0;
+                    lnk_blob.y_hist_bins = NULL;
+                    // These store the current average accumulation.
+                    lnk_blob.centroid_x_acc = lnk_blob.centroid_x * lnk_blob.pixels;
+                    lnk_blob.centroid_y_acc = lnk_blob.centroid_y * lnk_blob.pixels;
+                    lnk_blob.rotation_acc_x = cosf(lnk_blob.rotation) * lnk_blob.pixels;
+                    lnk_blob.rotation_acc_y = sinf(lnk_blob.rotation) * lnk_blob.pixels;
+                    lnk_blob.roundness_acc = lnk_blob.roundness * lnk_blob.pixels;
+
+                    if (x_hist_bins) {
+                        bin_up(x_hist_bins, ptr->w, x_hist_bins_max, &lnk_blob.x_hist_bins, &lnk_blob.x_hist_bins_count);
+                    }
+
+                    if (y_hist_bins) {
+                        bin_up(y_hist_bins, ptr->h, y_hist_bins_max, &lnk_blob.y_hist_bins, &lnk_blob.y_hist_bins_count);
+                    }
+
+                    if (((threshold_cb_arg == NULL) || threshold_cb(threshold_cb_arg, &lnk_blob))) {
+                        list_push_back(out, &lnk_blob);
+                    } else {
+                        if (lnk_blob.x_hist_bins) xfree(lnk_blob.x_hist_bins);
+                        if (lnk_blob.y_hist_bins) xfree(lnk_blob.y_hist_bins);
+                    }
+                }
+
             }
         }
 
+        fb_free(); // stack
+
+        // Pixels in a blob are skipped by the next thresholds.
+        if (iterator_next(it)) {
+            blob_runs_retire(&r, roi->h);
+        }
+
         code += 1;
     }
 
-    lifo_free(&lifo);
+    fb_free(); // runs
+    fb_free(); // rows
+    imlib_color_thresholds_lut_free(&lut);
     if (y_hist_bins) fb_free();
     if (x_hist_bins) fb_free();
-    fb_free(); // bitmap
 
     if (merge) {
         for(;;) {
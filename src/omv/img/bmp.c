@@ -45,6 +45,7 @@ bool bmp_read_geometry(FIL *fp, image_t *img, const char *path, bmp_read_setting
     if ((rs->bmp_w == 0) || (rs->bmp_h == 0)) ff_file_corrupted(fp);
     img->w = abs(rs->bmp_w);
     img->h = abs(rs->bmp_h);
+    img->stride = 0;
 
     read_word_expect(fp, 1);
     read_word(fp, &rs->bmp_bpp);
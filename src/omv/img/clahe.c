@@ -327,6 +327,7 @@ void imlib_clahe_histeq(image_t *img, float clip_limit, image_t *mask)
     temp.w = img->w;
     temp.h = img->h;
     temp.bpp = img->bpp;
+    temp.stride = 0;
     temp.data = fb_alloc0(pImageW * pImageH * sizeof(kz_pixel_t), FB_ALLOC_NO_HINT);
 
     switch(img->bpp) {
@@ -1013,6 +1013,7 @@ void imlib_flood_fill(image_t *img, int x, int y,
         out.w = img->w;
         out.h = img->h;
         out.bpp = IMAGE_BPP_BINARY;
+        out.stride = 0;
         out.data = fb_alloc0(image_size(&out), FB_ALLOC_NO_HINT);
 
         if (mask) {
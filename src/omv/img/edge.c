@@ -29,7 +29,7 @@ void imlib_edge_simple(image_t *src, rectangle_t *roi, int low_thresh, int high_
     lnk_data.LMin=low_thresh;
     lnk_data.LMax=high_thresh;
     list_push_back(&thresholds, &lnk_data);
-    imlib_binary(src, src, &thresholds, false, false, NULL);
+    imlib_binary(src, src, &thresholds, false, NULL, false, NULL);
     list_free(&thresholds);
     imlib_erode(src, 1, 2, NULL);
 }
@@ -44,29 +44,15 @@ void imlib_edge_canny(image_t *src, rectangle_t *roi, int low_thresh, int high_t
     imlib_sepconv3(src, kernel_gauss_3, 1.0f/16.0f, 0.0f);
 
     //2. Finding Image Gradients
+    uint16_t *t_row = fb_alloc(roi->w*sizeof*t_row, FB_ALLOC_NO_HINT);
+    uint16_t *g_row = fb_alloc(roi->w*sizeof*g_row, FB_ALLOC_NO_HINT);
     for (int gy=1, y=roi->y+1; y<roi->y+roi->h-1; y++, gy++) {
+        imlib_gradient_row(src, roi, y, 1, t_row, g_row);
         for (int gx=1, x=roi->x+1; x<roi->x+roi->w-1; x++, gx++) {
-            int vx=0, vy=0;
-            // sobel kernel in the horizontal direction
-            vx  = src->data [(y-1)*w+x-1]
-                - src->data [(y-1)*w+x+1]
-                + (src->data[(y+0)*w+x-1]<<1)
-                - (src->data[(y+0)*w+x+1]<<1)
-                + src->data [(y+1)*w+x-1]
-                - src->data [(y+1)*w+x+1];
-
-            // sobel kernel in the vertical direction
-            vy  = src->data [(y-1)*w+x-1]
-                + (src->data[(y-1)*w+x+0]<<1)
-                + src->data [(y-1)*w+x+1]
-                - src->data [(y+1)*w+x-1]
-                - (src->data[(y+1)*w+x+0]<<1)
-                - src->data [(y+1)*w+x+1];
-
             // Find magnitude
-            int g = (int) fast_sqrtf(vx*vx + vy*vy);
+            int g = g_row[gx-1];
             // Find the direction and round angle to 0, 45, 90 or 135
-            int t = (int) fast_fabsf((atan2f(vy, vx)*180.0f/M_PI));
+            int t = (t_row[gx-1] > 180) ? (360 - t_row[gx-1]) : t_row[gx-1];
             if (t < 22) {
                 t = 0;
             } else if (t < 67) {
@@ -83,6 +69,8 @@ void imlib_edge_canny(image_t *src, rectangle_t *roi, int low_thresh, int high_t
             gm[gy*roi->w+gx].g = g;
         }
     }
+    fb_free(); // g_row
+    fb_free(); // t_row
 
     // 3. Hysteresis Thresholding
     // 4. Non-maximum Suppression and output
@@ -85,26 +85,6 @@ ALWAYS_INLINE static float get_cos(int k, int N_pow2) // N=512 -> N=pow2=9
     return fft_cos_table[k << (9 - N_pow2)];
 }
 
-ALWAYS_INLINE static float get_ai(int k, int N_pow2) // N=512 -> N=pow2=9
-{
-    return 0.5 * (-get_cos(k, N_pow2));
-}
-
-ALWAYS_INLINE static float get_bi(int k, int N_pow2) // N=512 -> N=pow2=9
-{
-    return 0.5 * (+get_cos(k, N_pow2));
-}
-
-ALWAYS_INLINE static float get_a_star_i(int k, int N_pow2) // N=512 -> N=pow2=9
-{
-    return 0.5 * (+get_cos(k, N_pow2));
-}
-
-ALWAYS_INLINE static float get_b_star_i(int k, int N_pow2) // N=512 -> N=pow2=9
-{
-    return 0.5 * (-get_cos(k, N_pow2));
-}
-
 //// For samples 0 to (n/2)-1 --- Note: clog2(n/2) = N_pow2
 //ALWAYS_INLINE static float get_hann_l_side(int k, int N_pow2)
 //{
@@ -189,24 +169,26 @@ ALWAYS_INLINE static float get_sin(int k, int N_pow2) // N=512 -> N=pow2=9
     return fft_sin_table[k << (9 - N_pow2)];
 }
 
-ALWAYS_INLINE static float get_ar(int k, int N_pow2) // N=512 -> N=pow2=9
-{
-    return 0.5 * (1 - get_sin(k, N_pow2));
-}
+///////////////////////////////////////////////////////////////////////////////
 
-ALWAYS_INLINE static float get_br(int k, int N_pow2) // N=512 -> N=pow2=9
+ALWAYS_INLINE static int int_flog2(int x) // floor log 2
 {
-    return 0.5 * (1 + get_sin(k, N_pow2));
+    return 31 - __CLZ(x);
 }
 
-ALWAYS_INLINE static float get_a_star_r(int k, int N_pow2) // N=512 -> N=pow2=9
+ALWAYS_INLINE static int int_clog2(int x) // ceiling log 2
 {
-    return 0.5 * (1 - get_sin(k, N_pow2));
+    int y = int_flog2(x);
+    return (x - (1 << y)) ? (y + 1) : y;
 }
 
-ALWAYS_INLINE static float get_b_star_r(int k, int N_pow2) // N=512 -> N=pow2=9
+///////////////////////////////////////////////////////////////////////////////
+
+// Input even numbered index
+// Output even numbered index
+ALWAYS_INLINE static int bit_reverse(int index, int N_pow2)
 {
-    return 0.5 * (1 + get_sin(k, N_pow2));
+    return __RBIT(index) >> (30 - N_pow2);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -219,35 +201,34 @@ ALWAYS_INLINE static float get_b_star_r(int k, int N_pow2) // N=512 -> N=pow2=9
 // Unpack 2N data from N point fft
 // in = N real and complex floats
 // out = 2N real and complex floats
+// The A and B coefficients are 0.5*(1-sin), -0.5*cos, 0.5*(1+sin) and 0.5*cos so
+// only the sums and differences of in[k] and in[N-k] get multiplied. Outputs k
+// and N-k share those products since cos(N-k) = -cos(k) and sin(N-k) = sin(k).
 static void unpack_fft(float *in, float *out, int N_pow2)
 {
-    for (int k = 0, l = 2 << N_pow2, m = l << 1; k < l; k += 2) {
-        int k_r = k+0;
-        int k_i = k+1;
-        int N_k_r = ((!k)?0:(l-k))+0;
-        int N_k_i = ((!k)?0:(l-k))+1;
-        int N2_K_r = ((!k)?0:(m-k))+0;
-        int N2_K_i = ((!k)?0:(m-k))+1;
-        int k_2 = k >> 1;
-        // real
-        out[k_r] = (in[k_r] * get_ar(k_2, N_pow2)) -
-                   (in[k_i] * get_ai(k_2, N_pow2)) +
-                   (in[N_k_r] * get_br(k_2, N_pow2)) +
-                   (in[N_k_i] * get_bi(k_2, N_pow2));
-        // imaginary
-        out[k_i] = (in[k_i] * get_ar(k_2, N_pow2)) +
-                   (in[k_r] * get_ai(k_2, N_pow2)) +
-                   (in[N_k_r] * get_bi(k_2, N_pow2)) -
-                   (in[N_k_i] * get_br(k_2, N_pow2));
-        if (k > 0) {
-            // real conj
-            out[N2_K_r] = out[k_r];
-            // imaginary conj
-            out[N2_K_i] = -out[k_i];
-        }
+    int l = 2 << N_pow2, m = l << 1;
+    out[0] = in[0+0] + in[0+1];
+    out[1] = 0;
+    out[l+0] = in[0+0] - in[0+1];
+    out[l+1] = 0;
+
+    for (int k = 2; k <= (l >> 1); k += 2) {
+        int N_k = l-k;
+        float c = get_cos(k >> 1, N_pow2);
+        float s = get_sin(k >> 1, N_pow2);
+        float sum_r = in[k+0] + in[N_k+0], diff_r = in[k+0] - in[N_k+0];
+        float sum_i = in[k+1] + in[N_k+1], diff_i = in[k+1] - in[N_k+1];
+        float s_diff_r = s * diff_r, c_sum_i = c * sum_i;
+        float s_sum_i = s * sum_i, c_diff_r = c * diff_r;
+        // k and its conj
+        out[k+0] = out[m-k+0] = 0.5 * (sum_r - s_diff_r + c_sum_i);
+        out[k+1] = 0.5 * (diff_i - s_sum_i - c_diff_r);
+        out[m-k+1] = -out[k+1];
+        // N-k and its conj
+        out[N_k+0] = out[m-N_k+0] = 0.5 * (sum_r + s_diff_r - c_sum_i);
+        out[N_k+1] = 0.5 * (-diff_i - s_sum_i - c_diff_r);
+        out[m-N_k+1] = -out[N_k+1];
     }
-    out[(2 << N_pow2)+0] = in[0+0] - in[0+1];
-    out[(2 << N_pow2)+1] = 0;
 }
 
 // The IFFT takes N real and imaginary pairs to generate N real and imaginary
@@ -257,57 +238,32 @@ static void unpack_fft(float *in, float *out, int N_pow2)
 
 // Pack 2N data to N point fft
 // in = 2N real and complex floats
-// out = N real and complex floats
+// out = N real and complex floats (bit reversed for the ifft)
+// The conjugate A and B coefficients are 0.5*(1-sin), 0.5*cos, 0.5*(1+sin) and
+// -0.5*cos, outputs k and N-k share their products like in unpack_fft().
 static void pack_fft(float *in, float *out, int N_pow2)
 {
-    for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
-        int k_r = k+0;
-        int k_i = k+1;
-        int N_k_r = (l-k)+0;
-        int N_k_i = (l-k)+1;
-        int k_2 = k >> 1;
-        // real
-        out[k_r] = (in[k_r] * get_a_star_r(k_2, N_pow2)) -
-                   (in[k_i] * get_a_star_i(k_2, N_pow2)) +
-                   (in[N_k_r] * get_b_star_r(k_2, N_pow2)) +
-                   (in[N_k_i] * get_b_star_i(k_2, N_pow2));
-        // imaginary
-        out[k_i] = (in[k_i] * get_a_star_r(k_2, N_pow2)) +
-                   (in[k_r] * get_a_star_i(k_2, N_pow2)) +
-                   (in[N_k_r] * get_b_star_i(k_2, N_pow2)) -
-                   (in[N_k_i] * get_b_star_r(k_2, N_pow2));
+    int l = 2 << N_pow2;
+    out[0] = 0.5 * ((in[0+0] + in[l+0]) - (in[0+1] + in[l+1]));
+    out[1] = 0.5 * ((in[0+1] - in[l+1]) + (in[0+0] - in[l+0]));
+
+    for (int k = 2; k <= (l >> 1); k += 2) {
+        int N_k = l-k;
+        int m_k = bit_reverse(k, N_pow2);
+        int m_N_k = bit_reverse(N_k, N_pow2);
+        float c = get_cos(k >> 1, N_pow2);
+        float s = get_sin(k >> 1, N_pow2);
+        float sum_r = in[k+0] + in[N_k+0], diff_r = in[k+0] - in[N_k+0];
+        float sum_i = in[k+1] + in[N_k+1], diff_i = in[k+1] - in[N_k+1];
+        float s_diff_r = s * diff_r, c_sum_i = c * sum_i;
+        float s_sum_i = s * sum_i, c_diff_r = c * diff_r;
+        out[m_k+0] = 0.5 * (sum_r - s_diff_r - c_sum_i);
+        out[m_k+1] = 0.5 * (diff_i - s_sum_i + c_diff_r);
+        out[m_N_k+0] = 0.5 * (sum_r + s_diff_r + c_sum_i);
+        out[m_N_k+1] = 0.5 * (-diff_i - s_sum_i + c_diff_r);
     }
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-ALWAYS_INLINE static int int_flog2(int x) // floor log 2
-{
-    return 31 - __CLZ(x);
-}
-
-ALWAYS_INLINE static int int_clog2(int x) // ceiling log 2
-{
-    int y = int_flog2(x);
-    return (x - (1 << y)) ? (y + 1) : y;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-
-// Input even numbered index
-// Output even numbered index
-ALWAYS_INLINE static int bit_reverse(int index, int N_pow2)
-{
-    return __RBIT(index) >> (30 - N_pow2);
-}
-
-ALWAYS_INLINE static void swap(float *a, float *b)
-{
-    float tmp = *b;
-    *b = *a;
-    *a = tmp;
-}
-
 //ALWAYS_INLINE static float get_hann(int k, int N_pow2)
 //{
 //    if (k < (1 << N_pow2)) {
@@ -322,10 +278,16 @@ ALWAYS_INLINE static void swap(float *a, float *b)
 
 static void prepare_real_input(uint8_t *in, int in_len, float *out, int N_pow2)
 {
-    for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
+    int k = 0;
+    for (int l = in_len & ~1; k < l; k += 2) {
+        int m = bit_reverse(k, N_pow2);
+        out[m+0] = in[k+0];
+        out[m+1] = in[k+1];
+    }
+    for (int l = 2 << N_pow2; k < l; k += 2) {
         int m = bit_reverse(k, N_pow2);
         out[m+0] = ((k+0) < in_len) ? in[k+0] : 0;
-        out[m+1] = ((k+1) < in_len) ? in[k+1] : 0;
+        out[m+1] = 0;
 //        // Apply Hann Window (this is working on real numbers)
 //        out[m+0] *= get_hann(k+0, N_pow2);
 //        out[m+1] *= get_hann(k+1, N_pow2);
@@ -353,86 +315,167 @@ static void prepare_real_input_again(float *in, int in_len, float *out, int N_po
 //    }
 //}
 
-// Copies N complex pairs from in to out while bit reversing their indexes. The
-// in and out arrays may be the same.
+// Copies the N complex pairs of a column from in to out while bit reversing
+// their indexes. The out array is contiguous for the fft.
 
-static void prepare_complex_input(float *in, float *out, int N_pow2, int stride)
+static void prepare_column_input(float *in, float *out, int N_pow2, int stride)
 {
-    if(in == out) {
-        for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
-            int m = bit_reverse(k, N_pow2);
-            if (k < m) {
-                swap(out+(m*stride)+0, in+(k*stride)+0);
-                swap(out+(m*stride)+1, in+(k*stride)+1);
-            }
-        }
-    } else {
-        for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
-            int m = bit_reverse(k, N_pow2);
-            out[(m*stride)+0] = in[(k*stride)+0];
-            out[(m*stride)+1] = in[(k*stride)+1];
-        }
+    for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
+        int m = bit_reverse(k, N_pow2);
+        out[m+0] = in[(k*stride)+0];
+        out[m+1] = in[(k*stride)+1];
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// Performs the fft in place.
-static void do_fft(float *inout, int N_pow2, int stride)
-{
-    int N = 2 << N_pow2;
-    for (int N_pow2_i = 1; N_pow2_i <= N_pow2; N_pow2_i++) {
-        int N_mul2 = 2 << N_pow2_i;
-        int N_div2 = 1 << N_pow2_i;
-        for (int i = 0; i < N; i += N_mul2) {
-            for (int j = i, k = 0, l = i + N_div2, m = N >> N_pow2_i; j < l; j += 2, k += m) {
-                int x0_r = (j*stride)+0;
-                int x0_i = (j*stride)+1;
-                int x1_r = ((j+N_div2)*stride)+0;
-                int x1_i = ((j+N_div2)*stride)+1;
-                float tmp_r = (inout[x1_r] * get_cos(k, N_pow2)) +
-                              (inout[x1_i] * get_sin(k, N_pow2));
-                float tmp_i = (inout[x1_i] * get_cos(k, N_pow2)) -
-                              (inout[x1_r] * get_sin(k, N_pow2));
-                inout[x1_r] = inout[x0_r] - tmp_r;
-                inout[x1_i] = inout[x0_i] - tmp_i;
-                inout[x0_r] += tmp_r;
-                inout[x0_i] += tmp_i;
-            }
+// The twiddle factors of each radix-4 pass of one fft size are computed once per
+// transform from the tables above. A 2D transform shares one plan between all
+// of its rows or columns and the butterflies read the twiddles in order.
+typedef struct fft_plan {
+    int N_pow2;
+    float *twiddles;
+} fft_plan_t;
+
+// Radix-4 passes combine 4 ffts of L points into one of 4L points. With an odd
+// N_pow2 a radix-2 pass first makes 2 point ffts.
+ALWAYS_INLINE static int fft_plan_size(int N_pow2)
+{
+    int size = 0;
+    for (int L = 1 << (N_pow2 & 1); (L * 4) <= (1 << N_pow2); L *= 4) {
+        size += L * 6;
+    }
+    return size;
+}
+
+// Gets the cos and sin of the k-th of 1024 angles for k < 768.
+ALWAYS_INLINE static void get_twiddle(int k, float *c, float *s)
+{
+    if (k < 512) {
+        *c = fft_cos_table[k];
+        *s = fft_sin_table[k];
+    } else {
+        *c = -fft_cos_table[k - 512];
+        *s = -fft_sin_table[k - 512];
+    }
+}
+
+static void fft_plan_alloc(fft_plan_t *plan, int N_pow2)
+{
+    plan->N_pow2 = N_pow2;
+    plan->twiddles = fb_alloc(IM_MAX(fft_plan_size(N_pow2), 1) * sizeof(float), FB_ALLOC_NO_HINT);
+
+    // W^k, W^2k and W^3k where W is the 4L-th root of unity, 256/L of 1024 angles.
+    float *w = plan->twiddles;
+    for (int L_pow2 = N_pow2 & 1; (L_pow2 + 2) <= N_pow2; L_pow2 += 2) {
+        for (int k = 0, step = 256 >> L_pow2, l = 256; k < l; k += step, w += 6) {
+            get_twiddle(k * 1, w + 0, w + 1);
+            get_twiddle(k * 2, w + 2, w + 3);
+            get_twiddle(k * 3, w + 4, w + 5);
         }
     }
 }
 
-// Performs the ifft in place.
-static void do_ifft(float *inout, int N_pow2, int stride)
-{
-    int N = 2 << N_pow2;
-    for (int N_pow2_i = 1; N_pow2_i <= N_pow2; N_pow2_i++) {
-        int N_mul2 = 2 << N_pow2_i;
-        int N_div2 = 1 << N_pow2_i;
-        for (int i = 0; i < N; i += N_mul2) {
-            for (int j = i, k = 0, l = i + N_div2, m = N >> N_pow2_i; j < l; j += 2, k += m) {
-                int x0_r = (j*stride)+0;
-                int x0_i = (j*stride)+1;
-                int x1_r = ((j+N_div2)*stride)+0;
-                int x1_i = ((j+N_div2)*stride)+1;
-                float tmp_r = (inout[x1_r] * get_cos(k, N_pow2)) -
-                              (inout[x1_i] * get_sin(k, N_pow2));
-                float tmp_i = (inout[x1_i] * get_cos(k, N_pow2)) +
-                              (inout[x1_r] * get_sin(k, N_pow2));
-                inout[x1_r] = inout[x0_r] - tmp_r;
-                inout[x1_i] = inout[x0_i] - tmp_i;
-                inout[x0_r] += tmp_r;
-                inout[x0_i] += tmp_i;
+static void fft_plan_dealloc()
+{
+    fb_free();
+}
+
+// Multiplies (a_r, a_i) by W or by its conjugate for the ifft.
+#define FFT_TWIDDLE(a_r, a_i, w, inverse, out_r, out_i) \
+    do { \
+        float _a_r = (a_r), _a_i = (a_i), _c = (w)[0], _s = (w)[1]; \
+        if (!(inverse)) { \
+            out_r = (_a_r * _c) + (_a_i * _s); \
+            out_i = (_a_i * _c) - (_a_r * _s); \
+        } else { \
+            out_r = (_a_r * _c) - (_a_i * _s); \
+            out_i = (_a_i * _c) + (_a_r * _s); \
+        } \
+    } while (0)
+
+// Performs the fft in place on bit reversed input. The 4 L point ffts in a 4L
+// point block hold the samples 4n, 4n+2, 4n+1 and 4n+3 in that order. The ifft
+// is not scaled.
+ALWAYS_INLINE static void fft_butterflies(float *inout, fft_plan_t *plan, const bool inverse)
+{
+    int N = 2 << plan->N_pow2;
+    int L = 1;
+
+    if (plan->N_pow2 & 1) {
+        for (int j = 0; j < N; j += 4) {
+            float tmp_r = inout[j+2];
+            float tmp_i = inout[j+3];
+            inout[j+2] = inout[j+0] - tmp_r;
+            inout[j+3] = inout[j+1] - tmp_i;
+            inout[j+0] += tmp_r;
+            inout[j+1] += tmp_i;
+        }
+        L = 2;
+    }
+
+    for (float *w = plan->twiddles; (L * 8) <= N; w += L * 6, L *= 4) {
+        for (int i = 0, L2 = L * 2; i < N; i += L * 8) {
+            float *x0 = inout + i, *x1 = x0 + L2, *x2 = x1 + L2, *x3 = x2 + L2;
+            float *w_k = w;
+            for (int k = 0; k < L2; k += 2, w_k += 6) {
+                float t1_r, t1_i, t2_r, t2_i, t3_r, t3_i;
+                FFT_TWIDDLE(x1[k+0], x1[k+1], w_k + 2, inverse, t1_r, t1_i);
+                FFT_TWIDDLE(x2[k+0], x2[k+1], w_k + 0, inverse, t2_r, t2_i);
+                FFT_TWIDDLE(x3[k+0], x3[k+1], w_k + 4, inverse, t3_r, t3_i);
+                float s0_r = x0[k+0] + t1_r, s0_i = x0[k+1] + t1_i;
+                float s1_r = x0[k+0] - t1_r, s1_i = x0[k+1] - t1_i;
+                float s2_r = t2_r + t3_r, s2_i = t2_i + t3_i;
+                float s3_r = t2_r - t3_r, s3_i = t2_i - t3_i;
+                // The fft rotates s3 by -i and the ifft by +i.
+                if (inverse) {
+                    s3_r = -s3_r;
+                    s3_i = -s3_i;
+                }
+                x0[k+0] = s0_r + s2_r;
+                x0[k+1] = s0_i + s2_i;
+                x1[k+0] = s1_r + s3_i;
+                x1[k+1] = s1_i - s3_r;
+                x2[k+0] = s0_r - s2_r;
+                x2[k+1] = s0_i - s2_i;
+                x3[k+0] = s1_r - s3_i;
+                x3[k+1] = s1_i + s3_r;
             }
         }
     }
+}
+
+static void do_fft(float *inout, fft_plan_t *plan)
+{
+    fft_butterflies(inout, plan, false);
+}
+
+static void do_ifft(float *inout, fft_plan_t *plan)
+{
+    fft_butterflies(inout, plan, true);
+}
+
+// Real fft of in_len bytes of in into the 2N complex pairs of out.
+static void fft_real(uint8_t *in, int in_len, float *out, float *h_buffer, fft_plan_t *plan)
+{
+    prepare_real_input(in, in_len, h_buffer, plan->N_pow2);
+    do_fft(h_buffer, plan);
+    unpack_fft(h_buffer, out, plan->N_pow2);
+}
+
+// Real ifft of the 2N complex pairs of inout, the 2N real outputs are stored
+// in the first half of inout and the second half is zeroed.
+static void ifft_real(float *inout, float *h_buffer, fft_plan_t *plan)
+{
+    int N = 2 << plan->N_pow2;
+    pack_fft(inout, h_buffer, plan->N_pow2);
+    do_ifft(h_buffer, plan);
 
     float div = 1.0 / (N >> 1);
-    for (int i = 0; i < N; i += 2) {
-        inout[(i*stride)+0] *= div;
-        inout[(i*stride)+1] *= div;
+    for (int i = 0; i < N; i++) {
+        inout[i] = h_buffer[i] * div;
     }
+    memset(inout + N, 0, N * sizeof(float));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -456,10 +499,10 @@ void fft1d_run(fft1d_controller_t *controller)
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
-    prepare_real_input(controller->d_pointer, controller->d_len,
-                       h_buffer, controller->pow2 - 1);
-    do_fft(h_buffer, controller->pow2 - 1, 1);
-    unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->pow2 - 1);
+    fft_real(controller->d_pointer, controller->d_len, controller->data, h_buffer, &plan);
+    fft_plan_dealloc();
     fb_free();
 }
 
@@ -469,12 +512,10 @@ void ifft1d_run(fft1d_controller_t *controller)
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
-    pack_fft(controller->data, h_buffer, controller->pow2 - 1);
-    prepare_complex_input(h_buffer, h_buffer,
-                          controller->pow2 - 1, 1);
-    do_ifft(h_buffer, controller->pow2 - 1, 1);
-    memset(controller->data, 0, (2 << controller->pow2) * sizeof(float));
-    memcpy(controller->data, h_buffer, (1 << controller->pow2) * sizeof(float));
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->pow2 - 1);
+    ifft_real(controller->data, h_buffer, &plan);
+    fft_plan_dealloc();
     fb_free();
 }
 
@@ -536,22 +577,30 @@ void fft1d_run_again(fft1d_controller_t *controller)
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->pow2 - 1);
     prepare_real_input_again(controller->data, 1 << controller->pow2,
                              h_buffer, controller->pow2 - 1);
-    do_fft(h_buffer, controller->pow2 - 1, 1);
+    do_fft(h_buffer, &plan);
     unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
+    fft_plan_dealloc();
     fb_free();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void fft2d_alloc(fft2d_controller_t *controller, image_t *img, rectangle_t *r)
+{
+    fft2d_alloc_pow2(controller, img, r, 0, 0);
+}
+
+void fft2d_alloc_pow2(fft2d_controller_t *controller, image_t *img, rectangle_t *r, int w_pow2, int h_pow2)
 {
     controller->img = img;
     if (!rectangle_subimg(controller->img, r, &controller->r)) ff_no_intersection(NULL);
 
-    controller->w_pow2 = int_clog2(controller->r.w);
-    controller->h_pow2 = int_clog2(controller->r.h);
+    controller->w_pow2 = IM_MAX(int_clog2(controller->r.w), w_pow2);
+    controller->h_pow2 = IM_MAX(int_clog2(controller->r.h), h_pow2);
 
     controller->data =
     fb_alloc0(2 * (1 << controller->w_pow2) * (1 << controller->h_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
@@ -562,60 +611,102 @@ void fft2d_dealloc()
     fb_free();
 }
 
+// The rows hold real data so their ffts are conjugate symmetric and so are the
+// columns. Only the columns up to the middle one need a column fft, the others
+// are conjugates of them. The ifft only needs the same columns for the rows.
+static void fft2d_columns(fft2d_controller_t *controller, bool inverse)
+{
+    int w = 1 << controller->w_pow2;
+    int h = 1 << controller->h_pow2;
+    float *buffer = fb_alloc(h * 2 * sizeof(float), FB_ALLOC_NO_HINT);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->h_pow2);
+
+    // The above operates on the rows and this fft operates on the columns. The
+    // columns are copied out so the fft works on contiguous data.
+    for (int i = 0, ii = 2 * IM_MIN((w / 2) + 1, w); i < ii; i += 2) {
+        float *p = controller->data + i;
+        prepare_column_input(p, buffer, controller->h_pow2, w);
+
+        if (!inverse) {
+            do_fft(buffer, &plan);
+            for (int k = 0, l = 2 << controller->h_pow2; k < l; k += 2) {
+                p[(k*w)+0] = buffer[k+0];
+                p[(k*w)+1] = buffer[k+1];
+            }
+        } else {
+            do_ifft(buffer, &plan);
+            float div = 1.0 / h;
+            for (int k = 0, l = 2 << controller->h_pow2; k < l; k += 2) {
+                p[(k*w)+0] = buffer[k+0] * div;
+                p[(k*w)+1] = buffer[k+1] * div;
+            }
+        }
+    }
+
+    if (!inverse) {
+        for (int y = 0; y < h; y++) {
+            float *row = controller->data + (y * w * 2);
+            float *mirror_row = controller->data + (((h - y) & (h - 1)) * w * 2);
+            for (int x = (w / 2) + 1; x < w; x++) {
+                row[(x*2)+0] = mirror_row[((w-x)*2)+0];
+                row[(x*2)+1] = -mirror_row[((w-x)*2)+1];
+            }
+        }
+    }
+
+    fft_plan_dealloc();
+    fb_free();
+}
+
 void fft2d_run(fft2d_controller_t *controller)
 {
     // This section copies image data into the fft buffer. It takes care of
     // extracting the grey channel from RGB images if necessary. The code
     // also handles dealing with a rect less than the image size.
+    uint8_t *tmp = fb_alloc(controller->r.w * sizeof(uint8_t), FB_ALLOC_NO_HINT);
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->w_pow2 - 1);
+
     for (int i = 0; i < controller->r.h; i++) {
         // Get image data into buffer.
-        uint8_t *tmp = fb_alloc(controller->r.w * sizeof(uint8_t), FB_ALLOC_NO_HINT);
-        for (int j = 0; j < controller->r.w; j++) {
-            if (IM_IS_GS(controller->img)) {
-                tmp[j] = IM_GET_GS_PIXEL(controller->img,
-                    controller->r.x + j, controller->r.y + i);
-            } else {
-                tmp[j] = COLOR_RGB565_TO_Y(IM_GET_RGB565_PIXEL(controller->img,
-                    controller->r.x + j, controller->r.y + i));
+        if (IM_IS_GS(controller->img)) {
+            memcpy(tmp, IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(controller->img, controller->r.y + i) + controller->r.x,
+                   controller->r.w);
+        } else {
+            uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(controller->img, controller->r.y + i) + controller->r.x;
+            for (int j = 0; j < controller->r.w; j++) {
+                tmp[j] = COLOR_RGB565_TO_Y(row_ptr[j]);
             }
         }
-        // Do FFT on image data and copy to main buffer.
-        fft1d_controller_t fft1d_controller_i;
-        fft1d_alloc(&fft1d_controller_i, tmp, controller->r.w);
-        fft1d_run(&fft1d_controller_i);
-        memcpy(controller->data + (i * (2 << controller->w_pow2)),
-               fft1d_controller_i.data, (2 << fft1d_controller_i.pow2) * sizeof(float));
-        fft1d_dealloc();
-        // Free image data buffer.
-        fb_free();
+        // Do FFT on image data into the main buffer.
+        fft_real(tmp, controller->r.w, controller->data + (i * (2 << controller->w_pow2)), h_buffer, &plan);
     }
 
-    // The above operates on the rows and this fft operates on the columns. To
-    // avoid having to transpose the array the fft takes a stride input.
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-//        apply_hann_window(p, controller->h_pow2, (1 << controller->w_pow2));
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_fft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fft_plan_dealloc();
+    fb_free(); // h_buffer
+    fb_free(); // tmp
+
+    fft2d_columns(controller, false);
 }
 
 void ifft2d_run(fft2d_controller_t *controller)
 {
     // Do columns...
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_ifft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fft2d_columns(controller, true);
 
     // Do rows...
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->w_pow2 - 1);
+
     for (int i = 0, ii = 1 << controller->h_pow2; i < ii; i++) {
-        fft1d_controller_t fft1d_controller_i;
-        fft1d_controller_i.pow2 = controller->w_pow2;
-        fft1d_controller_i.data = controller->data + (i * (2 << controller->w_pow2));
-        ifft1d_run(&fft1d_controller_i);
+        ifft_real(controller->data + (i * (2 << controller->w_pow2)), h_buffer, &plan);
     }
+
+    fft_plan_dealloc();
+    fb_free();
 }
 
 void fft2d_mag(fft2d_controller_t *controller)
@@ -753,19 +844,19 @@ void fft2d_logpolar(fft2d_controller_t *controller)
 
 void fft2d_run_again(fft2d_controller_t *controller)
 {
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    fft_plan_t plan;
+    fft_plan_alloc(&plan, controller->w_pow2 - 1);
+
     for (int i = 0, ii = 1 << controller->h_pow2; i < ii; i++) {
-        fft1d_controller_t fft1d_controller_i;
-        fft1d_controller_i.pow2 = controller->w_pow2;
-        fft1d_controller_i.data = controller->data + (i * (2 << controller->w_pow2));
-        fft1d_run_again(&fft1d_controller_i);
+        float *row = controller->data + (i * (2 << controller->w_pow2));
+        prepare_real_input_again(row, 1 << controller->w_pow2, h_buffer, controller->w_pow2 - 1);
+        do_fft(h_buffer, &plan);
+        unpack_fft(h_buffer, row, controller->w_pow2 - 1);
     }
 
-    // The above operates on the rows and this fft operates on the columns. To
-    // avoid having to transpose the array the fft takes a stride input.
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-//        apply_hann_window(p, controller->h_pow2, (1 << controller->w_pow2));
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_fft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fft_plan_dealloc();
+    fb_free();
+
+    fft2d_columns(controller, false);
 }
@@ -33,6 +33,7 @@ typedef struct fft2d_controller {
     float *data;
 } fft2d_controller_t;
 void fft2d_alloc(fft2d_controller_t *controller, image_t *img, rectangle_t *r);
+void fft2d_alloc_pow2(fft2d_controller_t *controller, image_t *img, rectangle_t *r, int w_pow2, int h_pow2); // Zero padded to at least 2^w_pow2 by 2^h_pow2.
 void fft2d_dealloc();
 void fft2d_run(fft2d_controller_t *controller);
 void ifft2d_run(fft2d_controller_t *controller);
@@ -131,6 +131,8 @@ void imlib_histeq(image_t *img, image_t *mask)
 //   much change in performance.
 //
 #ifdef IMLIB_ENABLE_MEAN
+// Box filter with running sums: every column keeps the sum of its 2*ksize+1 rows which is moved
+// down one row per image row, and the kernel sum is slid along the row by one column per pixel.
 void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset, bool invert, image_t *mask)
 {
     int brows = ksize + 1;
@@ -138,44 +140,41 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
 
     int32_t over32_n = 65536 / (((ksize*2)+1)*((ksize*2)+1));
 
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
             buf.data = fb_alloc(IMAGE_BINARY_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+            int *col_acc = fb_alloc0(img->w * sizeof(int), FB_ALLOC_NO_HINT);
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    col_acc[x] += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x);
+                }
+            }
 
             for (int y = 0, yy = img->h; y < yy; y++) {
                 int pixel, acc = 0;
                 uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
                 uint32_t *buf_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, (y % brows));
 
+                for (int k = -ksize; k <= ksize; k++) {
+                    acc += col_acc[IM_MIN(IM_MAX(k, 0), (img->w - 1))];
+                }
+
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        acc += col_acc[IM_MIN(x + ksize, (img->w - 1))] - col_acc[IM_MAX(x - ksize - 1, 0)];
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
 
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y < img->h-ksize) {
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y + j);
-                            acc -= IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x - ksize - 1);
-                            acc += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x + ksize);
-                        }
-                    } else {
-                        acc = 0;
-
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img,
-                                IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
-
-                            for (int k = -ksize; k <= ksize; k++) {
-                                acc += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                            }
-                        }
-                    }
-
                     pixel = (int)((acc * over32_n)>>16);
 
                     if (threshold) {
@@ -189,6 +188,14 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                     IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint32_t *old_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint32_t *new_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        col_acc[x] += IMAGE_GET_BINARY_PIXEL_FAST(new_row_ptr, x) - IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x);
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -203,40 +210,39 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                        IMAGE_BINARY_LINE_LEN_BYTES(img));
             }
 
+            fb_free();
             fb_free();
             break;
         }
         case IMAGE_BPP_GRAYSCALE: {
             buf.data = fb_alloc(IMAGE_GRAYSCALE_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+            int *col_acc = fb_alloc0(img->w * sizeof(int), FB_ALLOC_NO_HINT);
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    col_acc[x] += IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x);
+                }
+            }
 
             for (int y = 0, yy = img->h; y < yy; y++) {
                 int pixel, acc = 0;
                 uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
                 uint8_t *buf_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows));
 
+                for (int k = -ksize; k <= ksize; k++) {
+                    acc += col_acc[IM_MIN(IM_MAX(k, 0), (img->w - 1))];
+                }
+
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        acc += col_acc[IM_MIN(x + ksize, (img->w - 1))] - col_acc[IM_MAX(x - ksize - 1, 0)];
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y < img->h-ksize) {
-                        for (int j = -ksize; j<= ksize; j++) {
-                            uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y+j);
-                            acc -= IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x-ksize-1);
-                            acc += IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x+ksize); 
-                        }
-                    } else {
-                        acc = 0;
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img,
-                                IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
-
-                                for (int k = -ksize; k <= ksize; k++) {
-                                acc += IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                            }
-                        }
-                    }
 
                     pixel = (int)((acc * over32_n)>>16);
 
@@ -251,6 +257,14 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                     IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint8_t *new_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        col_acc[x] += IMAGE_GET_GRAYSCALE_PIXEL_FAST(new_row_ptr, x) - IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x);
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -265,58 +279,56 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                        IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
             }
 
+            fb_free();
             fb_free();
             break;
         }
         case IMAGE_BPP_RGB565: {
-            int pixel, r, g, b, r_acc, g_acc, b_acc;
             buf.data = fb_alloc(IMAGE_RGB565_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+            int *col_r_acc = fb_alloc0(img->w * sizeof(int) * 3, FB_ALLOC_NO_HINT);
+            int *col_g_acc = col_r_acc + img->w;
+            int *col_b_acc = col_g_acc + img->w;
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    int pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x);
+                    col_r_acc[x] += COLOR_RGB565_TO_R5(pixel);
+                    col_g_acc[x] += COLOR_RGB565_TO_G6(pixel);
+                    col_b_acc[x] += COLOR_RGB565_TO_B5(pixel);
+                }
+            }
 
             for (int y = 0, yy = img->h; y < yy; y++) {
+                int r_acc = 0, g_acc = 0, b_acc = 0;
                 uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
                 uint16_t *buf_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows));
 
-                r_acc = g_acc = b_acc = 0;
+                for (int k = -ksize; k <= ksize; k++) {
+                    int x = IM_MIN(IM_MAX(k, 0), (img->w - 1));
+                    r_acc += col_r_acc[x];
+                    g_acc += col_g_acc[x];
+                    b_acc += col_b_acc[x];
+                }
+
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        int x_add = IM_MIN(x + ksize, (img->w - 1)), x_sub = IM_MAX(x - ksize - 1, 0);
+                        r_acc += col_r_acc[x_add] - col_r_acc[x_sub];
+                        g_acc += col_g_acc[x_add] - col_g_acc[x_sub];
+                        b_acc += col_b_acc[x_add] - col_b_acc[x_sub];
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y < img->h-ksize) {
-                       for (int j= -ksize; j<=ksize; j++) {
-                           uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y+j);
-                           // subtract last left-most pixel from the sums
-                           pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x-ksize-1);
-                           r_acc -= COLOR_RGB565_TO_R5(pixel);
-                           g_acc -= COLOR_RGB565_TO_G6(pixel);
-                           b_acc -= COLOR_RGB565_TO_B5(pixel);
-                           // add new right edge pixel to the sums
-                           pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x+ksize);
-                           r_acc += COLOR_RGB565_TO_R5(pixel);
-                           g_acc += COLOR_RGB565_TO_G6(pixel);
-                           b_acc += COLOR_RGB565_TO_B5(pixel);
-                        }
-                    } else { // check bounds and do full sum calculations
-                        r_acc = g_acc = b_acc = 0;
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img,
-                            IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
 
-                            for (int k = -ksize; k <= ksize; k++) {
-                                pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                                r_acc += COLOR_RGB565_TO_R5(pixel);
-                                g_acc += COLOR_RGB565_TO_G6(pixel);
-                                b_acc += COLOR_RGB565_TO_B5(pixel);
-                            }
-                        }
-                    }
-                    int pixel;
-                    r = (int)((r_acc * over32_n)>>16);
-                    g = (int)((g_acc * over32_n)>>16);
-                    b = (int)((b_acc * over32_n)>>16);
-                    pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
-                     
+                    int r = (int)((r_acc * over32_n)>>16);
+                    int g = (int)((g_acc * over32_n)>>16);
+                    int b = (int)((b_acc * over32_n)>>16);
+                    int pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
+
                     if (threshold) {
                         if (((COLOR_RGB565_TO_Y(pixel) - offset) < COLOR_RGB565_TO_Y(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x))) ^ invert) {
                             pixel = COLOR_RGB565_BINARY_MAX;
@@ -328,6 +340,18 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                     IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint16_t *new_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        int old_pixel = IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x);
+                        int new_pixel = IMAGE_GET_RGB565_PIXEL_FAST(new_row_ptr, x);
+                        col_r_acc[x] += COLOR_RGB565_TO_R5(new_pixel) - COLOR_RGB565_TO_R5(old_pixel);
+                        col_g_acc[x] += COLOR_RGB565_TO_G6(new_pixel) - COLOR_RGB565_TO_G6(old_pixel);
+                        col_b_acc[x] += COLOR_RGB565_TO_B5(new_pixel) - COLOR_RGB565_TO_B5(old_pixel);
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -342,6 +366,7 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
                        IMAGE_RGB565_LINE_LEN_BYTES(img));
             }
 
+            fb_free();
             fb_free();
             break;
         }
@@ -353,29 +378,124 @@ void imlib_mean_filter(image_t *img, const int ksize, bool threshold, int offset
 #endif // IMLIB_ENABLE_MEAN
 
 #ifdef IMLIB_ENABLE_MEDIAN
-static uint8_t hist_median(uint8_t *data, int len, const int cutoff)
+// Perreau's constant time median: every column keeps a histogram of its 2*ksize+1 rows which is
+// moved down one row per image row. The kernel histogram is slid along the row by adding and
+// subtracting column histograms. Only the coarse histogram (groups of 8 bins) is slid at every
+// pixel, the fine bins of a group are brought up to date when the percentile falls into it.
+//
+// Bins are 8-bit counters packed 4 to a word. A column histogram is always part of the kernel
+// histogram so the packed add/sub never carries between bins (for up to 255 samples per window).
+#define MEDIAN_FINE_WORDS(bins)     ((bins) / 4)
+#define MEDIAN_COARSE_WORDS(bins)   ((bins) / 32)
+#define MEDIAN_GET_BIN(words, i)    (((words)[(i) >> 2] >> (((i) & 3) << 3)) & 0xFF)
+
+typedef struct median_hist {
+    int bins;
+    uint32_t *col_fine, *col_coarse;
+    uint32_t fine[MEDIAN_FINE_WORDS(64)], coarse[MEDIAN_COARSE_WORDS(64)];
+    int last[64 / 8];   // Column each group of fine bins was last updated for (-1 if none).
+} median_hist_t;
+
+static void median_hist_alloc(median_hist_t *h, int w, int bins)
 {
-int i;
-#if defined(ARM_MATH_CM7) || defined(ARM_MATH_CM4)
-uint32_t oldsum=0, sum32 = 0;
-
-    for (i=0; i<len; i+=4) { // work 4 at time with SIMD
-        sum32 = __USADA8(*(uint32_t *)&data[i], 0, sum32);
-        if (sum32 >= cutoff) { // within this group
-            while (oldsum < cutoff && i < len)
-                oldsum += data[i++];
-            break;
-        } // if we're at the last 4 values
-        oldsum = sum32;
-    } // for each group of 4 elements
-#else // generic C version
-int sum = 0;
-    for (i=0; i<len && sum < cutoff; i++) {
-        sum += data[i];
+    h->bins = bins;
+    h->col_fine = fb_alloc0(w * MEDIAN_FINE_WORDS(bins) * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+    h->col_coarse = fb_alloc0(w * MEDIAN_COARSE_WORDS(bins) * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+}
+
+static void median_hist_free()
+{
+    fb_free(); // col_coarse
+    fb_free(); // col_fine
+}
+
+// Adds/removes a sample to/from the histogram of column x.
+static inline void median_hist_col_add(median_hist_t *h, int x, int bin)
+{
+    h->col_fine[(x * MEDIAN_FINE_WORDS(h->bins)) + (bin >> 2)] += 1 << ((bin & 3) << 3);
+    bin >>= 3;
+    h->col_coarse[(x * MEDIAN_COARSE_WORDS(h->bins)) + (bin >> 2)] += 1 << ((bin & 3) << 3);
+}
+
+static inline void median_hist_col_sub(median_hist_t *h, int x, int bin)
+{
+    h->col_fine[(x * MEDIAN_FINE_WORDS(h->bins)) + (bin >> 2)] -= 1 << ((bin & 3) << 3);
+    bin >>= 3;
+    h->col_coarse[(x * MEDIAN_COARSE_WORDS(h->bins)) + (bin >> 2)] -= 1 << ((bin & 3) << 3);
+}
+
+// Sets up the coarse kernel histogram for x = 0 and invalidates all fine bins.
+static void median_hist_row_start(median_hist_t *h, int ksize, int w)
+{
+    int words = MEDIAN_COARSE_WORDS(h->bins);
+    memset(h->coarse, 0, sizeof(h->coarse));
+
+    for (int j = -ksize; j <= ksize; j++) {
+        uint32_t *col = h->col_coarse + (IM_MIN(IM_MAX(j, 0), (w - 1)) * words);
+        for (int i = 0; i < words; i++) {
+            h->coarse[i] += col[i];
+        }
+    }
+
+    for (int i = 0, ii = h->bins / 8; i < ii; i++) {
+        h->last[i] = -1;
+    }
+}
+
+// Slides the coarse kernel histogram from x - 1 to x.
+static inline void median_hist_slide(median_hist_t *h, int x, int ksize, int w)
+{
+    int words = MEDIAN_COARSE_WORDS(h->bins);
+    uint32_t *col_sub = h->col_coarse + (IM_MAX(x - ksize - 1, 0) * words);
+    uint32_t *col_add = h->col_coarse + (IM_MIN(x + ksize, (w - 1)) * words);
+
+    for (int i = 0; i < words; i++) {
+        h->coarse[i] = h->coarse[i] - col_sub[i] + col_add[i];
+    }
+}
+
+// Returns the first bin where the kernel histogram sum reaches cutoff (-1 for a cutoff of 0).
+static int median_hist_find(median_hist_t *h, int x, int ksize, int w, int cutoff)
+{
+    if (cutoff <= 0) {
+        return -1;
+    }
+
+    int sum = 0, group = 0;
+    for (int count; sum + (count = MEDIAN_GET_BIN(h->coarse, group)) < cutoff; group++) {
+        sum += count;
     }
-#endif
-    return i-1;
-} /* hist_median() */
+
+    int words = MEDIAN_FINE_WORDS(h->bins);
+    uint32_t *fine = h->fine + (group * 2);
+    uint32_t *col_fine = h->col_fine + (group * 2);
+    int last = h->last[group];
+
+    if ((last < 0) || (((x - last) * 2) > ((ksize * 2) + 1))) {
+        fine[0] = fine[1] = 0;
+        for (int j = -ksize; j <= ksize; j++) {
+            uint32_t *col = col_fine + (IM_MIN(IM_MAX(x + j, 0), (w - 1)) * words);
+            fine[0] += col[0];
+            fine[1] += col[1];
+        }
+    } else {
+        for (int xx = last + 1; xx <= x; xx++) {
+            uint32_t *col_sub = col_fine + (IM_MAX(xx - ksize - 1, 0) * words);
+            uint32_t *col_add = col_fine + (IM_MIN(xx + ksize, (w - 1)) * words);
+            fine[0] = fine[0] - col_sub[0] + col_add[0];
+            fine[1] = fine[1] - col_sub[1] + col_add[1];
+        }
+    }
+
+    h->last[group] = x;
+
+    int bin = group * 8;
+    while ((sum += MEDIAN_GET_BIN(h->fine, bin)) < cutoff) {
+        bin++;
+    }
+
+    return bin;
+}
 
 void imlib_median_filter(image_t *img, const int ksize, float percentile, bool threshold, int offset, bool invert, image_t *mask)
 {
@@ -384,6 +504,7 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
 
     const int n = ((ksize*2)+1)*((ksize*2)+1);
     const int median_cutoff = fast_floorf(percentile * (float)n);
@@ -391,35 +512,35 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
             buf.data = fb_alloc(IMAGE_BINARY_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
-            int sum = 0;
+            // Per column count of set pixels over the 2*ksize+1 rows.
+            int *col_sum = fb_alloc0(img->w * sizeof(int), FB_ALLOC_NO_HINT);
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    col_sum[x] += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x);
+                }
+            }
 
             for (int y = 0, yy = img->h; y < yy; y++) {
                 uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
                 uint32_t *buf_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, (y % brows));
+                int sum = 0;
+
+                for (int k = -ksize; k <= ksize; k++) {
+                    sum += col_sum[IM_MIN(IM_MAX(k, 0), (img->w - 1))];
+                }
 
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        sum += col_sum[IM_MIN(x + ksize, (img->w - 1))] - col_sum[IM_MAX(x - ksize - 1, 0)];
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y <img->h-ksize) {
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y+j);
-                            sum -= IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x-ksize-1);
-                            sum += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x+ksize);
-                        }
-                    } else {
-                        sum = 0;
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img,
-                                IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
 
-                            for (int k = -ksize; k <= ksize; k++) {
-                                sum += IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                            }
-                        }
-                    }
                     int pixel = (sum >= median_cutoff);
 
                     if (threshold) {
@@ -433,6 +554,14 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                     IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint32_t *old_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint32_t *new_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        col_sum[x] += IMAGE_GET_BINARY_PIXEL_FAST(new_row_ptr, x) - IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x);
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -447,48 +576,39 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                        IMAGE_BINARY_LINE_LEN_BYTES(img));
             }
 
+            fb_free();
             fb_free();
             break;
         }
         case IMAGE_BPP_GRAYSCALE: {
             buf.data = fb_alloc(IMAGE_GRAYSCALE_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
-            uint8_t *data = fb_alloc(64, FB_ALLOC_NO_HINT);
-            uint8_t pixel;
+            median_hist_t hist;
+            median_hist_alloc(&hist, img->w, 64);
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    median_hist_col_add(&hist, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x) >> 2);
+                }
+            }
+
             for (int y = 0, yy = img->h; y < yy; y++) {
                 uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
                 uint8_t *buf_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows));
+                median_hist_row_start(&hist, ksize, img->w);
 
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        median_hist_slide(&hist, x, ksize, img->w);
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
 
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y < img->h-ksize) {
-                        // update histogram edges
-                        for (int j=-ksize; j<= ksize; j++) {
-                            uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y+j);
-                            pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x-ksize-1);
-                            data[pixel >> 2]--; // remove old pixels
-                            pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x+ksize);
-                            data[pixel >> 2]++; // add new pixels                            
-                        } // for j
-                    } else { // slow way
-                        memset(data, 0, 64);
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img,
-                                IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
-
-                            for (int k = -ksize; k <= ksize; k++) {
-                                pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                            data[pixel >> 2]++;
-                            }
-                        }
-                    }
+                    uint8_t pixel = median_hist_find(&hist, x, ksize, img->w, median_cutoff) << 2; // scale it back up
 
-                    pixel = hist_median(data, 64, median_cutoff); // find the median
-                    pixel <<= 2; // scale it back up
                     if (threshold) {
                         if (((pixel - offset) < IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) ^ invert) {
                             pixel = COLOR_GRAYSCALE_BINARY_MAX;
@@ -500,6 +620,19 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                     IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column histograms down before the top row is overwritten.
+                    uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint8_t *new_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        int old_bin = IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x) >> 2;
+                        int new_bin = IMAGE_GET_GRAYSCALE_PIXEL_FAST(new_row_ptr, x) >> 2;
+                        if (old_bin != new_bin) {
+                            median_hist_col_sub(&hist, x, old_bin);
+                            median_hist_col_add(&hist, x, new_bin);
+                        }
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -514,58 +647,49 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                        IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
             }
 
-            fb_free();
+            median_hist_free();
             fb_free();
             break;
         }
         case IMAGE_BPP_RGB565: {
             buf.data = fb_alloc(IMAGE_RGB565_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
-            uint8_t *r_data = fb_alloc(32, FB_ALLOC_NO_HINT);
-            uint8_t *g_data = fb_alloc(64, FB_ALLOC_NO_HINT);
-            uint8_t *b_data = fb_alloc(32, FB_ALLOC_NO_HINT);
-            uint8_t r, g, b;
+            median_hist_t r_hist, g_hist, b_hist;
+            median_hist_alloc(&r_hist, img->w, 32);
+            median_hist_alloc(&g_hist, img->w, 64);
+            median_hist_alloc(&b_hist, img->w, 32);
+
+            for (int j = -ksize; j <= ksize; j++) {
+                uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    int pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x);
+                    median_hist_col_add(&r_hist, x, COLOR_RGB565_TO_R5(pixel));
+                    median_hist_col_add(&g_hist, x, COLOR_RGB565_TO_G6(pixel));
+                    median_hist_col_add(&b_hist, x, COLOR_RGB565_TO_B5(pixel));
+                }
+            }
+
             for (int y = 0, yy = img->h; y < yy; y++) {
                 uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
                 uint16_t *buf_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows));
+                median_hist_row_start(&r_hist, ksize, img->w);
+                median_hist_row_start(&g_hist, ksize, img->w);
+                median_hist_row_start(&b_hist, ksize, img->w);
 
                 for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        median_hist_slide(&r_hist, x, ksize, img->w);
+                        median_hist_slide(&g_hist, x, ksize, img->w);
+                        median_hist_slide(&b_hist, x, ksize, img->w);
+                    }
+
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
                         continue; // Short circuit.
                     }
 
-
-                    if (!mask && x > ksize && x < img->w-ksize && y >= ksize && y < img->h-ksize) {
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y+j);
-                            int pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x-ksize-1);
-                            r_data[COLOR_RGB565_TO_R5(pixel)]--; // remove left pixel
-                            g_data[COLOR_RGB565_TO_G6(pixel)]--;
-                            b_data[COLOR_RGB565_TO_B5(pixel)]--;
-                            pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x+ksize);
-                            r_data[COLOR_RGB565_TO_R5(pixel)]++; // add right pixel
-                            g_data[COLOR_RGB565_TO_G6(pixel)]++;
-                            b_data[COLOR_RGB565_TO_B5(pixel)]++;
-                        }
-                    } else { // need to check bounds
-                        memset(r_data, 0, 32); memset(g_data, 0, 64); memset(b_data, 0, 32);
-                        for (int j = -ksize; j <= ksize; j++) {
-                            uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img,
-                                IM_MIN(IM_MAX(y + j, 0), (img->h - 1)));
-
-                            for (int k = -ksize; k <= ksize; k++) {
-                                int pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr,
-                                    IM_MIN(IM_MAX(x + k, 0), (img->w - 1)));
-                                r_data[COLOR_RGB565_TO_R5(pixel)]++;
-                                g_data[COLOR_RGB565_TO_G6(pixel)]++;
-                                b_data[COLOR_RGB565_TO_B5(pixel)]++;
-                            }
-                        }
-                    }
-
-                    r = hist_median(r_data, 32, median_cutoff);
-                    g = hist_median(g_data, 64, median_cutoff);
-                    b = hist_median(b_data, 32, median_cutoff);
+                    uint8_t r = median_hist_find(&r_hist, x, ksize, img->w, median_cutoff);
+                    uint8_t g = median_hist_find(&g_hist, x, ksize, img->w, median_cutoff);
+                    uint8_t b = median_hist_find(&b_hist, x, ksize, img->w, median_cutoff);
 
                     int pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
 
@@ -580,6 +704,23 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                     IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, pixel);
                 }
 
+                if ((y + 1) < img->h) { // Move the column histograms down before the top row is overwritten.
+                    uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MAX(y - ksize, 0));
+                    uint16_t *new_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(y + ksize + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        int old_pixel = IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x);
+                        int new_pixel = IMAGE_GET_RGB565_PIXEL_FAST(new_row_ptr, x);
+                        if (old_pixel != new_pixel) {
+                            median_hist_col_sub(&r_hist, x, COLOR_RGB565_TO_R5(old_pixel));
+                            median_hist_col_sub(&g_hist, x, COLOR_RGB565_TO_G6(old_pixel));
+                            median_hist_col_sub(&b_hist, x, COLOR_RGB565_TO_B5(old_pixel));
+                            median_hist_col_add(&r_hist, x, COLOR_RGB565_TO_R5(new_pixel));
+                            median_hist_col_add(&g_hist, x, COLOR_RGB565_TO_G6(new_pixel));
+                            median_hist_col_add(&b_hist, x, COLOR_RGB565_TO_B5(new_pixel));
+                        }
+                    }
+                }
+
                 if (y >= ksize) { // Transfer buffer lines...
                     memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, (y - ksize)),
                            IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
@@ -594,9 +735,9 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
                        IMAGE_RGB565_LINE_LEN_BYTES(img));
             }
 
-            fb_free();
-            fb_free();
-            fb_free();
+            median_hist_free();
+            median_hist_free();
+            median_hist_free();
             fb_free();
             break;
         }
@@ -632,6 +773,7 @@ void imlib_mode_filter(image_t *img, const int ksize, bool threshold, int offset
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
     const uint8_t n2 = (((ksize*2)+1)*((ksize*2)+1))/2;
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -939,6 +1081,7 @@ void imlib_midpoint_filter(image_t *img, const int ksize, float bias, bool thres
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
     uint8_t *u8BiasTable;
     float max_bias = bias, min_bias = 1.0f - bias;
 
@@ -1177,6 +1320,263 @@ void imlib_midpoint_filter(image_t *img, const int ksize, float bias, bool thres
 }
 #endif // IMLIB_ENABLE_MIDPOINT
 
+// Horizontal pass of one channel. The line has ksize replicated border pixels on both sides.
+static void sepconv_row(int32_t *out, const int32_t *line, int w, int ksize, const int *x_krn)
+{
+    int k_2 = (ksize * 2) + 1;
+
+    for (int x = 0; x < w; x++) {
+        int32_t acc = 0;
+
+        for (int k = 0; k < k_2; k++) {
+            acc += x_krn[k] * line[x + k];
+        }
+
+        out[x] = acc;
+    }
+}
+
+// Vertical pass of one channel at x, rows point to the horizontal sums of rows y-ksize...y+ksize.
+static inline int32_t sepconv_col(int32_t **rows, int x, int ksize, const int *y_krn)
+{
+    int32_t acc = 0;
+
+    for (int j = 0, k_2 = (ksize * 2) + 1; j < k_2; j++) {
+        acc += y_krn[j] * rows[j][x];
+    }
+
+    return acc;
+}
+
+// Loads channel c of row y into line with ksize replicated border pixels on both sides.
+static void sepconv_line(image_t *img, int y, int c, int32_t *line, int ksize)
+{
+    line += ksize;
+
+    switch(img->bpp) {
+        case IMAGE_BPP_BINARY: {
+            uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                line[x] = IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x);
+            }
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                line[x] = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
+            }
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+                line[x] = (c == 0) ? COLOR_RGB565_TO_R5(pixel) : ((c == 1) ? COLOR_RGB565_TO_G6(pixel) : COLOR_RGB565_TO_B5(pixel));
+            }
+            break;
+        }
+        default: {
+            memset(line, 0, img->w * sizeof(int32_t));
+            break;
+        }
+    }
+
+    for (int k = 1; k <= ksize; k++) {
+        line[-k] = line[0];
+        line[img->w - 1 + k] = line[img->w - 1];
+    }
+}
+
+static size_t sepconv_size(image_t *img, const int ksize)
+{
+    int k_2 = (ksize * 2) + 1, channels = (img->bpp == IMAGE_BPP_RGB565) ? 3 : 1;
+    return (k_2 * channels * img->w * sizeof(int32_t)) // ring
+         + ((img->w + (ksize * 2)) * sizeof(int32_t)) // line
+         + (k_2 * channels * sizeof(int32_t *)) // rows
+         + 32; // fb_alloc overhead
+}
+
+// Each source row goes through the horizontal kernel once into a ring buffer of 2*ksize+1 rows
+// and the vertical kernel is run over the ring. The ring holds all the source rows the output row
+// needs so the output is written in place. Borders are clamped like imlib_morph() so the result is
+// the same as the 2D convolution with the outer product of x_krn and y_krn.
+void imlib_sepconv(image_t *img, const int ksize, const int *x_krn, const int *y_krn, const float m, const int b,
+                   bool threshold, int offset, bool invert, image_t *mask)
+{
+    int k_2 = (ksize * 2) + 1;
+    int channels = (img->bpp == IMAGE_BPP_RGB565) ? 3 : 1;
+    const int32_t m_int = (int32_t)(65536.0 * m); // m is 1/kernel_weight
+
+    int32_t *ring = fb_alloc(k_2 * channels * img->w * sizeof(int32_t), FB_ALLOC_NO_HINT);
+    int32_t *line = fb_alloc((img->w + (ksize * 2)) * sizeof(int32_t), FB_ALLOC_NO_HINT);
+    int32_t **rows = fb_alloc(k_2 * channels * sizeof(int32_t *), FB_ALLOC_NO_HINT);
+
+    for (int y = 0, yy = img->h, next = 0; y < yy; y++) {
+        // Run the horizontal pass on the source rows that are new in the window.
+        for (int last = IM_MIN(y + ksize, (img->h - 1)); next <= last; next++) {
+            for (int c = 0; c < channels; c++) {
+                sepconv_line(img, next, c, line, ksize);
+                sepconv_row(ring + (((c * k_2) + (next % k_2)) * img->w), line, img->w, ksize, x_krn);
+            }
+        }
+
+        for (int c = 0; c < channels; c++) {
+            for (int j = -ksize; j <= ksize; j++) {
+                int sy = IM_MIN(IM_MAX(y + j, 0), (img->h - 1));
+                rows[(c * k_2) + j + ksize] = ring + (((c * k_2) + (sy % k_2)) * img->w);
+            }
+        }
+
+        switch(img->bpp) {
+            case IMAGE_BPP_BINARY: {
+                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        continue; // Short circuit.
+                    }
+
+                    int32_t tmp = (sepconv_col(rows, x, ksize, y_krn) * m_int) >> 16;
+                    int pixel = tmp + b;
+                    if (pixel < 0) pixel = 0;
+                    else if (pixel > 1) pixel = 1;
+
+                    if (threshold) {
+                        if (((pixel - offset) < IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x)) ^ invert) {
+                            pixel = COLOR_BINARY_MAX;
+                        } else {
+                            pixel = COLOR_BINARY_MIN;
+                        }
+                    }
+
+                    IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr, x, pixel);
+                }
+                break;
+            }
+            case IMAGE_BPP_GRAYSCALE: {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        continue; // Short circuit.
+                    }
+
+                    int32_t tmp = (sepconv_col(rows, x, ksize, y_krn) * m_int) >> 16;
+                    int pixel = tmp + b;
+                    if (pixel > COLOR_GRAYSCALE_MAX) pixel = COLOR_GRAYSCALE_MAX;
+                    else if (pixel < 0) pixel = 0;
+
+                    if (threshold) {
+                        if (((pixel - offset) < IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) ^ invert) {
+                            pixel = COLOR_GRAYSCALE_BINARY_MAX;
+                        } else {
+                            pixel = COLOR_GRAYSCALE_BINARY_MIN;
+                        }
+                    }
+
+                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, pixel);
+                }
+                break;
+            }
+            case IMAGE_BPP_RGB565: {
+                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        continue; // Short circuit.
+                    }
+
+                    int32_t tmp, r_acc, g_acc, b_acc;
+                    tmp = (sepconv_col(rows, x, ksize, y_krn) * m_int) >> 16;
+                    r_acc = tmp + b;
+                    if (r_acc > COLOR_R5_MAX) r_acc = COLOR_R5_MAX;
+                    else if (r_acc < 0) r_acc = 0;
+                    tmp = (sepconv_col(rows + k_2, x, ksize, y_krn) * m_int) >> 16;
+                    g_acc = tmp + b;
+                    if (g_acc > COLOR_G6_MAX) g_acc = COLOR_G6_MAX;
+                    else if (g_acc < 0) g_acc = 0;
+                    tmp = (sepconv_col(rows + (k_2 * 2), x, ksize, y_krn) * m_int) >> 16;
+                    b_acc = tmp + b;
+                    if (b_acc > COLOR_B5_MAX) b_acc = COLOR_B5_MAX;
+                    else if (b_acc < 0) b_acc = 0;
+
+                    int pixel = COLOR_R5_G6_B5_TO_RGB565(r_acc, g_acc, b_acc);
+
+                    if (threshold) {
+                        if (((COLOR_RGB565_TO_Y(pixel) - offset) < COLOR_RGB565_TO_Y(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x))) ^ invert) {
+                            pixel = COLOR_RGB565_BINARY_MAX;
+                        } else {
+                            pixel = COLOR_RGB565_BINARY_MIN;
+                        }
+                    }
+
+                    IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr, x, pixel);
+                }
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    fb_free(); // rows
+    fb_free(); // line
+    fb_free(); // ring
+}
+
+static int morph_gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// Returns true if krn is the outer product of an x and a y kernel (krn[j][k] = y_krn[j] * x_krn[k]).
+// The row of the first non-zero tap divided by its gcd is x_krn, which makes y_krn integral.
+static bool morph_separable(const int ksize, const int *krn, int *x_krn, int *y_krn)
+{
+    int k_2 = (ksize * 2) + 1, n = k_2 * k_2, i = 0;
+
+    while ((i < n) && (!krn[i])) {
+        i++;
+    }
+
+    if (i == n) {
+        return false;
+    }
+
+    const int *pivot_row = krn + ((i / k_2) * k_2);
+    int pivot_col = i % k_2, g = 0;
+
+    for (int k = 0; k < k_2; k++) {
+        g = morph_gcd(g, abs(pivot_row[k]));
+    }
+
+    for (int k = 0; k < k_2; k++) {
+        x_krn[k] = pivot_row[k] / g;
+    }
+
+    for (int j = 0; j < k_2; j++) {
+        y_krn[j] = krn[(j * k_2) + pivot_col] / x_krn[pivot_col];
+    }
+
+    for (int j = 0; j < k_2; j++) {
+        for (int k = 0; k < k_2; k++) {
+            if (krn[(j * k_2) + k] != (y_krn[j] * x_krn[k])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 // http://www.fmwconcepts.com/imagemagick/digital_image_filtering.pdf
 
 void imlib_morph(image_t *img, const int ksize, const int *krn, const float m, const int b, bool threshold, int offset, bool invert, image_t *mask)
@@ -1186,8 +1586,24 @@ void imlib_morph(image_t *img, const int ksize, const int *krn, const float m, c
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
     const int32_t m_int = (int32_t)(65536.0 * m); // m is 1/kernel_weight
 
+    // Rank-1 kernels (gaussian, box, ...) are run as two 1D passes when there's memory for it.
+    if (ksize) {
+        int k_2 = (ksize * 2) + 1;
+        int *x_krn = fb_alloc(k_2 * sizeof(int) * 2, FB_ALLOC_NO_HINT);
+        int *y_krn = x_krn + k_2;
+
+        if (morph_separable(ksize, krn, x_krn, y_krn) && (fb_avail() >= sepconv_size(img, ksize))) {
+            imlib_sepconv(img, ksize, x_krn, y_krn, m, b, threshold, offset, invert, mask);
+            fb_free();
+            return;
+        }
+
+        fb_free();
+    }
+
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
             buf.data = fb_alloc(IMAGE_BINARY_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
@@ -1419,13 +1835,337 @@ static float distance(int x, int y)
     return fast_sqrtf((x * x) + (y * y));
 }
 
-void imlib_bilateral_filter(image_t *img, const int ksize, float color_sigma, float space_sigma, bool threshold, int offset, bool invert, image_t *mask)
+// Fast approximation: the range is sampled at a few levels spaced about color_sigma apart. For
+// each level the range weighted sum of the pixels and of the weights is box filtered with running
+// sums (like the mean filter), and the output interpolates between the two levels around the pixel.
+// The box radius is picked to have the same variance as the spatial gaussian, so the cost doesn't
+// depend on ksize.
+#define BILATERAL_LEVELS_MAX    (16)
+#define BILATERAL_WEIGHT_SHIFT  (10)
+
+typedef struct bilateral_levels {
+    int levels, max;
+    uint16_t *lut;              // Q10 range weight of value v for level l at [(v * levels) + l].
+    int32_t *col_w, *col_v;     // Column sums at [(x * levels) + l].
+    int32_t w_acc[BILATERAL_LEVELS_MAX], v_acc[BILATERAL_LEVELS_MAX];
+} bilateral_levels_t;
+
+static void bilateral_levels_alloc(bilateral_levels_t *bl, int w, int max, int levels, float color_sigma)
+{
+    bl->levels = levels;
+    bl->max = max;
+    bl->lut = fb_alloc((max + 1) * levels * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    bl->col_w = fb_alloc0(w * levels * sizeof(int32_t) * 2, FB_ALLOC_NO_HINT);
+    bl->col_v = bl->col_w + (w * levels);
+
+    float max_color = IM_DIV(1.0f, max);
+    for (int v = 0; v <= max; v++) {
+        for (int l = 0; l < levels; l++) {
+            float d = (v - ((l * max) / (float) (levels - 1))) * max_color;
+            bl->lut[(v * levels) + l] = fast_roundf(fast_expf((d * d) / (-2.0f * color_sigma * color_sigma))
+                                                    * (1 << BILATERAL_WEIGHT_SHIFT));
+        }
+    }
+}
+
+static void bilateral_levels_free()
+{
+    fb_free(); // col_w, col_v
+    fb_free(); // lut
+}
+
+static inline void bilateral_levels_col_add(bilateral_levels_t *bl, int x, int v)
+{
+    uint16_t *lut = bl->lut + (v * bl->levels);
+    int32_t *col_w = bl->col_w + (x * bl->levels), *col_v = bl->col_v + (x * bl->levels);
+
+    for (int l = 0; l < bl->levels; l++) {
+        col_w[l] += lut[l];
+        col_v[l] += lut[l] * v;
+    }
+}
+
+static inline void bilateral_levels_col_sub(bilateral_levels_t *bl, int x, int v)
+{
+    uint16_t *lut = bl->lut + (v * bl->levels);
+    int32_t *col_w = bl->col_w + (x * bl->levels), *col_v = bl->col_v + (x * bl->levels);
+
+    for (int l = 0; l < bl->levels; l++) {
+        col_w[l] -= lut[l];
+        col_v[l] -= lut[l] * v;
+    }
+}
+
+static void bilateral_levels_row_start(bilateral_levels_t *bl, int r, int w)
+{
+    memset(bl->w_acc, 0, sizeof(bl->w_acc));
+    memset(bl->v_acc, 0, sizeof(bl->v_acc));
+
+    for (int k = -r; k <= r; k++) {
+        int x = IM_MIN(IM_MAX(k, 0), (w - 1));
+        for (int l = 0; l < bl->levels; l++) {
+            bl->w_acc[l] += bl->col_w[(x * bl->levels) + l];
+            bl->v_acc[l] += bl->col_v[(x * bl->levels) + l];
+        }
+    }
+}
+
+static inline void bilateral_levels_slide(bilateral_levels_t *bl, int x, int r, int w)
+{
+    int x_add = IM_MIN(x + r, (w - 1)) * bl->levels, x_sub = IM_MAX(x - r - 1, 0) * bl->levels;
+
+    for (int l = 0; l < bl->levels; l++) {
+        bl->w_acc[l] += bl->col_w[x_add + l] - bl->col_w[x_sub + l];
+        bl->v_acc[l] += bl->col_v[x_add + l] - bl->col_v[x_sub + l];
+    }
+}
+
+// Q8 mean of the range weighted pixels for level l, split in two divides so nothing overflows.
+static inline uint32_t bilateral_levels_mean(bilateral_levels_t *bl, int l, int v)
 {
+    uint32_t w = bl->w_acc[l], s = bl->v_acc[l];
+
+    if (!w) {
+        return v << 8;
+    }
+
+    uint32_t q = s / w;
+    return (q << 8) + (((s - (q * w)) << 8) / w);
+}
+
+static inline int bilateral_levels_value(bilateral_levels_t *bl, int v)
+{
+    int pos = v * (bl->levels - 1);
+    int l = pos / bl->max, t = pos - (l * bl->max);
+    uint32_t j0 = bilateral_levels_mean(bl, l, v);
+
+    if (!t) {
+        return j0 >> 8;
+    }
+
+    uint32_t j1 = bilateral_levels_mean(bl, l + 1, v);
+    return ((j0 * (bl->max - t)) + (j1 * t)) / (bl->max << 8);
+}
+
+// Returns the number of range levels for color_sigma, 0 if more than the fast mode supports.
+static int bilateral_levels_count(float color_sigma)
+{
+    int levels = IM_MAX(fast_ceilf(IM_DIV(1.0f, color_sigma)) + 1, 2);
+    return (levels <= BILATERAL_LEVELS_MAX) ? levels : 0;
+}
+
+// Box radius with the same variance as the spatial gaussian cut off at ksize.
+static int bilateral_box_radius(int ksize, float space_sigma)
+{
+    float sigma = space_sigma * distance(ksize, ksize), w_acc = 0, v_acc = 0;
+
+    if (sigma <= 0) {
+        return 0;
+    }
+
+    for (int x = -ksize; x <= ksize; x++) {
+        float w = gaussian(x, sigma);
+        w_acc += w;
+        v_acc += w * x * x;
+    }
+
+    int r = fast_roundf((fast_sqrtf(1 + (12 * IM_DIV(v_acc, w_acc))) - 1) / 2);
+    return IM_MIN(IM_MAX(r, 0), IM_MIN(ksize, 40)); // Q10 kernel sums stay in 32 bits.
+}
+
+static void bilateral_fast_filter(image_t *img, const int ksize, float color_sigma, float space_sigma, int levels, bool threshold, int offset, bool invert, image_t *mask)
+{
+    int r = bilateral_box_radius(ksize, space_sigma);
+    int brows = r + 1;
+    image_t buf;
+    buf.w = img->w;
+    buf.h = brows;
+    buf.bpp = img->bpp;
+    buf.stride = 0;
+
+    switch(img->bpp) {
+        case IMAGE_BPP_GRAYSCALE: {
+            buf.data = fb_alloc(IMAGE_GRAYSCALE_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+            bilateral_levels_t bl;
+            bilateral_levels_alloc(&bl, img->w, COLOR_GRAYSCALE_MAX, levels, color_sigma);
+
+            for (int j = -r; j <= r; j++) {
+                uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    bilateral_levels_col_add(&bl, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(k_row_ptr, x));
+                }
+            }
+
+            for (int y = 0, yy = img->h; y < yy; y++) {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+                uint8_t *buf_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows));
+                bilateral_levels_row_start(&bl, r, img->w);
+
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        bilateral_levels_slide(&bl, x, r, img->w);
+                    }
+
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
+                        continue; // Short circuit.
+                    }
+
+                    int pixel = bilateral_levels_value(&bl, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
+
+                    if (threshold) {
+                        if (((pixel - offset) < IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) ^ invert) {
+                            pixel = COLOR_GRAYSCALE_BINARY_MAX;
+                        } else {
+                            pixel = COLOR_GRAYSCALE_BINARY_MIN;
+                        }
+                    }
+
+                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, pixel);
+                }
+
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MAX(y - r, 0));
+                    uint8_t *new_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_MIN(y + r + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        int old_pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x);
+                        int new_pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(new_row_ptr, x);
+                        if (old_pixel != new_pixel) {
+                            bilateral_levels_col_sub(&bl, x, old_pixel);
+                            bilateral_levels_col_add(&bl, x, new_pixel);
+                        }
+                    }
+                }
+
+                if (y >= r) { // Transfer buffer lines...
+                    memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, (y - r)),
+                           IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, ((y - r) % brows)),
+                           IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
+                }
+            }
+
+            // Copy any remaining lines from the buffer image...
+            for (int y = IM_MAX(img->h - r, 0), yy = img->h; y < yy; y++) {
+                memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y),
+                       IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows)),
+                       IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
+            }
+
+            bilateral_levels_free();
+            fb_free();
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            buf.data = fb_alloc(IMAGE_RGB565_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+            bilateral_levels_t r_bl, g_bl, b_bl;
+            bilateral_levels_alloc(&r_bl, img->w, COLOR_R5_MAX, levels, color_sigma);
+            bilateral_levels_alloc(&g_bl, img->w, COLOR_G6_MAX, levels, color_sigma);
+            bilateral_levels_alloc(&b_bl, img->w, COLOR_B5_MAX, levels, color_sigma);
+
+            for (int j = -r; j <= r; j++) {
+                uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(IM_MAX(j, 0), (img->h - 1)));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    int pixel = IMAGE_GET_RGB565_PIXEL_FAST(k_row_ptr, x);
+                    bilateral_levels_col_add(&r_bl, x, COLOR_RGB565_TO_R5(pixel));
+                    bilateral_levels_col_add(&g_bl, x, COLOR_RGB565_TO_G6(pixel));
+                    bilateral_levels_col_add(&b_bl, x, COLOR_RGB565_TO_B5(pixel));
+                }
+            }
+
+            for (int y = 0, yy = img->h; y < yy; y++) {
+                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+                uint16_t *buf_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows));
+                bilateral_levels_row_start(&r_bl, r, img->w);
+                bilateral_levels_row_start(&g_bl, r, img->w);
+                bilateral_levels_row_start(&b_bl, r, img->w);
+
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (x) {
+                        bilateral_levels_slide(&r_bl, x, r, img->w);
+                        bilateral_levels_slide(&g_bl, x, r, img->w);
+                        bilateral_levels_slide(&b_bl, x, r, img->w);
+                    }
+
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
+                        continue; // Short circuit.
+                    }
+
+                    int this_pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+                    int pixel = COLOR_R5_G6_B5_TO_RGB565(bilateral_levels_value(&r_bl, COLOR_RGB565_TO_R5(this_pixel)),
+                                                         bilateral_levels_value(&g_bl, COLOR_RGB565_TO_G6(this_pixel)),
+                                                         bilateral_levels_value(&b_bl, COLOR_RGB565_TO_B5(this_pixel)));
+
+                    if (threshold) {
+                        if (((COLOR_RGB565_TO_Y(pixel) - offset) < COLOR_RGB565_TO_Y(this_pixel)) ^ invert) {
+                            pixel = COLOR_RGB565_BINARY_MAX;
+                        } else {
+                            pixel = COLOR_RGB565_BINARY_MIN;
+                        }
+                    }
+
+                    IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, pixel);
+                }
+
+                if ((y + 1) < img->h) { // Move the column sums down before the top row is overwritten.
+                    uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MAX(y - r, 0));
+                    uint16_t *new_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_MIN(y + r + 1, (img->h - 1)));
+                    for (int x = 0, xx = img->w; x < xx; x++) {
+                        int old_pixel = IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x);
+                        int new_pixel = IMAGE_GET_RGB565_PIXEL_FAST(new_row_ptr, x);
+                        if (old_pixel != new_pixel) {
+                            bilateral_levels_col_sub(&r_bl, x, COLOR_RGB565_TO_R5(old_pixel));
+                            bilateral_levels_col_sub(&g_bl, x, COLOR_RGB565_TO_G6(old_pixel));
+                            bilateral_levels_col_sub(&b_bl, x, COLOR_RGB565_TO_B5(old_pixel));
+                            bilateral_levels_col_add(&r_bl, x, COLOR_RGB565_TO_R5(new_pixel));
+                            bilateral_levels_col_add(&g_bl, x, COLOR_RGB565_TO_G6(new_pixel));
+                            bilateral_levels_col_add(&b_bl, x, COLOR_RGB565_TO_B5(new_pixel));
+                        }
+                    }
+                }
+
+                if (y >= r) { // Transfer buffer lines...
+                    memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, (y - r)),
+                           IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, ((y - r) % brows)),
+                           IMAGE_RGB565_LINE_LEN_BYTES(img));
+                }
+            }
+
+            // Copy any remaining lines from the buffer image...
+            for (int y = IM_MAX(img->h - r, 0), yy = img->h; y < yy; y++) {
+                memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y),
+                       IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows)),
+                       IMAGE_RGB565_LINE_LEN_BYTES(img));
+            }
+
+            bilateral_levels_free();
+            bilateral_levels_free();
+            bilateral_levels_free();
+            fb_free();
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void imlib_bilateral_filter(image_t *img, const int ksize, float color_sigma, float space_sigma, bool fast, bool threshold, int offset, bool invert, image_t *mask)
+{
+    // Small color sigmas need too many levels, so they fall back to the exact filter.
+    int levels = fast ? bilateral_levels_count(color_sigma) : 0;
+
+    if (levels && ((img->bpp == IMAGE_BPP_GRAYSCALE) || (img->bpp == IMAGE_BPP_RGB565))) {
+        bilateral_fast_filter(img, ksize, color_sigma, space_sigma, levels, threshold, offset, invert, mask);
+        return;
+    }
+
     int brows = ksize + 1;
     image_t buf;
     buf.w = img->w;
     buf.h = brows;
     buf.bpp = img->bpp;
+    buf.stride = 0;
 
     switch(img->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -1812,11 +2552,13 @@ void imlib_cartoon_filter(image_t *img, float seed_threshold, float floating_thr
     mean_image.w = img->w;
     mean_image.h = img->h;
     mean_image.bpp = IMAGE_BPP_BINARY;
+    mean_image.stride = 0;
     mean_image.data = fb_alloc0(image_size(&mean_image), FB_ALLOC_NO_HINT);
 
     fill_image.w = img->w;
     fill_image.h = img->h;
     fill_image.bpp = IMAGE_BPP_BINARY;
+    fill_image.stride = 0;
     fill_image.data = fb_alloc0(image_size(&fill_image), FB_ALLOC_NO_HINT);
 
     if (mask) {
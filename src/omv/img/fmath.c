@@ -10,6 +10,12 @@
  */
 #include "fmath.h"
 #include "common.h"
+#if !defined(__ARM_FP)
+#include <math.h>
+#undef M_PI
+#undef M_PI_2
+#undef M_PI_4
+#endif
 
 #define M_PI    3.14159265f
 #define M_PI_2  1.57079632f
@@ -24,25 +30,34 @@ const float __atanf_lut[4] = {
 
 float ALWAYS_INLINE fast_sqrtf(float x)
 {
+#if defined(__ARM_FP)
     asm volatile (
             "vsqrt.f32  %[r], %[x]\n"
             : [r] "=t" (x)
             : [x] "t"  (x));
     return x;
+#else
+    return sqrtf(x);
+#endif
 }
 
 int ALWAYS_INLINE fast_floorf(float x)
 {
+#if defined(__ARM_FP)
     int i;
     asm volatile (
             "vcvt.S32.f32  %[r], %[x]\n"
             : [r] "=t" (i)
             : [x] "t"  (x));
     return i;
+#else
+    return (int) x;
+#endif
 }
 
 int ALWAYS_INLINE fast_ceilf(float x)
 {
+#if defined(__ARM_FP)
     int i;
     x += 0.9999f;
     asm volatile (
@@ -50,16 +65,23 @@ int ALWAYS_INLINE fast_ceilf(float x)
             : [r] "=t" (i)
             : [x] "t"  (x));
     return i;
+#else
+    return (int) (x + 0.9999f);
+#endif
 }
 
 int ALWAYS_INLINE fast_roundf(float x)
 {
+#if defined(__ARM_FP)
     int i;
     asm volatile (
             "vcvtr.s32.f32  %[r], %[x]\n"
             : [r] "=t" (i)
             : [x] "t"  (x));
     return i;
+#else
+    return (int) lrintf(x);
+#endif
 }
 
 #pragma GCC diagnostic push
@@ -105,11 +127,15 @@ float fast_cbrtf(float x)
 
 float ALWAYS_INLINE fast_fabsf(float x)
 {
+#if defined(__ARM_FP)
     asm volatile (
             "vabs.f32  %[r], %[x]\n"
             : [r] "=t" (x)
             : [x] "t"  (x));
     return x;
+#else
+    return fabsf(x);
+#endif
 }
 
 inline float fast_atanf(float xx)
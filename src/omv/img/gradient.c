@@ -0,0 +1,185 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Sobel gradient field.
+ */
+#include "imlib.h"
+
+// Pixels per sobel row call, the derivatives are kept on the stack.
+#define GRADIENT_CHUNK (64)
+
+// The angle and the magnitude are found without floating point math. With mn <= mx the absolute
+// derivatives, k = (mn << 8) / mx indexes the tables below:
+// - gradient_atan_table[k] is round(atan(k / 256)) in degrees. Buckets are narrower than a degree
+//   so the rounded angle is that or the next one, which is picked by comparing the ratio to
+//   gradient_atan_bound_table[a], tan(a + 0.5 degrees) in 0.32 fixed point.
+// - gradient_sec_table[k] is sqrt(1 + (k / 256)^2) in 1.15 fixed point, rounded down. It gives
+//   a magnitude at most 4 under the real one, which is then stepped up to the rounded sqrt.
+static const uint8_t gradient_atan_table[257] = {
+    0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3,
+    4, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 6, 7, 7,
+    7, 7, 8, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10,
+    11, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 13, 14, 14,
+    14, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 16, 17, 17, 17, 17,
+    17, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 20, 20, 20, 20, 20,
+    21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22, 23, 23, 23, 23, 23,
+    24, 24, 24, 24, 24, 25, 25, 25, 25, 25, 25, 26, 26, 26, 26, 26,
+    27, 27, 27, 27, 27, 27, 28, 28, 28, 28, 28, 29, 29, 29, 29, 29,
+    29, 30, 30, 30, 30, 30, 30, 31, 31, 31, 31, 31, 31, 32, 32, 32,
+    32, 32, 32, 32, 33, 33, 33, 33, 33, 33, 34, 34, 34, 34, 34, 34,
+    35, 35, 35, 35, 35, 35, 35, 36, 36, 36, 36, 36, 36, 36, 37, 37,
+    37, 37, 37, 37, 37, 38, 38, 38, 38, 38, 38, 38, 39, 39, 39, 39,
+    39, 39, 39, 39, 40, 40, 40, 40, 40, 40, 40, 41, 41, 41, 41, 41,
+    41, 41, 41, 42, 42, 42, 42, 42, 42, 42, 42, 43, 43, 43, 43, 43,
+    43, 43, 43, 44, 44, 44, 44, 44, 44, 44, 44, 44, 45, 45, 45, 45,
+    45,
+};
+static const uint32_t gradient_atan_bound_table[45] = {
+    37481612, 112467677, 187522322, 262691454, 338021257, 413558313, 489349712, 565443172,
+    641887164, 718731034, 796025137, 873820973, 952171326, 1031130419, 1110754067, 1191099848,
+    1272227274, 1354197987, 1437075955, 1520927688, 1605822471, 1691832611, 1779033704, 1867504931,
+    1957329364, 2048594314, 2141391701, 2235818458, 2331976974, 2429975580, 2529929082, 2631959345,
+    2736195936, 2842776840, 2951849241, 3063570400, 3178108618, 3295644319, 3416371249, 3540497818,
+    3668248613, 3799866078, 3935612425, 4075771780, 4220652607,
+};
+static const uint16_t gradient_sec_table[257] = {
+    32768, 32768, 32768, 32770, 32771, 32774, 32776, 32780, 32783, 32788, 32792, 32798, 32803, 32810, 32816, 32824,
+    32831, 32840, 32848, 32858, 32867, 32878, 32888, 32899, 32911, 32923, 32936, 32949, 32963, 32977, 32992, 33007,
+    33023, 33039, 33055, 33072, 33090, 33108, 33127, 33146, 33165, 33185, 33206, 33227, 33248, 33270, 33292, 33315,
+    33339, 33362, 33387, 33411, 33437, 33462, 33489, 33515, 33542, 33570, 33598, 33626, 33655, 33685, 33715, 33745,
+    33776, 33807, 33839, 33871, 33904, 33937, 33970, 34004, 34039, 34074, 34109, 34145, 34181, 34218, 34255, 34292,
+    34330, 34369, 34407, 34447, 34486, 34527, 34567, 34608, 34649, 34691, 34734, 34776, 34819, 34863, 34907, 34951,
+    34996, 35041, 35086, 35132, 35179, 35226, 35273, 35320, 35368, 35417, 35465, 35515, 35564, 35614, 35664, 35715,
+    35766, 35818, 35870, 35922, 35975, 36028, 36081, 36135, 36189, 36243, 36298, 36354, 36409, 36465, 36521, 36578,
+    36635, 36693, 36750, 36809, 36867, 36926, 36985, 37045, 37104, 37165, 37225, 37286, 37347, 37409, 37471, 37533,
+    37596, 37659, 37722, 37786, 37849, 37914, 37978, 38043, 38108, 38174, 38240, 38306, 38372, 38439, 38506, 38573,
+    38641, 38709, 38777, 38846, 38915, 38984, 39054, 39123, 39193, 39264, 39334, 39405, 39477, 39548, 39620, 39692,
+    39764, 39837, 39910, 39983, 40057, 40131, 40205, 40279, 40353, 40428, 40503, 40579, 40654, 40730, 40806, 40883,
+    40960, 41036, 41114, 41191, 41269, 41347, 41425, 41503, 41582, 41661, 41740, 41819, 41899, 41979, 42059, 42140,
+    42220, 42301, 42382, 42463, 42545, 42627, 42709, 42791, 42873, 42956, 43039, 43122, 43205, 43289, 43372, 43456,
+    43541, 43625, 43710, 43794, 43879, 43965, 44050, 44136, 44222, 44308, 44394, 44480, 44567, 44654, 44741, 44828,
+    44916, 45003, 45091, 45179, 45267, 45356, 45444, 45533, 45622, 45711, 45801, 45890, 45980, 46070, 46160, 46250,
+    46340,
+};
+
+#define SOBEL_ROW(row_ptr_0, row_ptr_1, row_ptr_2, get_pixel) \
+do { \
+    for (int i = 0; x < xx; x += x_step, i++) { \
+        int p00 = get_pixel(row_ptr_0, x - 1), p01 = get_pixel(row_ptr_0, x), p02 = get_pixel(row_ptr_0, x + 1); \
+        int p10 = get_pixel(row_ptr_1, x - 1), p12 = get_pixel(row_ptr_1, x + 1); \
+        int p20 = get_pixel(row_ptr_2, x - 1), p21 = get_pixel(row_ptr_2, x), p22 = get_pixel(row_ptr_2, x + 1); \
+        x_acc[i] = (p00 - p02) + ((p10 - p12) << 1) + (p20 - p22); \
+        y_acc[i] = (p00 - p20) + ((p01 - p21) << 1) + (p02 - p22); \
+    } \
+} while (0)
+
+#define SOBEL_BINARY_PIXEL(row_ptr, x) COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST((row_ptr), (x)))
+#define SOBEL_GRAYSCALE_PIXEL(row_ptr, x) IMAGE_GET_GRAYSCALE_PIXEL_FAST((row_ptr), (x))
+#define SOBEL_RGB565_PIXEL(row_ptr, x) COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST((row_ptr), (x)))
+
+void imlib_sobel_row(image_t *img, int y, int x, int xx, int x_step, int16_t *x_acc, int16_t *y_acc)
+{
+    switch (img->bpp) {
+        case IMAGE_BPP_BINARY: {
+            uint32_t *row_ptr_0 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y - 1);
+            uint32_t *row_ptr_1 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+            uint32_t *row_ptr_2 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y + 1);
+            SOBEL_ROW(row_ptr_0, row_ptr_1, row_ptr_2, SOBEL_BINARY_PIXEL);
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            uint8_t *row_ptr_0 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y - 1);
+            uint8_t *row_ptr_1 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+            uint8_t *row_ptr_2 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y + 1);
+            SOBEL_ROW(row_ptr_0, row_ptr_1, row_ptr_2, SOBEL_GRAYSCALE_PIXEL);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            uint16_t *row_ptr_0 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y - 1);
+            uint16_t *row_ptr_1 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+            uint16_t *row_ptr_2 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y + 1);
+            SOBEL_ROW(row_ptr_0, row_ptr_1, row_ptr_2, SOBEL_RGB565_PIXEL);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void imlib_gradient_vector(int x_acc, int y_acc, uint16_t *theta, uint16_t *magnitude)
+{
+    if (!x_acc) {
+        // Flat areas are common, skip the table lookups (90 degrees) there.
+        *theta = 90;
+        *magnitude = abs(y_acc);
+        return;
+    }
+
+    uint32_t ax = abs(x_acc), ay = abs(y_acc);
+    uint32_t mx = IM_MAX(ax, ay), mn = IM_MIN(ax, ay);
+    uint32_t k = (mn << 8) / mx;
+
+    int t = gradient_atan_table[k];
+    if ((t < 45) && ((((uint64_t) mn) << 32) >= (((uint64_t) mx) * gradient_atan_bound_table[t]))) t += 1;
+    if (ay > ax) t = 90 - t;
+    if (y_acc < 0) t = 360 - t;
+    if (x_acc < 0) t = 540 - t; // 180 - t
+    *theta = t % 360;
+
+    uint32_t n = (ax * ax) + (ay * ay);
+    uint32_t m = (mx * gradient_sec_table[k]) >> 15;
+    while ((m * (m + 1)) < n) m += 1; // round(sqrt(n))
+    *magnitude = m;
+}
+
+void imlib_gradient_row(image_t *img, rectangle_t *roi, int y, unsigned int x_stride, uint16_t *theta, uint16_t *magnitude)
+{
+    int16_t x_acc[GRADIENT_CHUNK], y_acc[GRADIENT_CHUNK];
+
+    for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1, j = 0; x < xx; ) {
+        int chunk_xx = IM_MIN(xx, x + (GRADIENT_CHUNK * x_stride));
+        imlib_sobel_row(img, y, x, chunk_xx, x_stride, x_acc, y_acc);
+
+        for (int i = 0; x < chunk_xx; x += x_stride, i++, j++) {
+            imlib_gradient_vector(x_acc[i], y_acc[i], theta + j, magnitude + j);
+        }
+    }
+}
+
+static int gradient_samples(int len, unsigned int stride)
+{
+    return (len > 2) ? ((len - 2 + stride - 1) / stride) : 0;
+}
+
+size_t imlib_gradient_size(rectangle_t *roi, unsigned int x_stride, unsigned int y_stride)
+{
+    return gradient_samples(roi->w, x_stride) * gradient_samples(roi->h, y_stride) * sizeof(uint16_t) * 2;
+}
+
+void imlib_gradient_init(gradient_t *grad, void *buf, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride)
+{
+    grad->roi = *roi;
+    grad->x_stride = x_stride;
+    grad->y_stride = y_stride;
+    grad->w = gradient_samples(roi->w, x_stride);
+    grad->h = gradient_samples(roi->h, y_stride);
+    grad->theta = buf;
+    grad->magnitude = grad->theta + (grad->w * grad->h);
+}
+
+void imlib_gradient_update(gradient_t *grad, image_t *img)
+{
+    // Rows staggered to the right sample one pixel less, their last slot stays 0.
+    memset(grad->theta, 0, grad->w * grad->h * sizeof(uint16_t) * 2);
+
+    for (int y = grad->roi.y + 1, yy = grad->roi.y + grad->roi.h - 1, i = 0; y < yy; y += grad->y_stride, i++) {
+        int offset = grad->w * i;
+        imlib_gradient_row(img, &grad->roi, y, grad->x_stride, grad->theta + offset, grad->magnitude + offset);
+    }
+}
@@ -130,7 +130,7 @@ void imlib_find_hog(image_t *src, rectangle_t *roi, int cell_size)
         }
     }
 
-    xfree(gds);
+    array_free(gds);
     fb_free();
 }
 #endif // IMLIB_ENABLE_HOG
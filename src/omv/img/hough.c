@@ -12,8 +12,16 @@
 
 #ifdef IMLIB_ENABLE_FIND_LINES
 void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin)
+                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin, gradient_t *grad)
 {
+    // Without a precomputed field the gradient is computed one row at a time.
+    uint16_t *theta_row = NULL, *magnitude_row = NULL;
+
+    if (!grad) {
+        theta_row = fb_alloc(sizeof(uint16_t) * roi->w, FB_ALLOC_NO_HINT);
+        magnitude_row = fb_alloc(sizeof(uint16_t) * roi->w, FB_ALLOC_NO_HINT);
+    }
+
     int r_diag_len, r_diag_len_div, theta_size, r_size, hough_divide = 1; // divides theta and rho accumulators
 
     for (;;) { // shrink to fit...
@@ -28,201 +36,22 @@ void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
     uint32_t *acc = fb_alloc0(sizeof(uint32_t) * theta_size * r_size, FB_ALLOC_NO_HINT);
 
-    switch (ptr->bpp) {
-        case IMAGE_BPP_BINARY: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) theta += 180;
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta]) +
-                                ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-
-                    int acc_value = acc[acc_index] + fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    acc[acc_index] = acc_value;
-                }
-            }
-            break;
-        }
-        case IMAGE_BPP_GRAYSCALE: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) theta += 180;
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta])
-                                + ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-
-                    int acc_value = acc[acc_index] + fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    acc[acc_index] = acc_value;
-                }
-            }
-            break;
+    for (int y = roi->y + 1, yy = roi->y + roi->h - 1, j = 0; y < yy; y += y_stride, j++) {
+        if (grad) {
+            theta_row = grad->theta + (grad->w * j);
+            magnitude_row = grad->magnitude + (grad->w * j);
+        } else {
+            imlib_gradient_row(ptr, roi, y, x_stride, theta_row, magnitude_row);
         }
-        case IMAGE_BPP_RGB565: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
 
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
+        for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1, i = 0; x < xx; x += x_stride, i++) {
+            int theta = theta_row[i] % 180;
+            int rho = (fast_roundf(((x - roi->x) * cos_table[theta])
+                        + ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
+            int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
 
-                    // pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) theta += 180;
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta])
-                                + ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-
-                    int acc_value = acc[acc_index] + fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    acc[acc_index] = acc_value;
-                }
-            }
-            break;
-        }
-        default: {
-            break;
+            int acc_value = acc[acc_index] + magnitude_row[i];
+            acc[acc_index] = acc_value;
         }
     }
 
@@ -256,6 +85,11 @@ void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
     fb_free(); // acc
 
+    if (!grad) {
+        fb_free(); // magnitude_row
+        fb_free(); // theta_row
+    }
+
     for (;;) { // Merge overlapping.
         bool merge_occured = false;
 
@@ -360,13 +194,13 @@ void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 // Note this function is not used anymore, see lsd.c
 void imlib_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
                               uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin,
-                              uint32_t segment_threshold)
+                              uint32_t segment_threshold, gradient_t *grad)
 {
     const unsigned int max_theta_diff = 15;
     const unsigned int max_gap_pixels = 5;
 
     list_t temp_out;
-    imlib_find_lines(&temp_out, ptr, roi, x_stride, y_stride, threshold, theta_margin, rho_margin);
+    imlib_find_lines(&temp_out, ptr, roi, x_stride, y_stride, threshold, theta_margin, rho_margin, grad);
     list_init(out, sizeof(find_lines_list_lnk_data_t));
 
     const int r_diag_len = fast_roundf(fast_sqrtf((roi->w * roi->w) + (roi->h * roi->h))) * 2;
@@ -459,204 +293,18 @@ void imlib_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsig
 #ifdef IMLIB_ENABLE_FIND_CIRCLES
 void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
                         uint32_t threshold, unsigned int x_margin, unsigned int y_margin, unsigned int r_margin,
-                        unsigned int r_min, unsigned int r_max, unsigned int r_step)
+                        unsigned int r_min, unsigned int r_max, unsigned int r_step, gradient_t *grad)
 {
-    uint16_t *theta_acc = fb_alloc0(sizeof(uint16_t) * roi->w * roi->h, FB_ALLOC_NO_HINT);
-    uint16_t *magnitude_acc = fb_alloc0(sizeof(uint16_t) * roi->w * roi->h, FB_ALLOC_NO_HINT);
-
-    switch (ptr->bpp) {
-        case IMAGE_BPP_BINARY: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) theta += 360;
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        case IMAGE_BPP_GRAYSCALE: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) theta += 360;
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        case IMAGE_BPP_RGB565: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                                         // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                                         // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) theta += 360;
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        default: {
-            break;
-        }
+    // Every radius scans the whole field, without a precomputed one it is computed once per call.
+    gradient_t grad_local;
+    void *grad_buf = NULL;
+
+    if (!grad) {
+        size_t grad_size = imlib_gradient_size(roi, x_stride, y_stride);
+        if (grad_size) grad_buf = fb_alloc(grad_size, FB_ALLOC_NO_HINT);
+        grad = &grad_local;
+        imlib_gradient_init(grad, grad_buf, roi, x_stride, y_stride);
+        imlib_gradient_update(grad, ptr);
     }
 
     // Theta Direction (% 180)
@@ -705,11 +353,13 @@ void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned in
             rsin[i] = (int16_t)roundf(r * sin_table[i]);
         }
 
-        for (int y = 0, yy = roi->h; y < yy; y++) {
-            for (int x = 0, xx = roi->w; x < xx; x++) {
-                int index = (roi->w * y) + x;
-                int theta = theta_acc[index];
-                int magnitude = magnitude_acc[index];
+        for (int j = 0, y = 1; j < grad->h; j++, y += y_stride) {
+            uint16_t *theta_row = grad->theta + (grad->w * j);
+            uint16_t *magnitude_row = grad->magnitude + (grad->w * j);
+
+            for (int i = 0, x = ((roi->y + y) % x_stride) + 1; i < grad->w; i++, x += x_stride) {
+                int theta = theta_row[i];
+                int magnitude = magnitude_row[i];
                 if (!magnitude) continue;
 
                 // We have to do the below step twice because the gradient may be pointing inside or outside the circle.
@@ -773,8 +423,9 @@ void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned in
         fb_free(); // acc
     }
 
-    fb_free(); // magnitude_acc
-    fb_free(); // theta_acc
+    if (grad_buf) {
+        fb_free(); // grad_buf
+    }
 
     for (;;) { // Merge overlapping.
         bool merge_occured = false;
@@ -227,6 +227,45 @@ void image_init(image_t *ptr, int w, int h, int bpp, void *data)
     ptr->h = h;
     ptr->bpp = bpp;
     ptr->data = data;
+    ptr->stride = 0;
+}
+
+// Makes dst a view of the roi of src which shares src's pixels. Binary rows are
+// bit packed so binary views must start on a word boundary. Returns false if the
+// roi cannot be represented as a view.
+bool image_init_view(image_t *dst, image_t *src, rectangle_t *roi)
+{
+    if ((roi->x < 0) || (roi->y < 0) || (roi->w < 1) || (roi->h < 1)
+    || ((roi->x + roi->w) > src->w) || ((roi->y + roi->h) > src->h)) {
+        return false;
+    }
+
+    switch (src->bpp) {
+        case IMAGE_BPP_BINARY: {
+            if (roi->x & UINT32_T_MASK) {
+                return false;
+            }
+            dst->data = (uint8_t *) (IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(src, roi->y) + (roi->x >> UINT32_T_SHIFT));
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            dst->data = (uint8_t *) (IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(src, roi->y) + roi->x);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            dst->data = (uint8_t *) (IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(src, roi->y) + roi->x);
+            break;
+        }
+        default: {
+            return false;
+        }
+    }
+
+    dst->stride = IMAGE_STRIDE(src);
+    dst->w = roi->w;
+    dst->h = roi->h;
+    dst->bpp = src->bpp;
+    return true;
 }
 
 void image_copy(image_t *dst, image_t *src)
@@ -234,6 +273,41 @@ void image_copy(image_t *dst, image_t *src)
     memcpy(dst, src, sizeof(image_t));
 }
 
+// Copies the pixels of src (which may be a view) into the packed buffer of dst.
+void image_pack(image_t *dst, image_t *src)
+{
+    switch (src->bpp) {
+        case IMAGE_BPP_BINARY: {
+            for (int y = 0, yy = src->h; y < yy; y++) {
+                memcpy(IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(dst, y),
+                       IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(src, y),
+                       IMAGE_BINARY_LINE_LEN_BYTES(src));
+            }
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            for (int y = 0, yy = src->h; y < yy; y++) {
+                memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(dst, y),
+                       IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(src, y),
+                       IMAGE_GRAYSCALE_LINE_LEN_BYTES(src));
+            }
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            for (int y = 0, yy = src->h; y < yy; y++) {
+                memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(dst, y),
+                       IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(src, y),
+                       IMAGE_RGB565_LINE_LEN_BYTES(src));
+            }
+            break;
+        }
+        default: {
+            memcpy(dst->data, src->data, image_size(src));
+            break;
+        }
+    }
+}
+
 size_t image_size(image_t *ptr)
 {
     if (ptr->bpp < 0) {
@@ -420,6 +494,138 @@ uint16_t imlib_yuv_to_rgb(uint8_t y, int8_t u, int8_t v)
     return COLOR_R8_G8_B8_TO_RGB565(r, g, b);
 }
 
+#ifdef IMLIB_ENABLE_LAB_LUT
+// Filling the table walks the LAB table in order which is a lot cheaper than random lookups.
+#define COLOR_THRESHOLDS_LUT_RGB565_MIN_PIXELS (16384)
+#else
+#define COLOR_THRESHOLDS_LUT_RGB565_MIN_PIXELS (65536)
+#endif
+
+// pixels is the number of lookups the caller expects to do with the set.
+void imlib_color_thresholds_lut_alloc(color_thresholds_lut_t *lut, int bpp, uint32_t pixels, uint8_t *compiled)
+{
+    lut->bpp = bpp;
+    lut->count = 0;
+    lut->set = 0;
+    lut->invert = 0;
+    lut->table = NULL;
+    lut->channels = NULL;
+    lut->compiled = (bpp == IMAGE_BPP_RGB565) ? compiled : NULL;
+
+    if (lut->compiled) {
+        return;
+    }
+
+    switch (bpp) {
+        case IMAGE_BPP_BINARY: {
+            lut->table = fb_alloc(COLOR_BINARY_MAX + 1, FB_ALLOC_NO_HINT);
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            lut->table = fb_alloc(COLOR_GRAYSCALE_MAX + 1, FB_ALLOC_NO_HINT);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            lut->channels = fb_alloc(256 * 3, FB_ALLOC_NO_HINT);
+            // Leave at least as much memory to the caller as the table uses.
+            if ((pixels >= COLOR_THRESHOLDS_LUT_RGB565_MIN_PIXELS) && (fb_avail() >= (COLOR_THRESHOLDS_LUT_RGB565_SIZE * 2))) {
+                lut->table = fb_alloc(COLOR_THRESHOLDS_LUT_RGB565_SIZE, FB_ALLOC_PREFER_SPEED);
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// Compiles up to COLOR_THRESHOLDS_LUT_MAX thresholds starting at it and returns the first
+// threshold not in the set (NULL when all thresholds are compiled).
+list_lnk_t *imlib_color_thresholds_lut_compile(color_thresholds_lut_t *lut, list_t *thresholds, list_lnk_t *it, bool invert)
+{
+    if (lut->compiled) {
+        // Sets are compiled in order so the set index picks the table.
+        lut->table = lut->compiled + (lut->set * COLOR_THRESHOLDS_LUT_RGB565_SIZE);
+        for (lut->count = 0; it && (lut->count < COLOR_THRESHOLDS_LUT_MAX); it = iterator_next(it), lut->count++);
+        lut->invert = invert ? ((1 << lut->count) - 1) : 0;
+        lut->set += 1;
+        return it;
+    }
+
+    if (lut->channels) {
+        memset(lut->channels, 0, 256 * 3);
+    } else if (lut->table) {
+        memset(lut->table, 0, (lut->bpp == IMAGE_BPP_BINARY) ? (COLOR_BINARY_MAX + 1) : (COLOR_GRAYSCALE_MAX + 1));
+    }
+
+    for (lut->count = 0; it && (lut->count < COLOR_THRESHOLDS_LUT_MAX); it = iterator_next(it), lut->count++) {
+        color_thresholds_list_lnk_data_t lnk_data;
+        iterator_get(thresholds, it, &lnk_data);
+        uint8_t bit = 1 << lut->count;
+
+        switch (lut->bpp) {
+            case IMAGE_BPP_BINARY: {
+                for (int i = COLOR_BINARY_MIN; i <= COLOR_BINARY_MAX; i++) {
+                    if (COLOR_THRESHOLD_BINARY(i, &lnk_data, invert)) lut->table[i] |= bit;
+                }
+                break;
+            }
+            case IMAGE_BPP_GRAYSCALE: {
+                for (int i = COLOR_GRAYSCALE_MIN; i <= COLOR_GRAYSCALE_MAX; i++) {
+                    if (COLOR_THRESHOLD_GRAYSCALE(i, &lnk_data, invert)) lut->table[i] |= bit;
+                }
+                break;
+            }
+            case IMAGE_BPP_RGB565: {
+                // Invert is applied after the channel masks are ANDed.
+                for (int i = 0; i < 256; i++) {
+                    if ((lnk_data.LMin <= i) && (i <= lnk_data.LMax)) lut->channels[i] |= bit;
+                    if ((lnk_data.AMin <= ((int8_t) i)) && (((int8_t) i) <= lnk_data.AMax)) lut->channels[256 + i] |= bit;
+                    if ((lnk_data.BMin <= ((int8_t) i)) && (((int8_t) i) <= lnk_data.BMax)) lut->channels[512 + i] |= bit;
+                }
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    lut->invert = invert ? ((1 << lut->count) - 1) : 0;
+
+    if ((lut->bpp == IMAGE_BPP_RGB565) && lut->table) {
+        for (int i = 0; i < COLOR_THRESHOLDS_LUT_RGB565_SIZE; i++) {
+            lut->table[i] = lut->channels[(uint8_t) COLOR_RGB565_TO_L(i)] &
+                            lut->channels[256 + (uint8_t) COLOR_RGB565_TO_A(i)] &
+                            lut->channels[512 + (uint8_t) COLOR_RGB565_TO_B(i)];
+        }
+    }
+
+    lut->set += 1;
+    return it;
+}
+
+void imlib_color_thresholds_lut_free(color_thresholds_lut_t *lut)
+{
+    if (lut->compiled) return;
+    if (lut->table) fb_free();
+    if (lut->channels) fb_free();
+}
+
+void imlib_color_thresholds_lut_build(uint8_t *tables, list_t *thresholds)
+{
+    color_thresholds_lut_t lut;
+    imlib_color_thresholds_lut_alloc(&lut, IMAGE_BPP_RGB565, 0, NULL);
+
+    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; tables += COLOR_THRESHOLDS_LUT_RGB565_SIZE) {
+        lut.table = tables;
+        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, false);
+    }
+
+    lut.table = NULL; // Not fb_alloc'd.
+    imlib_color_thresholds_lut_free(&lut);
+}
+
 void imlib_bayer_to_rgb565(image_t *img, int w, int h, int xoffs, int yoffs, uint16_t *rgbbuf)
 {
     int r, g, b;
@@ -1206,15 +1412,30 @@ void imlib_zero(image_t *img, image_t *mask, bool invert)
 #ifdef IMLIB_ENABLE_LENS_CORR
 // A simple algorithm for correcting lens distortion.
 // See http://www.tannerhelland.com/4743/simple-algorithm-correcting-lens-distortion/
+// Returns the source distance scale by integer radius from the center, in fb_alloc memory.
+static float *lens_corr_table(int w, int h, float strength, float zoom)
+{
+    float maximum_diameter = fast_sqrtf((w * w) + (h * h));
+    float lens_corr_diameter = strength / maximum_diameter;
+    zoom = 1 / zoom;
+
+    int maximum_radius = fast_ceilf(maximum_diameter / 2) + 1; // +1 inclusive of final value
+    float *precalculated_table = fb_alloc(maximum_radius * sizeof(float), FB_ALLOC_NO_HINT);
+
+    for(int i=0; i < maximum_radius; i++) {
+        float r = lens_corr_diameter * i;
+        precalculated_table[i] = (fast_atanf(r) / r) * zoom;
+    }
+
+    return precalculated_table;
+}
+
 void imlib_lens_corr(image_t *img, float strength, float zoom, float x_corr, float y_corr)
 {
     int w = img->w;
     int h = img->h;
     int halfWidth = w / 2;
     int halfHeight = h / 2;
-    float maximum_diameter = fast_sqrtf((w * w) + (h * h));
-    float lens_corr_diameter = strength / maximum_diameter;
-    zoom = 1 / zoom;
 
     // Convert percentage offset to pixels from center of image
     int x_off = w * x_corr;
@@ -1226,13 +1447,7 @@ void imlib_lens_corr(image_t *img, float strength, float zoom, float x_corr, flo
     memcpy(data, img->data, size);
     memset(img->data, 0, size);
 
-    int maximum_radius = fast_ceilf(maximum_diameter / 2) + 1; // +1 inclusive of final value
-    float *precalculated_table = fb_alloc(maximum_radius * sizeof(float), FB_ALLOC_NO_HINT);
-
-    for(int i=0; i < maximum_radius; i++) {
-        float r = lens_corr_diameter * i;
-        precalculated_table[i] = (fast_atanf(r) / r) * zoom;
-    }
+    float *precalculated_table = lens_corr_table(w, h, strength, zoom);
 
     int down_adj = halfHeight + y_off;
     int up_adj = h - 1 - halfHeight + y_off;
@@ -1402,6 +1617,66 @@ void imlib_lens_corr(image_t *img, float strength, float zoom, float x_corr, flo
     fb_free(); // precalculated_table
     fb_free(); // data
 }
+
+// Stores the source pixel of the top left quadrant grid nodes for imlib_remap(). The nodes use the
+// exact radius where imlib_lens_corr() truncates it. Returns false if the image is too large for
+// the table or the source coordinates don't fit.
+bool imlib_lens_corr_remap(remap_t *remap, void *buf, image_t *img, bool bilinear,
+                           float strength, float zoom, float x_corr, float y_corr)
+{
+    float key[REMAP_KEY_LEN] = { strength, zoom, x_corr, y_corr };
+
+    if (imlib_remap_match(remap, buf, img, bilinear, key)) {
+        return true;
+    }
+
+    if (!imlib_remap_size(img->w, img->h)) {
+        return false;
+    }
+
+    imlib_remap_init(remap, buf, img, bilinear, key);
+
+    int w = img->w;
+    int h = img->h;
+    int halfWidth = w / 2;
+    int halfHeight = h / 2;
+    int x_off = w * x_corr;
+    int y_off = h * y_corr;
+    int down_adj = halfHeight + y_off;
+    int up_adj = h - 1 - halfHeight + y_off;
+    int right_adj = halfWidth + x_off;
+    int left_adj = w - 1 - halfWidth + x_off;
+    float lens_corr_diameter = strength / fast_sqrtf((w * w) + (h * h));
+    int x_nodes = (halfWidth + REMAP_GRID - 1) / REMAP_GRID + 1;
+    int y_nodes = (halfHeight + REMAP_GRID - 1) / REMAP_GRID + 1;
+
+    remap->x_mirror = (left_adj + right_adj) * (1 << REMAP_FRAC_BITS);
+    remap->y_mirror = (down_adj + up_adj) * (1 << REMAP_FRAC_BITS);
+
+    for (int y = 0; y < y_nodes; y++) {
+        remap_point_t *p = remap->points + (y * x_nodes);
+        int newY = (y * REMAP_GRID) - halfHeight;
+
+        for (int x = 0; x < x_nodes; x++) {
+            int newX = (x * REMAP_GRID) - halfWidth;
+            float r = fast_sqrtf((newX * newX) + (newY * newY)) * lens_corr_diameter;
+            float precalculated = (r ? (fast_atanf(r) / r) : 1) / zoom;
+            int sourceY_down = (down_adj * (1 << REMAP_FRAC_BITS)) + fast_roundf(precalculated * newY * (1 << REMAP_FRAC_BITS));
+            int sourceX_right = (right_adj * (1 << REMAP_FRAC_BITS)) + fast_roundf(precalculated * newX * (1 << REMAP_FRAC_BITS));
+
+            if ((sourceY_down < INT16_MIN) || (INT16_MAX < sourceY_down)
+            || (sourceX_right < INT16_MIN) || (INT16_MAX < sourceX_right)) {
+                remap->points = NULL;
+                return false;
+            }
+
+            p[x].x = sourceX_right;
+            p[x].y = sourceY_down;
+        }
+    }
+
+    return true;
+}
 #endif //IMLIB_ENABLE_LENS_CORR
 
 ////////////////////////////////////////////////////////////////////////////////
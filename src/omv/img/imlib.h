@@ -163,6 +163,48 @@ color_thresholds_list_lnk_data_t;
     (_threshold->BMin <= _b) && (_b <= _threshold->BMax)) ^ _invert; \
 })
 
+// A set of up to 8 thresholds compiled into per pixel value bitmasks. Bit n of a mask is set
+// when the pixel passes the n-th threshold of the set (after invert), so one lookup classifies
+// a pixel against every threshold in the set. RGB565 pixels are looked up in a 64K entry table
+// when it is worth building and fb memory allows, else the L, A and B channels are looked up
+// separately (thresholds are boxes in LAB space so the channel masks can be ANDed). The RGB565
+// tables are stored without invert so that they can be compiled once for a threshold list and
+// reused across calls (see imlib_color_thresholds_lut_build()).
+#define COLOR_THRESHOLDS_LUT_MAX (8)
+#define COLOR_THRESHOLDS_LUT_RGB565_SIZE (65536)
+
+typedef struct color_thresholds_lut
+{
+    int bpp;
+    int count; // Thresholds in the set.
+    int set; // Sets compiled so far.
+    uint8_t invert; // Mask of the inverted thresholds.
+    uint8_t *table; // Mask per pixel value, NULL for RGB565 when the channel masks are used.
+    uint8_t *channels; // RGB565 only, L, A and B masks indexed by the channel value.
+    uint8_t *compiled; // RGB565 only, tables of every set built by imlib_color_thresholds_lut_build().
+}
+color_thresholds_lut_t;
+
+// compiled is NULL or the tables of the thresholds built by imlib_color_thresholds_lut_build().
+void imlib_color_thresholds_lut_alloc(color_thresholds_lut_t *lut, int bpp, uint32_t pixels, uint8_t *compiled);
+list_lnk_t *imlib_color_thresholds_lut_compile(color_thresholds_lut_t *lut, list_t *thresholds, list_lnk_t *it, bool invert);
+void imlib_color_thresholds_lut_free(color_thresholds_lut_t *lut);
+// Builds the RGB565 table of every set of thresholds into tables (one table size per set).
+void imlib_color_thresholds_lut_build(uint8_t *tables, list_t *thresholds);
+
+#define COLOR_THRESHOLDS_LUT_BINARY(lut, pixel) ((lut)->table[pixel])
+#define COLOR_THRESHOLDS_LUT_GRAYSCALE(lut, pixel) ((lut)->table[pixel])
+
+#define COLOR_THRESHOLDS_LUT_RGB565(lut, pixel) \
+({ \
+    __typeof__ (pixel) _pixel = (pixel); \
+    __typeof__ (lut) _lut = (lut); \
+    _lut->table ? (_lut->table[_pixel] ^ _lut->invert) : \
+    ((_lut->channels[(uint8_t) COLOR_RGB565_TO_L(_pixel)] & \
+      _lut->channels[256 + (uint8_t) COLOR_RGB565_TO_A(_pixel)] & \
+      _lut->channels[512 + (uint8_t) COLOR_RGB565_TO_B(_pixel)]) ^ _lut->invert); \
+})
+
 #define COLOR_BOUND_BINARY(pixel0, pixel1, threshold) \
 ({ \
     __typeof__ (pixel0) _pixel0 = (pixel0); \
@@ -382,11 +424,16 @@ typedef struct image {
         uint8_t *pixels;
         uint8_t *data;
     };
+    // Distance between rows in pixels, or 0 if rows are packed. A non-zero
+    // stride makes the image a view into a larger image (see image_init_view).
+    int stride;
 } image_t;
 
 void image_init(image_t *ptr, int w, int h, int bpp, void *data);
+bool image_init_view(image_t *dst, image_t *src, rectangle_t *roi);
 void image_copy(image_t *dst, image_t *src);
 size_t image_size(image_t *ptr);
+void image_pack(image_t *dst, image_t *src);
 bool image_get_mask_pixel(image_t *ptr, int x, int y);
 
 #define IMAGE_IS_MUTABLE(image) \
@@ -406,6 +453,17 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     (_image->bpp == IMAGE_BPP_BAYER); \
 })
 
+#define IMAGE_IS_VIEW(image) ((image)->stride != 0)
+
+// Row pitch of the pixel buffer in pixels (differs from the width for views).
+#define IMAGE_STRIDE(image) \
+({ \
+    __typeof__ (image) _image_s = (image); \
+    _image_s->stride ? _image_s->stride : _image_s->w; \
+})
+
+#define IMAGE_BINARY_STRIDE(image) ((IMAGE_STRIDE(image) + UINT32_T_MASK) >> UINT32_T_SHIFT)
+
 #define IMAGE_BINARY_LINE_LEN(image) (((image)->w + UINT32_T_MASK) >> UINT32_T_SHIFT)
 #define IMAGE_BINARY_LINE_LEN_BYTES(image) (IMAGE_BINARY_LINE_LEN(image) * sizeof(uint32_t))
 
@@ -420,7 +478,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (image) _image = (image); \
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
-    (((uint32_t *) _image->data)[(((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * _y) + (_x >> UINT32_T_SHIFT)] >> (_x & UINT32_T_MASK)) & 1; \
+    (((uint32_t *) _image->data)[(IMAGE_BINARY_STRIDE(_image) * _y) + (_x >> UINT32_T_SHIFT)] >> (_x & UINT32_T_MASK)) & 1; \
 })
 
 #define IMAGE_PUT_BINARY_PIXEL(image, x, y, v) \
@@ -429,7 +487,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
     __typeof__ (v) _v = (v); \
-    size_t _i = (((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * _y) + (_x >> UINT32_T_SHIFT); \
+    size_t _i = (IMAGE_BINARY_STRIDE(_image) * _y) + (_x >> UINT32_T_SHIFT); \
     size_t _j = _x & UINT32_T_MASK; \
     ((uint32_t *) _image->data)[_i] = (((uint32_t *) _image->data)[_i] & (~(1 << _j))) | ((_v & 1) << _j); \
 })
@@ -439,7 +497,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (image) _image = (image); \
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
-    ((uint32_t *) _image->data)[(((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * _y) + (_x >> UINT32_T_SHIFT)] &= ~(1 << (_x & UINT32_T_MASK)); \
+    ((uint32_t *) _image->data)[(IMAGE_BINARY_STRIDE(_image) * _y) + (_x >> UINT32_T_SHIFT)] &= ~(1 << (_x & UINT32_T_MASK)); \
 })
 
 #define IMAGE_SET_BINARY_PIXEL(image, x, y) \
@@ -447,7 +505,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (image) _image = (image); \
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
-    ((uint32_t *) _image->data)[(((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * _y) + (_x >> UINT32_T_SHIFT)] |= 1 << (_x & UINT32_T_MASK); \
+    ((uint32_t *) _image->data)[(IMAGE_BINARY_STRIDE(_image) * _y) + (_x >> UINT32_T_SHIFT)] |= 1 << (_x & UINT32_T_MASK); \
 })
 
 #define IMAGE_GET_GRAYSCALE_PIXEL(image, x, y) \
@@ -455,7 +513,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (image) _image = (image); \
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
-    ((uint8_t *) _image->data)[(_image->w * _y) + _x]; \
+    ((uint8_t *) _image->data)[(IMAGE_STRIDE(_image) * _y) + _x]; \
 })
 
 #define IMAGE_PUT_GRAYSCALE_PIXEL(image, x, y, v) \
@@ -464,7 +522,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
     __typeof__ (v) _v = (v); \
-    ((uint8_t *) _image->data)[(_image->w * _y) + _x] = _v; \
+    ((uint8_t *) _image->data)[(IMAGE_STRIDE(_image) * _y) + _x] = _v; \
 })
 
 #define IMAGE_GET_RGB565_PIXEL(image, x, y) \
@@ -472,7 +530,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (image) _image = (image); \
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
-    ((uint16_t *) _image->data)[(_image->w * _y) + _x]; \
+    ((uint16_t *) _image->data)[(IMAGE_STRIDE(_image) * _y) + _x]; \
 })
 
 #define IMAGE_PUT_RGB565_PIXEL(image, x, y, v) \
@@ -481,7 +539,7 @@ bool image_get_mask_pixel(image_t *ptr, int x, int y);
     __typeof__ (x) _x = (x); \
     __typeof__ (y) _y = (y); \
     __typeof__ (v) _v = (v); \
-    ((uint16_t *) _image->data)[(_image->w * _y) + _x] = _v; \
+    ((uint16_t *) _image->data)[(IMAGE_STRIDE(_image) * _y) + _x] = _v; \
 })
 
 #ifdef __arm__
@@ -550,14 +608,14 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint32_t *) _image->data) + (((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * _y); \
+    ((uint32_t *) _image->data) + (IMAGE_BINARY_STRIDE(_image) * _y); \
 })
 
 #define IMAGE_INC_BINARY_PIXEL_ROW_PTR(row_ptr, image) \
 ({ \
     __typeof__ (row_ptr) _row_ptr = (row_ptr); \
     __typeof__ (image) _image = (image); \
-    _row_ptr + ((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT); \
+    _row_ptr + IMAGE_BINARY_STRIDE(_image); \
 })
 
 #define RGB565_TO_Y_FAST(pixel) \
@@ -598,14 +656,14 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint8_t *) _image->data) + (_image->w * _y); \
+    ((uint8_t *) _image->data) + (IMAGE_STRIDE(_image) * _y); \
 })
 
 #define IMAGE_INC_GRAYSCALE_PIXEL_ROW_PTR(row_ptr, image) \
 ({ \
     __typeof__ (row_ptr) _row_ptr = (row_ptr); \
     __typeof__ (image) _image = (image); \
-    row_ptr + _image->w; \
+    row_ptr + IMAGE_STRIDE(_image); \
 })
 
 #define IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x) \
@@ -627,14 +685,14 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint16_t *) _image->data) + (_image->w * _y); \
+    ((uint16_t *) _image->data) + (IMAGE_STRIDE(_image) * _y); \
 })
 
 #define IMAGE_INC_RGB565_PIXEL_ROW_PTR(row_ptr, image) \
 ({ \
     __typeof__ (row_ptr) _row_ptr = (row_ptr); \
     __typeof__ (image) _image = (image); \
-    row_ptr + _image->w; \
+    row_ptr + IMAGE_STRIDE(_image); \
 })
 
 #define IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x) \
@@ -656,7 +714,7 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint32_t *) _image->data) + (((_image->w + UINT32_T_MASK) >> UINT32_T_SHIFT) * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
+    ((uint32_t *) _image->data) + (IMAGE_BINARY_STRIDE(_image) * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
 })
 
 #define IMAGE_GET_SCALED_BINARY_PIXEL_FAST(row_ptr, x) IMAGE_GET_BINARY_PIXEL_FAST((row_ptr), ((size_t) ((IMAGE_X_RATIO * ((x) - IMAGE_X_TARGET_OFFSET)) + 0.5)) + IMAGE_X_SOURCE_OFFSET)
@@ -665,7 +723,7 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint8_t *) _image->data) + (_image->w * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
+    ((uint8_t *) _image->data) + (IMAGE_STRIDE(_image) * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
 })
 
 #define IMAGE_GET_SCALED_GRAYSCALE_PIXEL_FAST(row_ptr, x) IMAGE_GET_GRAYSCALE_PIXEL_FAST((row_ptr), ((size_t) ((IMAGE_X_RATIO * ((x) - IMAGE_X_TARGET_OFFSET)) + 0.5)) + IMAGE_X_SOURCE_OFFSET)
@@ -674,7 +732,7 @@ float IMAGE_Y_RATIO = ((float) _source_rect->s.h) / ((float) _target_rect->s.h);
 ({ \
     __typeof__ (image) _image = (image); \
     __typeof__ (y) _y = (y); \
-    ((uint16_t *) _image->data) + (_image->w * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
+    ((uint16_t *) _image->data) + (IMAGE_STRIDE(_image) * (((size_t) ((IMAGE_Y_RATIO * (_y - IMAGE_Y_TARGET_OFFSET)) + 0.5)) + IMAGE_Y_SOURCE_OFFSET)); \
 })
 
 #define IMAGE_GET_SCALED_RGB565_PIXEL_FAST(row_ptr, x) IMAGE_GET_RGB565_PIXEL_FAST((row_ptr), ((size_t) ((IMAGE_X_RATIO * ((x) - IMAGE_X_TARGET_OFFSET)) + 0.5)) + IMAGE_X_SOURCE_OFFSET)
@@ -814,27 +872,27 @@ extern const int kernel_high_pass_3[9];
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_GET_RAW_PIXEL(img, x, y) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_GET_RAW_PIXEL_CHECK_BOUNDS_X(img, x, y) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
        _x = (_x < 0) ? 0 : (_x >= img->w) ? (img->w -1): _x; \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_GET_RAW_PIXEL_CHECK_BOUNDS_Y(img, x, y) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
        _y = (_y < 0) ? 0 : (_y >= img->h) ? (img->h -1): _y; \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_GET_RAW_PIXEL_CHECK_BOUNDS_XY(img, x, y) \
     ({ __typeof__ (img) _img = (img); \
@@ -842,27 +900,27 @@ extern const int kernel_high_pass_3[9];
        __typeof__ (y) _y = (y); \
        _x = (_x < 0) ? 0 : (_x >= img->w) ? (img->w -1): _x; \
        _y = (_y < 0) ? 0 : (_y >= img->h) ? (img->h -1): _y; \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_GET_RGB565_PIXEL(img, x, y) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
-       ((uint16_t*)_img->pixels)[(_y*_img->w)+_x]; })
+       ((uint16_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]; })
 
 #define IM_SET_GS_PIXEL(img, x, y, p) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
        __typeof__ (p) _p = (p); \
-       ((uint8_t*)_img->pixels)[(_y*_img->w)+_x]=_p; })
+       ((uint8_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]=_p; })
 
 #define IM_SET_RGB565_PIXEL(img, x, y, p) \
     ({ __typeof__ (img) _img = (img); \
        __typeof__ (x) _x = (x); \
        __typeof__ (y) _y = (y); \
        __typeof__ (p) _p = (p); \
-       ((uint16_t*)_img->pixels)[(_y*_img->w)+_x]=_p; })
+       ((uint16_t*)_img->pixels)[(_y*IMAGE_STRIDE(_img))+_x]=_p; })
 
 #define IM_EQUAL(img0, img1) \
     ({ __typeof__ (img0) _img0 = (img0); \
@@ -870,7 +928,7 @@ extern const int kernel_high_pass_3[9];
        (_img0->w==_img1->w)&&(_img0->h==_img1->h)&&(_img0->bpp==_img1->bpp); })
 
 #define IM_TO_GS_PIXEL(img, x, y)    \
-    (img->bpp == 1 ? img->pixels[((y)*img->w)+(x)] : (COLOR_RGB565_TO_Y(((uint16_t*)img->pixels)[((y)*img->w)+(x)]) + 128))
+    (img->bpp == 1 ? img->pixels[((y)*IMAGE_STRIDE(img))+(x)] : (COLOR_RGB565_TO_Y(((uint16_t*)img->pixels)[((y)*IMAGE_STRIDE(img))+(x)]) + 128))
 
 typedef struct simple_color {
     uint8_t G;          // Gray
@@ -930,6 +988,33 @@ typedef struct kp {
     uint8_t desc[32];
 } kp_t;
 
+/* Keypoint descriptor index, each table buckets the keypoints by one byte of their descriptor. */
+#define ORB_INDEX_TABLES (16)
+
+typedef struct orb_index {
+    array_t *kpts;      // Indexed keypoints, or NULL if they are in block.
+    kp_t *block;
+    int size;
+    uint16_t *offsets;  // ORB_INDEX_TABLES tables of 257 bucket offsets.
+    uint16_t *indices;  // ORB_INDEX_TABLES tables of size keypoint indices in bucket order.
+    uint16_t *stamps;   // Last query that visited each keypoint.
+    uint16_t query;
+} orb_index_t;
+
+/* Keypoint database, many models searched through one index. Each keypoint takes 78 bytes of heap
+   with its index, plus 8KB of index tables, so the free heap bounds the database: about 2400 keypoints
+   (16 models of 150 keypoints) with 190KB free on OPENMV4/4P, and about 280 with 30KB free on OPENMV3. */
+#define ORB_DB_MAX_KEYPOINTS (UINT16_MAX) // The index stores 16-bit keypoint numbers.
+
+typedef struct orb_db {
+    kp_t *kpts;         // Keypoints of all the models in one block, model after model.
+    int size;           // Number of keypoints.
+    int count;          // Number of models.
+    uint16_t *starts;   // First keypoint of each model followed by the total number of keypoints.
+    bool indexed;       // Cleared when models are added, the index is rebuilt on the next match.
+    orb_index_t index;
+} orb_db_t;
+
 typedef struct size {
     int w;
     int h;
@@ -1001,6 +1086,7 @@ typedef void (*flood_fill_call_back_t)(image_t *, int, int, int, void *);
 typedef enum descriptor_type {
     DESC_LBP,
     DESC_ORB,
+    DESC_ORB_DB,
 } descriptor_t;
 
 typedef enum edge_detector_type {
@@ -1019,6 +1105,64 @@ typedef enum  jpeg_subsample {
     JPEG_SUBSAMPLE_2x2 = 0x22,  // 2x2 chroma subsampling
 } jpeg_subsample_t;
 
+typedef struct jpeg_buf {
+    int idx;
+    int length;
+    uint8_t *buf;
+    int bitc, bitb;
+    bool realloc;
+    bool overflow;
+} jpeg_buf_t;
+
+// Size of the line buffer needed to stream lines of width w into the JPEG encoder.
+#define JPEG_STREAM_LINES_SIZE(w, bpp)  ((w) * (bpp) * 16)
+
+typedef struct jpeg_stream {
+    jpeg_buf_t jpeg_buf;
+    jpeg_subsample_t subsample;
+    int dc[3];      // DC predictors (Y, U, V).
+    int y, h;       // Lines received and image height.
+    int mcu_h;      // Lines per MCU row.
+    image_t lines;  // Lines of the current MCU row, lines.h is the number buffered.
+} jpeg_stream_t;
+
+// Max number of RIFF segments (AVI + AVIX) in an MJPEG file, each holds up to 1GB of frames.
+#define MJPEG_MAX_SEGMENTS      (32)
+// Number of index entries buffered in RAM before being written to the index file.
+#define MJPEG_INDEX_BUF_SIZE    (64)
+// Frames are written through a buffer that ends on a multiple of its size in the file, so the file
+// is written in whole sectors. Must be a multiple of 512.
+#define MJPEG_WRITE_BUF_SIZE    (2048)
+
+typedef struct mjpeg {
+    FIL fp;                 // AVI file.
+    FIL idx_fp;             // Temporary index file, holds the offset and size of each frame.
+    uint32_t frames;        // Total number of frames.
+    uint32_t bytes;         // Total size of all frames.
+    uint32_t max_size;      // Largest frame size.
+    uint32_t riff_offset;   // Offset of the current RIFF chunk.
+    uint32_t movi_offset;   // Offset of the current movi list type.
+    uint32_t segment_start; // First frame of the current RIFF chunk.
+    uint32_t segments;      // Number of finished RIFF chunks.
+    uint32_t segment_0_frames;
+    uint32_t idx_count;
+    uint32_t idx_buf[MJPEG_INDEX_BUF_SIZE * 2];
+    uint32_t buf_count;     // Bytes buffered after the file position.
+    uint8_t buf[MJPEG_WRITE_BUF_SIZE];
+} mjpeg_t;
+
+typedef struct mjpeg_reader {
+    FIL fp;
+    uint32_t width, height;
+    uint32_t micros;        // Microseconds per frame.
+    uint32_t frames;
+    uint32_t segments;      // OpenDML super index entries.
+    uint32_t ix_offset[MJPEG_MAX_SEGMENTS];
+    uint32_t ix_frames[MJPEG_MAX_SEGMENTS];
+    uint32_t idx1_offset;   // Legacy index, only used without an OpenDML index.
+    uint32_t idx1_base;
+} mjpeg_reader_t;
+
 typedef enum corner_detector_type {
     CORNER_FAST,
     CORNER_AGAST
@@ -1074,6 +1218,58 @@ typedef struct find_circles_list_lnk_data {
     uint16_t r, magnitude;
 } find_circles_list_lnk_data_t;
 
+// Remap tables for the lens correction, built once for a set of arguments and applied to every
+// frame. key holds the arguments the table was built from. The table holds the source coordinate
+// of the top left quadrant on a grid with one node every REMAP_GRID pixels, which is interpolated
+// in between and mirrored to the other quadrants. Coordinates are fixed point with REMAP_FRAC_BITS
+// fractional bits. The grid of a QVGA image takes 1.3KB and is within 0.11 pixels of the exact
+// correction. The output is not bit-identical to imlib_lens_corr(), which truncates the radius:
+// about 5% of the pixels are taken from a source pixel next to the one it picks (see the
+// lens_corr_remap_diff bench).
+#define REMAP_FRAC_BITS     (5)
+#define REMAP_GRID_SHIFT    (3)
+#define REMAP_GRID          (1 << REMAP_GRID_SHIFT)
+#define REMAP_MAX_SIZE      (1 << (15 - REMAP_FRAC_BITS))
+#define REMAP_KEY_LEN       (4)
+
+typedef struct remap_point {
+    int16_t x, y;
+} remap_point_t;
+
+typedef struct remap {
+    int w, h;
+    bool bilinear;
+    float key[REMAP_KEY_LEN];
+    int x_mirror, y_mirror; // A mirrored coordinate is mirror - coordinate.
+    remap_point_t *points;
+} remap_t;
+
+// Sobel gradient field of a region of an image, sampled like the Hough transforms do: every
+// x_stride pixels (staggered by row) of every y_stride rows, skipping the region border. Only
+// the samples are stored, sample i of row j is the pixel at:
+//   y = roi.y + 1 + (j * y_stride)
+//   x = roi.x + (y % x_stride) + 1 + (i * x_stride)
+// theta is in degrees [0:360) and magnitude is rounded, both are 0 past the end of a row.
+typedef struct gradient {
+    rectangle_t roi;
+    unsigned int x_stride, y_stride;
+    int w, h; // Samples per row and rows.
+    uint16_t *theta, *magnitude; // w * h each.
+} gradient_t;
+
+// Spectra of the previous frame kept between phase correlations of consecutive frames, so each
+// frame is only transformed once. spectrum is the fft of the ROI (of its log-polar image with
+// logpolar) and rs_spectrum the fft of the log-polar magnitude spectrum used by
+// fix_rotation_scale. The buffers are heap memory of size floats each, reallocated when the ROI
+// size or the mode changes and the tracker restarts.
+typedef struct phasecorrelate_tracker {
+    int w, h;
+    bool logpolar, fix_rotation_scale;
+    bool valid; // Cleared to restart from the next frame.
+    int size;
+    float *spectrum, *rs_spectrum;
+} phasecorrelate_tracker_t;
+
 typedef struct find_rects_list_lnk_data {
     point_t corners[4];
     rectangle_t rect;
@@ -1149,6 +1345,7 @@ typedef struct find_barcodes_list_lnk_data {
 
 typedef enum image_hint {
     IMAGE_HINT_BILINEAR = 1,
+    IMAGE_HINT_AREA = 2,
     IMAGE_HINT_CENTER = 128
 } image_hint_t;
 
@@ -1181,20 +1378,33 @@ void jpeg_read_geometry(FIL *fp, image_t *img, const char *path, jpg_read_settin
 void jpeg_read_pixels(FIL *fp, image_t *img);
 void jpeg_read(image_t *img, const char *path);
 void jpeg_write(image_t *img, const char *path, int quality);
+void jpeg_decompress(image_t *src, image_t *dst);
+// Software encoder only. Lines are written to jpeg_stream_get_line() and committed with
+// jpeg_stream_put_line() which encodes every complete MCU row. Both return true on overflow.
+void jpeg_stream_init(jpeg_stream_t *stream, int w, int h, int bpp, int quality, image_t *dst, uint8_t *lines);
+uint8_t *jpeg_stream_get_line(jpeg_stream_t *stream);
+bool jpeg_stream_put_line(jpeg_stream_t *stream);
+bool jpeg_stream_end(jpeg_stream_t *stream, image_t *dst);
 bool imlib_read_geometry(FIL *fp, image_t *img, const char *path, img_read_settings_t *rs);
 void imlib_image_operation(image_t *img, const char *path, image_t *other, int scalar, line_op_t op, void *data);
 void imlib_load_image(image_t *img, const char *path);
 void imlib_save_image(image_t *img, const char *path, rectangle_t *roi, int quality);
 
+/* Lossless compression functions */
+uint32_t lossless_compress(image_t *src, uint8_t *dst, uint32_t size);
+bool lossless_decompress(const uint8_t *src, uint32_t size, image_t *dst);
+
 /* GIF functions */
 void gif_open(FIL *fp, int width, int height, bool color, bool loop);
 void gif_add_frame(FIL *fp, image_t *img, uint16_t delay);
 void gif_close(FIL *fp);
 
 /* MJPEG functions */
-void mjpeg_open(FIL *fp, int width, int height);
-void mjpeg_add_frame(FIL *fp, uint32_t *frames, uint32_t *bytes, image_t *img, int quality);
-void mjpeg_close(FIL *fp, uint32_t *frames, uint32_t *bytes, float fps);
+void mjpeg_open(mjpeg_t *mjpeg, int width, int height);
+void mjpeg_add_frame(mjpeg_t *mjpeg, image_t *img, int quality);
+void mjpeg_close(mjpeg_t *mjpeg, float fps);
+void mjpeg_read_open(mjpeg_reader_t *reader);
+uint32_t mjpeg_seek_frame(mjpeg_reader_t *reader, uint32_t n);
 
 /* Point functions */
 point_t *point_alloc(int16_t x, int16_t y);
@@ -1256,10 +1466,18 @@ void agast_detect(image_t *image, array_t *keypoints, int threshold, rectangle_t
 /* ORB descriptor */
 array_t *orb_find_keypoints(image_t *image, bool normalized, int threshold,
         float scale_factor, int max_keypoints, corner_detector_t corner_detector, rectangle_t *roi);
-int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshold, rectangle_t *r, point_t *c, int *angle);
+size_t orb_index_size(array_t *kpts);
+void orb_index_init(orb_index_t *index, void *buf, array_t *kpts);
+int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshold, rectangle_t *r, point_t *c, int *angle,
+        orb_index_t *index1, orb_index_t *index2);
 int orb_filter_keypoints(array_t *kpts, rectangle_t *r, point_t *c);
 int orb_save_descriptor(FIL *fp, array_t *kpts);
 int orb_load_descriptor(FIL *fp, array_t *kpts);
+void orb_db_init(orb_db_t *db);
+int orb_db_add(orb_db_t *db, array_t *kpts);
+int orb_db_match(orb_db_t *db, array_t *kpts, int threshold, int *counts);
+int orb_db_save(FIL *fp, orb_db_t *db);
+int orb_db_load(FIL *fp, orb_db_t *db);
 float orb_cluster_dist(int cx, int cy, void *kp);
 
 /* LBP Operator */
@@ -1303,7 +1521,7 @@ void imlib_flood_fill(image_t *img, int x, int y,
                       float seed_threshold, float floating_threshold,
                       int c, bool invert, bool clear_background, image_t *mask);
 // Binary Functions
-void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, bool zero, image_t *mask);
+void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, uint8_t *compiled, bool zero, image_t *mask);
 void imlib_invert(image_t *img);
 void imlib_b_and(image_t *img, const char *path, image_t *other, int scalar, image_t *mask);
 void imlib_b_nand(image_t *img, const char *path, image_t *other, int scalar, image_t *mask);
@@ -1337,7 +1555,9 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
 void imlib_mode_filter(image_t *img, const int ksize, bool threshold, int offset, bool invert, image_t *mask);
 void imlib_midpoint_filter(image_t *img, const int ksize, float bias, bool threshold, int offset, bool invert, image_t *mask);
 void imlib_morph(image_t *img, const int ksize, const int *krn, const float m, const int b, bool threshold, int offset, bool invert, image_t *mask);
-void imlib_bilateral_filter(image_t *img, const int ksize, float color_sigma, float space_sigma, bool threshold, int offset, bool invert, image_t *mask);
+void imlib_sepconv(image_t *img, const int ksize, const int *x_krn, const int *y_krn, const float m, const int b,
+                   bool threshold, int offset, bool invert, image_t *mask);
+void imlib_bilateral_filter(image_t *img, const int ksize, float color_sigma, float space_sigma, bool fast, bool threshold, int offset, bool invert, image_t *mask);
 void imlib_cartoon_filter(image_t *img, float seed_threshold, float floating_threshold, image_t *mask);
 // Image Correction
 void imlib_logpolar_int(image_t *dst, image_t *src, rectangle_t *roi, bool linear, bool reverse); // helper/internal
@@ -1350,9 +1570,15 @@ void imlib_lens_corr(image_t *img, float strength, float zoom, float x_corr, flo
 void imlib_rotation_corr(image_t *img, float x_rotation, float y_rotation,
                          float z_rotation, float x_translation, float y_translation,
                          float zoom, float fov, float *corners);
+size_t imlib_remap_size(int w, int h);
+void imlib_remap_init(remap_t *remap, void *buf, image_t *img, bool bilinear, const float *key); // helper/internal
+bool imlib_remap_match(remap_t *remap, void *buf, image_t *img, bool bilinear, const float *key); // helper/internal
+void imlib_remap(image_t *img, remap_t *remap);
+bool imlib_lens_corr_remap(remap_t *remap, void *buf, image_t *img, bool bilinear,
+                           float strength, float zoom, float x_corr, float y_corr);
 // Statistics
 void imlib_get_similarity(image_t *img, const char *path, image_t *other, int scalar, float *avg, float *std, float *min, float *max);
-void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, image_t *other);
+void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, uint8_t *compiled, image_t *other);
 void imlib_get_percentile(percentile_t *out, image_bpp_t bpp, histogram_t *ptr, float percentile);
 void imlib_get_threshold(threshold_t *out, image_bpp_t bpp, histogram_t *ptr);
 void imlib_get_statistics(statistics_t *out, image_bpp_t bpp, histogram_t *ptr);
@@ -1360,34 +1586,46 @@ bool imlib_get_regression(find_lines_list_lnk_data_t *out, image_t *ptr, rectang
                           list_t *thresholds, bool invert, unsigned int area_threshold, unsigned int pixels_threshold, bool robust);
 // Color Tracking
 void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      list_t *thresholds, bool invert, unsigned int area_threshold, unsigned int pixels_threshold,
+                      list_t *thresholds, bool invert, uint8_t *compiled, unsigned int area_threshold, unsigned int pixels_threshold,
                       bool merge, int margin,
                       bool (*threshold_cb)(void*,find_blobs_list_lnk_data_t*), void *threshold_cb_arg,
                       bool (*merge_cb)(void*,find_blobs_list_lnk_data_t*,find_blobs_list_lnk_data_t*), void *merge_cb_arg,
                       unsigned int x_hist_bins_max, unsigned int y_hist_bins_max);
+// Gradient
+void imlib_sobel_row(image_t *img, int y, int x, int xx, int x_step, int16_t *x_acc, int16_t *y_acc);
+void imlib_gradient_vector(int x_acc, int y_acc, uint16_t *theta, uint16_t *magnitude);
+void imlib_gradient_row(image_t *img, rectangle_t *roi, int y, unsigned int x_stride, uint16_t *theta, uint16_t *magnitude);
+size_t imlib_gradient_size(rectangle_t *roi, unsigned int x_stride, unsigned int y_stride);
+void imlib_gradient_init(gradient_t *grad, void *buf, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride);
+void imlib_gradient_update(gradient_t *grad, image_t *img);
+// Warp/Resize, transform is a row-major 3x3 homography from destination to source pixels and dst must not overlap src.
+void imlib_warp(image_t *dst, image_t *src, const float *transform, image_hint_t hint);
+void imlib_resize(image_t *dst, image_t *src, rectangle_t *roi, image_hint_t hint);
 // Shape Detection
 size_t trace_line(image_t *ptr, line_t *l, int *theta_buffer, uint32_t *mag_buffer, point_t *point_buffer); // helper/internal
 void merge_alot(list_t *out, int threshold, int theta_threshold); // helper/internal
 void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin);
+                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin, gradient_t *grad);
 void imlib_lsd_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int merge_distance, unsigned int max_theta_diff);
 void imlib_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
                               uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin,
-                              uint32_t segment_threshold);
+                              uint32_t segment_threshold, gradient_t *grad);
 void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
                         uint32_t threshold, unsigned int x_margin, unsigned int y_margin, unsigned int r_margin,
-                        unsigned int r_min, unsigned int r_max, unsigned int r_step);
+                        unsigned int r_min, unsigned int r_max, unsigned int r_step, gradient_t *grad);
 void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi,
                       uint32_t threshold);
 // 1/2D Bar Codes
 void imlib_find_qrcodes(list_t *out, image_t *ptr, rectangle_t *roi);
 void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_families_t families,
-                          float fx, float fy, float cx, float cy);
+                          float fx, float fy, float cx, float cy, int max_hamming, int decimate);
 void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int effort);
 void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi);
 // Template Matching
 void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, rectangle_t *roi1, bool logpolar, bool fix_rotation_scale,
                           float *x_translation, float *y_translation, float *rotation, float *scale, float *response);
+void imlib_phasecorrelate_tracker(image_t *img, rectangle_t *roi, phasecorrelate_tracker_t *tracker, bool logpolar, bool fix_rotation_scale,
+                                  float *x_translation, float *y_translation, float *rotation, float *scale, float *response);
 
 array_t *imlib_selective_search(image_t *src, float t, int min_size, float a1, float a2, float a3);
 #endif //__IMLIB_H__
@@ -8,7 +8,8 @@
  *
  * Minimalistic JPEG baseline encoder.
  * Ported from public domain JPEG writer by Jon Olick - http://jonolick.com
- * DCT implementation is based on Arai, Agui, and Nakajima's algorithm for scaled DCT.
+ * The software DCT is an even/odd decomposed integer DCT using dual 16-bit MACs, followed
+ * by a reciprocal multiply quantizer.
  */
 #include <stdio.h>
 #include STM32_HAL_H
@@ -388,25 +389,25 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
 
 #else
 // Software JPEG implementation.
-#define FIX_0_382683433  ((int32_t)   98)
-#define FIX_0_541196100  ((int32_t)  139)
-#define FIX_0_707106781  ((int32_t)  181)
-#define FIX_1_306562965  ((int32_t)  334)
-
-#define DESCALE(x, y)   (x>>y)
-#define MULTIPLY(x, y)  DESCALE((x) * (y), 8)
-
-typedef struct {
-    int idx;
-    int length;
-    uint8_t *buf;
-    int bitc, bitb;
-    bool realloc;
-    bool overflow;
-} jpeg_buf_t;
+
+// cos(k * pi / 16) in Q13, packed in pairs for the dual 16-bit multiplies.
+#define FIX_C1  (8035)
+#define FIX_C2  (7568)
+#define FIX_C3  (6811)
+#define FIX_C4  (5793)
+#define FIX_C5  (4551)
+#define FIX_C6  (3135)
+#define FIX_C7  (1598)
+#define FIX_BITS        (13)
+#define PASS1_BITS      (2)
+#define PACK(a, b)      ((((uint32_t) (a)) & 0xFFFF) | (((uint32_t) (b)) << 16))
+
+// Quantizer reciprocals are 2^QUANT_BITS / divisor. With |coefficient| < 2^15 and
+// divisors >= 16 the products fit in 32 bits and the rounding error stays below 1/64.
+#define QUANT_BITS      (20)
 
 // Quantization tables
-static float fdtbl_Y[64], fdtbl_UV[64];
+static uint32_t fdtbl_Y[64], fdtbl_UV[64];
 static uint8_t YTable[64], UVTable[64];
 
 static const uint8_t s_jpeg_ZigZag[] = {
@@ -442,10 +443,6 @@ static const uint8_t UVQT[] = {
     99,99,99,99,99,99,99,99
 };
 
-static const float aasf[] = {
-    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
-    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
-};
 
 
 static const uint8_t std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
@@ -605,106 +602,61 @@ static void jpeg_calcBits(int val, uint16_t bits[2]) {
     bits[0] = val & ((1<<bits[1])-1);
 }
 
-static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int DC, const uint16_t (*HTDC)[2], const uint16_t (*HTAC)[2])
+// One 8-point DCT with the even/odd decomposition done two lanes at a time. x01..x67 hold
+// the input pairs (x0, x1), (x2, x3), (x4, x5) and (x6, x7) and out[k * stride] receives
+// X(k) = C(k) * sum(x(n) * cos((2n + 1) * k * pi / 16)) scaled by 2^FIX_BITS >> shift.
+static inline void jpeg_fdct_1d(uint32_t x01, uint32_t x23, uint32_t x45, uint32_t x67, int16_t *out, int stride, int shift)
 {
-    int DU[64];
+    const int round = 1 << (shift - 1);
+    x67 = __ROR(x67, 16); // (x7, x6)
+    x45 = __ROR(x45, 16); // (x5, x4)
+
+    uint32_t s01 = __SADD16(x01, x67); // (s0, s1)
+    uint32_t d01 = __SSUB16(x01, x67); // (d0, d1)
+    uint32_t s32 = __ROR(__SADD16(x23, x45), 16); // (s3, s2)
+    uint32_t d23 = __SSUB16(x23, x45); // (d2, d3)
+
+    uint32_t e0 = __SADD16(s01, s32); // (s0 + s3, s1 + s2)
+    uint32_t e1 = __SSUB16(s01, s32); // (s0 - s3, s1 - s2)
+
+    out[0 * stride] = ((int32_t) __SMUAD(e0, PACK(FIX_C4, FIX_C4)) + round) >> shift;
+    out[4 * stride] = ((int32_t) __SMUSD(e0, PACK(FIX_C4, FIX_C4)) + round) >> shift;
+    out[2 * stride] = ((int32_t) __SMUAD(e1, PACK(FIX_C2, FIX_C6)) + round) >> shift;
+    out[6 * stride] = ((int32_t) __SMUSD(e1, PACK(FIX_C6, FIX_C2)) + round) >> shift;
+
+    out[1 * stride] = ((int32_t) __SMLAD(d23, PACK( FIX_C5,  FIX_C7), __SMUAD(d01, PACK(FIX_C1,  FIX_C3))) + round) >> shift;
+    out[3 * stride] = ((int32_t) __SMLAD(d23, PACK(-FIX_C1, -FIX_C5), __SMUAD(d01, PACK(FIX_C3, -FIX_C7))) + round) >> shift;
+    out[5 * stride] = ((int32_t) __SMLAD(d23, PACK( FIX_C7,  FIX_C3), __SMUAD(d01, PACK(FIX_C5, -FIX_C1))) + round) >> shift;
+    out[7 * stride] = ((int32_t) __SMLAD(d23, PACK( FIX_C3, -FIX_C1), __SMUAD(d01, PACK(FIX_C7, -FIX_C5))) + round) >> shift;
+}
+
+static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, uint32_t *fdtbl, int DC, const uint16_t (*HTDC)[2], const uint16_t (*HTAC)[2])
+{
+    int16_t T[64] __attribute__((aligned(4))), DU[64];
     int DUQ[64];
-    int z1, z2, z3, z4, z5, z11, z13;
-    int t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13;
     const uint16_t EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
     const uint16_t M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
 
-    // DCT rows
-    for (int i=8, *p=DU; i>0; i--, p+=8, CDU+=8) {
-        t0 = CDU[0] + CDU[7];
-        t1 = CDU[1] + CDU[6];
-        t2 = CDU[2] + CDU[5];
-        t3 = CDU[3] + CDU[4];
-
-        t7 = CDU[0] - CDU[7];
-        t6 = CDU[1] - CDU[6];
-        t5 = CDU[2] - CDU[5];
-        t4 = CDU[3] - CDU[4];
-
-        // Even part
-        t10 = t0 + t3;
-        t13 = t0 - t3;
-        t11 = t1 + t2;
-        t12 = t1 - t2;
-        z1 = MULTIPLY(t12 + t13, FIX_0_707106781); // c4
-
-        p[0] = t10 + t11;
-        p[4] = t10 - t11;
-        p[2] = t13 + z1;
-        p[6] = t13 - z1;
-
-        // Odd part
-        t10 = t4 + t5;// phase 2
-        t11 = t5 + t6;
-        t12 = t6 + t7;
-
-        // The rotator is modified from fig 4-8 to avoid extra negations.
-        z5 = MULTIPLY(t10 - t12, FIX_0_382683433); // c6
-        z2 = MULTIPLY(t10, FIX_0_541196100) + z5; // 1.306562965f-c6
-        z4 = MULTIPLY(t12, FIX_1_306562965) + z5; // 1.306562965f+c6
-        z3 = MULTIPLY(t11, FIX_0_707106781); // c4
-        z11 = t7 + z3;    // phase 5
-        z13 = t7 - z3;
-
-        p[5] = z13 + z2;// phase 6
-        p[3] = z13 - z2;
-        p[1] = z11 + z4;
-        p[7] = z11 - z4;
+    // DCT rows, stored transposed so that the column pass also reads pairs of neighbours.
+    for (int i = 0; i < 8; i++, CDU += 8) {
+        jpeg_fdct_1d(__PKHBT(CDU[0], CDU[1], 16), __PKHBT(CDU[2], CDU[3], 16),
+                     __PKHBT(CDU[4], CDU[5], 16), __PKHBT(CDU[6], CDU[7], 16),
+                     T + i, 8, FIX_BITS - PASS1_BITS);
     }
 
-    // DCT columns
-    for (int i=8, *p=DU; i>0; i--, p++) {
-        t0 = p[0]  + p[56];
-        t1 = p[8]  + p[48];
-        t2 = p[16] + p[40];
-        t3 = p[24] + p[32];
-
-        t7 = p[0]  - p[56];
-        t6 = p[8]  - p[48];
-        t5 = p[16] - p[40];
-        t4 = p[24] - p[32];
-
-        // Even part
-        t10 = t0 + t3;	// phase 2
-        t13 = t0 - t3;
-        t11 = t1 + t2;
-        t12 = t1 - t2;
-        z1 = MULTIPLY(t12 + t13, FIX_0_707106781); // c4
-
-        p[0] = t10 + t11; 		// phase 3
-        p[32] = t10 - t11;
-        p[16] = t13 + z1; 		// phase 5
-        p[48] = t13 - z1;
-
-        // Odd part
-        t10 = t4 + t5; 		// phase 2
-        t11 = t5 + t6;
-        t12 = t6 + t7;
-
-        // The rotator is modified from fig 4-8 to avoid extra negations.
-        z5 = MULTIPLY(t10 - t12, FIX_0_382683433); // c6
-        z2 = MULTIPLY(t10, FIX_0_541196100) + z5; // 1.306562965f-c6
-        z4 = MULTIPLY(t12, FIX_1_306562965) + z5; // 1.306562965f+c6
-        z3 = MULTIPLY(t11, FIX_0_707106781); // c4
-        z11 = t7 + z3;		// phase 5
-        z13 = t7 - z3;
-
-        p[40] = z13 + z2;// phase 6
-        p[24] = z13 - z2;
-        p[8] = z11 + z4;
-        p[56] = z11 - z4;
+    // DCT columns, back to natural order. The outputs are 16x the JPEG coefficients.
+    for (int i = 0; i < 8; i++) {
+        uint32_t *p = (uint32_t *) (T + (i * 8));
+        jpeg_fdct_1d(p[0], p[1], p[2], p[3], DU + i, 8, FIX_BITS);
     }
 
     // first non-zero element in reverse order
     int end0pos = 0;
     // Quantize/descale/zigzag the coefficients
     for(int i=0; i<64; ++i) {
-		DUQ[s_jpeg_ZigZag[i]] = fast_roundf(DU[i]*fdtbl[i]);
+        int v = DU[i];
+        uint32_t q = ((abs(v) * fdtbl[i]) + (1 << (QUANT_BITS - 1))) >> QUANT_BITS;
+        DUQ[s_jpeg_ZigZag[i]] = (v < 0) ? -q : q;
         if (s_jpeg_ZigZag[i] > end0pos && DUQ[s_jpeg_ZigZag[i]]) {
             end0pos = s_jpeg_ZigZag[i];
         }
@@ -765,11 +717,10 @@ static void jpeg_init(int quality)
             UVTable[s_jpeg_ZigZag[i]] = uvti < 1 ? 1 : uvti > 255 ? 255 : uvti;
         }
 
-        for(int r = 0, k = 0; r < 8; ++r) {
-            for(int c = 0; c < 8; ++c, ++k) {
-                fdtbl_Y[k]  = 1.0f / (aasf[r] * aasf[c] * YTable [s_jpeg_ZigZag[k]] * 8.0f);
-                fdtbl_UV[k] = 1.0f / (aasf[r] * aasf[c] * UVTable[s_jpeg_ZigZag[k]] * 8.0f);
-            }
+        for(int k = 0; k < 64; ++k) {
+            int y_div = YTable[s_jpeg_ZigZag[k]] * 16, uv_div = UVTable[s_jpeg_ZigZag[k]] * 16;
+            fdtbl_Y[k]  = ((1 << QUANT_BITS) + (y_div / 2)) / y_div;
+            fdtbl_UV[k] = ((1 << QUANT_BITS) + (uv_div / 2)) / uv_div;
         }
     }
 }
@@ -954,46 +905,42 @@ void jpeg_get_mcu(image_t *img, int mcu_w, int mcu_h, int x_offs, int y_offs, in
     }
 }
 
-bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
+static jpeg_subsample_t jpeg_get_subsample(int quality)
 {
-    int DCY=0, DCU=0, DCV=0;
-
-    #if (TIME_JPEG==1)
-    uint32_t start = HAL_GetTick();
-    #endif
-
-    // JPEG buffer
-    jpeg_buf_t  jpeg_buf = {
-        .idx =0,
-        .buf = dst->pixels,
-        .length = dst->bpp,
-        .bitc = 0,
-        .bitb = 0,
-        .realloc = realloc,
-        .overflow = false,
-    };
-
-    // Initialize quantization tables
-    jpeg_init(quality);
-
-    jpeg_subsample_t jpeg_subsample;
-
-
     if (quality >= 60) {
-        jpeg_subsample = JPEG_SUBSAMPLE_1x1;
+        return JPEG_SUBSAMPLE_1x1;
     } else if (quality > 35) {
-        jpeg_subsample = JPEG_SUBSAMPLE_2x1;
+        return JPEG_SUBSAMPLE_2x1;
     } else { // <= 35
-        jpeg_subsample = JPEG_SUBSAMPLE_2x2;
+        return JPEG_SUBSAMPLE_2x2;
     }
+}
 
-    // Write JPEG headers
+static void jpeg_write_image_headers(jpeg_buf_t *jpeg_buf, image_t *src, jpeg_subsample_t jpeg_subsample)
+{
     if (src->bpp == 3) { // BAYER
         // Will be converted to RGB565
-        jpeg_write_headers(&jpeg_buf, src->w, src->h, 2, jpeg_subsample);
+        jpeg_write_headers(jpeg_buf, src->w, src->h, 2, jpeg_subsample);
     } else {
-        jpeg_write_headers(&jpeg_buf, src->w, src->h, (src->bpp == 0) ? 1 : src->bpp, jpeg_subsample);
+        jpeg_write_headers(jpeg_buf, src->w, src->h, (src->bpp == 0) ? 1 : src->bpp, jpeg_subsample);
     }
+}
+
+static void jpeg_write_trailer(jpeg_buf_t *jpeg_buf)
+{
+    // Do the bit alignment of the EOI marker
+    static const uint16_t fillBits[] = {0x7F, 7};
+    jpeg_writeBits(jpeg_buf, fillBits);
+
+    // EOI
+    jpeg_put_char(jpeg_buf, 0xFF);
+    jpeg_put_char(jpeg_buf, 0xD9);
+}
+
+// Encodes all MCUs of src continuing from the DC predictors in DC (Y, U, V).
+static bool jpeg_encode(jpeg_buf_t *jpeg_buf, image_t *src, jpeg_subsample_t jpeg_subsample, int *DC)
+{
+    int DCY=DC[0], DCU=DC[1], DCV=DC[2];
 
     // Encode 8x8 macroblocks
     if (src->bpp == 0) {
@@ -1002,9 +949,9 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
         for (int y=0; y<src->h; y+=8) {
             for (int x=0; x<src->w; x+=8) {
                 jpeg_get_mcu(src, 8, 8, x, y, src->bpp, YDU);
-                DCY = jpeg_processDU(&jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCY = jpeg_processDU(jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
             }
-            if (jpeg_buf.overflow) {
+            if (jpeg_buf->overflow) {
                 goto jpeg_overflow;
             }
         }
@@ -1014,9 +961,9 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
         for (int y=0; y<src->h; y+=8) {
             for (int x=0; x<src->w; x+=8) {
                 jpeg_get_mcu(src, 8, 8, x, y, src->bpp, YDU);
-                DCY = jpeg_processDU(&jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCY = jpeg_processDU(jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
             }
-            if (jpeg_buf.overflow) {
+            if (jpeg_buf->overflow) {
                 goto jpeg_overflow;
             }
         }
@@ -1057,11 +1004,11 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                             } // for tx
                         } // for ty
 
-                        DCY = jpeg_processDU(&jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                     }
-                    if (jpeg_buf.overflow) {
+                    if (jpeg_buf->overflow) {
                         goto jpeg_overflow;
                     }
                 }
@@ -1108,12 +1055,12 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                             } // for tx
                         } // for ty
 
-                        DCY = jpeg_processDU(&jpeg_buf, YDU,    fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+64, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU,    fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+64, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                     }
-                    if (jpeg_buf.overflow) {
+                    if (jpeg_buf->overflow) {
                         goto jpeg_overflow;
                     }
                 }
@@ -1181,14 +1128,14 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                             } // for tx
                         } // for ty
 
-                        DCY = jpeg_processDU(&jpeg_buf, YDU,     fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+64,  fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+128, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+192, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU,     fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+64,  fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+128, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+192, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                     }
-                    if (jpeg_buf.overflow) {
+                    if (jpeg_buf->overflow) {
                         goto jpeg_overflow;
                     }
                 }
@@ -1202,10 +1149,10 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                 for (int y=0; y<src->h; y+=8) {
                     for (int x=0; x<src->w; x+=8) {
                         bayer_to_ycbcr(src, x, y, (uint8_t *)YDU, (uint8_t *)UDU, (uint8_t *)VDU, 1);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
-                        if (jpeg_buf.overflow) {
+                        DCY = jpeg_processDU(jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        if (jpeg_buf->overflow) {
                             goto jpeg_overflow;
                         }
                     }
@@ -1224,12 +1171,12 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                             UDU[idx] = (int8_t)((UDU[idx] + UDU[idx+64] + 1) >> 1);
                             VDU[idx] = (int8_t)((VDU[idx] + VDU[idx+64] + 1) >> 1);
                         } // for idx
-                        DCY = jpeg_processDU(&jpeg_buf, YDU,    fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+64, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU,    fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+64, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                     }
-                    if (jpeg_buf.overflow) {
+                    if (jpeg_buf->overflow) {
                         goto jpeg_overflow;
                     }
                 }
@@ -1250,14 +1197,14 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
                             VDU[idx] = (int8_t)((VDU[idx] + VDU[idx+64] + VDU[idx+128] + VDU[idx+192] + 2) >> 2);
                         } // for idx
 
-                        DCY = jpeg_processDU(&jpeg_buf, YDU,     fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+64,  fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+128, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCY = jpeg_processDU(&jpeg_buf, YDU+192, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU,     fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+64,  fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+128, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU+192, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                     }
-                    if (jpeg_buf.overflow) {
+                    if (jpeg_buf->overflow) {
                         goto jpeg_overflow;
                     }
                 }
@@ -1266,14 +1213,44 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
         }
     }
 
+jpeg_overflow:
+    DC[0] = DCY; DC[1] = DCU; DC[2] = DCV;
+    return jpeg_buf->overflow;
+}
 
-    // Do the bit alignment of the EOI marker
-    static const uint16_t fillBits[] = {0x7F, 7};
-    jpeg_writeBits(&jpeg_buf, fillBits);
+bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
+{
+    int DC[3] = {0, 0, 0};
 
-    // EOI
-    jpeg_put_char(&jpeg_buf, 0xFF);
-    jpeg_put_char(&jpeg_buf, 0xD9);
+    #if (TIME_JPEG==1)
+    uint32_t start = HAL_GetTick();
+    #endif
+
+    // JPEG buffer
+    jpeg_buf_t  jpeg_buf = {
+        .idx =0,
+        .buf = dst->pixels,
+        .length = dst->bpp,
+        .bitc = 0,
+        .bitb = 0,
+        .realloc = realloc,
+        .overflow = false,
+    };
+
+    // Initialize quantization tables
+    jpeg_init(quality);
+
+    jpeg_subsample_t jpeg_subsample = jpeg_get_subsample(quality);
+
+    // Write JPEG headers
+    jpeg_write_image_headers(&jpeg_buf, src, jpeg_subsample);
+
+    // Encode 8x8 macroblocks
+    if (jpeg_encode(&jpeg_buf, src, jpeg_subsample, DC)) {
+        return true;
+    }
+
+    jpeg_write_trailer(&jpeg_buf);
 
     dst->bpp = jpeg_buf.idx;
     dst->data = jpeg_buf.buf;
@@ -1282,9 +1259,75 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc)
     printf("time: %lums\n", HAL_GetTick() - start);
     #endif
 
-jpeg_overflow:
     return jpeg_buf.overflow;
 }
+
+// Line streaming: lines are buffered until a full MCU row (8 or 16 lines) is available, which is
+// then encoded right away with the same code as jpeg_compress(). The output is identical to
+// compressing the whole image at once.
+void jpeg_stream_init(jpeg_stream_t *stream, int w, int h, int bpp, int quality, image_t *dst, uint8_t *lines)
+{
+    stream->jpeg_buf = (jpeg_buf_t) {
+        .idx = 0,
+        .buf = dst->pixels,
+        .length = dst->bpp,
+        .bitc = 0,
+        .bitb = 0,
+        .realloc = false,
+        .overflow = false,
+    };
+
+    jpeg_init(quality);
+
+    stream->subsample = jpeg_get_subsample(quality);
+    stream->dc[0] = stream->dc[1] = stream->dc[2] = 0;
+    stream->y = 0;
+    stream->h = h;
+    stream->mcu_h = ((bpp == 2) && (stream->subsample == JPEG_SUBSAMPLE_2x2)) ? 16 : 8;
+    stream->lines.w = w;
+    stream->lines.h = h; // For the headers.
+    stream->lines.bpp = bpp;
+    stream->lines.stride = 0;
+    stream->lines.data = lines;
+
+    jpeg_write_image_headers(&stream->jpeg_buf, &stream->lines, stream->subsample);
+    stream->lines.h = 0;
+}
+
+uint8_t *jpeg_stream_get_line(jpeg_stream_t *stream)
+{
+    return stream->lines.data + (stream->lines.h * stream->lines.w * stream->lines.bpp);
+}
+
+bool jpeg_stream_put_line(jpeg_stream_t *stream)
+{
+    stream->lines.h += 1;
+    stream->y += 1;
+
+    if ((stream->lines.h == stream->mcu_h) || (stream->y == stream->h)) {
+        // After an overflow the lines are dropped, but the buffer still has to be recycled
+        // because the line callback keeps writing the rest of the frame to it.
+        if (!stream->jpeg_buf.overflow) {
+            jpeg_encode(&stream->jpeg_buf, &stream->lines, stream->subsample, stream->dc);
+        }
+        stream->lines.h = 0;
+    }
+
+    return stream->jpeg_buf.overflow;
+}
+
+bool jpeg_stream_end(jpeg_stream_t *stream, image_t *dst)
+{
+    if ((stream->y != stream->h) || stream->jpeg_buf.overflow) {
+        return true;
+    }
+
+    jpeg_write_trailer(&stream->jpeg_buf);
+
+    dst->bpp = stream->jpeg_buf.idx;
+    dst->data = stream->jpeg_buf.buf;
+    return stream->jpeg_buf.overflow;
+}
 #endif //defined OMV_HARDWARE_JPEG
 
 // This function inits the geometry values of an image.
@@ -1319,6 +1362,7 @@ void jpeg_read_geometry(FIL *fp, image_t *img, const char *path, jpg_read_settin
                 rs->jpg_w = img->w = width;
                 rs->jpg_h = img->h = height;
                 rs->jpg_size = img->bpp = f_size(fp);
+                img->stride = 0;
                 return;
             } else {
                 file_seek(fp, f_tell(fp) + size - 2);
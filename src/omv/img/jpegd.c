@@ -0,0 +1,644 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimalistic JPEG baseline decoder.
+ *
+ * Decodes one MCU row at a time into fb_alloc scratch buffers and converts each row to
+ * grayscale or RGB565. Downscaling by 2, 4 or 8 is done in the DCT domain by running a
+ * reduced size IDCT on the low frequency coefficients of each block (like libjpeg's
+ * jidctred.c), so decoding at 1/8 scale only needs the DC coefficients.
+ */
+#include <stdio.h>
+#include STM32_HAL_H
+#include <arm_math.h>
+#include <mp.h>
+
+#include "fb_alloc.h"
+#include "imlib.h"
+
+#define JPEGD_FAST_BITS     (9)
+#define JPEGD_MAX_COMP      (3)
+#define JPEGD_ERROR(msg)    nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, (msg)))
+
+typedef struct jpegd_huff {
+    uint8_t fast[1 << JPEGD_FAST_BITS]; // Index of the code for each 9-bit prefix or 255.
+    uint16_t code[256];
+    uint8_t values[256];
+    uint8_t size[257];
+    uint32_t maxcode[18];
+    int delta[17];
+} jpegd_huff_t;
+
+typedef struct jpegd_comp {
+    int id, h, v, tq, td, ta;
+    int dc_pred;
+    int scale;          // Block size after scaling (8, 4, 2 or 1).
+    int x_shift;        // Log2 of the upsampling left to do after scaling.
+    int y_shift;
+    int stride;         // Row stride of the plane in pixels.
+    uint8_t *plane;     // One MCU row of decoded samples.
+} jpegd_comp_t;
+
+typedef struct jpegd {
+    const uint8_t *ptr, *end;
+    uint32_t bits;
+    int n_bits;
+    int marker;         // Marker found in the entropy coded data or 0.
+    int w, h, n_comp, h_max, v_max;
+    int restart_interval;
+    int scale;          // Luma block size after scaling (8, 4, 2 or 1).
+    uint16_t qt[4][64]; // Natural order.
+    jpegd_huff_t huff[2][4]; // DC and AC tables.
+    jpegd_comp_t comp[JPEGD_MAX_COMP];
+} jpegd_t;
+
+static const uint8_t jpegd_zigzag[64 + 15] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+   // Run-lengths past the end of the block land here.
+   63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+// Reduced IDCT basis k(u) * cos((2x + 1) * u * pi / (2 * N)) in Q12 with the 8-point
+// normalization (k(0) = 1/sqrt(8), k(u) = 1/2) so that the outputs are block averages.
+static const int16_t jpegd_idct4[4][4] = {
+    {1448,  1892,  1448,   784},
+    {1448,   784, -1448, -1892},
+    {1448,  -784, -1448,  1892},
+    {1448, -1892,  1448,  -784},
+};
+
+static const int16_t jpegd_idct2[2][2] = {
+    {1448,  1448},
+    {1448, -1448},
+};
+
+static int jpegd_get_word(jpegd_t *d)
+{
+    if ((d->end - d->ptr) < 2) {
+        JPEGD_ERROR("JPEG is truncated!");
+    }
+    int w = (d->ptr[0] << 8) | d->ptr[1];
+    d->ptr += 2;
+    return w;
+}
+
+static void jpegd_build_huff(jpegd_huff_t *h, const uint8_t *counts)
+{
+    int k = 0;
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            h->size[k++] = i + 1;
+        }
+    }
+    h->size[k] = 0;
+
+    uint32_t code = 0;
+    k = 0;
+    for (int j = 1; j <= 16; j++) {
+        h->delta[j] = k - code;
+        while (h->size[k] == j) {
+            h->code[k++] = code++;
+        }
+        if (code > (1U << j)) {
+            JPEGD_ERROR("Corrupted JPEG Huffman table!");
+        }
+        h->maxcode[j] = code << (16 - j);
+        code <<= 1;
+    }
+    h->maxcode[17] = 0xFFFFFFFF;
+
+    memset(h->fast, 255, sizeof(h->fast));
+    for (int i = 0; i < k; i++) {
+        int s = h->size[i];
+        if (s <= JPEGD_FAST_BITS) {
+            int c = h->code[i] << (JPEGD_FAST_BITS - s);
+            for (int j = 0, m = 1 << (JPEGD_FAST_BITS - s); j < m; j++) {
+                h->fast[c + j] = i;
+            }
+        }
+    }
+}
+
+static void jpegd_read_dht(jpegd_t *d, int len)
+{
+    const uint8_t *end = d->ptr + len;
+    while (d->ptr < end) {
+        int tc = d->ptr[0] >> 4, th = d->ptr[0] & 15;
+        if ((tc > 1) || (th > 3) || ((end - d->ptr) < 17)) {
+            JPEGD_ERROR("Corrupted JPEG Huffman table!");
+        }
+        const uint8_t *counts = d->ptr + 1;
+        int n = 0;
+        for (int i = 0; i < 16; i++) {
+            n += counts[i];
+        }
+        if ((n > 256) || ((end - d->ptr) < (17 + n))) {
+            JPEGD_ERROR("Corrupted JPEG Huffman table!");
+        }
+        jpegd_huff_t *h = &d->huff[tc][th];
+        jpegd_build_huff(h, counts);
+        memcpy(h->values, d->ptr + 17, n);
+        d->ptr += 17 + n;
+    }
+}
+
+static void jpegd_read_dqt(jpegd_t *d, int len)
+{
+    const uint8_t *end = d->ptr + len;
+    while (d->ptr < end) {
+        int pq = d->ptr[0] >> 4, tq = d->ptr[0] & 15;
+        if ((pq > 1) || (tq > 3) || ((end - d->ptr) < (65 + (pq * 64)))) {
+            JPEGD_ERROR("Corrupted JPEG quantization table!");
+        }
+        d->ptr += 1;
+        for (int i = 0; i < 64; i++) {
+            d->qt[tq][jpegd_zigzag[i]] = pq ? ((d->ptr[i * 2] << 8) | d->ptr[(i * 2) + 1]) : d->ptr[i];
+        }
+        d->ptr += 64 << pq;
+    }
+}
+
+static void jpegd_read_sof(jpegd_t *d, int len)
+{
+    if ((len < 6) || (d->ptr[0] != 8)) {
+        JPEGD_ERROR("Only 8-bit JPEGs are supported!");
+    }
+    d->h = (d->ptr[1] << 8) | d->ptr[2];
+    d->w = (d->ptr[3] << 8) | d->ptr[4];
+    d->n_comp = d->ptr[5];
+    if ((d->n_comp != 1) && (d->n_comp != 3)) {
+        JPEGD_ERROR("Only grayscale and YCbCr JPEGs are supported!");
+    }
+    if ((!d->w) || (!d->h) || (len < (6 + (d->n_comp * 3)))) {
+        JPEGD_ERROR("Corrupted JPEG frame header!");
+    }
+    d->h_max = d->v_max = 1;
+    for (int i = 0; i < d->n_comp; i++) {
+        jpegd_comp_t *c = &d->comp[i];
+        c->id = d->ptr[6 + (i * 3)];
+        c->h = d->ptr[7 + (i * 3)] >> 4;
+        c->v = d->ptr[7 + (i * 3)] & 15;
+        c->tq = d->ptr[8 + (i * 3)] & 3;
+        // A single component scan has one block per MCU whatever the sampling factors.
+        if (d->n_comp == 1) {
+            c->h = c->v = 1;
+        }
+        if ((c->h < 1) || (c->h > 2) || (c->v < 1) || (c->v > 2) || (i && ((c->h != 1) || (c->v != 1)))) {
+            JPEGD_ERROR("Unsupported JPEG chroma subsampling!");
+        }
+        d->h_max = IM_MAX(d->h_max, c->h);
+        d->v_max = IM_MAX(d->v_max, c->v);
+    }
+    d->ptr += len;
+}
+
+static void jpegd_read_sos(jpegd_t *d, int len)
+{
+    if ((len < 1) || (d->ptr[0] != d->n_comp) || (len < (4 + (d->n_comp * 2)))) {
+        JPEGD_ERROR("Only interleaved baseline JPEG scans are supported!");
+    }
+    for (int i = 0; i < d->n_comp; i++) {
+        int id = d->ptr[1 + (i * 2)], t = d->ptr[2 + (i * 2)];
+        jpegd_comp_t *c = &d->comp[i];
+        if ((c->id != id) || ((t >> 4) > 3) || ((t & 15) > 3)) {
+            JPEGD_ERROR("Corrupted JPEG scan header!");
+        }
+        c->td = t >> 4;
+        c->ta = t & 15;
+    }
+    d->ptr += len;
+}
+
+static void jpegd_fill(jpegd_t *d)
+{
+    while (d->n_bits <= 24) {
+        int b = 0;
+        if (!d->marker) {
+            if (d->ptr >= d->end) {
+                d->marker = 0xD9; // Treat missing data as EOI.
+            } else if ((b = *d->ptr++) == 0xFF) {
+                while ((d->ptr < d->end) && (*d->ptr == 0xFF)) {
+                    d->ptr++; // Fill bytes.
+                }
+                int c = (d->ptr < d->end) ? *d->ptr++ : 0xD9;
+                if (c) {
+                    d->marker = c;
+                    b = 0;
+                }
+            }
+        }
+        d->bits |= b << (24 - d->n_bits);
+        d->n_bits += 8;
+    }
+}
+
+static inline int jpegd_get_bits(jpegd_t *d, int n)
+{
+    if (d->n_bits < n) {
+        jpegd_fill(d);
+    }
+    int v = d->bits >> (32 - n);
+    d->bits <<= n;
+    d->n_bits -= n;
+    return v;
+}
+
+static inline int jpegd_extend(jpegd_t *d, int n)
+{
+    if (!n) {
+        return 0;
+    }
+    int v = jpegd_get_bits(d, n);
+    return (v < (1 << (n - 1))) ? (v - (1 << n) + 1) : v;
+}
+
+static inline int jpegd_decode_huff(jpegd_t *d, jpegd_huff_t *h)
+{
+    if (d->n_bits < 16) {
+        jpegd_fill(d);
+    }
+
+    int k = h->fast[d->bits >> (32 - JPEGD_FAST_BITS)];
+    if (k < 255) {
+        int s = h->size[k];
+        d->bits <<= s;
+        d->n_bits -= s;
+        return h->values[k];
+    }
+
+    uint32_t temp = d->bits >> 16;
+    for (k = JPEGD_FAST_BITS + 1; temp >= h->maxcode[k]; k++);
+    if (k == 17) {
+        JPEGD_ERROR("Corrupted JPEG data!");
+    }
+
+    int c = (d->bits >> (32 - k)) + h->delta[k];
+    if ((c < 0) || (c > 255)) {
+        JPEGD_ERROR("Corrupted JPEG data!");
+    }
+    d->bits <<= k;
+    d->n_bits -= k;
+    return h->values[c];
+}
+
+// Decodes one block into natural order keeping only the scale x scale low frequency corner.
+static void jpegd_decode_block(jpegd_t *d, jpegd_comp_t *c, int16_t *blk)
+{
+    const uint16_t *qt = d->qt[c->tq];
+    int n = c->scale;
+
+    int t = jpegd_decode_huff(d, &d->huff[0][c->td]);
+    if (t > 11) {
+        JPEGD_ERROR("Corrupted JPEG data!");
+    }
+    c->dc_pred += jpegd_extend(d, t);
+    blk[0] = c->dc_pred * qt[0];
+
+    for (int k = 1; k < 64;) {
+        int rs = jpegd_decode_huff(d, &d->huff[1][c->ta]);
+        int r = rs >> 4, s = rs & 15;
+        if (!s) {
+            if (r != 15) {
+                break; // EOB
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        int v = jpegd_extend(d, s);
+        int z = jpegd_zigzag[k++];
+        if (((z & 7) < n) && ((z >> 3) < n)) {
+            blk[z] = v * qt[z];
+        }
+    }
+}
+
+#define JPEGD_F2F(x)  ((int) (((x) * 4096) + 0.5f))
+#define JPEGD_FSH(x)  ((x) * 4096)
+
+// Loeffler, Ligtenberg and Moschytz 8-point IDCT with 12 bit constants (jidctint.c).
+#define JPEGD_IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7) \
+    int t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3; \
+    p2 = s2; \
+    p3 = s6; \
+    p1 = (p2 + p3) * JPEGD_F2F(0.5411961f); \
+    t2 = p1 + (p3 * JPEGD_F2F(-1.847759065f)); \
+    t3 = p1 + (p2 * JPEGD_F2F(0.765366865f)); \
+    p2 = s0; \
+    p3 = s4; \
+    t0 = JPEGD_FSH(p2 + p3); \
+    t1 = JPEGD_FSH(p2 - p3); \
+    x0 = t0 + t3; \
+    x3 = t0 - t3; \
+    x1 = t1 + t2; \
+    x2 = t1 - t2; \
+    t0 = s7; \
+    t1 = s5; \
+    t2 = s3; \
+    t3 = s1; \
+    p3 = t0 + t2; \
+    p4 = t1 + t3; \
+    p1 = t0 + t3; \
+    p2 = t1 + t2; \
+    p5 = (p3 + p4) * JPEGD_F2F(1.175875602f); \
+    t0 = t0 * JPEGD_F2F(0.298631336f); \
+    t1 = t1 * JPEGD_F2F(2.053119869f); \
+    t2 = t2 * JPEGD_F2F(3.072711026f); \
+    t3 = t3 * JPEGD_F2F(1.501321110f); \
+    p1 = p5 + (p1 * JPEGD_F2F(-0.899976223f)); \
+    p2 = p5 + (p2 * JPEGD_F2F(-2.562915447f)); \
+    p3 = p3 * JPEGD_F2F(-1.961570560f); \
+    p4 = p4 * JPEGD_F2F(-0.390180644f); \
+    t3 += p1 + p4; \
+    t2 += p2 + p3; \
+    t1 += p2 + p4; \
+    t0 += p1 + p3;
+
+static void jpegd_idct8(int16_t *blk, uint8_t *out, int stride)
+{
+    int tmp[64];
+
+    for (int i = 0; i < 8; i++) {
+        int16_t *s = blk + i;
+        int *v = tmp + i;
+        if (!(s[8] | s[16] | s[24] | s[32] | s[40] | s[48] | s[56])) {
+            int dc = s[0] * 4;
+            v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+        } else {
+            JPEGD_IDCT_1D(s[0], s[8], s[16], s[24], s[32], s[40], s[48], s[56])
+            // Keep 2 extra bits of precision for the second pass.
+            x0 += 512; x1 += 512; x2 += 512; x3 += 512;
+            v[0]  = (x0 + t3) >> 10;
+            v[56] = (x0 - t3) >> 10;
+            v[8]  = (x1 + t2) >> 10;
+            v[48] = (x1 - t2) >> 10;
+            v[16] = (x2 + t1) >> 10;
+            v[40] = (x2 - t1) >> 10;
+            v[24] = (x3 + t0) >> 10;
+            v[32] = (x3 - t0) >> 10;
+        }
+    }
+
+    for (int i = 0; i < 8; i++, out += stride) {
+        int *v = tmp + (i * 8);
+        JPEGD_IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+        // 12 bits from the constants, 2 from the first pass and 3 from the 2D scaling.
+        x0 += 65536 + (128 << 17);
+        x1 += 65536 + (128 << 17);
+        x2 += 65536 + (128 << 17);
+        x3 += 65536 + (128 << 17);
+        out[0] = __USAT((x0 + t3) >> 17, 8);
+        out[7] = __USAT((x0 - t3) >> 17, 8);
+        out[1] = __USAT((x1 + t2) >> 17, 8);
+        out[6] = __USAT((x1 - t2) >> 17, 8);
+        out[2] = __USAT((x2 + t1) >> 17, 8);
+        out[5] = __USAT((x2 - t1) >> 17, 8);
+        out[3] = __USAT((x3 + t0) >> 17, 8);
+        out[4] = __USAT((x3 - t0) >> 17, 8);
+    }
+}
+
+// N-point IDCT (N = 4 or 2) of the N x N low frequency corner of the block.
+static void jpegd_idct_reduced(int16_t *blk, uint8_t *out, int stride, int n, const int16_t *basis)
+{
+    int tmp[16];
+
+    for (int v = 0; v < n; v++) {
+        for (int x = 0; x < n; x++) {
+            int acc = 0;
+            for (int u = 0; u < n; u++) {
+                acc += basis[(x * n) + u] * blk[(v * 8) + u];
+            }
+            tmp[(v * n) + x] = (acc + 2048) >> 12;
+        }
+    }
+
+    for (int y = 0; y < n; y++, out += stride) {
+        for (int x = 0; x < n; x++) {
+            int acc = 0;
+            for (int v = 0; v < n; v++) {
+                acc += basis[(y * n) + v] * tmp[(v * n) + x];
+            }
+            out[x] = __USAT(((acc + 2048) >> 12) + 128, 8);
+        }
+    }
+}
+
+static void jpegd_idct(int n, int16_t *blk, uint8_t *out, int stride)
+{
+    switch (n) {
+        case 8: {
+            jpegd_idct8(blk, out, stride);
+            break;
+        }
+        case 4: {
+            jpegd_idct_reduced(blk, out, stride, 4, &jpegd_idct4[0][0]);
+            break;
+        }
+        case 2: {
+            jpegd_idct_reduced(blk, out, stride, 2, &jpegd_idct2[0][0]);
+            break;
+        }
+        default: {
+            // DC / 8 is the block average.
+            out[0] = __USAT(((blk[0] + 4) >> 3) + 128, 8);
+            break;
+        }
+    }
+}
+
+// Skips to the restart marker and resets the decoder state.
+static void jpegd_restart(jpegd_t *d)
+{
+    if (!d->marker) {
+        while (d->ptr < (d->end - 1)) {
+            if ((d->ptr[0] == 0xFF) && (d->ptr[1] >= 0xD0) && (d->ptr[1] <= 0xD7)) {
+                d->ptr += 2;
+                break;
+            }
+            d->ptr++;
+        }
+    }
+    d->marker = 0;
+    d->bits = 0;
+    d->n_bits = 0;
+    for (int i = 0; i < d->n_comp; i++) {
+        d->comp[i].dc_pred = 0;
+    }
+}
+
+static void jpegd_put_row(jpegd_t *d, image_t *dst, int y, int row)
+{
+    jpegd_comp_t *c = d->comp;
+    uint8_t *y_ptr = c[0].plane + (row * c[0].stride);
+
+    if (dst->bpp == IMAGE_BPP_GRAYSCALE) {
+        memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(dst, y), y_ptr, dst->w);
+        return;
+    }
+
+    uint16_t *out = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(dst, y);
+
+    if (d->n_comp == 1) {
+        for (int x = 0, xx = dst->w; x < xx; x++) {
+            IMAGE_PUT_RGB565_PIXEL_FAST(out, x, COLOR_R8_G8_B8_TO_RGB565(y_ptr[x], y_ptr[x], y_ptr[x]));
+        }
+        return;
+    }
+
+    int x_shift = c[1].x_shift;
+    uint8_t *cb_ptr = c[1].plane + ((row >> c[1].y_shift) * c[1].stride);
+    uint8_t *cr_ptr = c[2].plane + ((row >> c[2].y_shift) * c[2].stride);
+
+    for (int x = 0, xx = dst->w; x < xx; x++) {
+        int l = y_ptr[x], cb = cb_ptr[x >> x_shift] - 128, cr = cr_ptr[x >> x_shift] - 128;
+        // JFIF YCbCr to RGB in Q16.
+        int r = l + (((91881 * cr) + 32768) >> 16);
+        int g = l - (((22554 * cb) + (46802 * cr) - 32768) >> 16);
+        int b = l + (((116130 * cb) + 32768) >> 16);
+        IMAGE_PUT_RGB565_PIXEL_FAST(out, x, COLOR_R8_G8_B8_TO_RGB565(__USAT(r, 8), __USAT(g, 8), __USAT(b, 8)));
+    }
+}
+
+static void jpegd_decode_scan(jpegd_t *d, image_t *dst)
+{
+    int n = d->scale;
+    int mcu_w = 8 * d->h_max, mcu_h = 8 * d->v_max;
+    int mcus_x = (d->w + mcu_w - 1) / mcu_w;
+    int mcus_y = (d->h + mcu_h - 1) / mcu_h;
+    // Grayscale output does not need the chroma samples (they are still entropy decoded).
+    int n_planes = (dst->bpp == IMAGE_BPP_GRAYSCALE) ? 1 : d->n_comp;
+
+    for (int i = 0; i < n_planes; i++) {
+        jpegd_comp_t *c = &d->comp[i];
+        c->scale = n;
+        c->x_shift = d->h_max - c->h; // Sampling factors are 1 or 2.
+        c->y_shift = d->v_max - c->v;
+        // Like libjpeg, spend the spare DCT resolution of subsampled chroma on upsampling.
+        while (c->x_shift && c->y_shift && (c->scale < 8)) {
+            c->scale *= 2;
+            c->x_shift -= 1;
+            c->y_shift -= 1;
+        }
+        c->stride = mcus_x * c->h * c->scale;
+        c->plane = fb_alloc(c->stride * c->v * c->scale, FB_ALLOC_NO_HINT);
+    }
+
+    for (int i = n_planes; i < d->n_comp; i++) {
+        d->comp[i].scale = 1; // Only the DC coefficient is kept.
+    }
+
+    int16_t *blk = fb_alloc(64 * sizeof(int16_t), FB_ALLOC_NO_HINT);
+    int restarts_left = d->restart_interval;
+
+    for (int my = 0, y = 0; my < mcus_y; my++) {
+        for (int mx = 0; mx < mcus_x; mx++) {
+            if (d->restart_interval && (!restarts_left--)) {
+                jpegd_restart(d);
+                restarts_left = d->restart_interval - 1;
+            }
+
+            for (int i = 0; i < d->n_comp; i++) {
+                jpegd_comp_t *c = &d->comp[i];
+                for (int v = 0; v < c->v; v++) {
+                    for (int h = 0; h < c->h; h++) {
+                        memset(blk, 0, 64 * sizeof(int16_t));
+                        jpegd_decode_block(d, c, blk);
+                        if (i < n_planes) {
+                            int cn = c->scale;
+                            uint8_t *out = c->plane + (v * cn * c->stride) + (((mx * c->h) + h) * cn);
+                            jpegd_idct(cn, blk, out, c->stride);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int row = 0, rows = d->v_max * n; (row < rows) && (y < dst->h); row++, y++) {
+            jpegd_put_row(d, dst, y, row);
+        }
+    }
+
+    fb_free(); // blk
+    for (int i = n_planes - 1; i >= 0; i--) {
+        fb_free();
+    }
+}
+
+void jpeg_decompress(image_t *src, image_t *dst)
+{
+    if ((dst->bpp != IMAGE_BPP_GRAYSCALE) && (dst->bpp != IMAGE_BPP_RGB565)) {
+        JPEGD_ERROR("JPEGs can only be decoded to grayscale or RGB565!");
+    }
+
+    jpegd_t *d = fb_alloc0(sizeof(jpegd_t), FB_ALLOC_NO_HINT);
+    d->ptr = src->data;
+    d->end = src->data + src->bpp;
+
+    if ((jpegd_get_word(d) != 0xFFD8)) {
+        JPEGD_ERROR("Not a JPEG!");
+    }
+
+    for (;;) {
+        int marker = jpegd_get_word(d);
+        if ((marker & 0xFF00) != 0xFF00) {
+            JPEGD_ERROR("Corrupted JPEG!");
+        }
+        if ((marker == 0xFFFF) || ((0xFFD0 <= marker) && (marker <= 0xFFD7)) || (marker == 0xFF01)) {
+            d->ptr -= (marker == 0xFFFF); // Fill byte, the next byte may start a marker.
+            continue;
+        }
+        if (marker == 0xFFD9) {
+            JPEGD_ERROR("JPEG has no image data!");
+        }
+
+        int len = jpegd_get_word(d) - 2;
+        if ((len < 0) || ((d->end - d->ptr) < len)) {
+            JPEGD_ERROR("JPEG is truncated!");
+        }
+
+        if ((marker == 0xFFC0) || (marker == 0xFFC1)) {
+            jpegd_read_sof(d, len);
+        } else if ((0xFFC2 <= marker) && (marker <= 0xFFCF) && (marker != 0xFFC4) && (marker != 0xFFC8) && (marker != 0xFFCC)) {
+            JPEGD_ERROR("Only baseline JPEGs are supported!");
+        } else if (marker == 0xFFC4) {
+            jpegd_read_dht(d, len);
+        } else if (marker == 0xFFDB) {
+            jpegd_read_dqt(d, len);
+        } else if (marker == 0xFFDD) {
+            d->restart_interval = (len >= 2) ? ((d->ptr[0] << 8) | d->ptr[1]) : 0;
+            d->ptr += len;
+        } else if (marker == 0xFFDA) {
+            if (!d->n_comp) {
+                JPEGD_ERROR("Corrupted JPEG!");
+            }
+            jpegd_read_sos(d, len);
+            break;
+        } else {
+            d->ptr += len;
+        }
+    }
+
+    // Pick the DCT scaling that produces the destination size.
+    for (d->scale = 8; d->scale; d->scale >>= 1) {
+        int div = 8 / d->scale;
+        if ((dst->w == ((d->w + div - 1) / div)) && (dst->h == ((d->h + div - 1) / div))) {
+            break;
+        }
+    }
+
+    if (!d->scale) {
+        JPEGD_ERROR("JPEGs can only be decoded at 1/1, 1/2, 1/4 or 1/8 scale!");
+    }
+
+    jpegd_decode_scan(d, dst);
+    fb_free(); // d
+}
@@ -0,0 +1,274 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Lossless image compression.
+ *
+ * Each sample is predicted from its left, upper and upper-left neighbours with the
+ * median edge detector of LOCO-I/JPEG-LS and the prediction error is written with
+ * an adaptive Golomb-Rice code, so flat areas cost 1 bit per sample. RGB565 pixels
+ * are coded as G, R-G and B-G to remove most of the correlation between channels.
+ * Bayer images are predicted from the neighbours of the same color.
+ */
+#include <arm_math.h>
+#include "imlib.h"
+
+// Max unary prefix length, longer codes escape to the raw sample value.
+#define LOSSLESS_LIMIT  (16)
+
+typedef struct lossless_ctx {
+    uint32_t a, n;  // Sum of the mapped errors and number of samples for the Rice parameter.
+} lossless_ctx_t;
+
+typedef struct lossless_writer {
+    uint8_t *ptr, *end;
+    uint32_t acc;
+    int bits;
+    bool overflow;
+} lossless_writer_t;
+
+typedef struct lossless_reader {
+    const uint8_t *ptr, *end;
+    uint32_t acc;   // Left aligned bits.
+    int bits;
+    bool error;
+} lossless_reader_t;
+
+static void lossless_ctx_init(lossless_ctx_t *ctx, int bits)
+{
+    ctx->a = IM_MAX(2, ((1 << bits) + 32) / 64);
+    ctx->n = 1;
+}
+
+static inline int lossless_ctx_k(lossless_ctx_t *ctx)
+{
+    int k = 0;
+    while ((ctx->n << k) < ctx->a) {
+        k++;
+    }
+    return k;
+}
+
+static inline void lossless_ctx_update(lossless_ctx_t *ctx, uint32_t u)
+{
+    ctx->a += u;
+    if (++ctx->n == 64) {
+        ctx->a >>= 1;
+        ctx->n >>= 1;
+    }
+}
+
+static inline int lossless_med(int a, int b, int c)
+{
+    int mx = IM_MAX(a, b), mn = IM_MIN(a, b);
+    return (c >= mx) ? mn : ((c <= mn) ? mx : (a + b - c));
+}
+
+static inline void lossless_put_bits(lossless_writer_t *w, uint32_t value, int bits)
+{
+    w->acc = (w->acc << bits) | value;
+    w->bits += bits;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        if (w->ptr == w->end) {
+            w->overflow = true;
+            return;
+        }
+        *w->ptr++ = w->acc >> w->bits;
+    }
+}
+
+static inline uint32_t lossless_get_bits(lossless_reader_t *r, int bits)
+{
+    if (!bits) {
+        return 0;
+    }
+    uint32_t value = r->acc >> (32 - bits);
+    r->acc <<= bits;
+    r->bits -= bits;
+    return value;
+}
+
+static inline void lossless_refill(lossless_reader_t *r)
+{
+    while (r->bits <= 24) {
+        // Zeros are shifted in past the end and caught by the length check at the end.
+        uint32_t byte = (r->ptr < r->end) ? *r->ptr : 0;
+        r->acc |= byte << (24 - r->bits);
+        r->ptr++;
+        r->bits += 8;
+    }
+}
+
+static inline void lossless_encode(lossless_writer_t *w, lossless_ctx_t *ctx, int value, int pred, int bits)
+{
+    int half = 1 << (bits - 1);
+    int e = ((value - pred + half) & ((1 << bits) - 1)) - half;
+    uint32_t u = (e << 1) ^ (e >> 31);
+    int k = lossless_ctx_k(ctx);
+    uint32_t q = u >> k;
+
+    if (q < LOSSLESS_LIMIT) {
+        lossless_put_bits(w, 1, q + 1);
+        lossless_put_bits(w, u & ((1 << k) - 1), k);
+    } else {
+        lossless_put_bits(w, 1, LOSSLESS_LIMIT + 1);
+        lossless_put_bits(w, u, bits);
+    }
+
+    lossless_ctx_update(ctx, u);
+}
+
+static inline int lossless_decode(lossless_reader_t *r, lossless_ctx_t *ctx, int pred, int bits)
+{
+    lossless_refill(r);
+    uint32_t q = __CLZ(r->acc);
+    if (q > LOSSLESS_LIMIT) {
+        r->error = true;
+        return 0;
+    }
+    lossless_get_bits(r, q + 1);
+    lossless_refill(r);
+
+    int k = lossless_ctx_k(ctx);
+    uint32_t u = (q < LOSSLESS_LIMIT) ? ((q << k) | lossless_get_bits(r, k)) : lossless_get_bits(r, bits);
+    int e = (u >> 1) ^ (-(u & 1));
+
+    lossless_ctx_update(ctx, u);
+    return (pred + e) & ((1 << bits) - 1);
+}
+
+// Gets the prediction of a sample from its neighbours dx and dy samples away.
+#define LOSSLESS_PRED(row, up, x, dx, mid) \
+({ \
+    int _a, _b, _c; \
+    if (up) { \
+        _b = (up)[x]; \
+        if ((x) >= (dx)) { _a = (row)[(x) - (dx)]; _c = (up)[(x) - (dx)]; } \
+        else { _a = _c = _b; } \
+    } else { \
+        _a = _b = _c = ((x) >= (dx)) ? (row)[(x) - (dx)] : (mid); \
+    } \
+    lossless_med(_a, _b, _c); \
+})
+
+// Splits an RGB565 pixel into G6, R5-G5 and B5-G5.
+#define LOSSLESS_RGB565_G(p) COLOR_RGB565_TO_G6(p)
+#define LOSSLESS_RGB565_R(p) ((COLOR_RGB565_TO_R5(p) - (COLOR_RGB565_TO_G6(p) >> 1)) & 0x1F)
+#define LOSSLESS_RGB565_B(p) ((COLOR_RGB565_TO_B5(p) - (COLOR_RGB565_TO_G6(p) >> 1)) & 0x1F)
+
+// Predicts one channel of an RGB565 pixel.
+#define LOSSLESS_RGB565_PRED(row, up, x, ch, mid) \
+({ \
+    int _a, _b, _c; \
+    if (up) { \
+        _b = ch((up)[x]); \
+        if (x) { _a = ch((row)[(x) - 1]); _c = ch((up)[(x) - 1]); } \
+        else { _a = _c = _b; } \
+    } else { \
+        _a = _b = _c = (x) ? ch((row)[(x) - 1]) : (mid); \
+    } \
+    lossless_med(_a, _b, _c); \
+})
+
+uint32_t lossless_compress(image_t *src, uint8_t *dst, uint32_t size)
+{
+    lossless_writer_t w = { .ptr = dst, .end = dst + size };
+    lossless_ctx_t ctx[3];
+
+    switch (src->bpp) {
+        case IMAGE_BPP_GRAYSCALE:
+        case IMAGE_BPP_BAYER: {
+            // Bayer samples are predicted from the nearest samples of the same color.
+            int d = (src->bpp == IMAGE_BPP_BAYER) ? 2 : 1;
+            lossless_ctx_init(&ctx[0], 8);
+            for (int y = 0; (y < src->h) && (!w.overflow); y++) {
+                uint8_t *row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(src, y);
+                uint8_t *up = (y >= d) ? IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(src, y - d) : NULL;
+                for (int x = 0; x < src->w; x++) {
+                    lossless_encode(&w, &ctx[0], row[x], LOSSLESS_PRED(row, up, x, d, 128), 8);
+                }
+            }
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            lossless_ctx_init(&ctx[0], 6);
+            lossless_ctx_init(&ctx[1], 5);
+            lossless_ctx_init(&ctx[2], 5);
+            for (int y = 0; (y < src->h) && (!w.overflow); y++) {
+                uint16_t *row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(src, y);
+                uint16_t *up = y ? IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(src, y - 1) : NULL;
+                for (int x = 0; x < src->w; x++) {
+                    uint16_t p = row[x];
+                    lossless_encode(&w, &ctx[0], LOSSLESS_RGB565_G(p),
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_G, 32), 6);
+                    lossless_encode(&w, &ctx[1], LOSSLESS_RGB565_R(p),
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_R, 0), 5);
+                    lossless_encode(&w, &ctx[2], LOSSLESS_RGB565_B(p),
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_B, 0), 5);
+                }
+            }
+            break;
+        }
+        default: {
+            return 0;
+        }
+    }
+
+    if (w.bits) {
+        lossless_put_bits(&w, 0, 8 - w.bits);
+    }
+
+    return w.overflow ? 0 : (w.ptr - dst);
+}
+
+bool lossless_decompress(const uint8_t *src, uint32_t size, image_t *dst)
+{
+    lossless_reader_t r = { .ptr = src, .end = src + size };
+    lossless_ctx_t ctx[3];
+
+    switch (dst->bpp) {
+        case IMAGE_BPP_GRAYSCALE:
+        case IMAGE_BPP_BAYER: {
+            int d = (dst->bpp == IMAGE_BPP_BAYER) ? 2 : 1;
+            lossless_ctx_init(&ctx[0], 8);
+            for (int y = 0; (y < dst->h) && (!r.error); y++) {
+                uint8_t *row = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(dst, y);
+                uint8_t *up = (y >= d) ? IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(dst, y - d) : NULL;
+                for (int x = 0; x < dst->w; x++) {
+                    row[x] = lossless_decode(&r, &ctx[0], LOSSLESS_PRED(row, up, x, d, 128), 8);
+                }
+            }
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            lossless_ctx_init(&ctx[0], 6);
+            lossless_ctx_init(&ctx[1], 5);
+            lossless_ctx_init(&ctx[2], 5);
+            for (int y = 0; (y < dst->h) && (!r.error); y++) {
+                uint16_t *row = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(dst, y);
+                uint16_t *up = y ? IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(dst, y - 1) : NULL;
+                for (int x = 0; x < dst->w; x++) {
+                    int g = lossless_decode(&r, &ctx[0],
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_G, 32), 6);
+                    int rg = lossless_decode(&r, &ctx[1],
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_R, 0), 5);
+                    int bg = lossless_decode(&r, &ctx[2],
+                            LOSSLESS_RGB565_PRED(row, up, x, LOSSLESS_RGB565_B, 0), 5);
+                    row[x] = COLOR_R5_G6_B5_TO_RGB565((rg + (g >> 1)) & 0x1F, g, (bg + (g >> 1)) & 0x1F);
+                }
+            }
+            break;
+        }
+        default: {
+            return true;
+        }
+    }
+
+    // Bytes still in the bit buffer were read ahead and not used.
+    return r.error || ((r.ptr - (r.bits / 8)) > r.end);
+}
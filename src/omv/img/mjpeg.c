@@ -7,28 +7,54 @@
  * This work is licensed under the MIT license, see the file LICENSE for details.
  *
  * A simple MJPEG encoder.
+ *
+ * Files are written with an idx1 index for the first RIFF chunk and an OpenDML
+ * (AVI 2.0) index for all RIFF chunks, so players and the reader below can seek
+ * without scanning the file. Recordings over 1GB continue in RIFF AVIX chunks.
+ *
+ * The frame index is built in a temporary file while recording since it can be
+ * much larger than the available RAM. Each entry holds the file offset and the
+ * size of a frame's data.
  */
+#include <mp.h>
 #include "fb_alloc.h"
 #include "ff_wrapper.h"
 #include "imlib.h"
 
 #define SIZE_OFFSET             (1*4)
 #define MICROS_OFFSET           (8*4)
+#define FLAGS_OFFSET            (11*4)
 #define FRAMES_OFFSET           (12*4)
+#define BUFFER_0_OFFSET         (15*4)
 #define RATE_0_OFFSET           (19*4)
 #define LENGTH_0_OFFSET         (21*4)
 #define RATE_1_OFFSET           (33*4)
 #define LENGTH_1_OFFSET         (35*4)
-#define MOVI_OFFSET             (54*4)
+#define BUFFER_1_OFFSET         (36*4)
+#define INDX_USED_OFFSET        (56*4)
+#define INDX_ENTRIES_OFFSET     (61*4)
+#define ODML_OFFSET             (INDX_ENTRIES_OFFSET + (MJPEG_MAX_SEGMENTS * 16))
+#define DMLH_FRAMES_OFFSET      (ODML_OFFSET + (5*4))
+#define MOVI_OFFSET             (ODML_OFFSET + (69*4))
+
+// OpenDML limits each RIFF chunk to 1GB for compatibility with old players.
+#define RIFF_SIZE_MAX           (1024*1024*1024)
 
-void mjpeg_open(FIL *fp, int width, int height)
+#define AVIF_HASINDEX           (0x10)
+#define AVIIF_KEYFRAME          (0x10)
+#define AVI_INDEX_OF_INDEXES    (0x00)
+#define AVI_INDEX_OF_CHUNKS     (0x01)
+
+void mjpeg_open(mjpeg_t *mjpeg, int width, int height)
 {
+    FIL *fp = &mjpeg->fp;
+
     write_data(fp, "RIFF", 4); // FOURCC fcc; - 0
     write_long(fp, 0); // DWORD cb; size - updated on close - 1
     write_data(fp, "AVI ", 4); // FOURCC fcc; - 2
 
     write_data(fp, "LIST", 4); // FOURCC fcc; - 3
-    write_long(fp, 192); // DWORD cb; - 4
+    write_long(fp, MOVI_OFFSET - 28); // DWORD cb; - 4
     write_data(fp, "hdrl", 4); // FOURCC fcc; - 5
 
     write_data(fp, "avih", 4); // FOURCC fcc; - 6
@@ -36,11 +62,11 @@ void mjpeg_open(FIL *fp, int width, int height)
     write_long(fp, 0); // DWORD dwMicroSecPerFrame; micros - updated on close - 8
     write_long(fp, 0); // DWORD dwMaxBytesPerSec; updated on close - 9
     write_long(fp, 4); // DWORD dwPaddingGranularity; - 10
-    write_long(fp, 0); // DWORD dwFlags; - 11
+    write_long(fp, 0); // DWORD dwFlags; flags - updated on close - 11
     write_long(fp, 0); // DWORD dwTotalFrames; frames - updated on close - 12
     write_long(fp, 0); // DWORD dwInitialFrames; - 13
     write_long(fp, 1); // DWORD dwStreams; - 14
-    write_long(fp, 0); // DWORD dwSuggestedBufferSize; - 15
+    write_long(fp, 0); // DWORD dwSuggestedBufferSize; buffer - updated on close - 15
     write_long(fp, width); // DWORD dwWidth; - 16
     write_long(fp, height); // DWORD dwHeight; - 17
     write_long(fp, 1000); // DWORD dwScale; - 18
@@ -49,7 +75,7 @@ void mjpeg_open(FIL *fp, int width, int height)
     write_long(fp, 0); // DWORD dwLength; length - updated on close - 21
 
     write_data(fp, "LIST", 4); // FOURCC fcc; - 22
-    write_long(fp, 116); // DWORD cb; - 23
+    write_long(fp, ODML_OFFSET - 96); // DWORD cb; - 23
     write_data(fp, "strl", 4); // FOURCC fcc; - 24
 
     write_data(fp, "strh", 4); // FOURCC fcc; - 25
@@ -64,7 +90,7 @@ void mjpeg_open(FIL *fp, int width, int height)
     write_long(fp, 0); // DWORD dwRate; rate - updated on close - 33
     write_long(fp, 0); // DWORD dwStart; - 34
     write_long(fp, 0); // DWORD dwLength; length - updated on close - 35
-    write_long(fp, 0); // DWORD dwSuggestedBufferSize; - 36
+    write_long(fp, 0); // DWORD dwSuggestedBufferSize; buffer - updated on close - 36
     write_long(fp, 10000); // DWORD dwQuality; - 37
     write_long(fp, 0); // DWORD dwSampleSize; - 38
     write_word(fp, 0); // short int left; - 39
@@ -86,20 +112,213 @@ void mjpeg_open(FIL *fp, int width, int height)
     write_long(fp, 0); // DWORD biClrUsed; - 51
     write_long(fp, 0); // DWORD biClrImportant; - 52
 
-    write_data(fp, "LIST", 4); // FOURCC fcc; - 53
-    write_long(fp, 0); // DWORD cb; movi - updated on close - 54
-    write_data(fp, "movi", 4); // FOURCC fcc; - 55
+    write_data(fp, "indx", 4); // FOURCC fcc; - 53
+    write_long(fp, 24 + (MJPEG_MAX_SEGMENTS * 16)); // DWORD cb; - 54
+    write_word(fp, 4); // WORD wLongsPerEntry; - 55
+    write_byte(fp, 0); // BYTE bIndexSubType; - 55.5
+    write_byte(fp, AVI_INDEX_OF_INDEXES); // BYTE bIndexType; - 55.75
+    write_long(fp, 0); // DWORD nEntriesInUse; segments - updated on close - 56
+    write_data(fp, "00dc", 4); // DWORD dwChunkId; - 57
+    write_long(fp, 0); // DWORD dwReserved[0]; - 58
+    write_long(fp, 0); // DWORD dwReserved[1]; - 59
+    write_long(fp, 0); // DWORD dwReserved[2]; - 60
+    for (int i = 0; i < (MJPEG_MAX_SEGMENTS * 4); i++) {
+        write_long(fp, 0); // QWORD qwOffset; DWORD dwSize; DWORD dwDuration; - updated on close - 61
+    }
+
+    write_data(fp, "LIST", 4); // FOURCC fcc;
+    write_long(fp, 260); // DWORD cb;
+    write_data(fp, "odml", 4); // FOURCC fcc;
+
+    write_data(fp, "dmlh", 4); // FOURCC fcc;
+    write_long(fp, 248); // DWORD cb;
+    for (int i = 0; i < 62; i++) {
+        write_long(fp, 0); // DWORD dwTotalFrames; frames - updated on close, DWORD dwReserved[61];
+    }
+
+    write_data(fp, "LIST", 4); // FOURCC fcc;
+    write_long(fp, 0); // DWORD cb; movi - updated on close
+    write_data(fp, "movi", 4); // FOURCC fcc;
+
+    mjpeg->frames = 0;
+    mjpeg->bytes = 0;
+    mjpeg->max_size = 0;
+    mjpeg->riff_offset = 0;
+    mjpeg->movi_offset = MOVI_OFFSET;
+    mjpeg->segment_start = 0;
+    mjpeg->segments = 0;
+    mjpeg->segment_0_frames = 0;
+    mjpeg->idx_count = 0;
+    mjpeg->buf_count = 0;
+}
+
+static void mjpeg_flush(mjpeg_t *mjpeg)
+{
+    if (mjpeg->buf_count) {
+        write_data(&mjpeg->fp, mjpeg->buf, mjpeg->buf_count);
+        mjpeg->buf_count = 0;
+    }
+}
+
+// Returns the file position including the buffered bytes.
+static uint32_t mjpeg_tell(mjpeg_t *mjpeg)
+{
+    return f_tell(&mjpeg->fp) + mjpeg->buf_count;
+}
+
+// The buffer covers the file up to the next multiple of MJPEG_WRITE_BUF_SIZE and is written out when
+// full. Whole blocks starting on a block boundary are written directly.
+static void mjpeg_write(mjpeg_t *mjpeg, const void *data, uint32_t size)
+{
+    FIL *fp = &mjpeg->fp;
+    const uint8_t *ptr = data;
+
+    while (size) {
+        uint32_t space = MJPEG_WRITE_BUF_SIZE - (f_tell(fp) % MJPEG_WRITE_BUF_SIZE) - mjpeg->buf_count;
+
+        if ((space == MJPEG_WRITE_BUF_SIZE) && (size >= MJPEG_WRITE_BUF_SIZE)) {
+            uint32_t n = size - (size % MJPEG_WRITE_BUF_SIZE);
+            write_data(fp, ptr, n);
+            ptr += n;
+            size -= n;
+        } else {
+            uint32_t n = IM_MIN(size, space);
+            memcpy(mjpeg->buf + mjpeg->buf_count, ptr, n);
+            mjpeg->buf_count += n;
+            ptr += n;
+            size -= n;
+
+            if (n == space) {
+                mjpeg_flush(mjpeg);
+            }
+        }
+    }
+}
+
+static void mjpeg_flush_index(mjpeg_t *mjpeg)
+{
+    if (mjpeg->idx_count) {
+        write_data(&mjpeg->idx_fp, mjpeg->idx_buf, mjpeg->idx_count * 8);
+        mjpeg->idx_count = 0;
+    }
+}
+
+// Finishes the current RIFF chunk. The frame index of the chunk is copied from the index file into
+// a standard index (ix00) at the end of the movi list and referenced from the super index (indx).
+// The first RIFF chunk also gets an idx1 index for players that don't support OpenDML.
+static void mjpeg_close_segment(mjpeg_t *mjpeg)
+{
+    FIL *fp = &mjpeg->fp;
+    FIL *idx_fp = &mjpeg->idx_fp;
+    uint32_t frames = mjpeg->frames - mjpeg->segment_start;
+
+    mjpeg_flush(mjpeg);
+    mjpeg_flush_index(mjpeg);
+
+    uint32_t ix_offset = f_tell(fp);
+    write_data(fp, "ix00", 4); // FOURCC fcc;
+    write_long(fp, 24 + (frames * 8)); // DWORD cb;
+    write_word(fp, 2); // WORD wLongsPerEntry;
+    write_byte(fp, 0); // BYTE bIndexSubType;
+    write_byte(fp, AVI_INDEX_OF_CHUNKS); // BYTE bIndexType;
+    write_long(fp, frames); // DWORD nEntriesInUse;
+    write_data(fp, "00dc", 4); // DWORD dwChunkId;
+    write_long(fp, mjpeg->movi_offset); // QWORD qwBaseOffset;
+    write_long(fp, 0);
+    write_long(fp, 0); // DWORD dwReserved;
+
+    // Entries are relative to qwBaseOffset and point to the frame data.
+    file_seek(idx_fp, mjpeg->segment_start * 8);
+    for (uint32_t i = 0; i < frames; i += MJPEG_INDEX_BUF_SIZE) {
+        uint32_t n = IM_MIN(frames - i, MJPEG_INDEX_BUF_SIZE);
+        read_data(idx_fp, mjpeg->idx_buf, n * 8);
+        for (uint32_t j = 0; j < n; j++) {
+            mjpeg->idx_buf[j * 2] -= mjpeg->movi_offset;
+        }
+        write_data(fp, mjpeg->idx_buf, n * 8);
+    }
+
+    uint32_t movi_end = f_tell(fp);
+    file_seek(fp, mjpeg->movi_offset - 4);
+    write_long(fp, movi_end - mjpeg->movi_offset);
+    file_seek(fp, movi_end);
+
+    if (!mjpeg->segments) {
+        // Entries are relative to the movi list type and point to the chunk header.
+        write_data(fp, "idx1", 4); // FOURCC fcc;
+        write_long(fp, frames * 16); // DWORD cb;
+        file_seek(idx_fp, 0);
+        for (uint32_t i = 0; i < frames; i++) {
+            uint32_t entry[2];
+            read_data(idx_fp, entry, sizeof(entry));
+            write_data(fp, "00dc", 4); // DWORD ckid;
+            write_long(fp, AVIIF_KEYFRAME); // DWORD dwFlags;
+            write_long(fp, entry[0] - 8 - mjpeg->movi_offset); // DWORD dwChunkOffset;
+            write_long(fp, entry[1]); // DWORD dwChunkLength;
+        }
+        mjpeg->segment_0_frames = frames;
+    }
+
+    uint32_t riff_end = f_tell(fp);
+    file_seek(fp, mjpeg->riff_offset + SIZE_OFFSET);
+    write_long(fp, riff_end - mjpeg->riff_offset - 8);
+
+    file_seek(fp, INDX_ENTRIES_OFFSET + (mjpeg->segments * 16));
+    write_long(fp, ix_offset); // QWORD qwOffset;
+    write_long(fp, 0);
+    write_long(fp, 32 + (frames * 8)); // DWORD dwSize;
+    write_long(fp, frames); // DWORD dwDuration;
+
+    mjpeg->segments += 1;
+    mjpeg->segment_start = mjpeg->frames;
+    file_seek(fp, riff_end);
+    file_seek(idx_fp, mjpeg->frames * 8);
+}
+
+static void mjpeg_open_segment(mjpeg_t *mjpeg)
+{
+    FIL *fp = &mjpeg->fp;
+    mjpeg->riff_offset = f_tell(fp);
+    write_data(fp, "RIFF", 4); // FOURCC fcc;
+    write_long(fp, 0); // DWORD cb; size - updated on close
+    write_data(fp, "AVIX", 4); // FOURCC fcc;
+    write_data(fp, "LIST", 4); // FOURCC fcc;
+    write_long(fp, 0); // DWORD cb; movi - updated on close
+    write_data(fp, "movi", 4); // FOURCC fcc;
+    mjpeg->movi_offset = mjpeg->riff_offset + 20;
+}
+
+static void mjpeg_write_frame(mjpeg_t *mjpeg, const void *data, uint32_t size)
+{
+    // Start a new RIFF chunk before this one grows over 1GB. The last super index entry is
+    // used for the rest of the file.
+    if ((mjpeg->frames != mjpeg->segment_start)
+    && ((mjpeg_tell(mjpeg) - mjpeg->riff_offset + 8 + size) > RIFF_SIZE_MAX)
+    && (mjpeg->segments < (MJPEG_MAX_SEGMENTS - 1))) {
+        mjpeg_close_segment(mjpeg);
+        mjpeg_open_segment(mjpeg);
+    }
+
+    uint32_t header[2] = { *((uint32_t *) "00dc"), size }; // FOURCC fcc; DWORD cb;
+    mjpeg_write(mjpeg, header, sizeof(header));
+    mjpeg->idx_buf[mjpeg->idx_count * 2 + 0] = mjpeg_tell(mjpeg);
+    mjpeg->idx_buf[mjpeg->idx_count * 2 + 1] = size;
+    mjpeg_write(mjpeg, data, size); // reading past okay
+
+    if (++mjpeg->idx_count == MJPEG_INDEX_BUF_SIZE) {
+        mjpeg_flush_index(mjpeg);
+    }
+
+    mjpeg->frames += 1;
+    mjpeg->bytes += size;
+    mjpeg->max_size = IM_MAX(mjpeg->max_size, size);
 }
 
-void mjpeg_add_frame(FIL *fp, uint32_t *frames, uint32_t *bytes, image_t *img, int quality)
+void mjpeg_add_frame(mjpeg_t *mjpeg, image_t *img, int quality)
 {
-    write_data(fp, "00dc", 4); // FOURCC fcc;
-    *frames += 1;
     if (IM_IS_JPEG(img)) {
         int pad = (((img->bpp + 3) / 4) * 4) - img->bpp;
-        write_long(fp, img->bpp + pad); // DWORD cb;
-        write_data(fp, img->pixels, img->bpp + pad); // reading past okay
-        *bytes += img->bpp + pad;
+        mjpeg_write_frame(mjpeg, img->pixels, img->bpp + pad);
     } else {
         uint32_t size;
         uint8_t *buffer = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE);
@@ -109,43 +328,217 @@ void mjpeg_add_frame(FIL *fp, uint32_t *frames, uint32_t *bytes, image_t *img, i
         // the heap and return NULL which will cause an out of memory error.
         jpeg_compress(img, &out, quality, true);
         int pad = (((out.bpp + 3) / 4) * 4) - out.bpp;
-        write_long(fp, out.bpp + pad); // DWORD cb;
-        write_data(fp, out.pixels, out.bpp + pad); // reading past okay
-        *bytes += out.bpp + pad;
+        mjpeg_write_frame(mjpeg, out.pixels, out.bpp + pad);
         fb_free();
     }
 }
 
-void mjpeg_close(FIL *fp, uint32_t *frames, uint32_t *bytes, float fps)
+void mjpeg_close(mjpeg_t *mjpeg, float fps)
 {
-    // Needed
-    file_seek(fp, SIZE_OFFSET);
-    write_long(fp, 216 + (*frames * 8) + *bytes);
+    FIL *fp = &mjpeg->fp;
+    uint32_t frames = mjpeg->frames;
+
+    mjpeg_close_segment(mjpeg);
+
     // Needed
     file_seek(fp, MICROS_OFFSET);
     write_long(fp, (!fast_roundf(fps)) ? 0 :
             fast_roundf(1000000 / fps));
-    write_long(fp, (!(*frames)) ? 0 :
-            fast_roundf((((*frames * 8) + *bytes) * fps) / *frames));
+    write_long(fp, (!frames) ? 0 :
+            fast_roundf((((frames * 8) + mjpeg->bytes) * fps) / frames));
     // Needed
+    file_seek(fp, FLAGS_OFFSET);
+    write_long(fp, AVIF_HASINDEX);
+    // Needed - only the frames in the first RIFF chunk are counted here.
     file_seek(fp, FRAMES_OFFSET);
-    write_long(fp, *frames);
+    write_long(fp, mjpeg->segment_0_frames);
+    file_seek(fp, BUFFER_0_OFFSET);
+    write_long(fp, mjpeg->max_size + 8);
     // Probably not needed but writing it just in case.
     file_seek(fp, RATE_0_OFFSET);
     write_long(fp, fast_roundf(fps * 1000));
     // Probably not needed but writing it just in case.
     file_seek(fp, LENGTH_0_OFFSET);
-    write_long(fp, (!fast_roundf(fps)) ? 0 :
-            fast_roundf((*frames * 1000) / fps));
-    // Probably not needed but writing it just in case.
+    write_long(fp, frames);
+    // Needed - the stream rate and length are in frames.
     file_seek(fp, RATE_1_OFFSET);
     write_long(fp, fast_roundf(fps * 1000));
-    // Probably not needed but writing it just in case.
     file_seek(fp, LENGTH_1_OFFSET);
-    write_long(fp, (!fast_roundf(fps)) ? 0 :
-            fast_roundf((*frames * 1000) / fps));
+    write_long(fp, frames);
+    file_seek(fp, BUFFER_1_OFFSET);
+    write_long(fp, mjpeg->max_size + 8);
     // Needed
-    file_seek(fp, MOVI_OFFSET);
-    write_long(fp, 4 + (*frames * 8) + *bytes);
+    file_seek(fp, INDX_USED_OFFSET);
+    write_long(fp, mjpeg->segments);
+    file_seek(fp, DMLH_FRAMES_OFFSET);
+    write_long(fp, frames);
     file_close(fp);
+    file_close(&mjpeg->idx_fp);
+}
+
+static void mjpeg_read_fourcc_expect(FIL *fp, const char *fourcc)
+{
+    read_long_expect(fp, *((uint32_t *) fourcc));
+}
+
+void mjpeg_read_open(mjpeg_reader_t *reader)
+{
+    FIL *fp = &reader->fp;
+    uint32_t riff_size, file_size = f_size(fp);
+    uint32_t movi_offset = 0;
+    bool strh = false;
+
+    mjpeg_read_fourcc_expect(fp, "RIFF");
+    read_long(fp, &riff_size);
+    mjpeg_read_fourcc_expect(fp, "AVI ");
+
+    reader->width = 0;
+    reader->height = 0;
+    reader->micros = 0;
+    reader->frames = 0;
+    reader->segments = 0;
+    reader->idx1_offset = 0;
+    reader->idx1_base = 0;
+
+    uint32_t riff_end = IM_MIN(8 + riff_size, file_size);
+    for (uint32_t offset = f_tell(fp); (offset + 8) <= riff_end; offset = f_tell(fp)) {
+        uint32_t fcc, size;
+        read_long(fp, &fcc);
+        read_long(fp, &size);
+
+        if ((offset + 8 + size) > riff_end) {
+            ff_file_corrupted(fp);
+        }
+
+        if (fcc == *((uint32_t *) "LIST")) {
+            uint32_t type;
+            read_long(fp, &type);
+            if (type == *((uint32_t *) "movi")) {
+                // Skip the frames.
+                movi_offset = offset + 8;
+                file_seek(fp, offset + 8 + size);
+            }
+            // Other lists are walked into.
+            continue;
+        } else if (fcc == *((uint32_t *) "avih")) {
+            read_long(fp, &reader->micros);
+            file_seek(fp, offset + 8 + 32);
+            read_long(fp, &reader->width);
+            read_long(fp, &reader->height);
+        } else if ((fcc == *((uint32_t *) "strh")) && (!strh)) {
+            // Only the first stream is read and it must be a video stream.
+            mjpeg_read_fourcc_expect(fp, "vids");
+            strh = true;
+        } else if ((fcc == *((uint32_t *) "indx")) && (!reader->segments)) {
+            uint16_t longs_per_entry;
+            uint8_t sub_type, type;
+            uint32_t entries;
+            read_word(fp, &longs_per_entry);
+            read_byte(fp, &sub_type);
+            read_byte(fp, &type);
+            read_long(fp, &entries);
+            if ((longs_per_entry != 4) || (type != AVI_INDEX_OF_INDEXES) || (entries > MJPEG_MAX_SEGMENTS)) {
+                ff_unsupported_format(fp);
+            }
+            file_seek(fp, offset + 8 + 24);
+            for (uint32_t i = 0; i < entries; i++) {
+                uint32_t offset_hi, ix_size;
+                read_long(fp, &reader->ix_offset[i]);
+                read_long(fp, &offset_hi);
+                read_long(fp, &ix_size);
+                read_long(fp, &reader->ix_frames[i]);
+                if (offset_hi || ((reader->ix_offset[i] + ix_size) > file_size)) {
+                    ff_file_corrupted(fp);
+                }
+                reader->frames += reader->ix_frames[i];
+            }
+            reader->segments = entries;
+        } else if (fcc == *((uint32_t *) "idx1")) {
+            reader->idx1_offset = offset + 8;
+            if (!reader->segments) {
+                reader->frames = size / 16;
+            }
+        }
+
+        file_seek(fp, offset + 8 + size + (size & 1));
+    }
+
+    if ((!strh) || (!movi_offset)) {
+        ff_unsupported_format(fp);
+    }
+
+    if ((!reader->segments) && (!reader->idx1_offset)) {
+        f_close(fp);
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "No frame index!"));
+    }
+
+    if ((!reader->segments) && reader->frames) {
+        // The idx1 offsets are relative to the movi list type in most files but are absolute
+        // in some, which can be detected using the first frame.
+        uint32_t first_offset;
+        file_seek(fp, reader->idx1_offset + 8);
+        read_long(fp, &first_offset);
+        reader->idx1_base = (first_offset < movi_offset) ? movi_offset : 0;
+    }
+}
+
+// Seeks to the data of frame n and returns its size.
+uint32_t mjpeg_seek_frame(mjpeg_reader_t *reader, uint32_t n)
+{
+    FIL *fp = &reader->fp;
+    uint32_t offset, size;
+
+    if (reader->segments) {
+        uint32_t i = 0;
+        for (; (i < reader->segments) && (n >= reader->ix_frames[i]); i++) {
+            n -= reader->ix_frames[i];
+        }
+
+        if (i == reader->segments) {
+            ff_file_corrupted(fp);
+        }
+
+        uint16_t longs_per_entry;
+        uint8_t sub_type, type;
+        uint32_t entries, base, base_hi;
+        file_seek(fp, reader->ix_offset[i] + 8);
+        read_word(fp, &longs_per_entry);
+        read_byte(fp, &sub_type);
+        read_byte(fp, &type);
+        read_long(fp, &entries);
+        read_long_ignore(fp); // dwChunkId
+        read_long(fp, &base);
+        read_long(fp, &base_hi);
+
+        if ((longs_per_entry != 2) || (type != AVI_INDEX_OF_CHUNKS) || (n >= entries) || base_hi) {
+            ff_unsupported_format(fp);
+        }
+
+        file_seek(fp, reader->ix_offset[i] + 32 + (n * 8));
+        read_long(fp, &offset);
+        read_long(fp, &size);
+        offset += base;
+        size &= 0x7FFFFFFF; // Clear the delta frame flag.
+    } else {
+        uint32_t ckid, flags;
+        file_seek(fp, reader->idx1_offset + (n * 16));
+        read_long(fp, &ckid);
+        read_long(fp, &flags);
+        read_long(fp, &offset);
+        read_long(fp, &size);
+
+        // Only video only files are supported.
+        if ((ckid != *((uint32_t *) "00dc")) && (ckid != *((uint32_t *) "00db"))) {
+            ff_unsupported_format(fp);
+        }
+
+        offset += reader->idx1_base + 8;
+    }
+
+    if ((offset + size) > f_size(fp)) {
+        ff_file_corrupted(fp);
+    }
+
+    file_seek(fp, offset);
+    return size;
 }
@@ -22,6 +22,9 @@
 #define PATCH_SIZE  (31) // 31x31 pixels
 #define KDESC_SIZE  (32) // 32 bytes
 #define MAX_KP_DIST (KDESC_SIZE*8)
+// Descriptor byte hashed by each index table and the most keypoints checked per bucket.
+#define ORB_INDEX_STRIDE     (KDESC_SIZE/ORB_INDEX_TABLES)
+#define ORB_INDEX_BUCKET_MAX (32)
 
 typedef struct {
     int x;
@@ -515,7 +518,124 @@ static kp_t *find_best_match(kp_t *kp1, array_t *kpts, int *dist_out1, int *dist
     return min_kp;
 }
 
-int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshold, rectangle_t *r, point_t *c, int *angle)
+static size_t orb_index_bytes(int size)
+{
+    return ((ORB_INDEX_TABLES * (257 + size)) + size) * sizeof(uint16_t);
+}
+
+size_t orb_index_size(array_t *kpts)
+{
+    return orb_index_bytes(array_length(kpts));
+}
+
+static inline kp_t *orb_index_at(orb_index_t *index, int i)
+{
+    return index->kpts ? array_at(index->kpts, i) : &index->block[i];
+}
+
+// The keypoints are either an array or, with kpts NULL, a block of size keypoints.
+static void orb_index_attach(orb_index_t *index, void *buf, array_t *kpts, kp_t *block, int size)
+{
+    index->kpts = kpts;
+    index->block = block;
+    index->size = size;
+    index->offsets = buf;
+    index->indices = index->offsets + (ORB_INDEX_TABLES * 257);
+    index->stamps = index->indices + (ORB_INDEX_TABLES * index->size);
+    index->query = 0;
+    memset(index->stamps, 0, index->size * sizeof(uint16_t));
+}
+
+static void orb_index_build(orb_index_t *index)
+{
+    memset(index->offsets, 0, ORB_INDEX_TABLES * 257 * sizeof(uint16_t));
+
+    // Counting sort of the keypoints by one descriptor byte per table.
+    for (int t=0; t<ORB_INDEX_TABLES; t++) {
+        uint16_t *offsets = index->offsets + (t * 257);
+        uint16_t *indices = index->indices + (t * index->size);
+
+        for (int i=0; i<index->size; i++) {
+            kp_t *kp = orb_index_at(index, i);
+            offsets[kp->desc[t * ORB_INDEX_STRIDE] + 1]++;
+        }
+
+        for (int k=0; k<256; k++) {
+            offsets[k + 1] += offsets[k];
+        }
+
+        for (int i=0; i<index->size; i++) {
+            kp_t *kp = orb_index_at(index, i);
+            indices[offsets[kp->desc[t * ORB_INDEX_STRIDE]]++] = i;
+        }
+
+        // The fill above moved each offset to the end of its bucket.
+        memmove(offsets + 1, offsets, 256 * sizeof(uint16_t));
+        offsets[0] = 0;
+    }
+}
+
+void orb_index_init(orb_index_t *index, void *buf, array_t *kpts)
+{
+    orb_index_attach(index, buf, kpts, NULL, array_length(kpts));
+    orb_index_build(index);
+}
+
+// Like find_best_match() but only keypoints sharing a descriptor byte with kp1 are compared, which
+// almost always includes the true match. The second best distance also comes from those keypoints.
+static kp_t *find_best_match_index(kp_t *kp1, orb_index_t *index, int *dist_out1, int *dist_out2, int *index_out)
+{
+    kp_t *min_kp=NULL;
+    int min_dist1 = MAX_KP_DIST;
+    int min_dist2 = MAX_KP_DIST;
+
+    if (!(++index->query)) {
+        memset(index->stamps, 0, index->size * sizeof(uint16_t));
+        index->query = 1;
+    }
+
+    // Large databases have fuller buckets, the limit only cuts off buckets well above average.
+    int bucket_max = IM_MAX(ORB_INDEX_BUCKET_MAX, index->size / 64);
+
+    for (int t=0; t<ORB_INDEX_TABLES; t++) {
+        uint16_t *offsets = index->offsets + (t * 257);
+        uint16_t *indices = index->indices + (t * index->size);
+        int key = kp1->desc[t * ORB_INDEX_STRIDE];
+
+        for (int j=offsets[key], jj=IM_MIN(offsets[key + 1], j + bucket_max); j<jj; j++) {
+            int i = indices[j];
+            kp_t *kp2 = orb_index_at(index, i);
+
+            if ((index->stamps[i] != index->query) && (kp2->matched == 0)) {
+                int dist = 0;
+                index->stamps[i] = index->query;
+
+                for (int m=0; m<(KDESC_SIZE/4); m++) {
+                    dist += popcount(((uint32_t*)(kp1->desc))[m] ^ ((uint32_t*)(kp2->desc))[m]);
+                }
+
+                // Ties go to the first keypoint like the full scan.
+                if ((dist < min_dist1) || ((dist == min_dist1) && (i < *index_out))) {
+                    *index_out = i;
+                    min_kp = kp2;
+                    min_dist2 = min_dist1;
+                    min_dist1 = dist;
+                } else if (dist < min_dist2) {
+                    min_dist2 = dist;
+                }
+            }
+        }
+    }
+
+    *dist_out1 = min_dist1;
+    *dist_out2 = min_dist2;
+    return min_kp;
+}
+
+// With both indexes only keypoints sharing a descriptor byte are compared, otherwise every pair is.
+// Each index is built once per keypoint set with orb_index_init() and can be reused across calls.
+int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshold, rectangle_t *r, point_t *c, int *angle,
+                        orb_index_t *index1, orb_index_t *index2)
 {
     int matches=0;
     int cx = 0, cy = 0;
@@ -525,6 +645,8 @@ int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshol
     r->w = r->h = 0;
     r->x = r->y = 20000;
 
+    bool index = index1 && index2;
+
     // Match keypoints and find "good matches" This runs 2/3 tests found in the RobustMatcher from the OpenCV programming cookbook.
     // The first test is based on the distance ratio between the two best matches for a feature, to remove ambiguous matches.
     // Second test is the symmetry test (corss-matching) both points in a match must be the best matching feature of each other.
@@ -537,16 +659,21 @@ int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshol
         kp_t *kp1 = array_at(kpts1, i);
 
         // Find the best match in second set
-        min_kp = find_best_match(kp1, kpts2, &min_dist1, &min_dist2, &kp_index2);
-        // Test the distance ratio between the best two matches
-        if ((min_dist1*100/min_dist2) > threshold) {
+        min_kp = index
+            ? find_best_match_index(kp1, index2, &min_dist1, &min_dist2, &kp_index2)
+            : find_best_match(kp1, kpts2, &min_dist1, &min_dist2, &kp_index2);
+        // Test the distance ratio between the best two matches, written to allow a zero second
+        // distance (the index returns equal distances for duplicate descriptors).
+        if ((min_kp == NULL) || ((min_dist1 * 100) >= ((threshold + 1) * min_dist2))) {
             continue;
         }
 
         // Cross-match the keypoint in the first set
-        kp_t *kp2 = find_best_match(min_kp, kpts1, &min_dist1, &min_dist2, &kp_index1);
+        kp_t *kp2 = index
+            ? find_best_match_index(min_kp, index1, &min_dist1, &min_dist2, &kp_index1)
+            : find_best_match(min_kp, kpts1, &min_dist1, &min_dist2, &kp_index1);
         // Test the distance ratio between the best two matches
-        if ((min_dist1*100/min_dist2) > threshold) {
+        if ((min_dist1 * 100) >= ((threshold + 1) * min_dist2)) {
             continue;
         }
 
@@ -675,6 +802,98 @@ int orb_filter_keypoints(array_t *kpts, rectangle_t *r, point_t *c)
     return matches;
 }
 
+static FRESULT orb_write_keypoint(FIL *fp, kp_t *kp)
+{
+    UINT bytes;
+    FRESULT res;
+
+    // Write X
+    res = f_write(fp, &kp->x, sizeof(kp->x), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->x)) {
+        goto error;
+    }
+
+    // Write Y
+    res = f_write(fp, &kp->y, sizeof(kp->y), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->y)) {
+        goto error;
+    }
+
+    // Write Score
+    res = f_write(fp, &kp->score, sizeof(kp->score), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->score)) {
+        goto error;
+    }
+
+    // Write Octave
+    res = f_write(fp, &kp->octave, sizeof(kp->octave), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->octave)) {
+        goto error;
+    }
+
+    // Write Angle
+    res = f_write(fp, &kp->angle, sizeof(kp->angle), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->angle)) {
+        goto error;
+    }
+
+    // Write descriptor
+    res = f_write(fp, kp->desc, KDESC_SIZE, &bytes);
+    if (res != FR_OK || bytes != KDESC_SIZE) {
+        goto error;
+    }
+
+error:
+    return res;
+}
+
+static FRESULT orb_read_keypoint(FIL *fp, kp_t *kp)
+{
+    UINT bytes;
+    FRESULT res;
+
+    kp->matched = 0;
+
+    // Read X
+    res = f_read(fp, &kp->x, sizeof(kp->x), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->x)) {
+        goto error;
+    }
+
+    // Read Y
+    res = f_read(fp, &kp->y, sizeof(kp->y), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->y)) {
+        goto error;
+    }
+
+    // Read Score
+    res = f_read(fp, &kp->score, sizeof(kp->score), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->score)) {
+        goto error;
+    }
+
+    // Read Octave
+    res = f_read(fp, &kp->octave, sizeof(kp->octave), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->octave)) {
+        goto error;
+    }
+
+    // Read Angle
+    res = f_read(fp, &kp->angle, sizeof(kp->angle), &bytes);
+    if (res != FR_OK || bytes != sizeof(kp->angle)) {
+        goto error;
+    }
+
+    // Read descriptor
+    res = f_read(fp, kp->desc,  KDESC_SIZE, &bytes);
+    if (res != FR_OK || bytes != KDESC_SIZE) {
+        goto error;
+    }
+
+error:
+    return res;
+}
+
 int orb_save_descriptor(FIL *fp, array_t *kpts)
 {
     UINT bytes;
@@ -690,41 +909,8 @@ int orb_save_descriptor(FIL *fp, array_t *kpts)
 
     // Write keypoints
     for (int i=0; i<kpts_size; i++) {
-        kp_t *kp = array_at(kpts, i);
-
-        // Write X
-        res = f_write(fp, &kp->x, sizeof(kp->x), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->x)) {
-            goto error;
-        }
-
-        // Write Y
-        res = f_write(fp, &kp->y, sizeof(kp->y), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->y)) {
-            goto error;
-        }
-
-        // Write Score
-        res = f_write(fp, &kp->score, sizeof(kp->score), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->score)) {
-            goto error;
-        }
-
-        // Write Octave
-        res = f_write(fp, &kp->octave, sizeof(kp->octave), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->octave)) {
-            goto error;
-        }
-
-        // Write Angle
-        res = f_write(fp, &kp->angle, sizeof(kp->angle), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->angle)) {
-            goto error;
-        }
-
-        // Write descriptor
-        res = f_write(fp, kp->desc, KDESC_SIZE, &bytes);
-        if (res != FR_OK || bytes != KDESC_SIZE) {
+        res = orb_write_keypoint(fp, array_at(kpts, i));
+        if (res != FR_OK) {
             goto error;
         }
     }
@@ -749,48 +935,303 @@ int orb_load_descriptor(FIL *fp, array_t *kpts)
     // Read keypoints
     for (int i=0; i<kpts_size; i++) {
         kp_t *kp = xalloc(sizeof(*kp));
-        kp->matched = 0;
 
-        // Read X
-        res = f_read(fp, &kp->x, sizeof(kp->x), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->x)) {
+        res = orb_read_keypoint(fp, kp);
+        if (res != FR_OK) {
             goto error;
         }
 
-        // Read Y
-        res = f_read(fp, &kp->y, sizeof(kp->y), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->y)) {
-            goto error;
+        // Add keypoint to array
+        array_push_back(kpts, kp);
+    }
+
+error:
+    return res;
+}
+
+void orb_db_init(orb_db_t *db)
+{
+    db->kpts = NULL;
+    db->size = 0;
+    db->count = 0;
+    db->starts = xalloc0(sizeof(uint16_t));
+    db->indexed = false;
+    db->index.offsets = NULL;
+}
+
+static void orb_db_index_free(orb_db_t *db)
+{
+    if (db->index.offsets) {
+        xfree(db->index.offsets);
+        db->index.offsets = NULL;
+    }
+
+    db->indexed = false;
+}
+
+// Copies the keypoints into the database, returns the model number or -1 if the database is full,
+// which is when the keypoints and their index do not fit in the heap anymore.
+int orb_db_add(orb_db_t *db, array_t *kpts)
+{
+    int kpts_size = array_length(kpts);
+
+    if ((db->size + kpts_size) > ORB_DB_MAX_KEYPOINTS) {
+        return -1;
+    }
+
+    db->starts = xrealloc(db->starts, (db->count + 2) * sizeof(uint16_t));
+
+    // The index is stale anyway, freeing it first leaves more room to grow the keypoints.
+    orb_db_index_free(db);
+
+    kp_t *block = xalloc_try_realloc(db->kpts, (db->size + kpts_size) * sizeof(kp_t));
+    if ((block == NULL) && (db->size + kpts_size)) {
+        return -1;
+    }
+
+    db->kpts = block;
+
+    // Reserve the index memory now so that matching never runs out of heap.
+    db->index.offsets = xalloc_try_alloc(orb_index_bytes(db->size + kpts_size));
+    if (db->index.offsets == NULL) {
+        db->kpts = xrealloc(db->kpts, db->size * sizeof(kp_t));
+        return -1;
+    }
+
+    for (int i=0; i<kpts_size; i++) {
+        kp_t *kp = &db->kpts[db->size + i];
+        memcpy(kp, array_at(kpts, i), sizeof(*kp));
+        kp->matched = 0;
+    }
+
+    db->size += kpts_size;
+    db->starts[db->count + 1] = db->size;
+    return db->count++;
+}
+
+static void orb_db_index(orb_db_t *db)
+{
+    // orb_db_add() reserves the index memory of the stale index.
+    if (db->index.offsets == NULL) {
+        db->index.offsets = xalloc(orb_index_bytes(db->size));
+    }
+
+    orb_index_attach(&db->index, db->index.offsets, NULL, db->kpts, db->size);
+    orb_index_build(&db->index);
+    db->indexed = true;
+}
+
+// Returns the model of the i-th database keypoint, the last model starting at or before it.
+static int orb_db_model(orb_db_t *db, int i)
+{
+    int lo = 0, hi = db->count - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (db->starts[mid] <= i) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
         }
+    }
 
-        // Read Score
-        res = f_read(fp, &kp->score, sizeof(kp->score), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->score)) {
-            goto error;
+    return lo;
+}
+
+// Matches the keypoints against all the models at once and counts the matches of each model.
+// The matches pass the same ratio and cross-match tests as orb_match_keypoints().
+int orb_db_match(orb_db_t *db, array_t *kpts, int threshold, int *counts)
+{
+    int matches=0;
+    int kpts_size = array_length(kpts);
+    memset(counts, 0, db->count * sizeof(int));
+
+    if (!db->indexed) {
+        orb_db_index(db);
+    }
+
+    // The keypoints are indexed for the cross-match too, without enough memory it scans them.
+    orb_index_t index;
+    bool indexed = fb_avail() >= (orb_index_size(kpts) + 64);
+
+    if (indexed) {
+        orb_index_init(&index, fb_alloc(orb_index_size(kpts), FB_ALLOC_NO_HINT), kpts);
+    }
+
+    for (int i=0; i<kpts_size; i++) {
+        int kp_index1 = 0;
+        int kp_index2 = 0;
+        int min_dist1 = 0;
+        int min_dist2 = 0;
+        kp_t *kp1 = array_at(kpts, i);
+
+        // Find the best match in all the models, the ratio test is written to allow a zero second distance.
+        kp_t *min_kp = find_best_match_index(kp1, &db->index, &min_dist1, &min_dist2, &kp_index2);
+        if ((min_kp == NULL) || ((min_dist1 * 100) >= ((threshold + 1) * min_dist2))) {
+            continue;
         }
 
-        // Read Octave
-        res = f_read(fp, &kp->octave, sizeof(kp->octave), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->octave)) {
-            goto error;
+        // Cross-match the keypoint in the frame
+        kp_t *kp2 = indexed
+            ? find_best_match_index(min_kp, &index, &min_dist1, &min_dist2, &kp_index1)
+            : find_best_match(min_kp, kpts, &min_dist1, &min_dist2, &kp_index1);
+        if ((min_dist1 * 100) >= ((threshold + 1) * min_dist2)) {
+            continue;
+        }
+
+        if (kp1 == kp2) {
+            matches++;
+            counts[orb_db_model(db, kp_index2)]++;
         }
+    }
+
+    if (indexed) {
+        fb_free();
+    }
+
+    return matches;
+}
+
+// Database files hold the model count, the model starts, the keypoints like orb_save_descriptor()
+// and the index tables so loading the database does not have to sort the keypoints again.
+int orb_db_save(FIL *fp, orb_db_t *db)
+{
+    UINT bytes;
+    FRESULT res;
+
+    if (!db->indexed) {
+        orb_db_index(db);
+    }
+
+    // Write the number of models
+    res = f_write(fp, &db->count, sizeof(db->count), &bytes);
+    if (res != FR_OK || bytes != sizeof(db->count)) {
+        goto error;
+    }
+
+    // Write model starts
+    UINT size = (db->count + 1) * sizeof(uint16_t);
+    res = f_write(fp, db->starts, size, &bytes);
+    if (res != FR_OK || bytes != size) {
+        goto error;
+    }
+
+    // Write keypoints like orb_save_descriptor()
+    res = f_write(fp, &db->size, sizeof(db->size), &bytes);
+    if (res != FR_OK || bytes != sizeof(db->size)) {
+        goto error;
+    }
 
-        // Read Angle
-        res = f_read(fp, &kp->angle, sizeof(kp->angle), &bytes);
-        if (res != FR_OK || bytes != sizeof(kp->angle)) {
+    for (int i=0; i<db->size; i++) {
+        res = orb_write_keypoint(fp, &db->kpts[i]);
+        if (res != FR_OK) {
             goto error;
         }
+    }
+
+    // Write the offsets and indices tables
+    size = ORB_INDEX_TABLES * (257 + db->index.size) * sizeof(uint16_t);
+    res = f_write(fp, db->index.offsets, size, &bytes);
+    if (res != FR_OK || bytes != size) {
+        goto error;
+    }
+
+error:
+    return res;
+}
+
+// Returns true if the index tables are consistent with the keypoints.
+static bool orb_index_check(orb_index_t *index)
+{
+    for (int t=0; t<ORB_INDEX_TABLES; t++) {
+        uint16_t *offsets = index->offsets + (t * 257);
+        uint16_t *indices = index->indices + (t * index->size);
+
+        if ((offsets[0] != 0) || (offsets[256] != index->size)) {
+            return false;
+        }
+
+        for (int k=0; k<256; k++) {
+            if (offsets[k] > offsets[k + 1]) {
+                return false;
+            }
+        }
+
+        for (int i=0; i<index->size; i++) {
+            if (indices[i] >= index->size) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int orb_db_load(FIL *fp, orb_db_t *db)
+{
+    UINT bytes;
+    FRESULT res;
+
+    int count=0;
+
+    // Read the number of models
+    res = f_read(fp, &count, sizeof(count), &bytes);
+    if (res != FR_OK) {
+        goto error;
+    }
+
+    if (bytes != sizeof(count) || count < 0 || count > UINT16_MAX) {
+        res = FR_INT_ERR;
+        goto error;
+    }
+
+    // Read model starts
+    UINT size = (count + 1) * sizeof(uint16_t);
+    db->starts = xrealloc(db->starts, size);
+    res = f_read(fp, db->starts, size, &bytes);
+    if (res != FR_OK) {
+        goto error;
+    }
+
+    if (bytes != size) {
+        res = FR_INT_ERR;
+        goto error;
+    }
+
+    // Read keypoints into one block
+    int kpts_size=0;
+    res = f_read(fp, &kpts_size, sizeof(kpts_size), &bytes);
+    if (res != FR_OK) {
+        goto error;
+    }
+
+    if (bytes != sizeof(kpts_size) || kpts_size != db->starts[count] || kpts_size > ORB_DB_MAX_KEYPOINTS) {
+        res = FR_INT_ERR;
+        goto error;
+    }
 
-        // Read descriptor
-        res = f_read(fp, kp->desc,  KDESC_SIZE, &bytes);
-        if (res != FR_OK || bytes != KDESC_SIZE) {
+    db->kpts = xalloc(kpts_size * sizeof(kp_t));
+    for (int i=0; i<kpts_size; i++) {
+        res = orb_read_keypoint(fp, &db->kpts[i]);
+        if (res != FR_OK) {
             goto error;
         }
+    }
 
-        // Add keypoint to array
-        array_push_back(kpts, kp);
+    db->size = kpts_size;
+    db->count = count;
+
+    // Read the offsets and indices tables, the index is rebuilt if they are missing or damaged.
+    orb_index_attach(&db->index, xalloc(orb_index_bytes(db->size)), NULL, db->kpts, db->size);
+    size = ORB_INDEX_TABLES * (257 + db->index.size) * sizeof(uint16_t);
+    res = f_read(fp, db->index.offsets, size, &bytes);
+    if ((res != FR_OK) || (bytes != size) || (!orb_index_check(&db->index))) {
+        orb_index_build(&db->index);
     }
 
+    db->indexed = true;
+    res = FR_OK;
+
 error:
     return res;
 }
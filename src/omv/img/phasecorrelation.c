@@ -10,6 +10,7 @@
  */
 #include "imlib.h"
 #include "fft.h"
+#include "xalloc.h"
 
 void imlib_logpolar_int(image_t *dst, image_t *src, rectangle_t *roi, bool linear, bool reverse)
 {
@@ -223,6 +224,7 @@ void imlib_logpolar(image_t *img, bool linear, bool reverse)
     img_2.w = img->w;
     img_2.h = img->h;
     img_2.bpp = img->bpp;
+    img_2.stride = 0;
 
     rectangle_t rect;
     rect.x = 0;
@@ -242,138 +244,198 @@ void imlib_logpolar(image_t *img, bool linear, bool reverse)
 #endif //defined(IMLIB_ENABLE_LOGPOLAR) || defined(IMLIB_ENABLE_LINPOLAR)
 
 #ifdef IMLIB_ENABLE_FIND_DISPLACEMENT
-// Note that both ROI widths and heights must be equal.
-void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, rectangle_t *roi1, bool logpolar, bool fix_rotation_scale,
-                          float *x_translation, float *y_translation, float *rotation, float *scale, float *response)
+// Runs the fft of the roi, or of the log-polar image of the roi which is stored in img_alt. Free
+// with phasecorrelate_fft_dealloc().
+static void phasecorrelate_fft(fft2d_controller_t *fft, image_t *img_alt, image_t *img, rectangle_t *roi, bool logpolar)
 {
-    // Step 1 - Get Rotation/Scale Differences
-    if ((!logpolar) && fix_rotation_scale) {
-        fft2d_controller_t fft0, fft1;
+    if (logpolar) {
+        img_alt->w = roi->w;
+        img_alt->h = roi->h;
+        img_alt->bpp = img->bpp;
+        img_alt->stride = 0;
+        img_alt->data = fb_alloc0(image_size(img_alt), FB_ALLOC_NO_HINT);
+        imlib_logpolar_int(img_alt, img, roi, false, false);
+
+        rectangle_t roi_alt;
+        roi_alt.x = 0;
+        roi_alt.y = 0;
+        roi_alt.w = roi->w;
+        roi_alt.h = roi->h;
+
+        fft2d_alloc(fft, img_alt, &roi_alt);
+    } else {
+        fft2d_alloc(fft, img, roi);
+    }
 
-        fft2d_alloc(&fft0, img0, roi0);
-        fft2d_alloc(&fft1, img1, roi1);
+    fft2d_run(fft);
+}
 
-        fft2d_run(&fft0);
-        fft2d_run(&fft1);
-
-        fft2d_mag(&fft0);
-        fft2d_mag(&fft1);
-
-        fft2d_swap(&fft0);
-        fft2d_swap(&fft1);
-
-        fft2d_logpolar(&fft0);
-        fft2d_logpolar(&fft1);
-
-        fft2d_run_again(&fft0);
-        fft2d_run_again(&fft1);
-
-        int w = (1 << fft0.w_pow2);
-        int h = (1 << fft0.h_pow2);
-
-        for (int i = 0, j = h * w * 2; i < j; i += 2) {
-            float ga_r = fft0.data[i+0];
-            float ga_i = fft0.data[i+1];
-            float gb_r = fft1.data[i+0];
-            float gb_i = -fft1.data[i+1]; // complex conjugate...
-            float hp_r = (ga_r * gb_r) - (ga_i * gb_i); // hadamard product
-            float hp_i = (ga_r * gb_i) + (ga_i * gb_r); // hadamard product
-            float mag = 1 / fast_sqrtf((hp_r*hp_r)+(hp_i*hp_i)); // magnitude
-            // Replace first fft with phase correlation...
-            fft0.data[i+0] = hp_r * mag;
-            fft0.data[i+1] = hp_i * mag;
+static void phasecorrelate_fft_dealloc(bool logpolar)
+{
+    fft2d_dealloc();
+    if (logpolar) fb_free(); // img_alt
+}
+
+// Turns the fft of the roi into the fft of the log-polar image of its magnitude spectrum which
+// does not change with translation.
+static void phasecorrelate_rs_fft(fft2d_controller_t *fft)
+{
+    fft2d_mag(fft);
+    fft2d_swap(fft);
+    fft2d_logpolar(fft);
+    fft2d_run_again(fft);
+}
+
+// Replaces the spectrum of fft0 with its phase correlation against the spectrum data1 and finds
+// the peak. With keep the spectrum of fft0 is moved to data1 as the next reference.
+static void phasecorrelate_peak(fft2d_controller_t *fft0, float *data1, bool keep,
+                                float *x_translation, float *y_translation, float *response)
+{
+    int w = (1 << fft0->w_pow2);
+    int h = (1 << fft0->h_pow2);
+
+    for (int i = 0, j = h * w * 2; i < j; i += 2) {
+        float ga_r = fft0->data[i+0];
+        float ga_i = fft0->data[i+1];
+        float gb_r = data1[i+0];
+        float gb_i = -data1[i+1]; // complex conjugate...
+        float hp_r = (ga_r * gb_r) - (ga_i * gb_i); // hadamard product
+        float hp_i = (ga_r * gb_i) + (ga_i * gb_r); // hadamard product
+        float mag = 1 / fast_sqrtf((hp_r*hp_r)+(hp_i*hp_i)); // magnitude
+        if (keep) {
+            data1[i+0] = ga_r;
+            data1[i+1] = ga_i;
         }
+        // Replace first fft with phase correlation...
+        fft0->data[i+0] = hp_r * mag;
+        fft0->data[i+1] = hp_i * mag;
+    }
 
-        ifft2d_run(&fft0);
-
-        float sum = 0;
-        float max = 0;
-        int off_x = 0;
-        int off_y = 0;
-
-        for (int i = 0; i < h; i++) {
-            for (int j = 0; j < w; j++) {
-                // Note that the output of the FFT is packed with real data in both
-                // the real and imaginary parts... (right side of the array is zero).
-                float f_r = fft0.data[(i * w * 2) + j];
-                sum += f_r;
-                if (f_r > max) {
-                    max = f_r;
-                    off_x = j;
-                    off_y = i;
-                }
+    ifft2d_run(fft0);
+
+    float sum = 0;
+    float max = 0;
+    int off_x = 0;
+    int off_y = 0;
+
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < w; j++) {
+            // Note that the output of the FFT is packed with real data in both
+            // the real and imaginary parts... (right side of the array is zero).
+            float f_r = fft0->data[(i * w * 2) + j];
+            sum += f_r;
+            if (f_r > max) {
+                max = f_r;
+                off_x = j;
+                off_y = i;
             }
         }
+    }
 
-        float tmp_response = max / sum; // normalize this to [0:1].
+    *response = max / sum; // normalize this to [0:1].
 
-        float f_sum = 0;
-        float f_off_x = 0;
-        float f_off_y = 0;
+    float f_sum = 0;
+    float f_off_x = 0;
+    float f_off_y = 0;
 
-        for (int i = -2; i < 2; i++) {
-            for (int j = -2; j < 2; j++) {
+    for (int i = -2; i < 2; i++) {
+        for (int j = -2; j < 2; j++) {
 
-                // Wrap around
-                int new_x = off_x + j;
-                if (new_x < 0) new_x += w;
-                if (new_x >= w) new_x -= w;
+            // Wrap around
+            int new_x = off_x + j;
+            if (new_x < 0) new_x += w;
+            if (new_x >= w) new_x -= w;
 
-                // Wrap around
-                int new_y = off_y + i;
-                if (new_y < 0) new_y += h;
-                if (new_y >= h) new_y -= h;
+            // Wrap around
+            int new_y = off_y + i;
+            if (new_y < 0) new_y += h;
+            if (new_y >= h) new_y -= h;
 
-                // Compute centroid.
-                float f_r = fft0.data[(new_y * w * 2) + new_x];
-                f_off_x += (off_x + j) * f_r; // don't use new_x here
-                f_off_y += (off_y + i) * f_r; // don't use new_y here
-                f_sum += f_r;
-            }
+            // Compute centroid.
+            float f_r = fft0->data[(new_y * w * 2) + new_x];
+            f_off_x += (off_x + j) * f_r; // don't use new_x here
+            f_off_y += (off_y + i) * f_r; // don't use new_y here
+            f_sum += f_r;
         }
+    }
 
-        f_off_x /= f_sum;
-        f_off_y /= f_sum;
+    f_off_x /= f_sum;
+    f_off_y /= f_sum;
 
-        // FFT Shift X
-        if (f_off_x >= (w/2.0f)) {
-            f_off_x = f_off_x - w;
-        } else {
-            f_off_x = f_off_x;
-        }
+    // FFT Shift X
+    if (f_off_x >= (w/2.0f)) {
+        *x_translation = f_off_x - w;
+    } else {
+        *x_translation = f_off_x;
+    }
 
-        // FFT Shift Y
-        if (f_off_y >= (h/2.0f)) {
-            f_off_y = -(f_off_y - h);
-        } else {
-            f_off_y = -f_off_y;
-        }
+    // FFT Shift Y
+    if (f_off_y >= (h/2.0f)) {
+        *y_translation = -(f_off_y - h);
+    } else {
+        *y_translation = -f_off_y;
+    }
+
+    if ((*x_translation < (-w/2.0f))
+    || ((w/2.0f) <= *x_translation)
+    || (*y_translation < (-h/2.0f))
+    || ((h/2.0f) <= *y_translation)
+    || isnanf(*x_translation)
+    || isinff(*x_translation)
+    || isnanf(*y_translation)
+    || isinff(*y_translation)
+    || isnanf(*response)
+    || isinff(*response)) { // Noise Filter
+        *x_translation = 0;
+        *y_translation = 0;
+        *response = 0;
+    }
+}
+
+// Converts a peak of the log-polar phase correlation to rotation and scale.
+static void phasecorrelate_rotation_scale(rectangle_t *roi, float x, float y, float *rotation, float *scale)
+{
+    float w_2 = roi->w / 2.0f;
+    float h_2 = roi->h / 2.0f;
+    float rho_scale = fast_log(fast_sqrtf((w_2 * w_2) + (h_2 * h_2))) / roi->h;
+    float theta_scale = (2 * M_PI) / roi->w;
+
+    *rotation = x * theta_scale;
+    *scale = (y * rho_scale) + 1;
+}
+
+// Without a tracker img1 and roi1 are the reference. With a valid tracker the reference spectra
+// come from the tracker and are replaced by the ones of img0.
+static void phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, rectangle_t *roi1,
+                           phasecorrelate_tracker_t *tracker, bool logpolar, bool fix_rotation_scale,
+                           float *x_translation, float *y_translation, float *rotation, float *scale, float *response)
+{
+    bool fix = (!logpolar) && fix_rotation_scale;
+    // The tracker keeps the spectrum of img0 and not of img0_fixed, it is saved before step 2.
+    float *spectrum = (tracker && fix) ? fb_alloc(tracker->size * sizeof(float), FB_ALLOC_NO_HINT) : NULL;
+
+    // Step 1 - Get Rotation/Scale Differences
+    if (fix) {
+        fft2d_controller_t fft0, fft1;
+
+        fft2d_alloc(&fft0, img0, roi0);
+        fft2d_run(&fft0);
+        if (tracker) memcpy(spectrum, fft0.data, tracker->size * sizeof(float));
+        phasecorrelate_rs_fft(&fft0);
 
-        if ((f_off_x < (-w/2.0f))
-        || ((w/2.0f) <= f_off_x)
-        || (f_off_y < (-h/2.0f))
-        || ((h/2.0f) <= f_off_y)
-        || isnanf(f_off_x)
-        || isinff(f_off_x)
-        || isnanf(f_off_y)
-        || isinff(f_off_y)
-        || isnanf(tmp_response)
-        || isinff(tmp_response)) { // Noise Filter
-            f_off_x = 0;
-            f_off_y = 0;
-            tmp_response = 0;
+        if (!tracker) {
+            fft2d_alloc(&fft1, img1, roi1);
+            fft2d_run(&fft1);
+            phasecorrelate_rs_fft(&fft1);
         }
 
-        fft2d_dealloc(); // fft1
-        fft2d_dealloc(); // fft0
+        float x, y, tmp_response;
+        phasecorrelate_peak(&fft0, tracker ? tracker->rs_spectrum : fft1.data, tracker != NULL, &x, &y, &tmp_response);
 
-        float w_2 = roi0->w / 2.0f;
-        float h_2 = roi0->h / 2.0f;
-        float rho_scale = fast_log(fast_sqrtf((w_2 * w_2) + (h_2 * h_2))) / roi0->h;
-        float theta_scale = (2 * M_PI) / roi0->w;
+        if (!tracker) fft2d_dealloc(); // fft1
+        fft2d_dealloc(); // fft0
 
-        *rotation = f_off_x * theta_scale;
-        *scale = (f_off_y * rho_scale) + 1;
+        phasecorrelate_rotation_scale(roi0, x, y, rotation, scale);
     } else {
         *rotation = 0;
         *scale = 0;
@@ -383,11 +445,12 @@ void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, recta
     rectangle_t roi0_fixed;
 
     // Step 2 - Fix Rotation/Scale Differences
-    if ((!logpolar) && fix_rotation_scale) {
+    if (fix) {
 
         img0_fixed.w = roi0->w;
         img0_fixed.h = roi0->h;
         img0_fixed.bpp = img0->bpp;
+        img0_fixed.stride = 0;
         img0_fixed.data = fb_alloc(image_size(&img0_fixed), FB_ALLOC_NO_HINT);
 
         roi0_fixed.x = 0;
@@ -400,7 +463,7 @@ void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, recta
                 for (int y = roi0->y, yy = roi0->y + roi0->h; y < yy; y++) {
                     uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img0, y);
                     for (int x = roi0->x, xx = roi0->x + roi0->w; x < xx; x++) {
-                        IMAGE_PUT_BINARY_PIXEL(&img0_fixed, x, y, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
+                        IMAGE_PUT_BINARY_PIXEL(&img0_fixed, x - roi0->x, y - roi0->y, IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
                     }
                 }
                 break;
@@ -409,7 +472,7 @@ void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, recta
                 for (int y = roi0->y, yy = roi0->y + roi0->h; y < yy; y++) {
                     uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img0, y);
                     for (int x = roi0->x, xx = roi0->x + roi0->w; x < xx; x++) {
-                        IMAGE_PUT_GRAYSCALE_PIXEL(&img0_fixed, x, y, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
+                        IMAGE_PUT_GRAYSCALE_PIXEL(&img0_fixed, x - roi0->x, y - roi0->y, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
                     }
                 }
                 break;
@@ -418,7 +481,7 @@ void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, recta
                 for (int y = roi0->y, yy = roi0->y + roi0->h; y < yy; y++) {
                     uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img0, y);
                     for (int x = roi0->x, xx = roi0->x + roi0->w; x < xx; x++) {
-                        IMAGE_PUT_RGB565_PIXEL(&img0_fixed, x, y, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
+                        IMAGE_PUT_RGB565_PIXEL(&img0_fixed, x - roi0->x, y - roi0->y, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
                     }
                 }
                 break;
@@ -438,152 +501,96 @@ void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, recta
     // Step 3 - Get Translation Differences
     {
         image_t img0alt, img1alt;
-        rectangle_t roi0alt, roi1alt;
-
-        if (logpolar) {
-            img0alt.w = roi0_fixed.w;
-            img0alt.h = roi0_fixed.h;
-            img0alt.bpp = img0_fixed.bpp;
-            img0alt.data = fb_alloc0(image_size(&img0alt), FB_ALLOC_NO_HINT);
-            imlib_logpolar_int(&img0alt, &img0_fixed, &roi0_fixed, false, false);
-            roi0alt.x = 0;
-            roi0alt.y = 0;
-            roi0alt.w = roi0_fixed.w;
-            roi0alt.h = roi0_fixed.h;
-
-            img1alt.w = roi1->w;
-            img1alt.h = roi1->h;
-            img1alt.bpp = img1->bpp;
-            img1alt.data = fb_alloc0(image_size(&img1alt), FB_ALLOC_NO_HINT);
-            imlib_logpolar_int(&img1alt, img1, roi1, false, false);
-            roi1alt.x = 0;
-            roi1alt.y = 0;
-            roi1alt.w = roi1->w;
-            roi1alt.h = roi1->h;
-        }
-
         fft2d_controller_t fft0, fft1;
 
-        fft2d_alloc(&fft0, logpolar ? &img0alt : &img0_fixed, logpolar ? &roi0alt : &roi0_fixed);
-        fft2d_alloc(&fft1, logpolar ? &img1alt : img1, logpolar ? &roi1alt : roi1);
+        phasecorrelate_fft(&fft0, &img0alt, &img0_fixed, &roi0_fixed, logpolar);
+        if (!tracker) phasecorrelate_fft(&fft1, &img1alt, img1, roi1, logpolar);
 
-        fft2d_run(&fft0);
-        fft2d_run(&fft1);
-
-        int w = (1 << fft0.w_pow2);
-        int h = (1 << fft0.h_pow2);
-
-        for (int i = 0, j = h * w * 2; i < j; i += 2) {
-            float ga_r = fft0.data[i+0];
-            float ga_i = fft0.data[i+1];
-            float gb_r = fft1.data[i+0];
-            float gb_i = -fft1.data[i+1]; // complex conjugate...
-            float hp_r = (ga_r * gb_r) - (ga_i * gb_i); // hadamard product
-            float hp_i = (ga_r * gb_i) + (ga_i * gb_r); // hadamard product
-            float mag = 1 / fast_sqrtf((hp_r*hp_r)+(hp_i*hp_i)); // magnitude
-            fft0.data[i+0] = hp_r * mag;
-            fft0.data[i+1] = hp_i * mag;
-        }
+        phasecorrelate_peak(&fft0, tracker ? tracker->spectrum : fft1.data, (tracker != NULL) && (!fix),
+                            x_translation, y_translation, response);
 
-        ifft2d_run(&fft0);
-
-        float sum = 0;
-        float max = 0;
-        int off_x = 0;
-        int off_y = 0;
-
-        for (int i = 0; i < h; i++) {
-            for (int j = 0; j < w; j++) {
-                // Note that the output of the FFT is packed with real data in both
-                // the real and imaginary parts... (right side of the array is zero).
-                float f_r = fft0.data[(i * w * 2) + j];
-                sum += f_r;
-                if (f_r > max) {
-                    max = f_r;
-                    off_x = j;
-                    off_y = i;
-                }
-            }
-        }
-
-        *response = max / sum; // normalize this to [0:1].
-
-        float f_sum = 0;
-        float f_off_x = 0;
-        float f_off_y = 0;
+        if (!tracker) phasecorrelate_fft_dealloc(logpolar); // fft1
+        phasecorrelate_fft_dealloc(logpolar); // fft0
 
-        for (int i = -2; i < 2; i++) {
-            for (int j = -2; j < 2; j++) {
+        if (logpolar) {
+            phasecorrelate_rotation_scale(roi0, *x_translation, *y_translation, rotation, scale);
+            *x_translation = 0;
+            *y_translation = 0;
+        }
+    }
 
-                // Wrap around
-                int new_x = off_x + j;
-                if (new_x < 0) new_x += w;
-                if (new_x >= w) new_x -= w;
+    if (fix) fb_free(); // img0_fixed
 
-                // Wrap around
-                int new_y = off_y + i;
-                if (new_y < 0) new_y += h;
-                if (new_y >= h) new_y -= h;
+    if (spectrum) {
+        memcpy(tracker->spectrum, spectrum, tracker->size * sizeof(float));
+        fb_free();
+    }
+}
 
-                // Compute centroid.
-                float f_r = fft0.data[(new_y * w * 2) + new_x];
-                f_off_x += (off_x + j) * f_r; // don't use new_x here
-                f_off_y += (off_y + i) * f_r; // don't use new_y here
-                f_sum += f_r;
-            }
-        }
+// Note that both ROI widths and heights must be equal.
+void imlib_phasecorrelate(image_t *img0, image_t *img1, rectangle_t *roi0, rectangle_t *roi1, bool logpolar, bool fix_rotation_scale,
+                          float *x_translation, float *y_translation, float *rotation, float *scale, float *response)
+{
+    phasecorrelate(img0, img1, roi0, roi1, NULL, logpolar, fix_rotation_scale,
+                   x_translation, y_translation, rotation, scale, response);
+}
 
-        f_off_x /= f_sum;
-        f_off_y /= f_sum;
+// Same as imlib_phasecorrelate() with the frame passed in the previous call as img1. The first
+// frame (or the first after the ROI size or the mode changed) only fills the tracker and returns
+// no displacement.
+void imlib_phasecorrelate_tracker(image_t *img, rectangle_t *roi, phasecorrelate_tracker_t *tracker, bool logpolar, bool fix_rotation_scale,
+                                  float *x_translation, float *y_translation, float *rotation, float *scale, float *response)
+{
+    bool fix = (!logpolar) && fix_rotation_scale;
+
+    if (tracker->valid
+    && (tracker->w == roi->w)
+    && (tracker->h == roi->h)
+    && (tracker->logpolar == logpolar)
+    && (tracker->fix_rotation_scale == fix)) {
+        phasecorrelate(img, NULL, roi, NULL, tracker, logpolar, fix_rotation_scale,
+                       x_translation, y_translation, rotation, scale, response);
+        return;
+    }
 
-        // FFT Shift X
-        if (f_off_x >= (w/2.0f)) {
-            *x_translation = f_off_x - w;
-        } else {
-            *x_translation = f_off_x;
-        }
+    image_t img_alt;
+    fft2d_controller_t fft;
+    phasecorrelate_fft(&fft, &img_alt, img, roi, logpolar);
 
-        // FFT Shift Y
-        if (f_off_y >= (h/2.0f)) {
-            *y_translation = -(f_off_y - h);
-        } else {
-            *y_translation = -f_off_y;
-        }
+    int size = 2 * (1 << fft.w_pow2) * (1 << fft.h_pow2);
 
-        if ((*x_translation < (-w/2.0f))
-        || ((w/2.0f) <= *x_translation)
-        || (*y_translation < (-h/2.0f))
-        || ((h/2.0f) <= *y_translation)
-        || isnanf(*x_translation)
-        || isinff(*x_translation)
-        || isnanf(*y_translation)
-        || isinff(*y_translation)
-        || isnanf(*response)
-        || isinff(*response)) { // Noise Filter
-            *x_translation = 0;
-            *y_translation = 0;
-            *response = 0;
-        }
+    if (tracker->size != size) {
+        xfree(tracker->spectrum);
+        xfree(tracker->rs_spectrum);
+        tracker->spectrum = NULL;
+        tracker->rs_spectrum = NULL;
+        tracker->size = 0;
+    }
 
-        fft2d_dealloc(); // fft1
-        fft2d_dealloc(); // fft0
+    tracker->w = roi->w;
+    tracker->h = roi->h;
+    tracker->logpolar = logpolar;
+    tracker->fix_rotation_scale = fix;
+    tracker->valid = false;
 
-        if (logpolar) {
-            fb_free(); // img1alt
-            fb_free(); // img0alt
+    if (!tracker->spectrum) tracker->spectrum = xalloc(size * sizeof(float));
+    if (fix && (!tracker->rs_spectrum)) tracker->rs_spectrum = xalloc(size * sizeof(float));
+    tracker->size = size;
 
-            float w_2 = roi0->w / 2.0f;
-            float h_2 = roi0->h / 2.0f;
-            float rho_scale = fast_log(fast_sqrtf((w_2 * w_2) + (h_2 * h_2))) / roi0->h;
-            float theta_scale = (2 * M_PI) / roi0->w;
+    memcpy(tracker->spectrum, fft.data, size * sizeof(float));
 
-            *rotation = *x_translation * theta_scale;
-            *scale = (*y_translation * rho_scale) + 1;
-            *x_translation = 0;
-            *y_translation = 0;
-        }
+    if (fix) {
+        phasecorrelate_rs_fft(&fft);
+        memcpy(tracker->rs_spectrum, fft.data, size * sizeof(float));
     }
 
-    if ((!logpolar) && fix_rotation_scale) fb_free();
+    phasecorrelate_fft_dealloc(logpolar);
+
+    tracker->valid = true;
+    *x_translation = 0;
+    *y_translation = 0;
+    *rotation = 0;
+    *scale = (logpolar || fix) ? 1 : 0;
+    *response = 0;
 }
 #endif //IMLIB_ENABLE_FIND_DISPLACEMENT
@@ -62,6 +62,7 @@ void ppm_read_geometry(FIL *fp, image_t *img, const char *path, ppm_read_setting
     read_int(fp, (uint32_t *) &img->w, rs);
     read_int(fp, (uint32_t *) &img->h, rs);
     if ((img->w == 0) || (img->h == 0)) ff_file_corrupted(fp);
+    img->stride = 0;
 
     uint32_t max;
     read_int(fp, &max, rs);
@@ -0,0 +1,164 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Remap tables for the lens correction.
+ */
+#include "imlib.h"
+
+#ifdef IMLIB_ENABLE_LENS_CORR
+#define REMAP_ONE   (1 << REMAP_FRAC_BITS)
+#define REMAP_MASK  (REMAP_ONE - 1)
+
+size_t imlib_remap_size(int w, int h)
+{
+    if ((w >= REMAP_MAX_SIZE) || (h >= REMAP_MAX_SIZE)) {
+        return 0;
+    }
+
+    return (((w / 2) + REMAP_GRID - 1) / REMAP_GRID + 1) * (((h / 2) + REMAP_GRID - 1) / REMAP_GRID + 1)
+        * sizeof(remap_point_t);
+}
+
+void imlib_remap_init(remap_t *remap, void *buf, image_t *img, bool bilinear, const float *key)
+{
+    remap->w = img->w;
+    remap->h = img->h;
+    remap->bilinear = bilinear;
+    remap->x_mirror = 0;
+    remap->y_mirror = 0;
+    memcpy(remap->key, key, sizeof(remap->key));
+    remap->points = buf;
+}
+
+bool imlib_remap_match(remap_t *remap, void *buf, image_t *img, bool bilinear, const float *key)
+{
+    return (remap->points == buf)
+        && (remap->w == img->w)
+        && (remap->h == img->h)
+        && (remap->bilinear == bilinear)
+        && (!memcmp(remap->key, key, sizeof(remap->key)));
+}
+
+// Binary pixels are blended as 0 and 1 and so round to the nearest of the 4 pixels.
+// Bilinear samples blend with the pixel to the right and below, the last row and column repeat.
+#define REMAP_SAMPLE(src, x, y, get_row, get_pixel, blend) \
+({ \
+    __typeof__ (src) _src = (src); \
+    int _x = (x), _y = (y); \
+    int _x0 = _x >> REMAP_FRAC_BITS, _y0 = _y >> REMAP_FRAC_BITS; \
+    int _pixel = -1; \
+    if ((0 <= _x0) && (_x0 < _src->w) && (0 <= _y0) && (_y0 < _src->h)) { \
+        __typeof__ (get_row(_src, 0)) _row0 = get_row(_src, _y0); \
+        if (!bilinear) { \
+            _pixel = get_pixel(_row0, _x0); \
+        } else { \
+            int _x1 = IM_MIN(_x0 + 1, _src->w - 1); \
+            __typeof__ (_row0) _row1 = get_row(_src, IM_MIN(_y0 + 1, _src->h - 1)); \
+            _pixel = blend(get_pixel(_row0, _x0), get_pixel(_row0, _x1), \
+                           get_pixel(_row1, _x0), get_pixel(_row1, _x1), \
+                           _x & REMAP_MASK, _y & REMAP_MASK); \
+        } \
+    } \
+    _pixel; \
+})
+
+static inline int remap_blend(int p00, int p01, int p10, int p11, int fx, int fy)
+{
+    int top = (p00 * (REMAP_ONE - fx)) + (p01 * fx);
+    int bottom = (p10 * (REMAP_ONE - fx)) + (p11 * fx);
+    return ((top * (REMAP_ONE - fy)) + (bottom * fy) + (1 << ((2 * REMAP_FRAC_BITS) - 1))) >> (2 * REMAP_FRAC_BITS);
+}
+
+static inline int remap_blend_rgb565(int p00, int p01, int p10, int p11, int fx, int fy)
+{
+    int r = remap_blend(COLOR_RGB565_TO_R5(p00), COLOR_RGB565_TO_R5(p01), COLOR_RGB565_TO_R5(p10), COLOR_RGB565_TO_R5(p11), fx, fy);
+    int g = remap_blend(COLOR_RGB565_TO_G6(p00), COLOR_RGB565_TO_G6(p01), COLOR_RGB565_TO_G6(p10), COLOR_RGB565_TO_G6(p11), fx, fy);
+    int b = remap_blend(COLOR_RGB565_TO_B5(p00), COLOR_RGB565_TO_B5(p01), COLOR_RGB565_TO_B5(p10), COLOR_RGB565_TO_B5(p11), fx, fy);
+    return COLOR_R5_G6_B5_TO_RGB565(r, g, b);
+}
+
+// Copies one source pixel to the destination, pixels mapped outside of the source stay black.
+#define REMAP_PUT(dst_row, dst_x, sx, sy, get_row, get_pixel, put_pixel, blend) \
+do { \
+    int _pixel = REMAP_SAMPLE(&src, (sx), (sy), get_row, get_pixel, blend); \
+    if (_pixel >= 0) { \
+        put_pixel((dst_row), (dst_x), _pixel); \
+    } \
+} while (0)
+
+// Walks the top left quadrant cell by cell, the source coordinates of each row of a cell step
+// linearly between its left and right edges which are interpolated between the grid nodes.
+#define REMAP_LOOP(row_type, get_row, get_pixel, put_pixel, blend) \
+do { \
+    int nodes = ((img->w / 2) + REMAP_GRID - 1) / REMAP_GRID + 1; \
+    for (int y = 0, yy = img->h / 2; y < yy; y++) { \
+        row_type *row_ptr = get_row(img, y); \
+        row_type *row_ptr2 = get_row(img, img->h - 1 - y); \
+        remap_point_t *n0 = remap->points + ((y >> REMAP_GRID_SHIFT) * nodes), *n1 = n0 + nodes; \
+        int fy = y & (REMAP_GRID - 1); \
+        for (int x = 0, xx = img->w / 2; x < xx; x += REMAP_GRID, n0++, n1++) { \
+            int lx = (n0[0].x * (REMAP_GRID - fy)) + (n1[0].x * fy); \
+            int ly = (n0[0].y * (REMAP_GRID - fy)) + (n1[0].y * fy); \
+            int dx = (n0[1].x * (REMAP_GRID - fy)) + (n1[1].x * fy) - lx; \
+            int dy = (n0[1].y * (REMAP_GRID - fy)) + (n1[1].y * fy) - ly; \
+            int vx = lx * REMAP_GRID, vy = ly * REMAP_GRID; \
+            for (int i = x, ii = IM_MIN(x + REMAP_GRID, xx); i < ii; i++, vx += dx, vy += dy) { \
+                int sx_right = ((vx + round) >> shift) << unshift; \
+                int sy_down = ((vy + round) >> shift) << unshift; \
+                int sx_left = remap->x_mirror - sx_right, sy_up = remap->y_mirror - sy_down; \
+                /* Plot the 4 symmetrical pixels. */ \
+                REMAP_PUT(row_ptr, i, sx_right, sy_down, get_row, get_pixel, put_pixel, blend); \
+                REMAP_PUT(row_ptr, img->w - 1 - i, sx_left, sy_down, get_row, get_pixel, put_pixel, blend); \
+                REMAP_PUT(row_ptr2, i, sx_right, sy_up, get_row, get_pixel, put_pixel, blend); \
+                REMAP_PUT(row_ptr2, img->w - 1 - i, sx_left, sy_up, get_row, get_pixel, put_pixel, blend); \
+            } \
+        } \
+    } \
+} while (0)
+
+void imlib_remap(image_t *img, remap_t *remap)
+{
+    bool bilinear = remap->bilinear;
+
+    // Create a tmp copy of the image to pull pixels from.
+    size_t size = image_size(img);
+    image_t src = *img;
+    src.data = fb_alloc(size, FB_ALLOC_NO_HINT);
+    memcpy(src.data, img->data, size);
+    memset(img->data, 0, size);
+
+    // The interpolated coordinates are scaled by REMAP_GRID squared, nearest tables round them to
+    // whole pixels.
+    int shift = (2 * REMAP_GRID_SHIFT) + (bilinear ? 0 : REMAP_FRAC_BITS);
+    int unshift = bilinear ? 0 : REMAP_FRAC_BITS;
+    int round = 1 << (shift - 1);
+
+    switch (img->bpp) {
+        case IMAGE_BPP_BINARY: {
+            REMAP_LOOP(uint32_t, IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR,
+                       IMAGE_GET_BINARY_PIXEL_FAST, IMAGE_PUT_BINARY_PIXEL_FAST, remap_blend);
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            REMAP_LOOP(uint8_t, IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR,
+                       IMAGE_GET_GRAYSCALE_PIXEL_FAST, IMAGE_PUT_GRAYSCALE_PIXEL_FAST, remap_blend);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            REMAP_LOOP(uint16_t, IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR,
+                       IMAGE_GET_RGB565_PIXEL_FAST, IMAGE_PUT_RGB565_PIXEL_FAST, remap_blend_rgb565);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    fb_free();
+}
+#endif // IMLIB_ENABLE_LENS_CORR
@@ -216,6 +216,7 @@ array_t *imlib_selective_search(image_t *src, float t, int min_size, float a1, f
         img->w = width;
         img->h = height;
         img->pixels = fb_alloc(width * height * 2, FB_ALLOC_NO_HINT);
+        img->stride = 0;
         image_scale(src, img); 
     }
 
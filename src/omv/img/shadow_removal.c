@@ -185,6 +185,7 @@ void imlib_remove_shadows(image_t *img, const char *path, image_t *other, int sc
         temp_image.w = img->w;
         temp_image.h = img->h;
         temp_image.bpp = img->bpp;
+        temp_image.stride = 0;
         temp_image.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
 
         memcpy(temp_image.data, img->data, image_size(img));
@@ -202,7 +203,7 @@ void imlib_remove_shadows(image_t *img, const char *path, image_t *other, int sc
         h.LBins = fb_alloc(h.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
         h.ABins = fb_alloc(h.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
         h.BBins = fb_alloc(h.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-        imlib_get_histogram(&h, &temp_image, &r, NULL, false, NULL);
+        imlib_get_histogram(&h, &temp_image, &r, NULL, false, NULL, NULL);
 
         statistics_t s;
         imlib_get_statistics(&s, temp_image.bpp, &h);
@@ -233,7 +234,7 @@ void imlib_remove_shadows(image_t *img, const char *path, image_t *other, int sc
             lnk_data.AMax = COLOR_A_MAX;
             lnk_data.BMax = COLOR_B_MAX;
             list_push_back(&thresholds, &lnk_data);
-            imlib_binary(&temp_image, &temp_image, &thresholds, false, false, NULL);
+            imlib_binary(&temp_image, &temp_image, &thresholds, false, NULL, false, NULL);
             list_free(&thresholds);
 
             imlib_erode(&temp_image, 3, 30, NULL);
@@ -245,6 +246,7 @@ void imlib_remove_shadows(image_t *img, const char *path, image_t *other, int sc
             temp_image_2.w = temp_image.w;
             temp_image_2.h = temp_image.h;
             temp_image_2.bpp = temp_image.bpp;
+            temp_image_2.stride = 0;
             temp_image_2.data = fb_alloc(image_size(&temp_image), FB_ALLOC_NO_HINT);
 
             memcpy(temp_image_2.data, temp_image.data, image_size(&temp_image));
@@ -146,7 +146,7 @@ void imlib_get_similarity(image_t *img, const char *path, image_t *other, int sc
 }
 #endif //IMLIB_ENABLE_GET_SIMILARITY
 
-void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, image_t *other)
+void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, uint8_t *compiled, image_t *other)
 {
     switch(ptr->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -177,39 +177,44 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
             } else {
                 // Reset pixel count.
                 pixel_count = 0;
+                color_thresholds_lut_t lut;
+                imlib_color_thresholds_lut_alloc(&lut, ptr->bpp, roi->w * roi->h, compiled);
                 if (!other) {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x);
-                                if (COLOR_THRESHOLD_BINARY(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_BINARY_MIN) * mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                // A pixel is counted once for each threshold it passes.
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_BINARY(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_BINARY_MIN) * mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 } else {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y), *other_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(other, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x) ^ IMAGE_GET_BINARY_PIXEL_FAST(other_row_ptr, x);
-                                if (COLOR_THRESHOLD_BINARY(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_BINARY_MIN) * mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_BINARY(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_BINARY_MIN) * mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 }
+
+                imlib_color_thresholds_lut_free(&lut);
             }
 
             float pixels = IM_DIV(1, ((float) pixel_count));
@@ -248,39 +253,43 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
             } else {
                 // Reset pixel count.
                 pixel_count = 0;
+                color_thresholds_lut_t lut;
+                imlib_color_thresholds_lut_alloc(&lut, ptr->bpp, roi->w * roi->h, compiled);
                 if (!other) {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                                if (COLOR_THRESHOLD_GRAYSCALE(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_GRAYSCALE_MIN) * mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_GRAYSCALE(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_GRAYSCALE_MIN) * mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 } else {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y), *other_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(other, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = abs(IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x) - IMAGE_GET_GRAYSCALE_PIXEL_FAST(other_row_ptr, x));
-                                if (COLOR_THRESHOLD_GRAYSCALE(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_GRAYSCALE_MIN) * mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_GRAYSCALE(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((pixel - COLOR_GRAYSCALE_MIN) * mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 }
+
+                imlib_color_thresholds_lut_free(&lut);
             }
 
             float pixels = IM_DIV(1, ((float) pixel_count));
@@ -331,28 +340,29 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
             } else {
                 // Reset pixel count.
                 pixel_count = 0;
+                color_thresholds_lut_t lut;
+                imlib_color_thresholds_lut_alloc(&lut, ptr->bpp, roi->w * roi->h, compiled);
                 if (!other) {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
-                                if (COLOR_THRESHOLD_RGB565(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++; // needs to be roundf
-                                    ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++; // needs to be roundf
-                                    ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_RGB565(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)] += n; // needs to be roundf
+                                    ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)] += n; // needs to be roundf
+                                    ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 } else {
-                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; it = iterator_next(it)) {
-                        color_thresholds_list_lnk_data_t lnk_data;
-                        iterator_get(thresholds, it, &lnk_data);
+                    for (list_lnk_t *it = iterator_start_from_head(thresholds); it; ) {
+                        it = imlib_color_thresholds_lut_compile(&lut, thresholds, it, invert);
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y), *other_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(other, y);
@@ -362,16 +372,19 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                                 int g = abs(COLOR_RGB565_TO_G6(pixel) - COLOR_RGB565_TO_G6(other_pixel));
                                 int b = abs(COLOR_RGB565_TO_B5(pixel) - COLOR_RGB565_TO_B5(other_pixel));
                                 pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
-                                if (COLOR_THRESHOLD_RGB565(pixel, &lnk_data, invert)) {
-                                    ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++; // needs to be roundf
-                                    ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++; // needs to be roundf
-                                    ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++; // needs to be roundf
-                                    pixel_count++;
+                                int n = __builtin_popcount(COLOR_THRESHOLDS_LUT_RGB565(&lut, pixel));
+                                if (n) {
+                                    ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)] += n; // needs to be roundf
+                                    ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)] += n; // needs to be roundf
+                                    ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)] += n; // needs to be roundf
+                                    pixel_count += n;
                                 }
                             }
                         }
                     }
                 }
+
+                imlib_color_thresholds_lut_free(&lut);
             }
 
             float pixels = IM_DIV(1, ((float) pixel_count));
@@ -7,6 +7,7 @@
  * This work is licensed under the MIT license, see the file LICENSE for details.
  *
  * Template matching with NCC (Normalized Cross Correlation) using exhaustive and diamond search.
+ * The exhaustive search computes the correlations in the frequency domain for large templates.
  *
  * References:
  * Briechle, Kai, and Uwe D. Hanebeck. "Template matching using fast normalized cross correlation." Aerospace
@@ -19,6 +20,7 @@
 
 #include "imlib.h"
 #include "xalloc.h"
+#include "fft.h"
 
 static void set_dsp(int cx, int cy, point_t *pts, bool sdsp, int step)
 {
@@ -210,6 +212,142 @@ float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r)
     return max_xc;
 }
 
+// The fft2d transforms are limited to 1024 point real rows and 512 point complex columns.
+#define TEMPLATE_FFT_MAX_W_POW2     (10)
+#define TEMPLATE_FFT_MAX_H_POW2     (9)
+// Cost of one 2D transform per element and pass in multiply-adds of the spatial search.
+#define TEMPLATE_FFT_COST           (0.75f)
+
+// Number of tiles of 2^pow2 pixels needed to cover the positions of a template along an axis.
+// Tiles overlap by the template size minus one so every position is in exactly one tile.
+static int template_fft_tiles(int size, int t_size, int pow2)
+{
+    int positions = size - t_size + 1;
+    int tile_positions = (1 << pow2) - t_size + 1;
+    return (positions + tile_positions - 1) / tile_positions;
+}
+
+// Picks the tile size of the frequency domain correlation with the lowest cost that fits in
+// memory. Returns false if the spatial search is cheaper. The spatial search costs one template
+// sized dot product per position searched while the transforms cost the same for any step: one
+// for the template and two per tile.
+static bool template_match_use_fft(image_t *t, rectangle_t *roi, int step, int *w_pow2, int *h_pow2)
+{
+    int positions = (((roi->w - t->w) / step) + 1) * (((roi->h - t->h) / step) + 1);
+    float best = ((float) positions) * t->w * t->h;
+    bool use_fft = false;
+
+    int min_w_pow2 = IM_MAX(2, 32 - __CLZ(t->w - 1)), max_w_pow2 = IM_MIN(TEMPLATE_FFT_MAX_W_POW2, 32 - __CLZ(roi->w - 1));
+    int min_h_pow2 = IM_MAX(1, 32 - __CLZ(t->h - 1)), max_h_pow2 = IM_MIN(TEMPLATE_FFT_MAX_H_POW2, 32 - __CLZ(roi->h - 1));
+
+    for (int i = min_w_pow2; i <= max_w_pow2; i++) {
+        for (int j = min_h_pow2; j <= max_h_pow2; j++) {
+            // Two spectra plus the row and column buffers of the transforms.
+            uint32_t size = (2 * 2 * sizeof(float) * (1 << i) * (1 << j)) + ((8 * sizeof(float)) << IM_MAX(i, j)) + roi->w;
+            if (size > fb_avail()) {
+                continue;
+            }
+
+            int tiles = template_fft_tiles(roi->w, t->w, i) * template_fft_tiles(roi->h, t->h, j);
+            float cost = TEMPLATE_FFT_COST * (1 + (2 * tiles)) * (1 << i) * (1 << j) * (i + j);
+            if (cost < best) {
+                best = cost;
+                use_fft = true;
+                *w_pow2 = i;
+                *h_pow2 = j;
+            }
+        }
+    }
+
+    return use_fft;
+}
+
+// Computes the NCC numerators of all the positions of a tile at once by correlating it with the
+// template in the frequency domain. With c = sum(f * t) the numerator sum((f - f_mean) * (t - t_mean))
+// is c - (t_mean * f_sum) - (f_mean * t_sum) + (n * f_mean * t_mean). The denominators and the
+// positions searched are the same as the spatial search.
+static float template_match_fft(image_t *f, image_t *t, rectangle_t *roi, int step, rectangle_t *r,
+                                i_image_t *sum, i_image_t *sumsq, int t_mean, int t_sum, int den_b,
+                                int w_pow2, int h_pow2)
+{
+    float corr = 0.0f;
+    int n = t->w * t->h;
+    int last_u = roi->x + roi->w - t->w, last_v = roi->y + roi->h - t->h;
+    int tile_w = (1 << w_pow2) - t->w + 1, tile_h = (1 << h_pow2) - t->h + 1; // positions per tile
+    rectangle_t t_roi = { .x = 0, .y = 0, .w = t->w, .h = t->h };
+    fft2d_controller_t fft_t;
+
+    fft2d_alloc_pow2(&fft_t, t, &t_roi, w_pow2, h_pow2);
+    fft2d_run(&fft_t);
+
+    for (int tile_y = roi->y; tile_y <= last_v; tile_y += tile_h) {
+        for (int tile_x = roi->x; tile_x <= last_u; tile_x += tile_w) {
+            rectangle_t tile;
+            tile.x = tile_x;
+            tile.y = tile_y;
+            tile.w = IM_MIN(1 << w_pow2, roi->x + roi->w - tile_x);
+            tile.h = IM_MIN(1 << h_pow2, roi->y + roi->h - tile_y);
+
+            fft2d_controller_t fft_f;
+            fft2d_alloc_pow2(&fft_f, f, &tile, w_pow2, h_pow2);
+            fft2d_run(&fft_f);
+
+            for (int i = 0, j = 2 * (1 << w_pow2) * (1 << h_pow2); i < j; i += 2) {
+                float f_r = fft_f.data[i+0];
+                float f_i = fft_f.data[i+1];
+                float t_r = fft_t.data[i+0];
+                float t_i = -fft_t.data[i+1]; // complex conjugate...
+                fft_f.data[i+0] = (f_r * t_r) - (f_i * t_i);
+                fft_f.data[i+1] = (f_r * t_i) + (f_i * t_r);
+            }
+
+            ifft2d_run(&fft_f);
+
+            // First positions of the search grid in the tile.
+            int u_start = roi->x + ((((tile_x - roi->x) + step - 1) / step) * step);
+            int v_start = roi->y + ((((tile_y - roi->y) + step - 1) / step) * step);
+            int u_end = IM_MIN(tile_x + tile_w - 1, last_u);
+            int v_end = IM_MIN(tile_y + tile_h - 1, last_v);
+
+            for (int v=v_start; v<=v_end; v+=step) {
+                // The real output of a row is in the first half of the row.
+                float *c_row = fft_f.data + ((v - tile_y) * (2 << w_pow2)) - tile_x;
+                for (int u=u_start; u<=u_end; u+=step) {
+                    // The mean of the current patch
+                    uint32_t f_sum = imlib_integral_lookup(sum, u, v, t->w, t->h);
+                    uint32_t f_sumsq = imlib_integral_lookup(sumsq, u, v, t->w, t->h);
+                    uint32_t f_mean = f_sum / (float) n;
+                    uint32_t den_a = f_sumsq - f_sum * (f_sum / (float) n);
+
+                    // Flat patches have no correlation, the transforms would leave round off over 0.
+                    if (!den_a) {
+                        continue;
+                    }
+
+                    float num = c_row[u] - (t_mean * (float) f_sum) - (f_mean * (float) t_sum)
+                              + (n * (float) (f_mean * t_mean));
+
+                    // Find normalized cross-correlation
+                    float c = num/(fast_sqrtf(den_a) * fast_sqrtf(den_b));
+
+                    if (c > corr) {
+                        corr = c;
+                        r->x = u;
+                        r->y = v;
+                        r->w = t->w;
+                        r->h = t->h;
+                    }
+                }
+            }
+
+            fft2d_dealloc(); // fft_f
+        }
+    }
+
+    fft2d_dealloc(); // fft_t
+    return corr;
+}
+
 /* The NCC can be optimized using integral images and rectangular basis functions.
  * See Kai Briechle's paper "Template Matching using Fast Normalized Cross Correlation".
  *
@@ -235,9 +373,19 @@ float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step
     int t_mean = 0;
     imlib_image_mean(t, &t_mean, &t_mean, &t_mean);
 
+    int t_sum = 0;
     for (int i=0; i < (t->w*t->h); i++) {
         int c = (int)t->data[i]-t_mean;
         den_b += c*c;
+        t_sum += t->data[i];
+    }
+
+    int w_pow2, h_pow2;
+    if (template_match_use_fft(t, roi, step, &w_pow2, &h_pow2)) {
+        corr = template_match_fft(f, t, roi, step, r, &sum, &sumsq, t_mean, t_sum, den_b, w_pow2, h_pow2);
+        imlib_integral_image_free(&sum);
+        imlib_integral_image_free(&sumsq);
+        return corr;
     }
 
     for (int v=roi->y; v<=(roi->y+roi->h-t->h); v+=step) {
@@ -247,6 +395,12 @@ float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step
         uint32_t f_sum = imlib_integral_lookup(&sum, u, v, t->w, t->h);
         uint32_t f_sumsq = imlib_integral_lookup(&sumsq, u, v, t->w, t->h);
         uint32_t f_mean = f_sum / (float) (t->w*t->h);
+        uint32_t den_a = f_sumsq - f_sum * (f_sum / (float) (t->w * t->h));
+
+        // Flat patches have no correlation, skipped like in the frequency domain search.
+        if (!den_a) {
+            continue;
+        }
 
         // Normalized sum of squares of the image
         for (int y=v; y<(v+t->h); y++) {
@@ -257,8 +411,6 @@ float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step
             }
         }
 
-        uint32_t den_a = f_sumsq - f_sum * (f_sum / (float) (t->w * t->h));
-
         // Find normalized cross-correlation
         float c = num/(fast_sqrtf(den_a) * fast_sqrtf(den_b));
 
@@ -0,0 +1,474 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2019 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2019 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Affine/perspective warp and resize.
+ */
+#include "imlib.h"
+
+// Source coordinates are stepped in fixed point with this many fraction bits.
+#define WARP_FRAC_BITS      (16)
+#define WARP_ONE            (1 << WARP_FRAC_BITS)
+#define WARP_HALF           (WARP_ONE >> 1)
+// Bilinear weights are reduced to this many bits so the blends fit in 32 bits.
+#define WARP_BLEND_BITS     (8)
+#define WARP_BLEND_ONE      (1 << WARP_BLEND_BITS)
+// Largest source coordinate and step handled by the affine rows.
+#define WARP_COORD_MAX      (16384.0f)
+
+// Resize weights of one axis sum to WARP_WEIGHT_ONE.
+#define WARP_WEIGHT_BITS    (12)
+#define WARP_WEIGHT_ONE     (1 << WARP_WEIGHT_BITS)
+// Horizontally filtered rows keep this many fraction bits.
+#define WARP_ROW_BITS       (8)
+
+////////////////////////
+// Warp               //
+////////////////////////
+
+static inline int warp_blend(int p00, int p01, int p10, int p11, int fx, int fy)
+{
+    int top = (p00 * (WARP_BLEND_ONE - fx)) + (p01 * fx);
+    int bottom = (p10 * (WARP_BLEND_ONE - fx)) + (p11 * fx);
+    return ((top * (WARP_BLEND_ONE - fy)) + (bottom * fy) + (1 << ((2 * WARP_BLEND_BITS) - 1))) >> (2 * WARP_BLEND_BITS);
+}
+
+static inline int warp_blend_rgb565(int p00, int p01, int p10, int p11, int fx, int fy)
+{
+    int r = warp_blend(COLOR_RGB565_TO_R5(p00), COLOR_RGB565_TO_R5(p01), COLOR_RGB565_TO_R5(p10), COLOR_RGB565_TO_R5(p11), fx, fy);
+    int g = warp_blend(COLOR_RGB565_TO_G6(p00), COLOR_RGB565_TO_G6(p01), COLOR_RGB565_TO_G6(p10), COLOR_RGB565_TO_G6(p11), fx, fy);
+    int b = warp_blend(COLOR_RGB565_TO_B5(p00), COLOR_RGB565_TO_B5(p01), COLOR_RGB565_TO_B5(p10), COLOR_RGB565_TO_B5(p11), fx, fy);
+    return COLOR_R5_G6_B5_TO_RGB565(r, g, b);
+}
+
+// The coordinates are biased by half a pixel so that [0, w) covers the source, nearest sampling
+// rounds and bilinear sampling repeats the edge pixels for the outer half pixel.
+#define WARP_SAMPLE(src, u, v, get_row, get_pixel, blend) \
+({ \
+    int _pixel; \
+    if (!bilinear) { \
+        _pixel = get_pixel(get_row((src), (v) >> WARP_FRAC_BITS), (u) >> WARP_FRAC_BITS); \
+    } else { \
+        int _u = IM_MAX((u) - WARP_HALF, 0), _v = IM_MAX((v) - WARP_HALF, 0); \
+        int _x0 = _u >> WARP_FRAC_BITS, _y0 = _v >> WARP_FRAC_BITS; \
+        int _x1 = IM_MIN(_x0 + 1, (src)->w - 1), _y1 = IM_MIN(_y0 + 1, (src)->h - 1); \
+        __typeof__ (get_row((src), 0)) _row0 = get_row((src), _y0); \
+        __typeof__ (_row0) _row1 = get_row((src), _y1); \
+        _pixel = blend(get_pixel(_row0, _x0), get_pixel(_row0, _x1), \
+                       get_pixel(_row1, _x0), get_pixel(_row1, _x1), \
+                       (_u & (WARP_ONE - 1)) >> (WARP_FRAC_BITS - WARP_BLEND_BITS), \
+                       (_v & (WARP_ONE - 1)) >> (WARP_FRAC_BITS - WARP_BLEND_BITS)); \
+    } \
+    _pixel; \
+})
+
+static inline bool warp_inside(int64_t u, int64_t v, image_t *src)
+{
+    return (0 <= u) && (u < (((int64_t) src->w) << WARP_FRAC_BITS))
+        && (0 <= v) && (v < (((int64_t) src->h) << WARP_FRAC_BITS));
+}
+
+// Keeps far away row starts representable in fixed point, they never land inside the source anyway.
+static inline float warp_clamp(float f)
+{
+    return IM_MIN(IM_MAX(f, -WARP_COORD_MAX), WARP_COORD_MAX);
+}
+
+// Returns the range of destination pixels [*xa, *xb) of an affine row that land inside the source.
+// The float estimate is corrected with the same fixed point math the row loop uses.
+static void warp_affine_span(image_t *src, int dst_w, float uf, float vf, float duf, float dvf,
+                             int64_t u, int64_t v, int32_t du, int32_t dv, int *xa, int *xb)
+{
+    float a = 0, b = dst_w;
+
+    if (duf) {
+        float t0 = -uf / duf, t1 = (src->w - uf) / duf;
+        a = IM_MAX(a, IM_MIN(t0, t1));
+        b = IM_MIN(b, IM_MAX(t0, t1));
+    } else if ((uf < 0) || (uf >= src->w)) {
+        b = a;
+    }
+
+    if (dvf) {
+        float t0 = -vf / dvf, t1 = (src->h - vf) / dvf;
+        a = IM_MAX(a, IM_MIN(t0, t1));
+        b = IM_MIN(b, IM_MAX(t0, t1));
+    } else if ((vf < 0) || (vf >= src->h)) {
+        b = a;
+    }
+
+    if (b <= a) {
+        *xa = *xb = 0;
+        return;
+    }
+
+    int x0 = IM_MAX(fast_floorf(a), 0), x1 = IM_MIN(fast_ceilf(b), dst_w);
+
+    // The inside pixels of a row are contiguous, so only the ends need checking.
+    while ((x0 < x1) && (!warp_inside(u + (((int64_t) du) * x0), v + (((int64_t) dv) * x0), src))) x0++;
+    while ((x0 > 0) && warp_inside(u + (((int64_t) du) * (x0 - 1)), v + (((int64_t) dv) * (x0 - 1)), src)) x0--;
+    while ((x1 > x0) && (!warp_inside(u + (((int64_t) du) * (x1 - 1)), v + (((int64_t) dv) * (x1 - 1)), src))) x1--;
+    while ((x1 < dst_w) && warp_inside(u + (((int64_t) du) * x1), v + (((int64_t) dv) * x1), src)) x1++;
+
+    *xa = x0;
+    *xb = x1;
+}
+
+// Affine rows step the source coordinates by a constant, only the span inside the source is sampled.
+#define WARP_AFFINE_LOOP(row_type, get_row, get_pixel, put_pixel, blend) \
+do { \
+    for (int y = 0; y < dst->h; y++) { \
+        row_type *row_ptr = get_row(dst, y); \
+        float uf = warp_clamp((t[1] * y) + t[2] + 0.5f), vf = warp_clamp((t[4] * y) + t[5] + 0.5f); \
+        int64_t u = (int64_t) (uf * WARP_ONE), v = (int64_t) (vf * WARP_ONE); \
+        int xa, xb; \
+        warp_affine_span(src, dst->w, uf, vf, t[0], t[3], u, v, du, dv, &xa, &xb); \
+        for (int x = 0; x < xa; x++) put_pixel(row_ptr, x, 0); \
+        int32_t uu = u + (((int64_t) du) * xa), vv = v + (((int64_t) dv) * xa); \
+        for (int x = xa; x < xb; x++, uu += du, vv += dv) { \
+            put_pixel(row_ptr, x, WARP_SAMPLE(src, uu, vv, get_row, get_pixel, blend)); \
+        } \
+        for (int x = xb; x < dst->w; x++) put_pixel(row_ptr, x, 0); \
+    } \
+} while (0)
+
+// Perspective rows need one division per pixel, the sample position is then fixed point. Like
+// rotation_corr() points of any w are sampled, w == 0 lands nowhere since the division isn't finite.
+#define WARP_PERSPECTIVE_LOOP(row_type, get_row, get_pixel, put_pixel, blend) \
+do { \
+    for (int y = 0; y < dst->h; y++) { \
+        row_type *row_ptr = get_row(dst, y); \
+        float un = (t[1] * y) + t[2], vn = (t[4] * y) + t[5], wn = (t[7] * y) + t[8]; \
+        for (int x = 0; x < dst->w; x++, un += t[0], vn += t[3], wn += t[6]) { \
+            float uf = (un / wn) + 0.5f, vf = (vn / wn) + 0.5f; \
+            int pixel = 0; \
+            if ((0 <= uf) && (uf < src->w) && (0 <= vf) && (vf < src->h)) { \
+                int32_t uu = IM_MIN((int32_t) (uf * WARP_ONE), (src->w << WARP_FRAC_BITS) - 1); \
+                int32_t vv = IM_MIN((int32_t) (vf * WARP_ONE), (src->h << WARP_FRAC_BITS) - 1); \
+                pixel = WARP_SAMPLE(src, uu, vv, get_row, get_pixel, blend); \
+            } \
+            put_pixel(row_ptr, x, pixel); \
+        } \
+    } \
+} while (0)
+
+#define WARP_LOOP(row_type, get_row, get_pixel, put_pixel, blend) \
+do { \
+    if (affine) { \
+        WARP_AFFINE_LOOP(row_type, get_row, get_pixel, put_pixel, blend); \
+    } else { \
+        WARP_PERSPECTIVE_LOOP(row_type, get_row, get_pixel, put_pixel, blend); \
+    } \
+} while (0)
+
+void imlib_warp(image_t *dst, image_t *src, const float *transform, image_hint_t hint)
+{
+    bool bilinear = hint & IMAGE_HINT_BILINEAR;
+    float t[9];
+    memcpy(t, transform, sizeof(t));
+
+    // A homography without a perspective row is an affine transform.
+    bool affine = (!t[6]) && (!t[7]) && t[8];
+
+    if (affine) {
+        for (int i = 0; i < 6; i++) {
+            t[i] /= t[8];
+        }
+    }
+
+    int32_t du = fast_roundf(warp_clamp(t[0]) * WARP_ONE);
+    int32_t dv = fast_roundf(warp_clamp(t[3]) * WARP_ONE);
+
+    switch (src->bpp) {
+        case IMAGE_BPP_BINARY: {
+            WARP_LOOP(uint32_t, IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR,
+                      IMAGE_GET_BINARY_PIXEL_FAST, IMAGE_PUT_BINARY_PIXEL_FAST, warp_blend);
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            WARP_LOOP(uint8_t, IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR,
+                      IMAGE_GET_GRAYSCALE_PIXEL_FAST, IMAGE_PUT_GRAYSCALE_PIXEL_FAST, warp_blend);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            WARP_LOOP(uint16_t, IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR,
+                      IMAGE_GET_RGB565_PIXEL_FAST, IMAGE_PUT_RGB565_PIXEL_FAST, warp_blend_rgb565);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+////////////////////////
+// Resize             //
+////////////////////////
+
+typedef struct warp_tap {
+    uint16_t start;     // First source pixel.
+    uint16_t count;     // Number of source pixels.
+    uint16_t *weights;  // One weight per source pixel, they sum to WARP_WEIGHT_ONE.
+} warp_tap_t;
+
+typedef enum warp_filter {
+    WARP_FILTER_NEAREST,
+    WARP_FILTER_LINEAR,
+    WARP_FILTER_AREA
+} warp_filter_t;
+
+// Upper bound of the number of weights warp_filter_init() writes.
+static int warp_filter_weights(int src_size, int dst_size)
+{
+    return src_size + (dst_size * 2);
+}
+
+// Fills in the taps of every destination pixel of one axis and returns the most taps of any pixel.
+static int warp_filter_init(warp_tap_t *taps, uint16_t *weights, int src_size, int dst_size, warp_filter_t filter)
+{
+    int max_count = 1;
+
+    for (int i = 0; i < dst_size; i++) {
+        warp_tap_t *tap = &taps[i];
+        tap->weights = weights;
+
+        if (filter == WARP_FILTER_AREA) {
+            // The pixel covers [a, b) of the source in WARP_WEIGHT_BITS fixed point.
+            int64_t a = (((int64_t) i) * src_size * WARP_WEIGHT_ONE) / dst_size;
+            int64_t b = (((int64_t) (i + 1)) * src_size * WARP_WEIGHT_ONE) / dst_size;
+            int j0 = a >> WARP_WEIGHT_BITS, j1 = (b - 1) >> WARP_WEIGHT_BITS;
+            int64_t covered = 0;
+            int prev = 0;
+            tap->start = j0;
+            tap->count = j1 - j0 + 1;
+
+            // Rounding the running coverage makes the weights sum to exactly WARP_WEIGHT_ONE.
+            for (int j = j0, k = 0; j <= j1; j++, k++) {
+                covered += IM_MIN(b, ((int64_t) (j + 1)) << WARP_WEIGHT_BITS)
+                         - IM_MAX(a, ((int64_t) j) << WARP_WEIGHT_BITS);
+                int next = ((covered << WARP_WEIGHT_BITS) + ((b - a) >> 1)) / (b - a);
+                weights[k] = next - prev;
+                prev = next;
+            }
+        } else if (filter == WARP_FILTER_LINEAR) {
+            // Pixel centers are aligned, positions past the edge centers repeat the edges.
+            float s = IM_MIN(IM_MAX((((i + 0.5f) * src_size) / dst_size) - 0.5f, 0), src_size - 1);
+            int j = fast_floorf(s);
+            int f = fast_roundf((s - j) * WARP_WEIGHT_ONE);
+            if (f >= WARP_WEIGHT_ONE) {
+                j += 1;
+                f = 0;
+            }
+
+            tap->start = j;
+            if ((!f) || ((j + 1) >= src_size)) {
+                tap->count = 1;
+                weights[0] = WARP_WEIGHT_ONE;
+            } else {
+                tap->count = 2;
+                weights[0] = WARP_WEIGHT_ONE - f;
+                weights[1] = f;
+            }
+        } else {
+            tap->start = ((2 * i + 1) * src_size) / (2 * dst_size);
+            tap->count = 1;
+            weights[0] = WARP_WEIGHT_ONE;
+        }
+
+        weights += tap->count;
+        max_count = IM_MAX(max_count, tap->count);
+    }
+
+    return max_count;
+}
+
+#define WARP_FILTER_ROW(row_ptr, get_pixel) \
+do { \
+    for (int i = 0; i < dst_w; i++) { \
+        warp_tap_t *tap = &taps[i]; \
+        int x = x_offset + tap->start, acc = 0; \
+        for (int k = 0; k < tap->count; k++) { \
+            acc += get_pixel((row_ptr), x + k) * tap->weights[k]; \
+        } \
+        out[i] = (acc + (1 << (WARP_WEIGHT_BITS - WARP_ROW_BITS - 1))) >> (WARP_WEIGHT_BITS - WARP_ROW_BITS); \
+    } \
+} while (0)
+
+// Horizontally filters one source row into out, RGB565 rows are stored as three channel planes.
+static void warp_filter_row(image_t *src, int x_offset, int y, warp_tap_t *taps, int dst_w, uint16_t *out)
+{
+    switch (src->bpp) {
+        case IMAGE_BPP_BINARY: {
+            uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(src, y);
+            WARP_FILTER_ROW(row_ptr, IMAGE_GET_BINARY_PIXEL_FAST);
+            break;
+        }
+        case IMAGE_BPP_GRAYSCALE: {
+            uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(src, y);
+            WARP_FILTER_ROW(row_ptr, IMAGE_GET_GRAYSCALE_PIXEL_FAST);
+            break;
+        }
+        case IMAGE_BPP_RGB565: {
+            uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(src, y);
+            const int shift = WARP_WEIGHT_BITS - WARP_ROW_BITS, round = 1 << (shift - 1);
+            for (int i = 0; i < dst_w; i++) {
+                warp_tap_t *tap = &taps[i];
+                int x = x_offset + tap->start, r_acc = 0, g_acc = 0, b_acc = 0;
+                for (int k = 0; k < tap->count; k++) {
+                    int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + k), weight = tap->weights[k];
+                    r_acc += COLOR_RGB565_TO_R5(pixel) * weight;
+                    g_acc += COLOR_RGB565_TO_G6(pixel) * weight;
+                    b_acc += COLOR_RGB565_TO_B5(pixel) * weight;
+                }
+                out[i] = (r_acc + round) >> shift;
+                out[i + dst_w] = (g_acc + round) >> shift;
+                out[i + (dst_w * 2)] = (b_acc + round) >> shift;
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// Drops the fraction bits of a vertically summed filtered row.
+#define WARP_ROUND(acc) (((acc) + (1 << (WARP_ROW_BITS + WARP_WEIGHT_BITS - 1))) >> (WARP_ROW_BITS + WARP_WEIGHT_BITS))
+
+#define WARP_COLUMN(c) \
+({ \
+    int _acc = 0; \
+    for (int k = 0; k < y_tap->count; k++) { \
+        _acc += rows[k][(c)] * y_tap->weights[k]; \
+    } \
+    WARP_ROUND(_acc); \
+})
+
+// Nearest resizing only gathers pixels.
+#define WARP_NEAREST_LOOP(row_type, get_row, get_pixel, put_pixel) \
+do { \
+    for (int y = 0; y < dst->h; y++) { \
+        row_type *src_row_ptr = get_row(src, roi->y + y_taps[y].start); \
+        row_type *dst_row_ptr = get_row(dst, y); \
+        for (int x = 0; x < dst->w; x++) { \
+            put_pixel(dst_row_ptr, x, get_pixel(src_row_ptr, roi->x + x_taps[x].start)); \
+        } \
+    } \
+} while (0)
+
+void imlib_resize(image_t *dst, image_t *src, rectangle_t *roi, image_hint_t hint)
+{
+    // Downscaling averages the covered area, upscaling interpolates, each axis on its own.
+    warp_filter_t filter = (hint & (IMAGE_HINT_AREA | IMAGE_HINT_BILINEAR)) ? WARP_FILTER_LINEAR : WARP_FILTER_NEAREST;
+    warp_filter_t x_filter = ((dst->w < roi->w) && (hint & IMAGE_HINT_AREA)) ? WARP_FILTER_AREA : filter;
+    warp_filter_t y_filter = ((dst->h < roi->h) && (hint & IMAGE_HINT_AREA)) ? WARP_FILTER_AREA : filter;
+
+    int channels = (src->bpp == IMAGE_BPP_RGB565) ? 3 : 1;
+    int row_len = dst->w * channels;
+
+    warp_tap_t *x_taps = fb_alloc(dst->w * sizeof(warp_tap_t), FB_ALLOC_NO_HINT);
+    uint16_t *x_weights = fb_alloc(warp_filter_weights(roi->w, dst->w) * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    warp_tap_t *y_taps = fb_alloc(dst->h * sizeof(warp_tap_t), FB_ALLOC_NO_HINT);
+    uint16_t *y_weights = fb_alloc(warp_filter_weights(roi->h, dst->h) * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    warp_filter_init(x_taps, x_weights, roi->w, dst->w, x_filter);
+    int ring_size = warp_filter_init(y_taps, y_weights, roi->h, dst->h, y_filter);
+
+    if ((x_filter == WARP_FILTER_NEAREST) && (y_filter == WARP_FILTER_NEAREST)) {
+        switch (dst->bpp) {
+            case IMAGE_BPP_BINARY: {
+                WARP_NEAREST_LOOP(uint32_t, IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR,
+                                  IMAGE_GET_BINARY_PIXEL_FAST, IMAGE_PUT_BINARY_PIXEL_FAST);
+                break;
+            }
+            case IMAGE_BPP_GRAYSCALE: {
+                WARP_NEAREST_LOOP(uint8_t, IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR,
+                                  IMAGE_GET_GRAYSCALE_PIXEL_FAST, IMAGE_PUT_GRAYSCALE_PIXEL_FAST);
+                break;
+            }
+            case IMAGE_BPP_RGB565: {
+                WARP_NEAREST_LOOP(uint16_t, IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR,
+                                  IMAGE_GET_RGB565_PIXEL_FAST, IMAGE_PUT_RGB565_PIXEL_FAST);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+
+        fb_free(); // y_weights
+        fb_free(); // y_taps
+        fb_free(); // x_weights
+        fb_free(); // x_taps
+        return;
+    }
+
+    // Filtered source row r lives in slot r % ring_size. The taps of the destination rows only move
+    // forward, so a row is overwritten after the last destination row that needs it.
+    uint16_t *ring = fb_alloc(ring_size * row_len * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    int *ring_tags = fb_alloc(ring_size * sizeof(int), FB_ALLOC_NO_HINT);
+    uint16_t **rows = fb_alloc(ring_size * sizeof(uint16_t *), FB_ALLOC_NO_HINT);
+
+    for (int i = 0; i < ring_size; i++) {
+        ring_tags[i] = -1;
+    }
+
+    for (int y = 0; y < dst->h; y++) {
+        warp_tap_t *y_tap = &y_taps[y];
+
+        for (int k = 0; k < y_tap->count; k++) {
+            int r = y_tap->start + k, slot = r % ring_size;
+            rows[k] = ring + (slot * row_len);
+
+            if (ring_tags[slot] != r) {
+                warp_filter_row(src, roi->x, roi->y + r, x_taps, dst->w, rows[k]);
+                ring_tags[slot] = r;
+            }
+        }
+
+        switch (dst->bpp) {
+            case IMAGE_BPP_BINARY: {
+                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(dst, y);
+                for (int x = 0; x < dst->w; x++) {
+                    IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr, x, WARP_COLUMN(x));
+                }
+                break;
+            }
+            case IMAGE_BPP_GRAYSCALE: {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(dst, y);
+                for (int x = 0; x < dst->w; x++) {
+                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, WARP_COLUMN(x));
+                }
+                break;
+            }
+            case IMAGE_BPP_RGB565: {
+                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(dst, y);
+                for (int x = 0; x < dst->w; x++) {
+                    int r_acc = 0, g_acc = 0, b_acc = 0;
+                    for (int k = 0; k < y_tap->count; k++) {
+                        int weight = y_tap->weights[k];
+                        r_acc += rows[k][x] * weight;
+                        g_acc += rows[k][x + dst->w] * weight;
+                        b_acc += rows[k][x + (dst->w * 2)] * weight;
+                    }
+                    IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr, x, COLOR_R5_G6_B5_TO_RGB565(WARP_ROUND(r_acc), WARP_ROUND(g_acc), WARP_ROUND(b_acc)));
+                }
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    fb_free(); // rows
+    fb_free(); // ring_tags
+    fb_free(); // ring
+    fb_free(); // y_weights
+    fb_free(); // y_taps
+    fb_free(); // x_weights
+    fb_free(); // x_taps
+}
@@ -571,6 +571,7 @@ static int snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
         image->h = MAIN_FB()->v;
         image->bpp = MAIN_FB()->bpp; // invalid
         image->data = MAIN_FB()->pixels; // valid
+        image->stride = 0;
 
         uint16_t *src = (uint16_t*) vospi_buffer;
 
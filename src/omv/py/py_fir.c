@@ -763,6 +763,7 @@ mp_obj_t py_fir_snapshot(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
     image.w = width;
     image.h = height;
     image.bpp = (pixformat == PIXFORMAT_RGB565) ? IMAGE_BPP_RGB565 : IMAGE_BPP_GRAYSCALE;
+    image.stride = 0;
     image.data = NULL;
 
     if (copy_to_fb) {
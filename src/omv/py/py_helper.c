@@ -12,6 +12,7 @@
 #include "py_helper.h"
 
 extern void *py_image_cobj(mp_obj_t img_obj);
+extern void *py_image_cobj_strided(mp_obj_t img_obj);
 
 mp_obj_t py_func_unavailable(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
@@ -34,6 +35,22 @@ image_t *py_helper_arg_to_image_mutable_bayer(const mp_obj_t arg)
     return arg_img;
 }
 
+// The strided versions pass views through as is. Only use them for methods
+// which access pixels through the IMAGE_* row pointer and pixel macros.
+image_t *py_helper_arg_to_image_mutable_strided(const mp_obj_t arg)
+{
+    image_t *arg_img = py_image_cobj_strided(arg);
+    PY_ASSERT_TRUE_MSG(IMAGE_IS_MUTABLE(arg_img), "Image is not mutable!");
+    return arg_img;
+}
+
+image_t *py_helper_arg_to_image_mutable_bayer_strided(const mp_obj_t arg)
+{
+    image_t *arg_img = py_image_cobj_strided(arg);
+    PY_ASSERT_TRUE_MSG(IMAGE_IS_MUTABLE_BAYER(arg_img), "Image is not mutable!");
+    return arg_img;
+}
+
 image_t *py_helper_arg_to_image_grayscale(const mp_obj_t arg)
 {
     image_t *arg_img = py_image_cobj(arg);
@@ -371,7 +388,7 @@ mp_obj_t py_helper_keyword_object(uint n_args, const mp_obj_t *args, uint arg_in
 
 bool py_helper_is_equal_to_framebuffer(image_t *img)
 {
-    return framebuffer_get_buffer() == img->data;
+    return (!IMAGE_IS_VIEW(img)) && (framebuffer_get_buffer() == img->data);
 }
 
 void py_helper_update_framebuffer(image_t *img)
@@ -386,5 +403,6 @@ void py_helper_set_to_framebuffer(image_t *img)
     PY_ASSERT_TRUE_MSG((image_size(img) <= framebuffer_get_buffer_size()),
             "The image doesn't fit in the frame buffer!");
     framebuffer_set(img->w, img->h, img->bpp);
+    framebuffer_new_frame();
     img->data = framebuffer_get_buffer();
 }
@@ -15,6 +15,8 @@
 extern const mp_obj_fun_builtin_var_t py_func_unavailable_obj;
 image_t *py_helper_arg_to_image_mutable(const mp_obj_t arg);
 image_t *py_helper_arg_to_image_mutable_bayer(const mp_obj_t arg);
+image_t *py_helper_arg_to_image_mutable_strided(const mp_obj_t arg);
+image_t *py_helper_arg_to_image_mutable_bayer_strided(const mp_obj_t arg);
 image_t *py_helper_arg_to_image_grayscale(const mp_obj_t arg);
 image_t *py_helper_arg_to_image_color(const mp_obj_t arg);
 image_t *py_helper_keyword_to_image_mutable(uint n_args, const mp_obj_t *args, uint arg_index,
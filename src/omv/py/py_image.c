@@ -65,6 +65,7 @@ typedef struct _py_kp_obj_t {
     array_t *kpts;
     int threshold;
     bool normalized;
+    orb_index_t index;  // Built by the first match_descriptor(index=True) call.
 } py_kp_obj_t;
 
 static void py_kp_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
@@ -115,6 +116,77 @@ py_kp_obj_t *py_kpts_obj(mp_obj_t kpts_obj)
     return kpts_obj;
 }
 
+// Returns the index of the keypoints, built once and kept with them. Returns NULL if there's no
+// heap memory left for it, the keypoints are then matched without it.
+static orb_index_t *py_kpts_index(py_kp_obj_t *self)
+{
+    if (!self->index.kpts) {
+        void *buf = xalloc_try_alloc(orb_index_size(self->kpts));
+        if (!buf) {
+            return NULL;
+        }
+
+        orb_index_init(&self->index, buf, self->kpts);
+    }
+
+    return &self->index;
+}
+
+// Keypoints database object /////////////////////////////////////////////////
+
+typedef struct _py_kp_db_obj_t {
+    mp_obj_base_t base;
+    orb_db_t _cobj;
+} py_kp_db_obj_t;
+
+static void py_kp_db_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_kp_db_obj_t *self = self_in;
+    mp_printf(print, "{\"models\":%d, \"size\":%d}", self->_cobj.count, self->_cobj.size);
+}
+
+mp_obj_t py_kp_db_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    py_kp_db_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->_cobj.count);
+
+        default:
+            return MP_OBJ_NULL; // op not supported
+    }
+}
+
+static mp_obj_t py_kp_db_add(mp_obj_t self_in, mp_obj_t kpts_obj)
+{
+    py_kp_db_obj_t *self = self_in;
+    int model = orb_db_add(&self->_cobj, py_kpts_obj(kpts_obj)->kpts);
+    PY_ASSERT_TRUE_MSG((model >= 0), "Keypoints database is full! Not enough heap for the keypoints and their index.");
+    return mp_obj_new_int(model);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_kp_db_add_obj, py_kp_db_add);
+
+STATIC const mp_rom_map_elem_t py_kp_db_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_add), MP_ROM_PTR(&py_kp_db_add_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(py_kp_db_locals_dict, py_kp_db_locals_dict_table);
+
+static const mp_obj_type_t py_kp_db_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_kp_db,
+    .print = py_kp_db_print,
+    .unary_op = py_kp_db_unary_op,
+    .locals_dict = (mp_obj_t) &py_kp_db_locals_dict
+};
+
+static py_kp_db_obj_t *py_kp_db_new()
+{
+    py_kp_db_obj_t *o = m_new_obj(py_kp_db_obj_t);
+    o->base.type = &py_kp_db_type;
+    orb_db_init(&o->_cobj);
+    return o;
+}
+
 #endif // IMLIB_ENABLE_FIND_KEYPOINTS
 
 // LBP descriptor /////////////////////////////////////////////////////////////
@@ -139,6 +211,192 @@ static const mp_obj_type_t py_lbp_type = {
 
 #endif // IMLIB_ENABLE_FIND_LBP
 
+// Remap table ////////////////////////////////////////////////////////////////
+
+#ifdef IMLIB_ENABLE_LENS_CORR
+
+typedef struct _py_remap_obj_t {
+    mp_obj_base_t base;
+    remap_t _cobj;
+    void *buf; // Heap memory of the table, kept across calls.
+    bool bilinear;
+    bool used; // The last correction went through the table and not the direct path.
+} py_remap_obj_t;
+
+static void py_remap_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_remap_obj_t *self = self_in;
+    mp_printf(print, "{\"bilinear\":%d, \"size\":%d, \"used\":%d}",
+              self->bilinear, self->buf ? gc_nbytes(self->buf) : 0, self->used);
+}
+
+static const mp_obj_type_t py_remap_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_remap_table,
+    .print = py_remap_print,
+};
+
+// Returns the remap table object with a buffer large enough for the correction of img, or NULL to
+// correct the image directly when no table was passed or the heap is too small for it.
+static py_remap_obj_t *py_remap_obj(mp_obj_t remap_obj, image_t *img)
+{
+    if (!remap_obj) {
+        return NULL;
+    }
+
+    PY_ASSERT_TYPE(remap_obj, &py_remap_type);
+    py_remap_obj_t *self = remap_obj;
+    self->used = false;
+
+    size_t size = imlib_remap_size(img->w, img->h);
+    if (!size) {
+        return NULL;
+    }
+
+    if (self->buf && (gc_nbytes(self->buf) < size)) {
+        xfree(self->buf);
+        self->buf = NULL;
+    }
+
+    if (!self->buf) {
+        self->buf = xalloc_try_alloc(size);
+    }
+
+    return self->buf ? self : NULL;
+}
+
+#endif // IMLIB_ENABLE_LENS_CORR
+
+// Thresholds Object //////////////////////////////////////////////////////////
+
+typedef struct _py_thresholds_obj_t {
+    mp_obj_base_t base;
+    size_t len;
+    color_thresholds_list_lnk_data_t *thresholds;
+    uint8_t *tables; // RGB565 table of each set, built by the first call on an RGB565 image.
+    bool no_tables; // The tables did not fit in the heap, the thresholds are compiled per call.
+} py_thresholds_obj_t;
+
+static void py_thresholds_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_thresholds_obj_t *self = self_in;
+    mp_printf(print, "{\"thresholds\":%d, \"compiled\":%d}", self->len, self->tables != NULL);
+}
+
+static const mp_obj_type_t py_thresholds_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_thresholds,
+    .print = py_thresholds_print,
+};
+
+// Parses a list of thresholds or a Thresholds object. Returns the compiled tables of a Thresholds
+// object passed with an RGB565 image, else NULL so that the caller compiles the thresholds itself.
+static uint8_t *py_thresholds_arg(mp_obj_t arg, image_t *img, list_t *thresholds)
+{
+    if (!MP_OBJ_IS_TYPE(arg, &py_thresholds_type)) {
+        py_helper_arg_to_thresholds(arg, thresholds);
+        return NULL;
+    }
+
+    py_thresholds_obj_t *self = arg;
+
+    for (size_t i = 0; i < self->len; i++) {
+        list_push_back(thresholds, &self->thresholds[i]);
+    }
+
+    if ((img->bpp != IMAGE_BPP_RGB565) || (!self->len)) {
+        return NULL;
+    }
+
+    if ((!self->tables) && (!self->no_tables)) {
+        size_t sets = (self->len + COLOR_THRESHOLDS_LUT_MAX - 1) / COLOR_THRESHOLDS_LUT_MAX;
+        uint8_t *tables = xalloc_try_alloc(sets * COLOR_THRESHOLDS_LUT_RGB565_SIZE);
+        if (!tables) {
+            // Each set takes 64KB which is more than some heaps have. Don't retry (and collect) on
+            // every call, imlib compiles the thresholds per call without the tables.
+            self->no_tables = true;
+            return NULL;
+        }
+        fb_alloc_mark();
+        imlib_color_thresholds_lut_build(tables, thresholds);
+        fb_alloc_free_till_mark();
+        self->tables = tables;
+    }
+
+    return self->tables;
+}
+
+static uint8_t *py_thresholds_keyword(uint n_args, const mp_obj_t *args, uint arg_index, mp_map_t *kw_args,
+                                      image_t *img, list_t *thresholds)
+{
+    mp_map_elem_t *kw_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_thresholds), MP_MAP_LOOKUP);
+
+    if (kw_arg) {
+        return py_thresholds_arg(kw_arg->value, img, thresholds);
+    } else if (n_args > arg_index) {
+        return py_thresholds_arg(args[arg_index], img, thresholds);
+    }
+
+    return NULL;
+}
+
+// Gradient Object ////////////////////////////////////////////////////////////
+
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+
+typedef struct _py_gradient_obj_t {
+    mp_obj_base_t base;
+    gradient_t _cobj;
+    void *data; // Pixels of the image the field was last computed from.
+    uint32_t frame_id; // Frame buffer frame at that time, pixels in the frame buffer change per frame.
+} py_gradient_obj_t;
+
+static void py_gradient_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_gradient_obj_t *self = self_in;
+    mp_printf(print, "{\"x\":%d, \"y\":%d, \"w\":%d, \"h\":%d, \"x_stride\":%d, \"y_stride\":%d}",
+              self->_cobj.roi.x, self->_cobj.roi.y, self->_cobj.roi.w, self->_cobj.roi.h,
+              self->_cobj.x_stride, self->_cobj.y_stride);
+}
+
+static const mp_obj_type_t py_gradient_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_gradient,
+    .print = py_gradient_print,
+};
+
+// Returns true if the pixels of img are in the frame buffer (in any buffer of the capture ring), new
+// frames are written there without changing the image data pointer.
+static bool py_gradient_in_framebuffer(image_t *img)
+{
+    return (MAIN_FB()->pixels <= img->data) && (img->data < framebuffer_get_buffers_end());
+}
+
+// Returns the field of a gradient keyword argument computed from img, else NULL. The roi and the
+// strides of the field replace the ones of the call.
+static gradient_t *py_gradient_keyword(mp_map_t *kw_args, image_t *img, rectangle_t *roi,
+                                       unsigned int *x_stride, unsigned int *y_stride)
+{
+    mp_map_elem_t *kw_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_gradient), MP_MAP_LOOKUP);
+
+    if (!kw_arg) {
+        return NULL;
+    }
+
+    PY_ASSERT_TYPE(kw_arg->value, &py_gradient_type);
+    py_gradient_obj_t *self = kw_arg->value;
+    PY_ASSERT_TRUE_MSG(self->data && (self->data == img->data)
+                    && ((!py_gradient_in_framebuffer(img)) || (self->frame_id == framebuffer_get_frame_id())),
+                       "The gradient was not computed from this image! Call gradient() on it first.");
+
+    *roi = self->_cobj.roi;
+    *x_stride = self->_cobj.x_stride;
+    *y_stride = self->_cobj.y_stride;
+    return &self->_cobj;
+}
+
+#endif // IMLIB_ENABLE_FIND_LINES || IMLIB_ENABLE_FIND_CIRCLES
+
 // Keypoints Match Object /////////////////////////////////////////////////////
 
 #ifdef IMLIB_ENABLE_FIND_KEYPOINTS
@@ -246,6 +504,7 @@ static const mp_obj_type_t py_kptmatch_type = {
 typedef struct _py_image_obj_t {
     mp_obj_base_t base;
     image_t _cobj;
+    mp_obj_t parent; // Keeps the pixels of a view alive.
 } py_image_obj_t;
 
 typedef struct _mp_obj_py_image_it_t {
@@ -255,7 +514,24 @@ typedef struct _mp_obj_py_image_it_t {
     size_t cur;
 } mp_obj_py_image_it_t;
 
+// Views share the pixels of their parent image. Most of imlib indexes the pixel
+// buffer directly so views are rejected by code that does not honor the stride
+// instead of silently working on a copy that no longer aliases the parent.
+static void py_image_assert_not_view(py_image_obj_t *self)
+{
+    PY_ASSERT_FALSE_MSG(IMAGE_IS_VIEW(&self->_cobj),
+                        "Operation not supported on image views! Use copy() to get a packed image.");
+}
+
 void *py_image_cobj(mp_obj_t img_obj)
+{
+    PY_ASSERT_TYPE(img_obj, &py_image_type);
+    py_image_assert_not_view((py_image_obj_t *) img_obj);
+    return &((py_image_obj_t *)img_obj)->_cobj;
+}
+
+// Returns the image without rejecting views for callers which honor the stride.
+void *py_image_cobj_strided(mp_obj_t img_obj)
 {
     PY_ASSERT_TYPE(img_obj, &py_image_type);
     return &((py_image_obj_t *)img_obj)->_cobj;
@@ -586,6 +862,7 @@ static mp_obj_t py_image_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value
 static mp_int_t py_image_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags)
 {
     py_image_obj_t *self = self_in;
+    py_image_assert_not_view(self);
     if (flags == MP_BUFFER_READ) {
         bufinfo->buf = self->_cobj.data;
         bufinfo->len = image_size(&self->_cobj);
@@ -605,19 +882,19 @@ static mp_int_t py_image_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo,
 
 static mp_obj_t py_image_width(mp_obj_t img_obj)
 {
-    return mp_obj_new_int(((image_t *) py_image_cobj(img_obj))->w);
+    return mp_obj_new_int(((image_t *) py_image_cobj_strided(img_obj))->w);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_width_obj, py_image_width);
 
 static mp_obj_t py_image_height(mp_obj_t img_obj)
 {
-    return mp_obj_new_int(((image_t *) py_image_cobj(img_obj))->h);
+    return mp_obj_new_int(((image_t *) py_image_cobj_strided(img_obj))->h);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_height_obj, py_image_height);
 
 static mp_obj_t py_image_format(mp_obj_t img_obj)
 {
-    switch (((image_t *) py_image_cobj(img_obj))->bpp) {
+    switch (((image_t *) py_image_cobj_strided(img_obj))->bpp) {
         case IMAGE_BPP_BINARY: return mp_obj_new_int(PIXFORMAT_BINARY);
         case IMAGE_BPP_GRAYSCALE: return mp_obj_new_int(PIXFORMAT_GRAYSCALE);
         case IMAGE_BPP_RGB565: return mp_obj_new_int(PIXFORMAT_RGB565);
@@ -629,7 +906,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_format_obj, py_image_format);
 
 static mp_obj_t py_image_size(mp_obj_t img_obj)
 {
-    return mp_obj_new_int(image_size((image_t *) py_image_cobj(img_obj)));
+    return mp_obj_new_int(image_size((image_t *) py_image_cobj_strided(img_obj)));
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_size_obj, py_image_size);
 
@@ -642,7 +919,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_bytearray_obj, py_image_bytearray);
 
 STATIC mp_obj_t py_image_get_pixel(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable_bayer(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_bayer_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -711,7 +988,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_pixel_obj, 2, py_image_get_pixel)
 
 STATIC mp_obj_t py_image_set_pixel(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable_bayer(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_bayer_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -763,6 +1040,7 @@ static mp_obj_t py_image_mean_pool(mp_obj_t img_obj, mp_obj_t x_div_obj, mp_obj_
     out_img.w = arg_img->w / arg_x_div;
     out_img.h = arg_img->h / arg_y_div;
     out_img.bpp = arg_img->bpp;
+    out_img.stride = 0;
     out_img.pixels = arg_img->pixels;
     PY_ASSERT_TRUE_MSG(image_size(&out_img) <= image_size(arg_img), "Can't pool in place!");
 
@@ -789,6 +1067,7 @@ static mp_obj_t py_image_mean_pooled(mp_obj_t img_obj, mp_obj_t x_div_obj, mp_ob
     out_img.w = arg_img->w / arg_x_div;
     out_img.h = arg_img->h / arg_y_div;
     out_img.bpp = arg_img->bpp;
+    out_img.stride = 0;
     out_img.pixels = xalloc(image_size(&out_img));
 
     imlib_mean_pool(arg_img, &out_img, arg_x_div, arg_y_div);
@@ -816,6 +1095,7 @@ static mp_obj_t py_image_midpoint_pool(uint n_args, const mp_obj_t *args, mp_map
     out_img.w = arg_img->w / arg_x_div;
     out_img.h = arg_img->h / arg_y_div;
     out_img.bpp = arg_img->bpp;
+    out_img.stride = 0;
     out_img.pixels = arg_img->pixels;
     PY_ASSERT_TRUE_MSG(image_size(&out_img) <= image_size(arg_img), "Can't pool in place!");
 
@@ -845,6 +1125,7 @@ static mp_obj_t py_image_midpoint_pooled(uint n_args, const mp_obj_t *args, mp_m
     out_img.w = arg_img->w / arg_x_div;
     out_img.h = arg_img->h / arg_y_div;
     out_img.bpp = arg_img->bpp;
+    out_img.stride = 0;
     out_img.pixels = xalloc(image_size(&out_img));
 
     imlib_midpoint_pool(arg_img, &out_img, arg_x_div, arg_y_div, arg_bias);
@@ -863,6 +1144,7 @@ static mp_obj_t py_image_to_bitmap(uint n_args, const mp_obj_t *args, mp_map_t *
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = IMAGE_BPP_BINARY;
+    out.stride = 0;
     out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
 
     switch(arg_img->bpp) {
@@ -936,17 +1218,58 @@ static mp_obj_t py_image_to_bitmap(uint n_args, const mp_obj_t *args, mp_map_t *
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_to_bitmap_obj, 1, py_image_to_bitmap);
 
+// Decodes a JPEG image to out->bpp at 1/1, 1/2, 1/4 or 1/8 scale.
+static void py_image_decompress(image_t *arg_img, image_t *out, bool copy, float scale)
+{
+    int div = (scale > 0) ? fast_roundf(1 / scale) : 0;
+    PY_ASSERT_TRUE_MSG((div == 1) || (div == 2) || (div == 4) || (div == 8),
+            "Scale must be 1, 0.5, 0.25 or 0.125!");
+
+    out->w = (arg_img->w + div - 1) / div;
+    out->h = (arg_img->h + div - 1) / div;
+
+    if (copy || (!py_helper_is_equal_to_framebuffer(arg_img))) {
+        out->data = xalloc(image_size(out));
+        jpeg_decompress(arg_img, out);
+    } else {
+        // The decoded image replaces the compressed one in the frame buffer.
+        image_t temp;
+        memcpy(&temp, arg_img, sizeof(image_t));
+        fb_alloc_mark();
+        temp.data = fb_alloc(image_size(&temp), FB_ALLOC_NO_HINT);
+        memcpy(temp.data, arg_img->data, image_size(&temp));
+        py_helper_set_to_framebuffer(out);
+        jpeg_decompress(&temp, out);
+        fb_alloc_free_till_mark();
+    }
+
+    if (!copy) {
+        arg_img->w = out->w;
+        arg_img->h = out->h;
+        arg_img->data = out->data;
+    }
+}
+
 static mp_obj_t py_image_to_grayscale(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_image_cobj(args[0]);
+    PY_ASSERT_TRUE_MSG(IMAGE_IS_MUTABLE(arg_img) || IM_IS_JPEG(arg_img), "Image is not mutable!");
     bool copy = py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_copy), false);
     int channel = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_rgb_channel), -1);
+    float scale = py_helper_keyword_float(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_scale), 1.0f);
 
     image_t out;
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = IMAGE_BPP_GRAYSCALE;
-    out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
+    out.stride = 0;
+
+    if (IM_IS_JPEG(arg_img)) {
+        py_image_decompress(arg_img, &out, copy, scale);
+    } else {
+        PY_ASSERT_TRUE_MSG(scale == 1.0f, "Only JPEG images can be scaled!");
+        out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
+    }
 
     switch(arg_img->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -1031,15 +1354,24 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_to_grayscale_obj, 1, py_image_to_gray
 
 static mp_obj_t py_image_to_rgb565(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_image_cobj(args[0]);
+    PY_ASSERT_TRUE_MSG(IMAGE_IS_MUTABLE(arg_img) || IM_IS_JPEG(arg_img), "Image is not mutable!");
     bool copy = py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_copy), false);
     int channel = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_rgb_channel), -1);
+    float scale = py_helper_keyword_float(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_scale), 1.0f);
 
     image_t out;
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = IMAGE_BPP_RGB565;
-    out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
+    out.stride = 0;
+
+    if (IM_IS_JPEG(arg_img)) {
+        py_image_decompress(arg_img, &out, copy, scale);
+    } else {
+        PY_ASSERT_TRUE_MSG(scale == 1.0f, "Only JPEG images can be scaled!");
+        out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
+    }
 
     switch(arg_img->bpp) {
         case IMAGE_BPP_BINARY: {
@@ -1170,6 +1502,7 @@ static mp_obj_t py_image_to_rainbow(uint n_args, const mp_obj_t *args, mp_map_t
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = IMAGE_BPP_RGB565;
+    out.stride = 0;
     out.data = copy ? xalloc(image_size(&out)) : arg_img->data;
 
     switch(arg_img->bpp) {
@@ -1297,6 +1630,7 @@ static mp_obj_t py_image_jpeg_encode_for_ide(mp_obj_t img_obj)
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = new_size;
+    out.stride = 0;
     py_helper_set_to_framebuffer(&out);
     arg_img->bpp = new_size;
 
@@ -1424,7 +1758,11 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
 {
     // mode == false -> copy behavior
     // mode == true -> crop/scale behavior
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    // view == true -> zero-copy view of the roi sharing the pixels of the image
+    bool arg_view = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_view), false);
+    image_t *arg_img = (mode && (!arg_view))
+        ? py_helper_arg_to_image_mutable(args[0])
+        : py_helper_arg_to_image_mutable_strided(args[0]);
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
@@ -1438,6 +1776,7 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
     PY_ASSERT_TRUE_MSG((0.0f <= arg_y_scale), "Error: 0.0 <= y_scale!");
 
     mp_obj_t copy_to_fb_obj = py_helper_keyword_object(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(mode ? MP_QSTR_copy : MP_QSTR_copy_to_fb));
+    int arg_hint = py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_hint), 0);
     bool copy_to_fb = false;
     image_t *arg_other = mode ? arg_img : NULL;
 
@@ -1453,6 +1792,18 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
         }
     }
 
+    if (arg_view) {
+        PY_ASSERT_TRUE_MSG((arg_x_scale == 1.0f) && (arg_y_scale == 1.0f) && (!copy_to_fb_obj),
+                           "Views cannot be scaled or copied!");
+        py_image_obj_t *self = args[0];
+        py_image_obj_t *o = m_new_obj(py_image_obj_t);
+        o->base.type = &py_image_type;
+        PY_ASSERT_TRUE_MSG(image_init_view(&o->_cobj, arg_img, &roi),
+                           "Binary image views must start on a multiple of 32 pixels!");
+        o->parent = (self->parent != MP_OBJ_NULL) ? self->parent : args[0];
+        return o;
+    }
+
     if (copy_to_fb) {
         fb_update_jpeg_buffer();
     }
@@ -1463,6 +1814,7 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
     image.h = fast_floorf(roi.h * arg_y_scale);
     PY_ASSERT_TRUE_MSG(image.h >= 1, "Output image height is 0!");
     image.bpp = arg_img->bpp;
+    image.stride = 0;
     image.data = NULL;
 
     if (copy_to_fb) {
@@ -1474,14 +1826,21 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
         image.data = xalloc(image_size(&image));
     }
 
-    bool in_place = arg_img->data == image.data;
+    // The rows of a view span its stride so a view of the target may overlap it
+    // without starting at the same address.
+    image_t span = *arg_img;
+    span.w = IMAGE_STRIDE(arg_img);
+    span.stride = 0;
+    bool in_place = (arg_img->data < (image.data + image_size(&image)))
+                 && (image.data < (arg_img->data + image_size(&span)));
     image_t temp;
 
     if (in_place) {
         memcpy(&temp, arg_img, sizeof(image_t));
         fb_alloc_mark();
+        temp.stride = 0;
         temp.data = fb_alloc(image_size(&temp), FB_ALLOC_NO_HINT);
-        memcpy(temp.data, arg_img->data, image_size(&temp));
+        image_pack(&temp, arg_img);
         arg_img = &temp;
         if (copy_to_fb) {
             py_helper_set_to_framebuffer(&image);
@@ -1490,42 +1849,47 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
 
     float over_xscale = IM_DIV(1.0, arg_x_scale), over_yscale = IM_DIV(1.0f, arg_y_scale);
 
-    switch(arg_img->bpp) {
-        case IMAGE_BPP_BINARY: {
-            for (int y = 0, yy = image.h; y < yy; y++) {
-                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
-                uint32_t *row_ptr_2 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&image, y);
-                for (int x = 0, xx = image.w; x < xx; x++) {
-                    IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr_2, x,
-                        IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+    if (arg_hint & (IMAGE_HINT_AREA | IMAGE_HINT_BILINEAR)) {
+        // Filtered scaling goes through the resize engine.
+        imlib_resize(&image, arg_img, &roi, arg_hint);
+    } else {
+        switch(arg_img->bpp) {
+            case IMAGE_BPP_BINARY: {
+                for (int y = 0, yy = image.h; y < yy; y++) {
+                    uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
+                    uint32_t *row_ptr_2 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&image, y);
+                    for (int x = 0, xx = image.w; x < xx; x++) {
+                        IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr_2, x,
+                            IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+                    }
                 }
+                break;
             }
-            break;
-        }
-        case IMAGE_BPP_GRAYSCALE: {
-            for (int y = 0, yy = image.h; y < yy; y++) {
-                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
-                uint8_t *row_ptr_2 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&image, y);
-                for (int x = 0, xx = image.w; x < xx; x++) {
-                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr_2, x,
-                        IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+            case IMAGE_BPP_GRAYSCALE: {
+                for (int y = 0, yy = image.h; y < yy; y++) {
+                    uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
+                    uint8_t *row_ptr_2 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&image, y);
+                    for (int x = 0, xx = image.w; x < xx; x++) {
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr_2, x,
+                            IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+                    }
                 }
+                break;
             }
-            break;
-        }
-        case IMAGE_BPP_RGB565: {
-            for (int y = 0, yy = image.h; y < yy; y++) {
-                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
-                uint16_t *row_ptr_2 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&image, y);
-                for (int x = 0, xx = image.w; x < xx; x++) {
-                    IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr_2, x,
-                        IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+            case IMAGE_BPP_RGB565: {
+                for (int y = 0, yy = image.h; y < yy; y++) {
+                    uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(arg_img, fast_floorf(y * over_yscale) + roi.y);
+                    uint16_t *row_ptr_2 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&image, y);
+                    for (int x = 0, xx = image.w; x < xx; x++) {
+                        IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr_2, x,
+                            IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, fast_floorf(x * over_xscale) + roi.x));
+                    }
                 }
+                break;
+            }
+            default: {
+                break;
             }
-            break;
-        }
-        default: {
-            break;
         }
     }
 
@@ -1536,7 +1900,7 @@ static mp_obj_t py_image_copy_int(uint n_args, const mp_obj_t *args, mp_map_t *k
     py_helper_update_framebuffer(&image);
 
     if (copy_to_fb) {
-        image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+        image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
         if (py_helper_is_equal_to_framebuffer(arg_img)) {
             arg_img->w = image.w;
@@ -1607,7 +1971,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_clear_obj, 1, py_image_clear);
 
 STATIC mp_obj_t py_image_draw_line(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1628,7 +1992,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_line_obj, 2, py_image_draw_line)
 
 STATIC mp_obj_t py_image_draw_rectangle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1651,7 +2015,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_rectangle_obj, 2, py_image_draw_
 
 STATIC mp_obj_t py_image_draw_circle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 3, &arg_vec);
@@ -1673,7 +2037,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_circle_obj, 2, py_image_draw_cir
 
 STATIC mp_obj_t py_image_draw_ellipse(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 5, &arg_vec);
@@ -1697,7 +2061,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_ellipse_obj, 2, py_image_draw_el
 
 STATIC mp_obj_t py_image_draw_string(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 3, &arg_vec);
@@ -1739,7 +2103,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_string_obj, 2, py_image_draw_str
 
 STATIC mp_obj_t py_image_draw_cross(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -1761,7 +2125,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_cross_obj, 2, py_image_draw_cros
 
 STATIC mp_obj_t py_image_draw_arrow(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1934,7 +2298,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_image_obj, 3, py_image_draw_imag
 
 STATIC mp_obj_t py_image_draw_keypoints(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     int arg_c =
         py_helper_keyword_color(arg_img, n_args, args, 2, kw_args, -1); // White.
@@ -2009,6 +2373,7 @@ STATIC mp_obj_t py_image_mask_rectangle(uint n_args, const mp_obj_t *args, mp_ma
     temp.w = arg_img->w;
     temp.h = arg_img->h;
     temp.bpp = IMAGE_BPP_BINARY;
+    temp.stride = 0;
     temp.data = fb_alloc0(image_size(&temp), FB_ALLOC_NO_HINT);
 
     imlib_draw_rectangle(&temp, arg_rx, arg_ry, arg_rw, arg_rh, -1, 0, true);
@@ -2043,6 +2408,7 @@ STATIC mp_obj_t py_image_mask_circle(uint n_args, const mp_obj_t *args, mp_map_t
     temp.w = arg_img->w;
     temp.h = arg_img->h;
     temp.bpp = IMAGE_BPP_BINARY;
+    temp.stride = 0;
     temp.data = fb_alloc0(image_size(&temp), FB_ALLOC_NO_HINT);
 
     imlib_draw_circle(&temp, arg_cx, arg_cy, arg_cr, -1, 0, true);
@@ -2083,6 +2449,7 @@ STATIC mp_obj_t py_image_mask_ellipse(uint n_args, const mp_obj_t *args, mp_map_
     temp.w = arg_img->w;
     temp.h = arg_img->h;
     temp.bpp = IMAGE_BPP_BINARY;
+    temp.stride = 0;
     temp.data = fb_alloc0(image_size(&temp), FB_ALLOC_NO_HINT);
 
     imlib_draw_ellipse(&temp, arg_cx, arg_cy, arg_rx, arg_ry, arg_r, -1, 0, true);
@@ -2141,7 +2508,7 @@ STATIC mp_obj_t py_image_binary(uint n_args, const mp_obj_t *args, mp_map_t *kw_
 
     list_t arg_thresholds;
     list_init(&arg_thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_arg_to_thresholds(args[1], &arg_thresholds);
+    uint8_t *arg_compiled = py_thresholds_arg(args[1], arg_img, &arg_thresholds);
 
     bool arg_invert =
         py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
@@ -2176,10 +2543,11 @@ STATIC mp_obj_t py_image_binary(uint n_args, const mp_obj_t *args, mp_map_t *kw_
     out.w = arg_img->w;
     out.h = arg_img->h;
     out.bpp = arg_to_bitmap ? IMAGE_BPP_BINARY : arg_img->bpp;
+    out.stride = 0;
     out.data = arg_copy ? xalloc(image_size(&out)) : arg_img->data;
 
     fb_alloc_mark();
-    imlib_binary(&out, arg_img, &arg_thresholds, arg_invert, arg_zero, arg_msk);
+    imlib_binary(&out, arg_img, &arg_thresholds, arg_invert, arg_compiled, arg_zero, arg_msk);
     fb_alloc_free_till_mark();
 
     list_free(&arg_thresholds);
@@ -3045,9 +3413,11 @@ STATIC mp_obj_t py_image_bilateral(uint n_args, const mp_obj_t *args, mp_map_t *
         py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
     image_t *arg_msk =
         py_helper_keyword_to_image_mutable_mask(n_args, args, 7, kw_args);
+    bool arg_fast =
+        py_helper_keyword_int(n_args, args, 8, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_fast), false);
 
     fb_alloc_mark();
-    imlib_bilateral_filter(arg_img, arg_ksize, arg_color_sigma, arg_space_sigma, arg_threshold, arg_offset, arg_invert, arg_msk);
+    imlib_bilateral_filter(arg_img, arg_ksize, arg_color_sigma, arg_space_sigma, arg_fast, arg_threshold, arg_offset, arg_invert, arg_msk);
     fb_alloc_free_till_mark();
     return args[0];
 }
@@ -3190,8 +3560,17 @@ STATIC mp_obj_t py_image_lens_corr(uint n_args, const mp_obj_t *args, mp_map_t *
     float arg_y_corr =
         py_helper_keyword_float(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_corr), 0.0f);
 
+    py_remap_obj_t *arg_remap =
+        py_remap_obj(py_helper_keyword_object(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_remap)), arg_img);
+
     fb_alloc_mark();
-    imlib_lens_corr(arg_img, arg_strength, arg_zoom, arg_x_corr, arg_y_corr);
+    if (arg_remap && imlib_lens_corr_remap(&arg_remap->_cobj, arg_remap->buf, arg_img, arg_remap->bilinear,
+                                           arg_strength, arg_zoom, arg_x_corr, arg_y_corr)) {
+        imlib_remap(arg_img, &arg_remap->_cobj);
+        arg_remap->used = true;
+    } else {
+        imlib_lens_corr(arg_img, arg_strength, arg_zoom, arg_x_corr, arg_y_corr);
+    }
     fb_alloc_free_till_mark();
     return args[0];
 }
@@ -3969,11 +4348,11 @@ static const mp_obj_type_t py_histogram_type = {
 
 static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     list_t thresholds;
     list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
+    uint8_t *compiled = py_thresholds_keyword(n_args, args, 1, kw_args, arg_img, &thresholds);
     bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
     image_t *other = py_helper_keyword_to_image_mutable(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
 
@@ -3994,7 +4373,7 @@ static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = NULL;
             hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4010,7 +4389,7 @@ static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = NULL;
             hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4034,7 +4413,7 @@ static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = fb_alloc(hist.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.BBins = fb_alloc(hist.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4071,11 +4450,11 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_histogram_obj, 1, py_image_get_hi
 
 static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     list_t thresholds;
     list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
+    uint8_t *compiled = py_thresholds_keyword(n_args, args, 1, kw_args, arg_img, &thresholds);
     bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
     image_t *other = py_helper_keyword_to_image_mutable(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
 
@@ -4096,7 +4475,7 @@ static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_ma
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = NULL;
             hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4112,7 +4491,7 @@ static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_ma
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = NULL;
             hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4136,7 +4515,7 @@ static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_ma
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = fb_alloc(hist.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.BBins = fb_alloc(hist.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
+            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, compiled, other);
             list_free(&thresholds);
             break;
         }
@@ -4282,11 +4661,11 @@ static const mp_obj_type_t py_line_type = {
 
 static mp_obj_t py_image_get_regression(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     list_t thresholds;
     list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_arg_to_thresholds(args[1], &thresholds);
+    py_thresholds_arg(args[1], arg_img, &thresholds);
     if (!list_size(&thresholds)) return mp_const_none;
     bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
 
@@ -4874,11 +5253,11 @@ static bool py_image_find_blobs_merge_cb(void *fun_obj, find_blobs_list_lnk_data
 
 static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
+    image_t *arg_img = py_helper_arg_to_image_mutable_strided(args[0]);
 
     list_t thresholds;
     list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_arg_to_thresholds(args[1], &thresholds);
+    uint8_t *compiled = py_thresholds_arg(args[1], arg_img, &thresholds);
     if (!list_size(&thresholds)) return mp_obj_new_list(0, NULL);
     bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
 
@@ -4910,7 +5289,7 @@ static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t
 
     list_t out;
     fb_alloc_mark();
-    imlib_find_blobs(&out, arg_img, &roi, x_stride, y_stride, &thresholds, invert,
+    imlib_find_blobs(&out, arg_img, &roi, x_stride, y_stride, &thresholds, invert, compiled,
             area_threshold, pixels_threshold, merge, margin,
             py_image_find_blobs_threshold_cb, threshold_cb, py_image_find_blobs_merge_cb, merge_cb, x_hist_bins_max, y_hist_bins_max);
     fb_alloc_free_till_mark();
@@ -4971,6 +5350,27 @@ static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_find_blobs_obj, 2, py_image_find_blobs);
 
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+static mp_obj_t py_image_gradient(mp_obj_t img_obj, mp_obj_t gradient_obj)
+{
+    image_t *arg_img = py_helper_arg_to_image_mutable(img_obj);
+
+    PY_ASSERT_TYPE(gradient_obj, &py_gradient_type);
+    py_gradient_obj_t *self = gradient_obj;
+
+    rectangle_t *roi = &self->_cobj.roi;
+    PY_ASSERT_TRUE_MSG((roi->x >= 0) && (roi->y >= 0)
+                    && ((roi->x + roi->w) <= arg_img->w) && ((roi->y + roi->h) <= arg_img->h),
+                       "The gradient ROI is not inside the image!");
+
+    imlib_gradient_update(&self->_cobj, arg_img);
+    self->data = arg_img->data;
+    self->frame_id = framebuffer_get_frame_id();
+    return gradient_obj;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_image_gradient_obj, py_image_gradient);
+#endif // IMLIB_ENABLE_FIND_LINES || IMLIB_ENABLE_FIND_CIRCLES
+
 #ifdef IMLIB_ENABLE_FIND_LINES
 static mp_obj_t py_image_find_lines(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
@@ -4983,13 +5383,14 @@ static mp_obj_t py_image_find_lines(uint n_args, const mp_obj_t *args, mp_map_t
     PY_ASSERT_TRUE_MSG(x_stride > 0, "x_stride must not be zero.");
     unsigned int y_stride = py_helper_keyword_int(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_stride), 1);
     PY_ASSERT_TRUE_MSG(y_stride > 0, "y_stride must not be zero.");
+    gradient_t *grad = py_gradient_keyword(kw_args, arg_img, &roi, &x_stride, &y_stride);
     uint32_t threshold = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), 1000);
     unsigned int theta_margin = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_theta_margin), 25);
     unsigned int rho_margin = py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_rho_margin), 25);
 
     list_t out;
     fb_alloc_mark();
-    imlib_find_lines(&out, arg_img, &roi, x_stride, y_stride, threshold, theta_margin, rho_margin);
+    imlib_find_lines(&out, arg_img, &roi, x_stride, y_stride, threshold, theta_margin, rho_margin, grad);
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5149,6 +5550,7 @@ static mp_obj_t py_image_find_circles(uint n_args, const mp_obj_t *args, mp_map_
     PY_ASSERT_TRUE_MSG(x_stride > 0, "x_stride must not be zero.");
     unsigned int y_stride = py_helper_keyword_int(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_stride), 1);
     PY_ASSERT_TRUE_MSG(y_stride > 0, "y_stride must not be zero.");
+    gradient_t *grad = py_gradient_keyword(kw_args, arg_img, &roi, &x_stride, &y_stride);
     uint32_t threshold = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), 2000);
     unsigned int x_margin = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_x_margin), 10);
     unsigned int y_margin = py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_margin), 10);
@@ -5162,7 +5564,7 @@ static mp_obj_t py_image_find_circles(uint n_args, const mp_obj_t *args, mp_map_
     list_t out;
     fb_alloc_mark();
     imlib_find_circles(&out, arg_img, &roi, x_stride, y_stride, threshold, x_margin, y_margin, r_margin,
-                       r_min, r_max, r_step);
+                       r_min, r_max, r_step, grad);
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5647,10 +6049,15 @@ static mp_obj_t py_image_find_apriltags(uint n_args, const mp_obj_t *args, mp_ma
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
+
+    // Quads are found on the roi decimated by this factor and decoded at full resolution.
+    int decimate = py_helper_keyword_int(n_args, args, 8, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_decimate), 1);
+    PY_ASSERT_TRUE_MSG(decimate >= 1, "Decimate must be >= 1");
 #ifndef IMLIB_ENABLE_HIGH_RES_APRILTAGS
-    PY_ASSERT_TRUE_MSG((roi.w * roi.h) < 65536, "The maximum supported resolution for find_apriltags() is < 64K pixels.");
+    PY_ASSERT_TRUE_MSG(((roi.w / decimate) * (roi.h / decimate)) < 65536,
+                       "The maximum supported resolution for find_apriltags() is < 64K pixels after decimation.");
 #endif
-    if ((roi.w < 4) || (roi.h < 4)) {
+    if (((roi.w / decimate) < 4) || ((roi.h / decimate) < 4)) {
         return mp_obj_new_list(0, NULL);
     }
 
@@ -5663,10 +6070,12 @@ static mp_obj_t py_image_find_apriltags(uint n_args, const mp_obj_t *args, mp_ma
     float cx = py_helper_keyword_float(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_cx), arg_img->w * 0.5);
     // Use the image versus the roi here since the image should be projected from the camera center.
     float cy = py_helper_keyword_float(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_cy), arg_img->h * 0.5);
+    // Negative corrects as many bits as each family allows, less uses less memory and rejects more noise.
+    int max_hamming = py_helper_keyword_int(n_args, args, 7, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_max_hamming), -1);
 
     list_t out;
     fb_alloc_mark();
-    imlib_find_apriltags(&out, arg_img, &roi, families, fx, fy, cx, cy);
+    imlib_find_apriltags(&out, arg_img, &roi, families, fx, fy, cx, cy, max_hamming, decimate);
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -6088,26 +6497,68 @@ static const mp_obj_type_t py_displacement_type = {
     .locals_dict = (mp_obj_t) &py_displacement_locals_dict
 };
 
+// Displacement Tracker Object //
+typedef struct py_displacement_tracker_obj {
+    mp_obj_base_t base;
+    phasecorrelate_tracker_t _cobj;
+} py_displacement_tracker_obj_t;
+
+static void py_displacement_tracker_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_displacement_tracker_obj_t *self = self_in;
+    mp_printf(print, "{\"w\":%d, \"h\":%d, \"valid\":%d}", self->_cobj.w, self->_cobj.h, self->_cobj.valid);
+}
+
+static mp_obj_t py_displacement_tracker_reset(mp_obj_t self_in)
+{
+    ((py_displacement_tracker_obj_t *) self_in)->_cobj.valid = false;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_displacement_tracker_reset_obj, py_displacement_tracker_reset);
+
+STATIC const mp_rom_map_elem_t py_displacement_tracker_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&py_displacement_tracker_reset_obj) }
+};
+
+STATIC MP_DEFINE_CONST_DICT(py_displacement_tracker_locals_dict, py_displacement_tracker_locals_dict_table);
+
+static const mp_obj_type_t py_displacement_tracker_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_displacement_tracker,
+    .print = py_displacement_tracker_print,
+    .locals_dict = (mp_obj_t) &py_displacement_tracker_locals_dict
+};
+
 static mp_obj_t py_image_find_displacement(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
     image_t *arg_img = py_helper_arg_to_image_mutable(args[0]);
-    image_t *arg_template_img = py_helper_arg_to_image_mutable(args[1]);
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 2, kw_args, &roi);
 
-    rectangle_t template_roi;
-    py_helper_keyword_rectangle(arg_template_img, n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_template_roi), &template_roi);
-
-    PY_ASSERT_FALSE_MSG((roi.w != template_roi.w) || (roi.h != template_roi.h), "ROI(w,h) != TEMPLATE_ROI(w,h)");
-
     bool logpolar = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_logpolar), false);
     bool fix_rotation_scale = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_fix_rotation_scale), false);
 
     float x, y, r, s, response;
-    fb_alloc_mark();
-    imlib_phasecorrelate(arg_img, arg_template_img, &roi, &template_roi, logpolar, fix_rotation_scale, &x, &y, &r, &s, &response);
-    fb_alloc_free_till_mark();
+
+    if (MP_OBJ_IS_TYPE(args[1], &py_displacement_tracker_type)) {
+        // The tracker holds the spectra of the previous frame passed with it, roi is used for both.
+        py_displacement_tracker_obj_t *tracker = args[1];
+        fb_alloc_mark();
+        imlib_phasecorrelate_tracker(arg_img, &roi, &tracker->_cobj, logpolar, fix_rotation_scale, &x, &y, &r, &s, &response);
+        fb_alloc_free_till_mark();
+    } else {
+        image_t *arg_template_img = py_helper_arg_to_image_mutable(args[1]);
+
+        rectangle_t template_roi;
+        py_helper_keyword_rectangle(arg_template_img, n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_template_roi), &template_roi);
+
+        PY_ASSERT_FALSE_MSG((roi.w != template_roi.w) || (roi.h != template_roi.h), "ROI(w,h) != TEMPLATE_ROI(w,h)");
+
+        fb_alloc_mark();
+        imlib_phasecorrelate(arg_img, arg_template_img, &roi, &template_roi, logpolar, fix_rotation_scale, &x, &y, &r, &s, &response);
+        fb_alloc_free_till_mark();
+    }
 
     py_displacement_obj_t *o = m_new_obj(py_displacement_obj_t);
     o->base.type = &py_displacement_type;
@@ -6274,6 +6725,7 @@ static mp_obj_t py_image_find_keypoints(uint n_args, const mp_obj_t *args, mp_ma
         kp_obj->kpts = kpts;
         kp_obj->threshold = threshold;
         kp_obj->normalized = normalized;
+        kp_obj->index.kpts = NULL;
         return kp_obj;
     }
     return mp_const_none;
@@ -6603,6 +7055,11 @@ static const mp_rom_map_elem_t locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_get_regression),      MP_ROM_PTR(&py_image_get_regression_obj)},
     /* Find Methods */
     {MP_ROM_QSTR(MP_QSTR_find_blobs),          MP_ROM_PTR(&py_image_find_blobs_obj)},
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+    {MP_ROM_QSTR(MP_QSTR_gradient),            MP_ROM_PTR(&py_image_gradient_obj)},
+#else
+    {MP_ROM_QSTR(MP_QSTR_gradient),            MP_ROM_PTR(&py_func_unavailable_obj)},
+#endif
 #ifdef IMLIB_ENABLE_FIND_LINES
     {MP_ROM_QSTR(MP_QSTR_find_lines),          MP_ROM_PTR(&py_image_find_lines_obj)},
 #else
@@ -6696,16 +7153,32 @@ static const mp_obj_type_t py_image_type = {
 };
 
 // ImageWriter Object //
+//
+// Stream format V2.0: a 16 byte header followed by frames and a trailing frame index.
+// Each frame has a 32 byte header (elapsed ms, w, h, bpp, encoding, size and two reserved
+// words) and its data padded to a multiple of 16 bytes. Frames are stored as is (raw or
+// JPEG images) or lossless compressed. The index holds the offset and the time in ms of
+// each frame followed by a 16 byte footer (index offset, frame count, "IDX ", "V2.0").
+// Files which were not closed have no index and can only be read sequentially.
+#define IMAGE_STREAM_RAW            (0)
+#define IMAGE_STREAM_LOSSLESS       (1)
+#define IMAGE_STREAM_FRAME_HEADER   (32)
+#define IMAGE_STREAM_FOOTER         (16)
+
 typedef struct py_imagewriter_obj {
     mp_obj_base_t base;
     FIL fp;
+    FIL idx_fp; // Temporary index file.
+    mp_obj_t idx_path;
     uint32_t ms;
+    uint32_t elapsed;
+    uint32_t frames;
 } py_imagewriter_obj_t;
 
 static void py_imagewriter_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
 {
     py_imagewriter_obj_t *self = self_in;
-    mp_printf(print, "{\"size\":%d}", f_size(&self->fp));
+    mp_printf(print, "{\"size\":%d, \"count\":%d}", f_size(&self->fp), self->frames);
 }
 
 mp_obj_t py_imagewriter_size(mp_obj_t self_in)
@@ -6713,41 +7186,146 @@ mp_obj_t py_imagewriter_size(mp_obj_t self_in)
     return mp_obj_new_int(f_size(&((py_imagewriter_obj_t *) self_in)->fp));
 }
 
-mp_obj_t py_imagewriter_add_frame(mp_obj_t self_in, mp_obj_t img_obj)
+mp_obj_t py_imagewriter_count(mp_obj_t self_in)
 {
-    // Don't use the file buffer here...
+    return mp_obj_new_int(((py_imagewriter_obj_t *) self_in)->frames);
+}
 
-    FIL *fp = &((py_imagewriter_obj_t *) self_in)->fp;
-    PY_ASSERT_TYPE(img_obj, &py_image_type);
-    image_t *arg_img = &((py_image_obj_t *) img_obj)->_cobj;
+// Closes both files after an error and removes the temporary index file, the stream can't be
+// continued since the file helpers close the file that failed.
+static void py_imagewriter_abort(py_imagewriter_obj_t *self)
+{
+    f_close(&self->fp);
+    f_close(&self->idx_fp);
+    f_unlink_helper(mp_obj_str_get_str(self->idx_path));
+}
 
+static void py_imagewriter_write_frame(py_imagewriter_obj_t *self, image_t *arg_img, int arg_q, bool arg_lossless)
+{
+    FIL *fp = &self->fp;
     uint32_t ms = systick_current_millis(); // Write out elapsed ms.
-    write_long(fp, ms - ((py_imagewriter_obj_t *) self_in)->ms);
-    ((py_imagewriter_obj_t *) self_in)->ms = ms;
+    uint32_t elapsed = ms - self->ms;
+    uint32_t offset = f_tell(fp);
+
+    fb_alloc_mark();
+
+    image_t image = *arg_img;
+    uint32_t encoding = IMAGE_STREAM_RAW;
+    uint32_t size = image_size(&image);
 
-    write_long(fp, arg_img->w);
-    write_long(fp, arg_img->h);
-    write_long(fp, arg_img->bpp);
+    if ((!IM_IS_JPEG(&image)) && (arg_q > 0)) {
+        // Lossy, the frame is stored as a JPEG image.
+        uint32_t buffer_size;
+        uint8_t *buffer = fb_alloc_all(&buffer_size, FB_ALLOC_PREFER_SIZE);
+        image_t out = { .w=image.w, .h=image.h, .bpp=buffer_size, .pixels=buffer };
+        if (jpeg_compress(&image, &out, IM_MIN(arg_q, 100), false)) {
+            fb_alloc_free_till_mark();
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "Out of memory!"));
+        }
+        image = out;
+        size = out.bpp;
+    } else if ((!IM_IS_JPEG(&image)) && arg_lossless) {
+        // Frames are only stored compressed if that's smaller.
+        uint32_t buffer_size;
+        uint8_t *buffer = fb_alloc_all(&buffer_size, FB_ALLOC_PREFER_SIZE);
+        uint32_t compressed_size = lossless_compress(&image, buffer, IM_MIN(buffer_size, size - 1));
+        if (compressed_size) {
+            encoding = IMAGE_STREAM_LOSSLESS;
+            image.data = buffer;
+            size = compressed_size;
+        }
+    }
 
-    uint32_t size = image_size(arg_img);
+    write_long(fp, elapsed);
+    write_long(fp, image.w);
+    write_long(fp, image.h);
+    write_long(fp, image.bpp);
+    write_long(fp, encoding);
+    write_long(fp, size);
+    write_long(fp, 0);
+    write_long(fp, 0);
 
-    write_data(fp, arg_img->data, size);
+    write_data(fp, image.data, size);
     if (size % 16) write_data(fp, "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16 - (size % 16)); // Pad to multiple of 16 bytes.
-    return self_in;
+
+    fb_alloc_free_till_mark();
+
+    // The frame is only indexed once its data is in the file.
+    write_long(&self->idx_fp, offset);
+    write_long(&self->idx_fp, self->elapsed + elapsed);
+    self->ms = ms;
+    self->elapsed += elapsed;
+    self->frames += 1;
+}
+
+mp_obj_t py_imagewriter_add_frame(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    // Don't use the file buffer here...
+
+    py_imagewriter_obj_t *self = args[0];
+    image_t *arg_img = py_image_cobj(args[1]);
+
+    int arg_q = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quality), 0);
+    bool arg_lossless = py_helper_keyword_int(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_lossless), true);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        py_imagewriter_write_frame(self, arg_img, arg_q, arg_lossless);
+        nlr_pop();
+    } else {
+        // Out of memory errors happen before anything is written.
+        if (mp_obj_exception_match((mp_obj_t) nlr.ret_val, &mp_type_OSError)) {
+            py_imagewriter_abort(self);
+        }
+        nlr_jump(nlr.ret_val);
+    }
+
+    return self;
 }
 
 mp_obj_t py_imagewriter_close(mp_obj_t self_in)
 {
-    file_close(&((py_imagewriter_obj_t *) self_in)->fp);
+    py_imagewriter_obj_t *self = self_in;
+    FIL *fp = &self->fp;
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        uint32_t index_offset = f_tell(fp);
+
+        // Append the index.
+        uint32_t entries[64 * 2];
+        file_seek(&self->idx_fp, 0);
+        for (uint32_t i = 0; i < self->frames; i += 64) {
+            uint32_t n = IM_MIN(self->frames - i, 64);
+            read_data(&self->idx_fp, entries, n * 8);
+            write_data(fp, entries, n * 8);
+        }
+
+        write_long(fp, index_offset);
+        write_long(fp, self->frames);
+        write_long(fp, *((uint32_t *) "IDX "));
+        write_long(fp, *((uint32_t *) "V2.0"));
+
+        file_close(fp);
+        file_close(&self->idx_fp);
+        nlr_pop();
+    } else {
+        py_imagewriter_abort(self);
+        nlr_jump(nlr.ret_val);
+    }
+
+    f_unlink_helper(mp_obj_str_get_str(self->idx_path));
     return self_in;
 }
 
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagewriter_size_obj, py_imagewriter_size);
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_imagewriter_add_frame_obj, py_imagewriter_add_frame);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagewriter_count_obj, py_imagewriter_count);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_imagewriter_add_frame_obj, 2, py_imagewriter_add_frame);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagewriter_close_obj, py_imagewriter_close);
 
 STATIC const mp_rom_map_elem_t py_imagewriter_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_size), MP_ROM_PTR(&py_imagewriter_size_obj) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&py_imagewriter_count_obj) },
     { MP_ROM_QSTR(MP_QSTR_add_frame), MP_ROM_PTR(&py_imagewriter_add_frame_obj) },
     { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&py_imagewriter_close_obj) }
 };
@@ -6765,14 +7343,33 @@ mp_obj_t py_image_imagewriter(mp_obj_t path)
 {
     py_imagewriter_obj_t *obj = m_new_obj(py_imagewriter_obj_t);
     obj->base.type = &py_imagewriter_type;
+
+    // The frame index is stored in a temporary file next to the stream.
+    vstr_t idx_path;
+    vstr_init(&idx_path, 0);
+    vstr_add_str(&idx_path, mp_obj_str_get_str(path));
+    vstr_add_str(&idx_path, ".idx");
+    obj->idx_path = mp_obj_new_str_from_vstr(&mp_type_str, &idx_path);
+
     file_write_open(&obj->fp, mp_obj_str_get_str(path));
 
-    write_long(&obj->fp, *((uint32_t *) "OMV ")); // OpenMV
-    write_long(&obj->fp, *((uint32_t *) "IMG ")); // Image
-    write_long(&obj->fp, *((uint32_t *) "STR ")); // Stream
-    write_long(&obj->fp, *((uint32_t *) "V1.0")); // v1.0
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        file_read_write_open(&obj->idx_fp, mp_obj_str_get_str(obj->idx_path));
+
+        write_long(&obj->fp, *((uint32_t *) "OMV ")); // OpenMV
+        write_long(&obj->fp, *((uint32_t *) "IMG ")); // Image
+        write_long(&obj->fp, *((uint32_t *) "STR ")); // Stream
+        write_long(&obj->fp, *((uint32_t *) "V2.0")); // v2.0
+        nlr_pop();
+    } else {
+        py_imagewriter_abort(obj);
+        nlr_jump(nlr.ret_val);
+    }
 
     obj->ms = systick_current_millis();
+    obj->elapsed = 0;
+    obj->frames = 0;
     return obj;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_imagewriter_obj, py_image_imagewriter);
@@ -6782,12 +7379,15 @@ typedef struct py_imagereader_obj {
     mp_obj_base_t base;
     FIL fp;
     uint32_t ms;
+    bool v2;
+    uint32_t frames;    // Number of indexed frames, 0 if the stream has no index.
+    uint32_t data_end;  // Offset of the index or size of the file.
 } py_imagereader_obj_t;
 
 static void py_imagereader_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
 {
     py_imagereader_obj_t *self = self_in;
-    mp_printf(print, "{\"size\":%d}", f_size(&self->fp));
+    mp_printf(print, "{\"size\":%d, \"count\":%d}", f_size(&self->fp), self->frames);
 }
 
 mp_obj_t py_imagereader_size(mp_obj_t self_in)
@@ -6795,10 +7395,16 @@ mp_obj_t py_imagereader_size(mp_obj_t self_in)
     return mp_obj_new_int(f_size(&((py_imagereader_obj_t *) self_in)->fp));
 }
 
+mp_obj_t py_imagereader_count(mp_obj_t self_in)
+{
+    return mp_obj_new_int(((py_imagereader_obj_t *) self_in)->frames);
+}
+
 mp_obj_t py_imagereader_next_frame(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
     // Don't use the file buffer here...
 
+    py_imagereader_obj_t *self = args[0];
     mp_obj_t copy_to_fb_obj = py_helper_keyword_object(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_copy_to_fb));
     bool copy_to_fb = true;
     image_t *arg_other = NULL;
@@ -6815,16 +7421,16 @@ mp_obj_t py_imagereader_next_frame(uint n_args, const mp_obj_t *args, mp_map_t *
         fb_update_jpeg_buffer();
     }
 
-    FIL *fp = &((py_imagereader_obj_t *) args[0])->fp;
+    FIL *fp = &self->fp;
 
-    if (f_eof(fp)) {
+    if (f_tell(fp) >= self->data_end) {
         if (!py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_loop), true)) {
             return mp_const_none;
         }
 
         file_seek(fp, 16); // skip past the header
 
-        if (f_eof(fp)) { // empty file
+        if (f_tell(fp) >= self->data_end) { // empty file
             return mp_const_none;
         }
     }
@@ -6834,12 +7440,12 @@ mp_obj_t py_imagereader_next_frame(uint n_args, const mp_obj_t *args, mp_map_t *
 
     uint32_t ms; // Wait for elapsed ms.
     for (ms = systick_current_millis();
-         ((ms - ((py_imagewriter_obj_t *) args[0])->ms) < ms_tmp);
+         ((ms - self->ms) < ms_tmp);
          ms = systick_current_millis()) {
         __WFI();
     }
 
-    ((py_imagewriter_obj_t *) args[0])->ms = ms;
+    self->ms = ms;
 
     image_t image = {0};
 
@@ -6847,19 +7453,45 @@ mp_obj_t py_imagereader_next_frame(uint n_args, const mp_obj_t *args, mp_map_t *
     read_long(fp, (uint32_t *) &image.h);
     read_long(fp, (uint32_t *) &image.bpp);
 
+    uint32_t encoding = IMAGE_STREAM_RAW;
     uint32_t size = image_size(&image);
 
+    if (self->v2) {
+        read_long(fp, &encoding);
+        read_long(fp, &size);
+        read_long_ignore(fp);
+        read_long_ignore(fp);
+
+        // Raw frames are read straight into the image, their size must match it.
+        if ((encoding > IMAGE_STREAM_LOSSLESS) || ((f_tell(fp) + size) > self->data_end)
+        || ((encoding == IMAGE_STREAM_RAW) && (size != image_size(&image)))) {
+            ff_file_corrupted(fp);
+        }
+    }
+
     if (copy_to_fb) {
         py_helper_set_to_framebuffer(&image);
     } else if (arg_other) {
-        PY_ASSERT_TRUE_MSG((size <= image_size(arg_other)), "The new image won't fit in the target frame buffer!");
+        PY_ASSERT_TRUE_MSG((image_size(&image) <= image_size(arg_other)), "The new image won't fit in the target frame buffer!");
         image.data = arg_other->data;
     } else {
-        image.data = xalloc(size);
+        image.data = xalloc(image_size(&image));
     }
 
     char ignore[15];
-    read_data(fp, image.data, size);
+    if (encoding == IMAGE_STREAM_LOSSLESS) {
+        // Read the whole frame at once and decompress it into the image.
+        fb_alloc_mark();
+        uint8_t *data = fb_alloc(size, FB_ALLOC_NO_HINT);
+        read_data(fp, data, size);
+        if (lossless_decompress(data, size, &image)) {
+            fb_alloc_free_till_mark();
+            ff_file_corrupted(fp);
+        }
+        fb_alloc_free_till_mark();
+    } else {
+        read_data(fp, image.data, size);
+    }
     if (size % 16) read_data(fp, ignore, 16 - (size % 16)); // Read in to multiple of 16 bytes.
     py_helper_update_framebuffer(&image);
 
@@ -6872,6 +7504,51 @@ mp_obj_t py_imagereader_next_frame(uint n_args, const mp_obj_t *args, mp_map_t *
     return py_image_from_struct(&image);
 }
 
+mp_obj_t py_imagereader_seek(mp_obj_t self_in, mp_obj_t frame_obj)
+{
+    py_imagereader_obj_t *self = self_in;
+    int frame = mp_obj_get_int(frame_obj);
+    PY_ASSERT_TRUE_MSG(self->frames, "The stream has no frame index!");
+
+    if (frame < 0) {
+        frame += self->frames;
+    }
+
+    PY_ASSERT_TRUE_MSG((0 <= frame) && (frame < ((int) self->frames)), "Frame index out of range!");
+
+    uint32_t offset;
+    file_seek(&self->fp, self->data_end + (frame * 8));
+    read_long(&self->fp, &offset);
+    file_seek(&self->fp, offset);
+
+    // Don't wait for the next frame.
+    self->ms = systick_current_millis() - 0x7FFFFFFF;
+    return self_in;
+}
+
+mp_obj_t py_imagereader_seek_ms(mp_obj_t self_in, mp_obj_t ms_obj)
+{
+    py_imagereader_obj_t *self = self_in;
+    uint32_t ms = IM_MAX(mp_obj_get_int(ms_obj), 0);
+    PY_ASSERT_TRUE_MSG(self->frames, "The stream has no frame index!");
+
+    // Binary search for the last frame at or before ms.
+    int lo = 0, hi = self->frames - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        uint32_t mid_ms;
+        file_seek(&self->fp, self->data_end + (mid * 8) + 4);
+        read_long(&self->fp, &mid_ms);
+        if (mid_ms <= ms) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return py_imagereader_seek(self_in, mp_obj_new_int(lo));
+}
+
 mp_obj_t py_imagereader_close(mp_obj_t self_in)
 {
     file_close(&((py_imagereader_obj_t *) self_in)->fp);
@@ -6879,12 +7556,18 @@ mp_obj_t py_imagereader_close(mp_obj_t self_in)
 }
 
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagereader_size_obj, py_imagereader_size);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagereader_count_obj, py_imagereader_count);
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_imagereader_next_frame_obj, 1, py_imagereader_next_frame);
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_imagereader_seek_obj, py_imagereader_seek);
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_imagereader_seek_ms_obj, py_imagereader_seek_ms);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_imagereader_close_obj, py_imagereader_close);
 
 STATIC const mp_rom_map_elem_t py_imagereader_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_size), MP_ROM_PTR(&py_imagereader_size_obj) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&py_imagereader_count_obj) },
     { MP_ROM_QSTR(MP_QSTR_next_frame), MP_ROM_PTR(&py_imagereader_next_frame_obj) },
+    { MP_ROM_QSTR(MP_QSTR_seek), MP_ROM_PTR(&py_imagereader_seek_obj) },
+    { MP_ROM_QSTR(MP_QSTR_seek_ms), MP_ROM_PTR(&py_imagereader_seek_ms_obj) },
     { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&py_imagereader_close_obj) }
 };
 
@@ -6906,7 +7589,32 @@ mp_obj_t py_image_imagereader(mp_obj_t path)
     read_long_expect(&obj->fp, *((uint32_t *) "OMV ")); // OpenMV
     read_long_expect(&obj->fp, *((uint32_t *) "IMG ")); // Image
     read_long_expect(&obj->fp, *((uint32_t *) "STR ")); // Stream
-    read_long_expect(&obj->fp, *((uint32_t *) "V1.0")); // v1.0
+
+    uint32_t version;
+    read_long(&obj->fp, &version);
+    obj->v2 = (version == *((uint32_t *) "V2.0"));
+    if ((!obj->v2) && (version != *((uint32_t *) "V1.0"))) {
+        ff_unsupported_format(&obj->fp);
+    }
+
+    uint32_t file_size = f_size(&obj->fp);
+    obj->frames = 0;
+    obj->data_end = file_size;
+
+    if (obj->v2 && (file_size >= (16 + IMAGE_STREAM_FOOTER))) {
+        uint32_t index_offset, frames, magic, index_version;
+        file_seek(&obj->fp, file_size - IMAGE_STREAM_FOOTER);
+        read_long(&obj->fp, &index_offset);
+        read_long(&obj->fp, &frames);
+        read_long(&obj->fp, &magic);
+        read_long(&obj->fp, &index_version);
+        if ((magic == *((uint32_t *) "IDX ")) && (index_version == *((uint32_t *) "V2.0"))
+        && (index_offset >= 16) && ((index_offset + (frames * 8) + IMAGE_STREAM_FOOTER) == file_size)) {
+            obj->frames = frames;
+            obj->data_end = index_offset;
+        }
+        file_seek(&obj->fp, 16);
+    }
 
     obj->ms = systick_current_millis();
     return obj;
@@ -7163,6 +7871,8 @@ mp_obj_t py_image(int w, int h, int bpp, void *pixels)
     o->_cobj.h = h;
     o->_cobj.bpp = bpp;
     o->_cobj.pixels = pixels;
+    o->_cobj.stride = 0;
+    o->parent = MP_OBJ_NULL;
     return o;
 }
 
@@ -7171,6 +7881,7 @@ mp_obj_t py_image_from_struct(image_t *img)
     py_image_obj_t *o = m_new_obj(py_image_obj_t);
     o->base.type = &py_image_type;
     o->_cobj = *img;
+    o->parent = MP_OBJ_NULL;
     return o;
 }
 
@@ -7259,6 +7970,86 @@ mp_obj_t py_image_load_image(uint n_args, const mp_obj_t *args, mp_map_t *kw_arg
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_load_image_obj, 1, py_image_load_image);
 
+#ifdef IMLIB_ENABLE_LENS_CORR
+mp_obj_t py_image_remap_table(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_remap_obj_t *o = m_new_obj(py_remap_obj_t);
+    o->base.type = &py_remap_type;
+    o->buf = NULL;
+    o->used = false;
+    o->bilinear = py_helper_keyword_int(n_args, args, 0, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bilinear), false);
+    // The table is built by the first lens_corr() call it is passed to.
+    o->_cobj.points = NULL;
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_remap_table_obj, 0, py_image_remap_table);
+#endif // IMLIB_ENABLE_LENS_CORR
+
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+mp_obj_t py_image_gradient_field(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    mp_obj_t *arg_roi;
+    mp_obj_get_array_fixed_n(args[0], 4, &arg_roi);
+    rectangle_t roi = {
+        .x = mp_obj_get_int(arg_roi[0]),
+        .y = mp_obj_get_int(arg_roi[1]),
+        .w = mp_obj_get_int(arg_roi[2]),
+        .h = mp_obj_get_int(arg_roi[3])
+    };
+    PY_ASSERT_TRUE_MSG((roi.w >= 1) && (roi.h >= 1), "Invalid ROI dimensions!");
+
+    unsigned int x_stride = py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_x_stride), 2);
+    PY_ASSERT_TRUE_MSG(x_stride > 0, "x_stride must not be zero.");
+    unsigned int y_stride = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_stride), 1);
+    PY_ASSERT_TRUE_MSG(y_stride > 0, "y_stride must not be zero.");
+
+    // The field is heap memory owned by the object, so it lives as long as the object does.
+    py_gradient_obj_t *o = m_new_obj(py_gradient_obj_t);
+    o->base.type = &py_gradient_type;
+    o->data = NULL; // Computed by gradient() on each new frame.
+    o->frame_id = 0;
+
+    imlib_gradient_init(&o->_cobj, xalloc(imlib_gradient_size(&roi, x_stride, y_stride)),
+                        &roi, x_stride, y_stride);
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_gradient_field_obj, 1, py_image_gradient_field);
+#endif // IMLIB_ENABLE_FIND_LINES || IMLIB_ENABLE_FIND_CIRCLES
+
+mp_obj_t py_image_thresholds(mp_obj_t thresholds_obj)
+{
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    py_helper_arg_to_thresholds(thresholds_obj, &thresholds);
+
+    py_thresholds_obj_t *o = m_new_obj(py_thresholds_obj_t);
+    o->base.type = &py_thresholds_type;
+    o->len = list_size(&thresholds);
+    o->thresholds = xalloc(o->len * sizeof(color_thresholds_list_lnk_data_t));
+    // The tables are built by the first RGB565 call the object is passed to.
+    o->tables = NULL;
+    o->no_tables = false;
+
+    for (size_t i = 0; list_size(&thresholds); i++) {
+        list_pop_front(&thresholds, &o->thresholds[i]);
+    }
+
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_thresholds_obj, py_image_thresholds);
+
+#ifdef IMLIB_ENABLE_FIND_DISPLACEMENT
+mp_obj_t py_image_displacement_tracker(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_displacement_tracker_obj_t *o = m_new_obj(py_displacement_tracker_obj_t);
+    o->base.type = &py_displacement_tracker_type;
+    // The spectra are allocated by the first find_displacement() call it is passed to.
+    memset(&o->_cobj, 0, sizeof(o->_cobj));
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_displacement_tracker_obj, 0, py_image_displacement_tracker);
+#endif // IMLIB_ENABLE_FIND_DISPLACEMENT
+
 mp_obj_t py_image_load_cascade(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
     cascade_t cascade;
@@ -7286,6 +8077,13 @@ mp_obj_t py_image_load_cascade(uint n_args, const mp_obj_t *args, mp_map_t *kw_a
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_load_cascade_obj, 1, py_image_load_cascade);
 
 #ifdef IMLIB_ENABLE_DESCRIPTOR
+mp_obj_t py_image_keypoint_database(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    // Models are added with add() or the whole database is loaded with load_descriptor().
+    return py_kp_db_new();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_keypoint_database_obj, 0, py_image_keypoint_database);
+
 mp_obj_t py_image_load_descriptor(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
     FIL fp;
@@ -7316,6 +8114,15 @@ mp_obj_t py_image_load_descriptor(uint n_args, const mp_obj_t *args, mp_map_t *k
                 break;
             }
 
+            case DESC_ORB_DB: {
+                py_kp_db_obj_t *db = py_kp_db_new();
+                res = orb_db_load(&fp, &db->_cobj);
+                if (res == FR_OK) {
+                    desc = db;
+                }
+                break;
+            }
+
             case DESC_ORB: {
                 array_t *kpts = NULL;
                 array_alloc(&kpts, xfree);
@@ -7328,6 +8135,7 @@ mp_obj_t py_image_load_descriptor(uint n_args, const mp_obj_t *args, mp_map_t *k
                     kp_obj->kpts = kpts;
                     kp_obj->threshold = 10;
                     kp_obj->normalized = false;
+                    kp_obj->index.kpts = NULL;
                     desc = kp_obj;
                 }
                 break;
@@ -7367,6 +8175,8 @@ mp_obj_t py_image_save_descriptor(uint n_args, const mp_obj_t *args, mp_map_t *k
             desc_type = DESC_LBP;
         } else if (desc_obj_type ==  &py_kp_type) {
             desc_type = DESC_ORB;
+        } else if (desc_obj_type ==  &py_kp_db_type) {
+            desc_type = DESC_ORB_DB;
         }
 
         // Write descriptor type
@@ -7388,6 +8198,12 @@ mp_obj_t py_image_save_descriptor(uint n_args, const mp_obj_t *args, mp_map_t *k
                 res = orb_save_descriptor(&fp, kpts->kpts);
                 break;
             }
+
+            case DESC_ORB_DB: {
+                py_kp_db_obj_t *db = ((py_kp_db_obj_t*)args[0]);
+                res = orb_db_save(&fp, &db->_cobj);
+                break;
+            }
         }
         // ignore unsupported descriptors when saving
         f_close(&fp);
@@ -7407,6 +8223,50 @@ static mp_obj_t py_image_match_descriptor(uint n_args, const mp_obj_t *args, mp_
     mp_obj_t match_obj = mp_const_none;
     mp_obj_type_t *desc1_type = mp_obj_get_type(args[0]);
     mp_obj_type_t *desc2_type = mp_obj_get_type(args[1]);
+
+    // A keypoints database is matched against the keypoints of a frame in one call.
+    if (desc1_type == &py_kp_db_type) {
+        py_kp_db_obj_t *db = ((py_kp_db_obj_t*)args[0]);
+        py_kp_obj_t *kpts = py_kpts_obj(args[1]);
+        int threshold = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), 85);
+        PY_ASSERT_TRUE_MSG((threshold >=0 && threshold <= 100), "Expected threshold between 0 and 100");
+
+        // List of (model, count) tuples of the matched models, most matches first.
+        mp_obj_t match_list = mp_obj_new_list(0, NULL);
+
+        if (db->_cobj.count && array_length(kpts->kpts)) {
+            fb_alloc_mark();
+            int *counts = fb_alloc(db->_cobj.count * sizeof(int), FB_ALLOC_NO_HINT);
+            int *models = fb_alloc(db->_cobj.count * sizeof(int), FB_ALLOC_NO_HINT);
+            int matched = 0;
+
+            orb_db_match(&db->_cobj, kpts->kpts, threshold, counts);
+
+            // Insertion sort of the matched models by count, ties keep the model order.
+            for (int i=0; i<db->_cobj.count; i++) {
+                if (counts[i]) {
+                    int j = matched++;
+                    for (; j && (counts[models[j - 1]] < counts[i]); j--) {
+                        models[j] = models[j - 1];
+                    }
+                    models[j] = i;
+                }
+            }
+
+            for (int i=0; i<matched; i++) {
+                mp_obj_t model_obj[2] = {
+                    mp_obj_new_int(models[i]),
+                    mp_obj_new_int(counts[models[i]]),
+                };
+                mp_obj_list_append(match_list, mp_obj_new_tuple(2, model_obj));
+            }
+
+            fb_alloc_free_till_mark();
+        }
+
+        return match_list;
+    }
+
     PY_ASSERT_TRUE_MSG((desc1_type == desc2_type), "Descriptors have different types!");
 
     if (desc1_type ==  &py_lbp_type) {
@@ -7424,6 +8284,7 @@ static mp_obj_t py_image_match_descriptor(uint n_args, const mp_obj_t *args, mp_
         py_kp_obj_t *kpts2 = ((py_kp_obj_t*)args[1]);
         int threshold = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), 85);
         int filter_outliers = py_helper_keyword_int(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_filter_outliers), false);
+        int index = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_index), false);
 
         // Sanity checks
         PY_ASSERT_TYPE(kpts1, &py_kp_type);
@@ -7442,7 +8303,9 @@ static mp_obj_t py_image_match_descriptor(uint n_args, const mp_obj_t *args, mp_
             int *match = fb_alloc(array_length(kpts1->kpts) * sizeof(int) * 2, FB_ALLOC_NO_HINT);
 
             // Match the two keypoint sets
-            count = orb_match_keypoints(kpts1->kpts, kpts2->kpts, match, threshold, &r, &c, &theta);
+            orb_index_t *index1 = index ? py_kpts_index(kpts1) : NULL;
+            orb_index_t *index2 = index ? py_kpts_index(kpts2) : NULL;
+            count = orb_match_keypoints(kpts1->kpts, kpts2->kpts, match, threshold, &r, &c, &theta, index1, index2);
 
             // Add matching keypoints to Python list.
             for (int i=0; i<count*2; i+=2) {
@@ -7541,6 +8404,7 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_CODE128),             MP_ROM_INT(BARCODE_CODE128)},
 #endif
     {MP_ROM_QSTR(MP_QSTR_IMAGE_HINT_BILINEAR),MP_ROM_INT(IMAGE_HINT_BILINEAR)},
+    {MP_ROM_QSTR(MP_QSTR_IMAGE_HINT_AREA),          MP_ROM_INT(IMAGE_HINT_AREA)},
     {MP_ROM_QSTR(MP_QSTR_IMAGE_HINT_CENTER),        MP_ROM_INT(IMAGE_HINT_CENTER)},
     {MP_ROM_QSTR(MP_QSTR_ImageWriter),         MP_ROM_PTR(&py_image_imagewriter_obj)},
     {MP_ROM_QSTR(MP_QSTR_ImageReader),         MP_ROM_PTR(&py_image_imagereader_obj)},
@@ -7566,11 +8430,29 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_yuv_to_lab),          MP_ROM_PTR(&py_image_yuv_to_lab_obj)},
     {MP_ROM_QSTR(MP_QSTR_Image),               MP_ROM_PTR(&py_image_load_image_obj)},
     {MP_ROM_QSTR(MP_QSTR_HaarCascade),         MP_ROM_PTR(&py_image_load_cascade_obj)},
+    {MP_ROM_QSTR(MP_QSTR_Thresholds),          MP_ROM_PTR(&py_image_thresholds_obj)},
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+    {MP_ROM_QSTR(MP_QSTR_Gradient),            MP_ROM_PTR(&py_image_gradient_field_obj)},
+#else
+    {MP_ROM_QSTR(MP_QSTR_Gradient),            MP_ROM_PTR(&py_func_unavailable_obj)},
+#endif
+#ifdef IMLIB_ENABLE_LENS_CORR
+    {MP_ROM_QSTR(MP_QSTR_RemapTable),          MP_ROM_PTR(&py_image_remap_table_obj)},
+#else
+    {MP_ROM_QSTR(MP_QSTR_RemapTable),          MP_ROM_PTR(&py_func_unavailable_obj)},
+#endif
+#ifdef IMLIB_ENABLE_FIND_DISPLACEMENT
+    {MP_ROM_QSTR(MP_QSTR_DisplacementTracker), MP_ROM_PTR(&py_image_displacement_tracker_obj)},
+#else
+    {MP_ROM_QSTR(MP_QSTR_DisplacementTracker), MP_ROM_PTR(&py_func_unavailable_obj)},
+#endif
 #ifdef IMLIB_ENABLE_DESCRIPTOR
+    {MP_ROM_QSTR(MP_QSTR_KeypointDatabase),    MP_ROM_PTR(&py_image_keypoint_database_obj)},
     {MP_ROM_QSTR(MP_QSTR_load_descriptor),     MP_ROM_PTR(&py_image_load_descriptor_obj)},
     {MP_ROM_QSTR(MP_QSTR_save_descriptor),     MP_ROM_PTR(&py_image_save_descriptor_obj)},
     {MP_ROM_QSTR(MP_QSTR_match_descriptor),    MP_ROM_PTR(&py_image_match_descriptor_obj)}
 #else
+    {MP_ROM_QSTR(MP_QSTR_KeypointDatabase),    MP_ROM_PTR(&py_func_unavailable_obj)},
     {MP_ROM_QSTR(MP_QSTR_load_descriptor),     MP_ROM_PTR(&py_func_unavailable_obj)},
     {MP_ROM_QSTR(MP_QSTR_save_descriptor),     MP_ROM_PTR(&py_func_unavailable_obj)},
     {MP_ROM_QSTR(MP_QSTR_match_descriptor),    MP_ROM_PTR(&py_func_unavailable_obj)}
@@ -15,5 +15,6 @@
 mp_obj_t py_image(int width, int height, int bpp, void *pixels);
 mp_obj_t py_image_from_struct(image_t *img);
 void *py_image_cobj(mp_obj_t img_obj);
+void *py_image_cobj_strided(mp_obj_t img_obj);
 int py_image_descriptor_from_roi(image_t *img, const char *path, rectangle_t *roi);
 #endif // __PY_IMAGE_H__
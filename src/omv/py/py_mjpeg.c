@@ -9,6 +9,7 @@
  * MJPEG Python module.
  */
 #include "mp.h"
+#include "xalloc.h"
 #include "ff_wrapper.h"
 #include "framebuffer.h"
 #include "sensor.h"
@@ -22,22 +23,45 @@ typedef struct py_mjpeg_obj {
     mp_obj_base_t base;
     int width;
     int height;
-    uint32_t frames;
-    uint32_t bytes;
-    FIL fp;
+    mp_obj_t idx_path;
+    mjpeg_t mjpeg;
 } py_mjpeg_obj_t;
 
+// Closes both files after an error and removes the temporary index file, the recording can't be
+// continued since the file helpers close the file that failed.
+static void py_mjpeg_abort(py_mjpeg_obj_t *mjpeg)
+{
+    f_close(&mjpeg->mjpeg.fp);
+    f_close(&mjpeg->mjpeg.idx_fp);
+    f_unlink_helper(mp_obj_str_get_str(mjpeg->idx_path));
+}
+
 static mp_obj_t py_mjpeg_open(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
     py_mjpeg_obj_t *mjpeg = m_new_obj(py_mjpeg_obj_t);
     mjpeg->width  = py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_width), MAIN_FB()->w);
     mjpeg->height = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_height), MAIN_FB()->h);
-    mjpeg->frames = 0; // private
-    mjpeg->bytes = 0; // private
     mjpeg->base.type = &py_mjpeg_type;
 
-    file_write_open(&mjpeg->fp, mp_obj_str_get_str(args[0]));
-    mjpeg_open(&mjpeg->fp, mjpeg->width, mjpeg->height);
+    // The frame index is stored in a temporary file next to the recording.
+    vstr_t idx_path;
+    vstr_init(&idx_path, 0);
+    vstr_add_str(&idx_path, mp_obj_str_get_str(args[0]));
+    vstr_add_str(&idx_path, ".idx");
+    mjpeg->idx_path = mp_obj_new_str_from_vstr(&mp_type_str, &idx_path);
+
+    file_write_open(&mjpeg->mjpeg.fp, mp_obj_str_get_str(args[0]));
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        file_read_write_open(&mjpeg->mjpeg.idx_fp, mp_obj_str_get_str(mjpeg->idx_path));
+        mjpeg_open(&mjpeg->mjpeg, mjpeg->width, mjpeg->height);
+        nlr_pop();
+    } else {
+        py_mjpeg_abort(mjpeg);
+        nlr_jump(nlr.ret_val);
+    }
+
     return mjpeg;
 }
 
@@ -56,7 +80,13 @@ static mp_obj_t py_mjpeg_height(mp_obj_t mjpeg_obj)
 static mp_obj_t py_mjpeg_size(mp_obj_t mjpeg_obj)
 {
     py_mjpeg_obj_t *arg_mjpeg = mjpeg_obj;
-    return mp_obj_new_int(f_size(&arg_mjpeg->fp));
+    return mp_obj_new_int(f_size(&arg_mjpeg->mjpeg.fp));
+}
+
+static mp_obj_t py_mjpeg_count(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_int(arg_mjpeg->mjpeg.frames);
 }
 
 static mp_obj_t py_mjpeg_add_frame(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
@@ -69,14 +99,37 @@ static mp_obj_t py_mjpeg_add_frame(uint n_args, const mp_obj_t *args, mp_map_t *
 
     int arg_q = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quality), 50);
     arg_q = IM_MIN(IM_MAX(arg_q, 1), 100);
-    mjpeg_add_frame(&arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, arg_img, arg_q);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mjpeg_add_frame(&arg_mjpeg->mjpeg, arg_img, arg_q);
+        nlr_pop();
+    } else {
+        // Out of memory errors happen before anything is written.
+        if (mp_obj_exception_match((mp_obj_t) nlr.ret_val, &mp_type_OSError)) {
+            py_mjpeg_abort(arg_mjpeg);
+        }
+        nlr_jump(nlr.ret_val);
+    }
+
     return mp_const_none;
 }
 
 static mp_obj_t py_mjpeg_close(mp_obj_t mjpeg_obj, mp_obj_t fps_obj)
 {
     py_mjpeg_obj_t *arg_mjpeg = mjpeg_obj;
-    mjpeg_close(&arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, mp_obj_get_float(fps_obj));
+    float fps = mp_obj_get_float(fps_obj);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mjpeg_close(&arg_mjpeg->mjpeg, fps);
+        nlr_pop();
+    } else {
+        py_mjpeg_abort(arg_mjpeg);
+        nlr_jump(nlr.ret_val);
+    }
+
+    f_unlink_helper(mp_obj_str_get_str(arg_mjpeg->idx_path));
     return mp_const_none;
 }
 
@@ -89,12 +142,14 @@ static void py_mjpeg_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_width_obj, py_mjpeg_width);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_height_obj, py_mjpeg_height);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_size_obj, py_mjpeg_size);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_count_obj, py_mjpeg_count);
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_mjpeg_add_frame_obj, 2, py_mjpeg_add_frame);
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_mjpeg_close_obj, py_mjpeg_close);
 static const mp_map_elem_t locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_width),       (mp_obj_t)&py_mjpeg_width_obj     },
     { MP_OBJ_NEW_QSTR(MP_QSTR_height),      (mp_obj_t)&py_mjpeg_height_obj    },
     { MP_OBJ_NEW_QSTR(MP_QSTR_size),        (mp_obj_t)&py_mjpeg_size_obj      },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_count),       (mp_obj_t)&py_mjpeg_count_obj     },
     { MP_OBJ_NEW_QSTR(MP_QSTR_add_frame),   (mp_obj_t)&py_mjpeg_add_frame_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_close),       (mp_obj_t)&py_mjpeg_close_obj     },
     { NULL, NULL },
@@ -108,10 +163,149 @@ static const mp_obj_type_t py_mjpeg_type = {
     .locals_dict = (mp_obj_t)&locals_dict,
 };
 
+static const mp_obj_type_t py_mjpeg_reader_type; // forward declare
+// MjpegReader class
+typedef struct py_mjpeg_reader_obj {
+    mp_obj_base_t base;
+    mjpeg_reader_t reader;
+} py_mjpeg_reader_obj_t;
+
+static mp_obj_t py_mjpeg_reader_open(mp_obj_t path)
+{
+    py_mjpeg_reader_obj_t *mjpeg = m_new_obj(py_mjpeg_reader_obj_t);
+    mjpeg->base.type = &py_mjpeg_reader_type;
+
+    file_read_open(&mjpeg->reader.fp, mp_obj_str_get_str(path));
+    mjpeg_read_open(&mjpeg->reader);
+    return mjpeg;
+}
+
+static mp_obj_t py_mjpeg_reader_width(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_int(arg_mjpeg->reader.width);
+}
+
+static mp_obj_t py_mjpeg_reader_height(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_int(arg_mjpeg->reader.height);
+}
+
+static mp_obj_t py_mjpeg_reader_size(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_int(f_size(&arg_mjpeg->reader.fp));
+}
+
+static mp_obj_t py_mjpeg_reader_count(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_int(arg_mjpeg->reader.frames);
+}
+
+static mp_obj_t py_mjpeg_reader_fps(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    return mp_obj_new_float((!arg_mjpeg->reader.micros) ? 0 : (1000000.0f / arg_mjpeg->reader.micros));
+}
+
+static mp_obj_t py_mjpeg_reader_read_frame(uint n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = args[0];
+    int index = mp_obj_get_int(args[1]);
+    if (index < 0) {
+        index += arg_mjpeg->reader.frames;
+    }
+    PY_ASSERT_TRUE_MSG((0 <= index) && (index < ((int) arg_mjpeg->reader.frames)), "Frame index out of range!");
+
+    mp_obj_t copy_to_fb_obj = py_helper_keyword_object(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_copy_to_fb));
+    bool copy_to_fb = true;
+    image_t *arg_other = NULL;
+
+    if (copy_to_fb_obj) {
+        if (mp_obj_is_integer(copy_to_fb_obj)) {
+            copy_to_fb = mp_obj_get_int(copy_to_fb_obj);
+        } else {
+            arg_other = py_helper_arg_to_image_mutable(copy_to_fb_obj);
+        }
+    }
+
+    if (copy_to_fb) {
+        fb_update_jpeg_buffer();
+    }
+
+    image_t image = {0};
+    image.w = arg_mjpeg->reader.width;
+    image.h = arg_mjpeg->reader.height;
+    image.bpp = mjpeg_seek_frame(&arg_mjpeg->reader, index);
+
+    if (copy_to_fb) {
+        py_helper_set_to_framebuffer(&image);
+    } else if (arg_other) {
+        PY_ASSERT_TRUE_MSG((image.bpp <= image_size(arg_other)), "The new image won't fit in the target frame buffer!");
+        image.data = arg_other->data;
+    } else {
+        image.data = xalloc(image.bpp);
+    }
+
+    read_data(&arg_mjpeg->reader.fp, image.data, image.bpp);
+    py_helper_update_framebuffer(&image);
+
+    if (arg_other) {
+        arg_other->w = image.w;
+        arg_other->h = image.h;
+        arg_other->bpp = image.bpp;
+    }
+
+    return py_image_from_struct(&image);
+}
+
+static mp_obj_t py_mjpeg_reader_close(mp_obj_t mjpeg_obj)
+{
+    py_mjpeg_reader_obj_t *arg_mjpeg = mjpeg_obj;
+    file_close(&arg_mjpeg->reader.fp);
+    return mp_const_none;
+}
+
+static void py_mjpeg_reader_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_mjpeg_reader_obj_t *self = self_in;
+    mp_printf(print, "<mjpeg_reader width:%d height:%d count:%d>", self->reader.width, self->reader.height, self->reader.frames);
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_width_obj, py_mjpeg_reader_width);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_height_obj, py_mjpeg_reader_height);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_size_obj, py_mjpeg_reader_size);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_count_obj, py_mjpeg_reader_count);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_fps_obj, py_mjpeg_reader_fps);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_mjpeg_reader_read_frame_obj, 2, py_mjpeg_reader_read_frame);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_close_obj, py_mjpeg_reader_close);
+static const mp_map_elem_t reader_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_width),       (mp_obj_t)&py_mjpeg_reader_width_obj      },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_height),      (mp_obj_t)&py_mjpeg_reader_height_obj     },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_size),        (mp_obj_t)&py_mjpeg_reader_size_obj       },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_count),       (mp_obj_t)&py_mjpeg_reader_count_obj      },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_fps),         (mp_obj_t)&py_mjpeg_reader_fps_obj        },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read_frame),  (mp_obj_t)&py_mjpeg_reader_read_frame_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_close),       (mp_obj_t)&py_mjpeg_reader_close_obj      },
+    { NULL, NULL },
+};
+STATIC MP_DEFINE_CONST_DICT(reader_locals_dict, reader_locals_dict_table);
+
+static const mp_obj_type_t py_mjpeg_reader_type = {
+    { &mp_type_type },
+    .name  = MP_QSTR_MjpegReader,
+    .print = py_mjpeg_reader_print,
+    .locals_dict = (mp_obj_t)&reader_locals_dict,
+};
+
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_mjpeg_open_obj, 1, py_mjpeg_open);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_reader_open_obj, py_mjpeg_reader_open);
 static const mp_map_elem_t globals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),    MP_OBJ_NEW_QSTR(MP_QSTR_mjpeg) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Mjpeg),       (mp_obj_t)&py_mjpeg_open_obj   },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MjpegReader), (mp_obj_t)&py_mjpeg_reader_open_obj },
     { NULL, NULL },
 };
 STATIC MP_DEFINE_CONST_DICT(globals_dict, globals_dict_table);
@@ -11,6 +11,7 @@
 #include <mp.h>
 #include "usbdbg.h"
 #include "framebuffer.h"
+#include "fb_alloc.h"
 #include "omv_boardconfig.h"
 
 static mp_obj_t py_omv_version_string()
@@ -59,6 +60,69 @@ static mp_obj_t py_omv_disable_fb(uint n_args, const mp_obj_t *args)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_disable_fb_obj, 0, 1, py_omv_disable_fb);
 
+static mp_obj_t py_omv_fb_alloc_profile(uint n_args, const mp_obj_t *args)
+{
+    if (!n_args) {
+        return mp_obj_new_bool(fb_alloc_profile_enabled());
+    }
+    fb_alloc_profile_enable(mp_obj_get_int(args[0]));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_fb_alloc_profile_obj, 0, 1, py_omv_fb_alloc_profile);
+
+// Returns (peak, min_free, dropped, fail, scopes, sites) where fail is None or
+// (caller, scope, size, free), each scope is (caller, parent, marks, peak) and
+// each site is (caller, scope, allocs, peak, max_alloc, max_all). Callers are
+// return addresses which can be looked up in firmware.elf with addr2line.
+static mp_obj_t py_omv_fb_alloc_stats(uint n_args, const mp_obj_t *args)
+{
+    const fb_alloc_profile_t *profile = fb_alloc_profile_get();
+    mp_obj_t fail = mp_const_none;
+
+    if (profile->fail.caller) {
+        fail = mp_obj_new_tuple(4, (mp_obj_t []) {mp_obj_new_int_from_uint(profile->fail.caller),
+                                                  mp_obj_new_int_from_uint(profile->fail.scope),
+                                                  mp_obj_new_int(profile->fail.size),
+                                                  mp_obj_new_int(profile->fail.free)});
+    }
+
+    mp_obj_t scopes = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < profile->n_scopes; i++) {
+        const fb_alloc_profile_scope_t *scope = &profile->scopes[i];
+        mp_obj_list_append(scopes, mp_obj_new_tuple(4, (mp_obj_t []) {mp_obj_new_int_from_uint(scope->caller),
+                                                                      mp_obj_new_int_from_uint(scope->parent),
+                                                                      mp_obj_new_int(scope->marks),
+                                                                      mp_obj_new_int(scope->peak)}));
+    }
+
+    mp_obj_t sites = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < profile->n_sites; i++) {
+        const fb_alloc_profile_site_t *site = &profile->sites[i];
+        mp_obj_list_append(sites, mp_obj_new_tuple(6, (mp_obj_t []) {mp_obj_new_int_from_uint(site->caller),
+                                                                     mp_obj_new_int_from_uint(site->scope),
+                                                                     mp_obj_new_int(site->allocs),
+                                                                     mp_obj_new_int(site->peak),
+                                                                     mp_obj_new_int(site->max_alloc),
+                                                                     mp_obj_new_int(site->max_all)}));
+    }
+
+    mp_obj_t result = mp_obj_new_tuple(6, (mp_obj_t []) {mp_obj_new_int(profile->peak),
+                                                         mp_obj_new_int((profile->min_free == UINT32_MAX)
+                                                                        ? fb_avail() : profile->min_free),
+                                                         mp_obj_new_int(profile->dropped),
+                                                         fail,
+                                                         scopes,
+                                                         sites});
+
+    // Optionally start a new measurement window (e.g. once per frame).
+    if (n_args && mp_obj_get_int(args[0])) {
+        fb_alloc_profile_clear();
+    }
+
+    return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_fb_alloc_stats_obj, 0, 1, py_omv_fb_alloc_stats);
+
 static const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),        MP_OBJ_NEW_QSTR(MP_QSTR_omv) },
     { MP_ROM_QSTR(MP_QSTR_version_major),   MP_ROM_INT(FIRMWARE_VERSION_MAJOR) },
@@ -68,7 +132,9 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_arch),            MP_ROM_PTR(&py_omv_arch_obj) },
     { MP_ROM_QSTR(MP_QSTR_board_type),      MP_ROM_PTR(&py_omv_board_type_obj) },
     { MP_ROM_QSTR(MP_QSTR_board_id),        MP_ROM_PTR(&py_omv_board_id_obj) },
-    { MP_ROM_QSTR(MP_QSTR_disable_fb),      MP_ROM_PTR(&py_omv_disable_fb_obj) }
+    { MP_ROM_QSTR(MP_QSTR_disable_fb),      MP_ROM_PTR(&py_omv_disable_fb_obj) },
+    { MP_ROM_QSTR(MP_QSTR_fb_alloc_profile), MP_ROM_PTR(&py_omv_fb_alloc_profile_obj) },
+    { MP_ROM_QSTR(MP_QSTR_fb_alloc_stats),  MP_ROM_PTR(&py_omv_fb_alloc_stats_obj) }
 };
 
 STATIC MP_DEFINE_CONST_DICT(globals_dict, globals_dict_table);
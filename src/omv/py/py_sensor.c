@@ -110,6 +110,7 @@ static mp_obj_t py_sensor_snapshot(uint n_args, const mp_obj_t *args, mp_map_t *
         nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_RuntimeError, "Capture Failed: %d", ret));
     }
 
+    framebuffer_new_frame();
     return image;
 }
 
@@ -464,6 +465,30 @@ static mp_obj_t py_sensor_get_auto_rotation() {
     return mp_obj_new_bool(sensor_get_auto_rotation());
 }
 
+static mp_obj_t py_sensor_set_framebuffers(mp_obj_t count) {
+    if (sensor_set_framebuffers(mp_obj_get_int(count)) != 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Invalid number of frame buffers!"));
+    }
+    return mp_const_none;
+}
+
+static mp_obj_t py_sensor_get_framebuffers() {
+    return mp_obj_new_int(sensor_get_framebuffers());
+}
+
+static mp_obj_t py_sensor_set_jpeg_stream(mp_obj_t quality) {
+    int q = mp_obj_get_int(quality);
+    PY_ASSERT_TRUE_MSG((0 <= q) && (q <= 100), "Quality must be between 0 and 100!");
+    if (sensor_set_jpeg_stream(q) != 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "JPEG streaming is not supported!"));
+    }
+    return mp_const_none;
+}
+
+static mp_obj_t py_sensor_get_jpeg_stream() {
+    return mp_obj_new_int(sensor_get_jpeg_stream());
+}
+
 static mp_obj_t py_sensor_set_special_effect(mp_obj_t sde) {
     if (sensor_set_special_effect(mp_obj_get_int(sde)) != 0) {
         return mp_const_false;
@@ -755,6 +780,10 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_transpose_obj,       py_sensor_se
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_transpose_obj,       py_sensor_get_transpose);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_auto_rotation_obj,   py_sensor_set_auto_rotation);
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_auto_rotation_obj,   py_sensor_get_auto_rotation);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_framebuffers_obj,    py_sensor_set_framebuffers);
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_framebuffers_obj,    py_sensor_get_framebuffers);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_jpeg_stream_obj,     py_sensor_set_jpeg_stream);
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_jpeg_stream_obj,     py_sensor_get_jpeg_stream);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_special_effect_obj,  py_sensor_set_special_effect);
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(py_sensor_set_lens_correction_obj, py_sensor_set_lens_correction);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_vsync_output_obj,    py_sensor_set_vsync_output);
@@ -887,6 +916,10 @@ STATIC const mp_map_elem_t globals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_get_transpose),       (mp_obj_t)&py_sensor_get_transpose_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_auto_rotation),   (mp_obj_t)&py_sensor_set_auto_rotation_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_get_auto_rotation),   (mp_obj_t)&py_sensor_get_auto_rotation_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_framebuffers),    (mp_obj_t)&py_sensor_set_framebuffers_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_get_framebuffers),    (mp_obj_t)&py_sensor_get_framebuffers_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_jpeg_stream),     (mp_obj_t)&py_sensor_set_jpeg_stream_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_get_jpeg_stream),     (mp_obj_t)&py_sensor_get_jpeg_stream_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_special_effect),  (mp_obj_t)&py_sensor_set_special_effect_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_lens_correction), (mp_obj_t)&py_sensor_set_lens_correction_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_vsync_output),    (mp_obj_t)&py_sensor_set_vsync_output_obj },
@@ -19,6 +19,8 @@ Q(arch)
 Q(board_type)
 Q(board_id)
 Q(disable_fb)
+Q(fb_alloc_profile)
+Q(fb_alloc_stats)
 
 // Image module
 Q(image)
@@ -43,6 +45,9 @@ Q(yuv_to_grayscale)
 Q(yuv_to_rgb)
 Q(yuv_to_lab)
 Q(HaarCascade)
+Q(RemapTable)
+Q(Thresholds)
+Q(Gradient)
 Q(search)
 Q(SEARCH_EX)
 Q(SEARCH_DS)
@@ -50,6 +55,7 @@ Q(EDGE_CANNY)
 Q(EDGE_SIMPLE)
 Q(CORNER_FAST)
 Q(CORNER_AGAST)
+Q(KeypointDatabase)
 Q(load_descriptor)
 Q(save_descriptor)
 Q(match_descriptor)
@@ -57,8 +63,10 @@ Q(match_descriptor)
 // Image class
 Q(find_template)
 Q(kp_desc)
+Q(kp_db)
 Q(lbp_desc)
 Q(Cascade)
+Q(remap_table)
 Q(cmp_lbp)
 Q(find_features)
 Q(find_keypoints)
@@ -103,6 +111,8 @@ Q(loop)
 // Mjpeg module
 Q(mjpeg)
 Q(Mjpeg)
+Q(MjpegReader)
+Q(read_frame)
 
 // Led Module
 Q(led)
@@ -279,6 +289,10 @@ Q(set_transpose)
 Q(get_transpose)
 Q(set_auto_rotation)
 Q(get_auto_rotation)
+Q(set_framebuffers)
+Q(get_framebuffers)
+Q(set_jpeg_stream)
+Q(get_jpeg_stream)
 Q(set_special_effect)
 Q(set_lens_correction)
 Q(ioctl)
@@ -484,6 +498,7 @@ Q(roi)
 Q(x_scale)
 Q(y_scale)
 // duplicate Q(copy_to_fb)
+Q(view)
 
 // Save
 Q(save)
@@ -556,6 +571,7 @@ Q(alpha)
 // duplicate Q(mask)
 Q(hint)
 Q(IMAGE_HINT_BILINEAR)
+Q(IMAGE_HINT_AREA)
 Q(IMAGE_HINT_CENTER)
 
 // Draw Keypoints
@@ -780,6 +796,9 @@ Q(sharpen)
 Q(bilateral)
 Q(color_sigma)
 Q(space_sigma)
+Q(fast)
+Q(remap)
+Q(bilinear)
 // duplicate Q(threshold)
 // duplicate Q(offset)
 // duplicate Q(invert)
@@ -992,6 +1011,7 @@ Q(find_lines)
 // duplicate Q(threshold)
 Q(theta_margin)
 Q(rho_margin)
+Q(gradient)
 
 // Find Line Segments
 Q(find_line_segments)
@@ -1011,6 +1031,7 @@ Q(r_margin)
 Q(r_min)
 Q(r_max)
 Q(r_step)
+// duplicate Q(gradient)
 // Circle Object
 Q(circle)
 // duplicate Q(circle)
@@ -1063,6 +1084,8 @@ Q(fx)
 Q(fy)
 // duplicate Q(cx)
 // duplicate Q(cy)
+Q(max_hamming)
+Q(decimate)
 // AprilTag Object
 Q(apriltag)
 // duplicate Q(corners)
@@ -1145,6 +1168,8 @@ Q(CODE128)
 
 // Find Displacement
 Q(find_displacement)
+Q(DisplacementTracker)
+Q(displacement_tracker)
 // duplicate Q(roi)
 Q(template_roi)
 // duplicate Q(logpolar)
@@ -1161,7 +1186,10 @@ Q(ImageWriter)
 // Image Writer Object
 Q(imagewriter)
 // duplicate Q(size)
+// duplicate Q(count)
 // duplicate Q(add_frame)
+// duplicate Q(quality)
+Q(lossless)
 // duplicate Q(close)
 
 // Image Reader
@@ -1169,7 +1197,10 @@ Q(ImageReader)
 // Image Reader Object
 Q(imagereader)
 // duplicate Q(size)
+// duplicate Q(count)
 Q(next_frame)
+Q(seek)
+Q(seek_ms)
 // duplicate Q(copy_to_fb)
 // duplicate Q(loop)
 // duplicate Q(close)
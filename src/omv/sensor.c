@@ -24,6 +24,7 @@
 #include "sensor.h"
 #include "systick.h"
 #include "framebuffer.h"
+#include "fb_alloc.h"
 #include "omv_boardconfig.h"
 
 #define MAX_XFER_SIZE   (0xFFFF*4)
@@ -41,6 +42,22 @@ static volatile int offset = 0;
 static volatile bool jpeg_buffer_overflow = false;
 static volatile bool waiting_for_data = false;
 
+// Window written by DCMI_DMAConvCpltUser(). This is latched from MAIN_FB() by snapshot since
+// the capture ring keeps receiving frames while the user is free to change MAIN_FB().
+static int capture_x, capture_y, capture_w, capture_h;
+
+// Capture ring state. The DCMI receives into ring_write while the user owns MAIN_FB()->buf_index.
+// ring_ready is the latest complete frame not handed to the user yet. Both are -1 if unused.
+static volatile int ring_write = -1;
+static volatile int ring_ready = -1;
+
+#if (OMV_HARDWARE_JPEG == 0)
+// Line streaming JPEG state. jpeg_stream_quality is 0 if disabled. jpeg_stream is only set while
+// sensor_snapshot_jpeg_stream() waits for a frame so DCMI_DMAConvCpltUser() can compress lines.
+static int jpeg_stream_quality = 0;
+static jpeg_stream_t *volatile jpeg_stream = NULL;
+#endif
+
 const int resolution[][2] = {
     {0,    0   },
     // C/SIF Resolutions
@@ -218,6 +235,30 @@ static void dcmi_abort()
         DCMI->CR &= ~DCMI_CR_ENABLE;
         HAL_DMA_Abort(&DMAHandle);
     }
+
+    // The next snapshot restarts the capture ring.
+    ring_write = -1;
+    ring_ready = -1;
+}
+
+// Stops the capture ring and moves the frame buffer back to a single buffer at the start of the
+// frame buffer memory. Note that this invalidates the current frame if it's not in the first buffer.
+static void ring_reset()
+{
+    dcmi_abort();
+    MAIN_FB()->buf_index = 0;
+    MAIN_FB()->buf_size = 0;
+}
+
+// Returns a ring buffer which is neither owned by the user nor holding the latest frame, or -1.
+static int ring_next_free()
+{
+    for (int i = 0; i < MAIN_FB()->n_buffers; i++) {
+        if ((i != MAIN_FB()->buf_index) && (i != ring_ready)) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 // Returns true if a crop is being applied to the frame buffer.
@@ -243,6 +284,9 @@ void sensor_init0()
     // Skip the first frame.
     MAIN_FB()->bpp = -1;
 
+    // Single frame buffer.
+    MAIN_FB()->n_buffers = 1;
+
     // Enable streaming.
     MAIN_FB()->streaming_enabled = true; // controlled by the OpenMV Cam.
 
@@ -680,6 +724,9 @@ int sensor_set_windowing(int x, int y, int w, int h)
         return -1;
     }
 
+    // The capture ring must not receive frames with the old window.
+    dcmi_abort();
+
     // We force everything to be a multiple of 2 so that when you switch between
     // grayscale/rgb565/bayer/jpeg the frame doesn't need to move around for bayer to work.
     MAIN_FB()->x = (x / 2) * 2;
@@ -872,6 +919,11 @@ int sensor_set_transpose(bool enable)
         return -1;
     }
 
+    // The capture ring must not receive frames with the old orientation.
+    if (sensor.transpose != enable) {
+        dcmi_abort();
+    }
+
     sensor.transpose = enable;
     return 0;
 }
@@ -896,6 +948,52 @@ bool sensor_get_auto_rotation()
     return sensor.auto_rotation;
 }
 
+int sensor_set_framebuffers(int count)
+{
+    if ((count < 1) || (count > FB_MAX_BUFFERS)) {
+        return -1;
+    }
+
+    ring_reset();
+    MAIN_FB()->n_buffers = count;
+
+    // Skip the first frame.
+    MAIN_FB()->bpp = -1;
+    return 0;
+}
+
+int sensor_get_framebuffers()
+{
+    return MAIN_FB()->n_buffers;
+}
+
+int sensor_set_jpeg_stream(int quality)
+{
+    #if (OMV_HARDWARE_JPEG == 0)
+    if ((quality < 0) || (quality > 100)) {
+        return -1;
+    }
+
+    jpeg_stream_quality = quality;
+
+    // Skip the first frame.
+    MAIN_FB()->bpp = -1;
+    return 0;
+    #else
+    // The hardware JPEG encoder compresses whole frames.
+    return -1;
+    #endif
+}
+
+int sensor_get_jpeg_stream()
+{
+    #if (OMV_HARDWARE_JPEG == 0)
+    return jpeg_stream_quality;
+    #else
+    return 0;
+    #endif
+}
+
 int sensor_set_special_effect(sde_t sde)
 {
     if (sensor.sde == sde) {
@@ -974,10 +1072,10 @@ void DCMI_VsyncExtiCallback()
 }
 
 // To make the user experience better we automatically shrink the size of the MAIN_FB() to fit
-// within the RAM we have onboard the system.
-static void sensor_check_buffsize()
+// within the RAM we have onboard the system. With the capture ring the frame has to fit in a ring buffer.
+static void sensor_check_buffsize(bool ring)
 {
-    uint32_t size = framebuffer_get_buffer_size();
+    uint32_t size = ring ? framebuffer_get_ring_buffer_size(MAIN_FB()->n_buffers) : framebuffer_get_buffer_size();
     uint32_t bpp;
 
     switch (sensor.pixformat) {
@@ -1120,6 +1218,20 @@ void *unaligned_memcpy(void *dest, void *src, size_t n)
 // waiting_for_data is set to false.
 void HAL_DCMI_FrameEventCallback(DCMI_HandleTypeDef *hdcmi)
 {
+    if (ring_write >= 0) {
+        // Capture ring mode: publish the frame (dropping an older one the user didn't take) and
+        // keep receiving into a free buffer if there is one. Otherwise the next frame is dropped
+        // and snapshot restarts the transfer once the user returns a buffer.
+        ring_ready = ring_write;
+        ring_write = ring_next_free();
+        if (ring_write >= 0) {
+            dest_fb = framebuffer_get_buffer_at(ring_write);
+        }
+        offset = 0;
+        waiting_for_data = (ring_write >= 0);
+        return;
+    }
+
     waiting_for_data = false;
 }
 
@@ -1192,33 +1304,56 @@ void DCMI_DMAConvCpltUser(uint32_t addr)
         return;
     }
 
+    #if (OMV_HARDWARE_JPEG == 0)
+    if (jpeg_stream) {
+        // Line streaming JPEG mode: the cropped lines go to the encoder which compresses every
+        // MCU row (8 or 16 lines) as soon as it's complete. This is too slow to keep up with
+        // high pixel clocks, in which case the line buffers overrun and the frame is corrupted.
+        if (offset >= capture_y && offset < (capture_y + capture_h)) {
+            uint8_t *line = jpeg_stream_get_line(jpeg_stream);
+            if (sensor.pixformat == PIXFORMAT_RGB565) {
+                unaligned_memcpy(line, src16 + capture_x, capture_w * sizeof(uint16_t));
+            } else if (sensor.gs_bpp == 1) {
+                unaligned_memcpy(line, src + capture_x, capture_w);
+            } else {
+                unaligned_2_to_1_memcpy(line, src16 + capture_x, capture_w);
+            }
+            if (jpeg_stream_put_line(jpeg_stream)) {
+                jpeg_buffer_overflow = true;
+            }
+        }
+        offset++;
+        return;
+    }
+    #endif
+
     // Implement per line, per pixel cropping, and image transposing (for image rotation) in
     // in software using the CPU to transfer the image from the line buffers to the frame buffer.
-    if (offset >= MAIN_FB()->y && offset <= (MAIN_FB()->y + MAIN_FB()->h)) {
+    if (offset >= capture_y && offset < (capture_y + capture_h)) {
         if (!sensor.transpose) {
             switch (sensor.pixformat) {
                 case PIXFORMAT_BAYER:
-                    dst += (offset - MAIN_FB()->y) * MAIN_FB()->w;
-                    src += MAIN_FB()->x;
-                    unaligned_memcpy(dst, src, MAIN_FB()->w);
+                    dst += (offset - capture_y) * capture_w;
+                    src += capture_x;
+                    unaligned_memcpy(dst, src, capture_w);
                     break;
                 case PIXFORMAT_GRAYSCALE:
-                    dst += (offset - MAIN_FB()->y) * MAIN_FB()->w;
+                    dst += (offset - capture_y) * capture_w;
                     if (sensor.gs_bpp == 1) {
                         // 1BPP GRAYSCALE.
-                        src += MAIN_FB()->x;
-                        unaligned_memcpy(dst, src, MAIN_FB()->w);
+                        src += capture_x;
+                        unaligned_memcpy(dst, src, capture_w);
                     } else {
                         // Extract Y channel from YUV.
-                        src16 += MAIN_FB()->x;
-                        unaligned_2_to_1_memcpy(dst, src16, MAIN_FB()->w);
+                        src16 += capture_x;
+                        unaligned_2_to_1_memcpy(dst, src16, capture_w);
                     }
                     break;
                 case PIXFORMAT_YUV422:
                 case PIXFORMAT_RGB565:
-                    dst16 += (offset - MAIN_FB()->y) * MAIN_FB()->w;
-                    src16 += MAIN_FB()->x;
-                    unaligned_memcpy(dst16, src16, MAIN_FB()->w * sizeof(uint16_t));
+                    dst16 += (offset - capture_y) * capture_w;
+                    src16 += capture_x;
+                    unaligned_memcpy(dst16, src16, capture_w * sizeof(uint16_t));
                     break;
                 default:
                     break;
@@ -1226,26 +1361,26 @@ void DCMI_DMAConvCpltUser(uint32_t addr)
         } else {
             switch (sensor.pixformat) {
                 case PIXFORMAT_BAYER:
-                    dst += offset - MAIN_FB()->y;
-                    src += MAIN_FB()->x;
-                    for (int i = MAIN_FB()->w, h = MAIN_FB()->h; i; i--) {
+                    dst += offset - capture_y;
+                    src += capture_x;
+                    for (int i = capture_w, h = capture_h; i; i--) {
                         *dst = *src++;
                         dst += h;
                     }
                     break;
                 case PIXFORMAT_GRAYSCALE:
-                    dst += offset - MAIN_FB()->y;
+                    dst += offset - capture_y;
                     if (sensor.gs_bpp == 1) {
-                        src += MAIN_FB()->x;
+                        src += capture_x;
                         // 1BPP GRAYSCALE.
-                        for (int i = MAIN_FB()->w, h = MAIN_FB()->h; i; i--) {
+                        for (int i = capture_w, h = capture_h; i; i--) {
                             *dst = *src++;
                             dst += h;
                         }
                     } else {
-                        src16 += MAIN_FB()->x;
+                        src16 += capture_x;
                         // Extract Y channel from YUV.
-                        for (int i = MAIN_FB()->w, h = MAIN_FB()->h; i; i--) {
+                        for (int i = capture_w, h = capture_h; i; i--) {
                             *dst = *src16++;
                             dst += h;
                         }
@@ -1253,9 +1388,9 @@ void DCMI_DMAConvCpltUser(uint32_t addr)
                     break;
                 case PIXFORMAT_YUV422:
                 case PIXFORMAT_RGB565:
-                    dst16 += offset - MAIN_FB()->y;
-                    src16 += MAIN_FB()->x;
-                    for (int i = MAIN_FB()->w, h = MAIN_FB()->h; i; i--) {
+                    dst16 += offset - capture_y;
+                    src16 += capture_x;
+                    for (int i = capture_w, h = capture_h; i; i--) {
                         *dst16 = *src16++;
                         dst16 += h;
                     }
@@ -1269,6 +1404,160 @@ void DCMI_DMAConvCpltUser(uint32_t addr)
     offset++;
 }
 
+// Capture ring snapshot. Instead of starting a capture and waiting for it, this hands the user the
+// latest complete frame and gives the buffer with the previous frame back to the DCMI, which keeps
+// receiving frames into the free buffers while the user processes the current one. With two buffers
+// the DCMI stops after filling the free buffer, with three it never stops and old frames are dropped.
+static int sensor_snapshot_ring(sensor_t *sensor, image_t *image, uint32_t addr, uint32_t length, uint32_t h)
+{
+    int bpp = ((sensor->pixformat == PIXFORMAT_RGB565) || (sensor->pixformat == PIXFORMAT_YUV422)) ? 2 : 1;
+    // sensor_check_buffsize() made sure that the frame fits in a ring buffer.
+    uint32_t buf_size = (((MAIN_FB()->u * MAIN_FB()->v * bpp) + 31) / 32) * 32;
+
+    // Restart the ring if the frame size changed.
+    if (MAIN_FB()->buf_size != buf_size) {
+        ring_reset();
+        MAIN_FB()->buf_size = buf_size;
+    }
+
+    for (uint32_t tick_start = HAL_GetTick(); ; ) {
+        bool frame_ready = false, start = false;
+
+        __disable_irq();
+        if (ring_ready >= 0) {
+            // Hand over the latest frame, the buffer of the previous one becomes free.
+            MAIN_FB()->buf_index = ring_ready;
+            ring_ready = -1;
+            frame_ready = true;
+        }
+        if (ring_write < 0) {
+            // Nothing is being received, either the ring was just (re)started or all buffers were full.
+            ring_write = ring_next_free();
+            dest_fb = framebuffer_get_buffer_at(ring_write);
+            capture_x = MAIN_FB()->x;
+            capture_y = MAIN_FB()->y;
+            capture_w = MAIN_FB()->u;
+            capture_h = MAIN_FB()->v;
+            offset = 0;
+            waiting_for_data = true;
+            start = true;
+        }
+        __enable_irq();
+
+        // If the line callback stopped the DCMI because there was no free buffer restart it. Otherwise
+        // waiting_for_data was set before the next frame started and it's received as usual.
+        if (start && (!(DCMI->CR & DCMI_CR_ENABLE))) {
+            HAL_DCMI_Start_DMA_MB(&DCMIHandle,
+                    DCMI_MODE_CONTINUOUS, addr, length/4, h);
+        }
+
+        if (frame_ready) {
+            break;
+        }
+
+        __WFI();
+
+        if ((HAL_GetTick() - tick_start) >= 3000) {
+            dcmi_abort();
+            return -4;
+        }
+    }
+
+    // Fix resolution if transposed.
+    if (sensor->transpose) {
+        MAIN_FB()->w = MAIN_FB()->v; // v==h -> w
+        MAIN_FB()->h = MAIN_FB()->u; // u==w -> h
+    }
+
+    // Fix the BPP.
+    MAIN_FB()->bpp = (sensor->pixformat == PIXFORMAT_BAYER) ? 3 : bpp;
+
+    // Set the user image.
+    if (image != NULL) {
+        image->w = MAIN_FB()->w;
+        image->h = MAIN_FB()->h;
+        image->bpp = MAIN_FB()->bpp;
+        image->pixels = framebuffer_get_buffer();
+        image->stride = 0;
+    }
+
+    return 0;
+}
+
+#if (OMV_HARDWARE_JPEG == 0)
+// Line streaming JPEG snapshot. The frame is compressed by DCMI_DMAConvCpltUser() while it's
+// received, so the frame buffer only has to hold the compressed frame and it's ready right at
+// the end of the frame.
+static int sensor_snapshot_jpeg_stream(sensor_t *sensor, image_t *image, uint32_t addr, uint32_t length, uint32_t h)
+{
+    int bpp = (sensor->pixformat == PIXFORMAT_RGB565) ? 2 : 1;
+    jpeg_stream_t stream;
+
+    fb_alloc_mark();
+    uint8_t *lines = fb_alloc(JPEG_STREAM_LINES_SIZE(capture_w, bpp), FB_ALLOC_NO_HINT);
+    image_t out = { .w = capture_w, .h = capture_h, .bpp = framebuffer_get_buffer_size(), .pixels = MAIN_FB()->pixels };
+    jpeg_stream_init(&stream, capture_w, capture_h, bpp, jpeg_stream_quality, &out, lines);
+
+    offset = 0;
+    jpeg_buffer_overflow = false;
+    jpeg_stream = &stream;
+    waiting_for_data = true;
+
+    if (!(DCMI->CR & DCMI_CR_ENABLE)) {
+        HAL_DCMI_Start_DMA_MB(&DCMIHandle,
+                DCMI_MODE_CONTINUOUS, addr, length/4, h);
+    }
+
+    #if defined(DCMI_FSYNC_PIN)
+    if (SENSOR_HW_FLAGS_GET(sensor, SENSOR_HW_FLAGS_FSYNC)) {
+        DCMI_FSYNC_HIGH();
+    }
+    #endif
+
+    int ret = 0;
+    for (uint32_t tick_start = HAL_GetTick(); waiting_for_data; ) {
+        __WFI();
+
+        if ((HAL_GetTick() - tick_start) >= 3000) {
+            waiting_for_data = false;
+            dcmi_abort();
+            ret = -4;
+            break;
+        }
+    }
+
+    #if defined(DCMI_FSYNC_PIN)
+    if (SENSOR_HW_FLAGS_GET(sensor, SENSOR_HW_FLAGS_FSYNC)) {
+        DCMI_FSYNC_LOW();
+    }
+    #endif
+
+    jpeg_stream = NULL;
+
+    if ((!ret) && (jpeg_buffer_overflow || jpeg_stream_end(&stream, &out))) {
+        ret = -5;
+    }
+
+    fb_alloc_free_till_mark();
+
+    if (ret) {
+        return ret;
+    }
+
+    MAIN_FB()->bpp = out.bpp;
+
+    if (image != NULL) {
+        image->w = MAIN_FB()->w;
+        image->h = MAIN_FB()->h;
+        image->bpp = MAIN_FB()->bpp;
+        image->pixels = MAIN_FB()->pixels;
+        image->stride = 0;
+    }
+
+    return 0;
+}
+#endif
+
 // This is the default snapshot function, which can be replaced in sensor_init functions. This function
 // uses the DCMI and DMA to capture frames and each line is processed in the DCMI_DMAConvCpltUser function.
 int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_cb)
@@ -1293,13 +1582,26 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
     // Note: This doesn't run unless the IDE is connected and the framebuffer is enabled.
     fb_update_jpeg_buffer();
 
+    // Line streaming JPEG mode is used for single snapshots of uncropped raw frames. Only the
+    // compressed frame has to fit in the frame buffer.
+    bool jpeg_streaming = false;
+    #if (OMV_HARDWARE_JPEG == 0)
+    jpeg_streaming = (!streaming) && jpeg_stream_quality && (!sensor->transpose)
+        && ((sensor->pixformat == PIXFORMAT_GRAYSCALE) || (sensor->pixformat == PIXFORMAT_RGB565));
+    #endif
+
+    // The capture ring is only used for raw frames in snapshot mode.
+    bool ring = (!streaming) && (!jpeg_streaming) && (MAIN_FB()->n_buffers > 1) && (sensor->pixformat != PIXFORMAT_JPEG);
+    #if defined(DCMI_FSYNC_PIN)
+    // Frame sync triggered sensors only output a frame per snapshot.
+    ring = ring && (!SENSOR_HW_FLAGS_GET(sensor, SENSOR_HW_FLAGS_FSYNC));
+    #endif
+
     // Make sure the raw frame fits into the FB. It will be switched from RGB565 to BAYER
     // first to save space before being cropped until it fits.
-    sensor_check_buffsize();
-
-    // Set the current frame buffer target used in the DMA line callback
-    // (DCMI_DMAConvCpltUser function), in both snapshot and streaming modes.
-    dest_fb = MAIN_FB()->pixels;
+    if (!jpeg_streaming) {
+        sensor_check_buffsize(ring);
+    }
 
     // The user may have changed the MAIN_FB width or height on the last image so we need
     // to restore that here. We don't have to restore bpp because that's taken care of
@@ -1308,6 +1610,22 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
     MAIN_FB()->w = MAIN_FB()->u;
     MAIN_FB()->h = MAIN_FB()->v;
 
+    if ((!ring) && MAIN_FB()->buf_size) {
+        ring_reset();
+    }
+
+    if (!ring) {
+        // Set the current frame buffer target used in the DMA line callback
+        // (DCMI_DMAConvCpltUser function), in both snapshot and streaming modes.
+        dest_fb = MAIN_FB()->pixels;
+
+        // Latch the window written by the DMA line callback.
+        capture_x = MAIN_FB()->x;
+        capture_y = MAIN_FB()->y;
+        capture_w = MAIN_FB()->w;
+        capture_h = MAIN_FB()->h;
+    }
+
     // If an error occurs we should have a valid w/h and invalid bpp so that we leave the frame
     // buffer like how sensor_set_pixformat()/sensor_set_framesize() leave it.
     MAIN_FB()->bpp = -1;
@@ -1365,6 +1683,16 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
         HAL_DCMI_ConfigCrop(&DCMIHandle,0,0,w-1,h-1);
     #endif
 
+    if (ring) {
+        return sensor_snapshot_ring(sensor, image, addr, length, h);
+    }
+
+    #if (OMV_HARDWARE_JPEG == 0)
+    if (jpeg_streaming) {
+        return sensor_snapshot_jpeg_stream(sensor, image, addr, length, h);
+    }
+    #endif
+
     do {
         // Clear the offset counter variable before we allow more data to be received.
         offset = 0;
@@ -1562,6 +1890,7 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
             image->h = MAIN_FB()->h;
             image->bpp = MAIN_FB()->bpp;
             image->pixels = MAIN_FB()->pixels;
+            image->stride = 0;
 
             if (streaming_cb) {
                 // In streaming mode, either switch frame buffers in double buffer mode,
@@ -299,6 +299,18 @@ int sensor_set_auto_rotation(bool enable);
 // Get transpose mode state.
 bool sensor_get_auto_rotation();
 
+// Set the number of frame buffers in the capture ring (1 to FB_MAX_BUFFERS).
+int sensor_set_framebuffers(int count);
+
+// Get the number of frame buffers in the capture ring.
+int sensor_get_framebuffers();
+
+// Set the line streaming JPEG quality (1 to 100, 0 disables), software JPEG only.
+int sensor_set_jpeg_stream(int quality);
+
+// Get the line streaming JPEG quality.
+int sensor_get_jpeg_stream();
+
 // Set special digital effects (SDE).
 int sensor_set_special_effect(sde_t sde);
 
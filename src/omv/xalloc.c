@@ -61,3 +61,10 @@ void *xrealloc(void *mem, uint32_t size)
     }
     return mem;
 }
+
+// returns null pointer without error if size==0 or if there is not enough memory,
+// in which case mem is left allocated
+void *xalloc_try_realloc(void *mem, uint32_t size)
+{
+    return gc_realloc(mem, size, true);
+}
@@ -16,4 +16,5 @@ void *xalloc_try_alloc(uint32_t size);
 void *xalloc0(uint32_t size);
 void xfree(void *mem);
 void *xrealloc(void *mem, uint32_t size);
+void *xalloc_try_realloc(void *mem, uint32_t size);
 #endif // __XALLOC_H__